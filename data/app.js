@@ -168,7 +168,9 @@ document.getElementById('mqtt-form').addEventListener('submit', function(e) {
         ssl: document.getElementById('mqtt-ssl').checked,
         username: document.getElementById('mqtt-user').value,
         password: document.getElementById('mqtt-pass').value,
-        topic: document.getElementById('mqtt-topic').value
+        topic: document.getElementById('mqtt-topic').value,
+        layout: document.getElementById('mqtt-layout').value,
+        qos: parseInt(document.getElementById('mqtt-qos').value)
     };
 
     config.mqtt = mqttConfig;
@@ -187,7 +189,10 @@ document.getElementById('mqtt-form').addEventListener('submit', function(e) {
                 'Generic MQTT mode configured successfully!',
                 [
                     'Inverter data will be published to your MQTT broker',
-                    'Topic format: ' + mqttConfig.topic + '/{dtu_id}/{inverter_serial}',
+                    'Topic format: ' + ({
+                        fields: mqttConfig.topic + '/{inverter_serial}/{channel}/{field}',
+                        batch: mqttConfig.topic + '/{dtu_id}/data'
+                    }[mqttConfig.layout] || mqttConfig.topic + '/{dtu_id}/{inverter_serial}'),
                     'Device will reboot and start polling inverters',
                     'Configure inverters from the dashboard'
                 ]
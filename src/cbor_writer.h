@@ -0,0 +1,88 @@
+/**
+ * CBOR Writer - Minimal CBOR (RFC 8949) encoder into a caller buffer
+ *
+ * Covers what the telemetry payloads need: unsigned and negative integers,
+ * maps and arrays of known length. Items are written in their shortest
+ * form. Nothing is allocated; when the buffer is too small the writer
+ * stops and ok() turns false.
+ */
+
+#ifndef CBOR_WRITER_H
+#define CBOR_WRITER_H
+
+#include <Arduino.h>
+
+class CborWriter {
+public:
+    CborWriter(uint8_t* buffer, size_t size)
+        : m_buffer(buffer)
+        , m_size(size)
+        , m_length(0)
+        , m_overflow(false)
+    {}
+
+    void writeMap(uint32_t pairs) { writeHead(CBOR_MAJOR_MAP, pairs); }
+    void writeArray(uint32_t items) { writeHead(CBOR_MAJOR_ARRAY, items); }
+
+    void writeUInt(uint64_t value) { writeHead(CBOR_MAJOR_UNSIGNED, value); }
+
+    void writeInt(int64_t value) {
+        if (value < 0) {
+            // Negative integers carry -1 - value
+            writeHead(CBOR_MAJOR_NEGATIVE, (uint64_t)(-1 - value));
+        } else {
+            writeHead(CBOR_MAJOR_UNSIGNED, (uint64_t)value);
+        }
+    }
+
+    size_t length() const { return m_length; }
+    bool ok() const { return !m_overflow; }
+
+private:
+    static constexpr uint8_t CBOR_MAJOR_UNSIGNED = 0;
+    static constexpr uint8_t CBOR_MAJOR_NEGATIVE = 1;
+    static constexpr uint8_t CBOR_MAJOR_ARRAY = 4;
+    static constexpr uint8_t CBOR_MAJOR_MAP = 5;
+
+    uint8_t* m_buffer;
+    size_t m_size;
+    size_t m_length;
+    bool m_overflow;
+
+    void writeHead(uint8_t major, uint64_t value) {
+        uint8_t type = major << 5;
+        uint8_t bytes;
+
+        if (value < 24) {
+            put(type | (uint8_t)value);
+            return;
+        } else if (value <= 0xFF) {
+            type |= 24;
+            bytes = 1;
+        } else if (value <= 0xFFFF) {
+            type |= 25;
+            bytes = 2;
+        } else if (value <= 0xFFFFFFFF) {
+            type |= 26;
+            bytes = 4;
+        } else {
+            type |= 27;
+            bytes = 8;
+        }
+
+        put(type);
+        for (int8_t i = bytes - 1; i >= 0; i--) {
+            put((uint8_t)(value >> (8 * i)));
+        }
+    }
+
+    void put(uint8_t byte) {
+        if (m_length < m_size) {
+            m_buffer[m_length++] = byte;
+        } else {
+            m_overflow = true;
+        }
+    }
+};
+
+#endif // CBOR_WRITER_H
@@ -24,14 +24,32 @@
 #define MQTT_DEFAULT_PORT 1883
 #define MQTT_DEFAULT_SSL_PORT 8883
 #define MQTT_DEFAULT_KEEPALIVE 60
+#define MQTT_DEFAULT_INFLIGHT_WINDOW 8  // QoS 1 messages sent before the first PUBACK
 #define MQTT_RECONNECT_INTERVAL 5000
 #define MQTT_MAX_RECONNECT_ATTEMPTS 10
 
+// ESP32 builds connect and send from a dedicated MQTT task, so a slow TLS
+// write or a blocking reconnect never holds up loop() or radio polling;
+// publish() only queues into the outbox (mqtt_outbox.h). [env:native]
+// defines MQTT_TASK as well and runs the task on the FreeRTOS shim.
+#if defined(ESP32) && !defined(MQTT_TASK)
+    #define MQTT_TASK
+#endif
+#ifdef MQTT_TASK
+    #define MQTT_TASK_STACK 8192        // TLS handshake
+    #define MQTT_TASK_PRIORITY 1        // Same as loop(), below the radio tasks
+    #define MQTT_TASK_CORE 0            // With the WiFi stack
+#endif
+
 // mypvlog.net Configuration
 #define MYPVLOG_API_URL "https://api.mypvlog.net"
 #define MYPVLOG_MQTT_BROKER "mqtt.mypvlog.net"
 #define MYPVLOG_MQTT_PORT 8883
 
+// Wall clock (UTC, via SNTP), used to align rollup windows
+#define NTP_SERVER "pool.ntp.org"
+#define NTP_VALID_AFTER 1700000000  // Unix time; earlier means not synchronized yet
+
 // SSL/TLS Configuration
 // Set to false to disable certificate validation (INSECURE - for testing only!)
 #ifndef MYPVLOG_SSL_VERIFY
@@ -60,6 +78,8 @@
 #ifdef RADIO_CMT2300A
     #define CMT2300A_CS_PIN 15
     #define CMT2300A_FCSB_PIN 4
+    #define CMT2300A_GPIO1_PIN 21
+    #define CMT2300A_GPIO2_PIN 22
     // Shares SPI bus with NRF24
 #endif
 
@@ -67,8 +87,31 @@
 #define HOYMILES_POLL_INTERVAL 5000     // Generic mode: 5 seconds
 #define HOYMILES_POLL_INTERVAL_FAST 2000 // mypvlog Direct mode: 2 seconds
 #define HOYMILES_MAX_INVERTERS 8
-#define HOYMILES_RETRY_ATTEMPTS 3
-#define HOYMILES_RESPONSE_TIMEOUT 1000
+#define HOYMILES_RETRY_ATTEMPTS 3         // Transmissions per poll (request + retransmits)
+#define HOYMILES_RESPONSE_TIMEOUT 1000    // Upper bound of the RTT-based response timeout (ms)
+
+// Dual-radio ESP32 builds poll HM and HMS from separate FreeRTOS tasks,
+// sharing the SPI bus through the SPI arbiter (spi_arbiter.h)
+#if (defined(ESP32) || defined(ESP32S3)) && defined(RADIO_NRF24) && defined(RADIO_CMT2300A)
+    #ifndef HOYMILES_RADIO_TASKS
+    #define HOYMILES_RADIO_TASKS
+    #endif
+    #define HOYMILES_RADIO_TASK_STACK 4096
+    #define HOYMILES_RADIO_TASK_PRIORITY 2    // Above loop() (1), so polls keep their timing
+    #define HOYMILES_RADIO_TASK_CORE 1
+#endif
+
+// NRF24 RX task (ESP32): the IRQ wakes a task that drains the radio FIFO into
+// the packet ring at once, so back-to-back fragments do not wait for the next
+// poll step (the NRF24 FIFO holds only 3 packets)
+#if (defined(ESP32) || defined(ESP32S3)) && defined(RADIO_NRF24)
+    #ifndef HOYMILES_RX_TASK
+    #define HOYMILES_RX_TASK
+    #endif
+    #define HOYMILES_RX_TASK_STACK 3072
+    #define HOYMILES_RX_TASK_PRIORITY 3       // Above the radio tasks (2) and loop() (1)
+    #define HOYMILES_RX_TASK_CORE 1
+#endif
 
 // LED Configuration
 #ifdef ESP32
@@ -79,15 +122,33 @@
 
 // Debug Configuration
 #define DEBUG_SERIAL Serial
+#ifndef DEBUG_ENABLED
 #define DEBUG_ENABLED true
+#endif
+
+// Log levels of the deferred logger (logger.h); records above LOG_LEVEL
+// are compiled out. Override with e.g. -D LOG_LEVEL=LOG_LEVEL_INFO
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+    #if DEBUG_ENABLED
+        #define LOG_LEVEL LOG_LEVEL_DEBUG
+    #else
+        #define LOG_LEVEL LOG_LEVEL_ERROR
+    #endif
+#endif
 
 #if DEBUG_ENABLED
-    #define DEBUG_PRINT(x) DEBUG_SERIAL.print(x)
-    #define DEBUG_PRINTLN(x) DEBUG_SERIAL.println(x)
+    #define DEBUG_PRINT(...) DEBUG_SERIAL.print(__VA_ARGS__)
+    #define DEBUG_PRINTLN(...) DEBUG_SERIAL.println(__VA_ARGS__)
     #define DEBUG_PRINTF(...) DEBUG_SERIAL.printf(__VA_ARGS__)
 #else
-    #define DEBUG_PRINT(x)
-    #define DEBUG_PRINTLN(x)
+    #define DEBUG_PRINT(...)
+    #define DEBUG_PRINTLN(...)
     #define DEBUG_PRINTF(...)
 #endif
 
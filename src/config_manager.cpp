@@ -71,6 +71,9 @@ MqttConfig ConfigManager::getMqttConfig() {
     config.username = configStorage.getString("mqtt_user", "");
     config.password = configStorage.getString("mqtt_pass", "");
     config.topic_prefix = configStorage.getString("mqtt_topic", "opendtu");
+    config.topic_layout = configStorage.getUChar("mqtt_layout", 0);
+    config.qos = configStorage.getUChar("mqtt_qos", 0);
+    config.inflight_window = configStorage.getUChar("mqtt_window", MQTT_DEFAULT_INFLIGHT_WINDOW);
 
     configStorage.end();
 
@@ -86,6 +89,9 @@ void ConfigManager::setMqttConfig(const MqttConfig& config) {
     configStorage.putString("mqtt_user", config.username);
     configStorage.putString("mqtt_pass", config.password);
     configStorage.putString("mqtt_topic", config.topic_prefix);
+    configStorage.putUChar("mqtt_layout", config.topic_layout);
+    configStorage.putUChar("mqtt_qos", config.qos);
+    configStorage.putUChar("mqtt_window", config.inflight_window);
 
     configStorage.end();
 
@@ -101,6 +107,7 @@ MyPVLogConfig ConfigManager::getMyPVLogConfig() {
     config.mqtt_username = configStorage.getString("pvlog_mqtt_user", "");
     config.mqtt_password = configStorage.getString("pvlog_mqtt_pass", "");
     config.api_token = configStorage.getString("pvlog_token", "");
+    config.payload_encoding = configStorage.getUChar("pvlog_encoding", 0);
 
     configStorage.end();
 
@@ -114,6 +121,7 @@ void ConfigManager::setMyPVLogConfig(const MyPVLogConfig& config) {
     configStorage.putString("pvlog_mqtt_user", config.mqtt_username);
     configStorage.putString("pvlog_mqtt_pass", config.mqtt_password);
     configStorage.putString("pvlog_token", config.api_token);
+    configStorage.putUChar("pvlog_encoding", config.payload_encoding);
 
     configStorage.end();
 
@@ -24,6 +24,9 @@ struct MqttConfig {
     String username;
     String password;
     String topic_prefix;
+    uint8_t topic_layout;   // InverterTopicLayout: 0 = JSON per inverter, 1 = per field, 2 = batch
+    uint8_t qos;            // Telemetry QoS, 0 or 1
+    uint8_t inflight_window;    // QoS 1 messages sent before the first PUBACK
 };
 
 // MyPVLog Configuration
@@ -32,6 +35,7 @@ struct MyPVLogConfig {
     String mqtt_username;
     String mqtt_password;
     String api_token;
+    uint8_t payload_encoding;   // InverterPayloadEncoding: 0 = JSON, 1 = CBOR
 };
 
 class ConfigManager {
@@ -0,0 +1,228 @@
+/**
+ * Energy Integrator - Per-channel energy counters from the power samples
+ */
+
+#include "energy_integrator.h"
+#include "logger.h"
+#include <Preferences.h>
+
+#ifdef ESP32
+#include <freertos/FreeRTOS.h>
+#include <esp_system.h>
+
+static portMUX_TYPE s_energyMux = portMUX_INITIALIZER_UNLOCKED;
+#define ENERGY_LOCK()       portENTER_CRITICAL(&s_energyMux)
+#define ENERGY_UNLOCK()     portEXIT_CRITICAL(&s_energyMux)
+#else
+// Single-threaded
+#define ENERGY_LOCK()
+#define ENERGY_UNLOCK()
+#endif
+
+#define ENERGY_NAMESPACE    "energy"
+#define ENERGY_KEY          "counters"
+
+// Instance written by the shutdown handler (plain function, no context)
+static EnergyIntegrator* s_shutdownInstance = nullptr;
+
+EnergyIntegrator::EnergyIntegrator()
+    : m_count(0)
+    , m_pending(0)
+    , m_dirty(false)
+    , m_lastCheckpoint(0)
+    , m_checkpoints(0)
+    , m_gapTime(0)
+{
+}
+
+void EnergyIntegrator::begin() {
+    Stored stored[ENERGY_MAX_INVERTERS];
+    size_t length = 0;
+
+    Preferences storage;
+    if (storage.begin(ENERGY_NAMESPACE, true)) {
+        length = storage.getBytesLength(ENERGY_KEY);
+        if (length > 0 && length <= sizeof(stored) && length % sizeof(Stored) == 0) {
+            length = storage.getBytes(ENERGY_KEY, stored, length);
+        } else {
+            length = 0;
+        }
+        storage.end();
+    }
+
+    ENERGY_LOCK();
+    m_count = 0;
+    for (size_t i = 0; i < length / sizeof(Stored); i++) {
+        Counter& counter = m_counters[m_count++];
+        memset(&counter, 0, sizeof(counter));
+        counter.serial = stored[i].serial;
+        memcpy(counter.energy, stored[i].energy, sizeof(counter.energy));
+    }
+    m_pending = 0;
+    m_dirty = false;
+    ENERGY_UNLOCK();
+
+    m_lastCheckpoint = millis();
+
+    DEBUG_PRINT("Energy Integrator: ");
+    DEBUG_PRINT(m_count);
+    DEBUG_PRINTLN(" inverter counters restored");
+
+#ifdef ESP32
+    if (!s_shutdownInstance) {
+        s_shutdownInstance = this;
+        esp_register_shutdown_handler(onShutdown);
+    }
+#endif
+}
+
+/**
+ * Counter of an inverter, created on its first sample
+ * @return Counter, or nullptr if the table is full
+ */
+EnergyIntegrator::Counter* EnergyIntegrator::counterFor(uint64_t serial) {
+    for (uint8_t i = 0; i < m_count; i++) {
+        if (m_counters[i].serial == serial) {
+            return &m_counters[i];
+        }
+    }
+
+    if (m_count >= ENERGY_MAX_INVERTERS) {
+        return nullptr;
+    }
+
+    Counter& counter = m_counters[m_count++];
+    memset(&counter, 0, sizeof(counter));
+    counter.serial = serial;
+    return &counter;
+}
+
+const EnergyIntegrator::Counter* EnergyIntegrator::find(uint64_t serial) const {
+    for (uint8_t i = 0; i < m_count; i++) {
+        if (m_counters[i].serial == serial) {
+            return &m_counters[i];
+        }
+    }
+    return nullptr;
+}
+
+void EnergyIntegrator::update(const InverterSample& sample) {
+    uint8_t channels = sample.data.dcChannels + 1;
+    if (channels > ENERGY_CHANNELS) {
+        channels = ENERGY_CHANNELS;
+    }
+
+    ENERGY_LOCK();
+    Counter* counter = counterFor(sample.serial);
+    if (!counter) {
+        ENERGY_UNLOCK();
+        LOG_ERROR("Energy Integrator: counter table full");
+        return;
+    }
+
+    uint32_t interval = sample.timestamp - counter->timestamp;
+    bool integrate = counter->running && interval > 0 && interval <= ENERGY_INTEGRATOR_MAX_GAP;
+    bool changed = false;
+    if (counter->running && interval > ENERGY_INTEGRATOR_MAX_GAP) {
+        m_gapTime += interval;
+    }
+
+    for (uint8_t ch = 0; ch < channels; ch++) {
+        // Power cannot be negative; a negative reading is a decoding artefact
+        int32_t power = sample.data.get(ch, FIELD_POWER);
+        if (power < 0) {
+            power = 0;
+        }
+
+        if (integrate) {
+            uint64_t energy = (uint64_t)(counter->power[ch] + power) * interval;
+            counter->energy[ch] += energy;
+            changed = changed || energy > 0;
+            if (ch == 0) {
+                m_pending += energy;
+            }
+        }
+        counter->power[ch] = power;
+    }
+
+    // A repeated timestamp (same response twice) keeps the interval start
+    if (!counter->running || interval > 0) {
+        counter->timestamp = sample.timestamp;
+    }
+    counter->running = true;
+    m_dirty = m_dirty || changed;
+    ENERGY_UNLOCK();
+}
+
+void EnergyIntegrator::loop() {
+    if (!m_dirty) {
+        return;
+    }
+
+    if (m_pending >= ENERGY_CHECKPOINT_WH * ENERGY_UNITS_PER_WH ||
+        (uint32_t)(millis() - m_lastCheckpoint) >= ENERGY_CHECKPOINT_INTERVAL) {
+        checkpoint();
+    }
+}
+
+bool EnergyIntegrator::checkpoint() {
+    Stored stored[ENERGY_MAX_INVERTERS];
+
+    // Snapshot under the lock, write outside of it
+    ENERGY_LOCK();
+    uint8_t count = m_count;
+    for (uint8_t i = 0; i < count; i++) {
+        stored[i].serial = m_counters[i].serial;
+        memcpy(stored[i].energy, m_counters[i].energy, sizeof(stored[i].energy));
+    }
+    uint64_t pending = m_pending;
+    ENERGY_UNLOCK();
+
+    m_lastCheckpoint = millis();
+    if (count == 0) {
+        return true;
+    }
+
+    Preferences storage;
+    size_t length = count * sizeof(Stored);
+    bool written = storage.begin(ENERGY_NAMESPACE, false) &&
+                   storage.putBytes(ENERGY_KEY, stored, length) == length;
+    storage.end();
+
+    if (!written) {
+        LOG_ERROR("Energy Integrator: checkpoint failed");
+        return false;
+    }
+
+    // Energy integrated while writing stays pending
+    ENERGY_LOCK();
+    m_pending -= pending;
+    m_dirty = m_pending > 0;
+    ENERGY_UNLOCK();
+
+    m_checkpoints++;
+    return true;
+}
+
+void EnergyIntegrator::onShutdown() {
+    if (s_shutdownInstance && s_shutdownInstance->m_dirty) {
+        s_shutdownInstance->checkpoint();
+    }
+}
+
+uint64_t EnergyIntegrator::getEnergyMilli(uint64_t serial, uint8_t channel) const {
+    if (channel >= ENERGY_CHANNELS) {
+        return 0;
+    }
+
+    ENERGY_LOCK();
+    const Counter* counter = find(serial);
+    uint64_t energy = counter ? counter->energy[channel] : 0;
+    ENERGY_UNLOCK();
+
+    return energy / (ENERGY_UNITS_PER_WH / 1000);
+}
+
+uint32_t EnergyIntegrator::getEnergy(uint64_t serial, uint8_t channel) const {
+    return (uint32_t)(getEnergyMilli(serial, channel) / 1000);
+}
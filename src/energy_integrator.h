@@ -0,0 +1,130 @@
+/**
+ * Energy Integrator - Per-channel energy counters from the power samples
+ *
+ * The inverters only report their yields in whole Wh (and the AC side not
+ * at all), so every sample's power is integrated here, per inverter and
+ * per channel (0 = AC, 1..n = DC inputs), with the trapezoidal rule over
+ * the sample timestamps. Counters are kept in fixed point (see
+ * ENERGY_UNITS_PER_WH) so nothing is lost to rounding between samples.
+ *
+ * Gaps: an interval longer than ENERGY_INTEGRATOR_MAX_GAP (inverter asleep
+ * or out of reach, samples dropped for a long time) is not integrated,
+ * because nothing is known about the power in between; its length is
+ * counted in getGapTime(). The next sample starts a new interval.
+ *
+ * Counters survive resets through checkpoints in NVS (namespace "energy",
+ * a single blob), written in batches: once the AC energy since the last
+ * checkpoint reaches ENERGY_CHECKPOINT_WH, or after ENERGY_CHECKPOINT_INTERVAL
+ * if anything changed at all. NVS spreads the writes over its pages
+ * itself, so the batching bounds the wear: a 0.5 KB write every 90 s at
+ * 8 kW around noon, about 250 on a good day and none at night. On ESP32 a
+ * checkpoint is also written on every orderly restart (esp_restart(): OTA,
+ * configuration changes).
+ * A brownout reset cannot be caught in time (and flash writes at low supply
+ * voltage are unsafe), so a power cut loses at most one checkpoint step.
+ *
+ * update() runs in loop(); the shutdown handler may run in another task
+ * (e.g. a restart requested over HTTP), hence the lock on ESP32.
+ */
+
+#ifndef ENERGY_INTEGRATOR_H
+#define ENERGY_INTEGRATOR_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "inverter_sample.h"
+
+#ifndef ENERGY_INTEGRATOR_MAX_GAP
+  #define ENERGY_INTEGRATOR_MAX_GAP     60000   // ms, longer intervals are not integrated
+#endif
+
+#ifndef ENERGY_CHECKPOINT_WH
+  #define ENERGY_CHECKPOINT_WH          200     // AC Wh (all inverters) between checkpoints
+#endif
+
+#ifndef ENERGY_CHECKPOINT_INTERVAL
+  #define ENERGY_CHECKPOINT_INTERVAL    900000  // ms, 15 minutes
+#endif
+
+// Counter unit: 0.1 W * 1 ms * 2 (trapezoid sums are not halved)
+#define ENERGY_UNITS_PER_WH             72000000ULL
+
+#define ENERGY_CHANNELS                 (HOYMILES_MAX_DC_CHANNELS + 1)
+
+// HM and HMS inverters are counted together on dual-radio builds
+#if defined(RADIO_NRF24) && defined(RADIO_CMT2300A)
+  #define ENERGY_MAX_INVERTERS          (2 * HOYMILES_MAX_INVERTERS)
+#else
+  #define ENERGY_MAX_INVERTERS          HOYMILES_MAX_INVERTERS
+#endif
+
+class EnergyIntegrator {
+public:
+    EnergyIntegrator();
+
+    /**
+     * Restore the counters of the last checkpoint
+     */
+    void begin();
+
+    /**
+     * Integrate one sample (samples of an inverter in timestamp order)
+     */
+    void update(const InverterSample& sample);
+
+    /**
+     * Write a checkpoint when one is due
+     */
+    void loop();
+
+    /**
+     * Write a checkpoint now
+     * @return false if NVS could not be written
+     */
+    bool checkpoint();
+
+    /**
+     * Energy of a channel since the counters were started
+     * @return Wh, 0 if the inverter is unknown
+     */
+    uint32_t getEnergy(uint64_t serial, uint8_t channel) const;
+
+    /**
+     * Same in mWh
+     */
+    uint64_t getEnergyMilli(uint64_t serial, uint8_t channel) const;
+
+    uint32_t getGapTime() const { return m_gapTime; }   // ms not integrated (since boot)
+    uint32_t getCheckpointCount() const { return m_checkpoints; }
+
+private:
+    struct Counter {
+        uint64_t serial;
+        uint64_t energy[ENERGY_CHANNELS];   // ENERGY_UNITS_PER_WH
+        int32_t power[ENERGY_CHANNELS];     // Last sample, 0.1 W
+        uint32_t timestamp;                 // Of the last sample
+        bool running;                       // power[] and timestamp are valid
+    };
+
+    // Checkpoint blob
+    struct Stored {
+        uint64_t serial;
+        uint64_t energy[ENERGY_CHANNELS];
+    };
+
+    Counter m_counters[ENERGY_MAX_INVERTERS];
+    uint8_t m_count;
+
+    uint64_t m_pending;             // AC energy since the last checkpoint
+    bool m_dirty;
+    uint32_t m_lastCheckpoint;      // millis()
+    uint32_t m_checkpoints;
+    uint32_t m_gapTime;
+
+    Counter* counterFor(uint64_t serial);
+    const Counter* find(uint64_t serial) const;
+
+    static void onShutdown();
+};
+
+#endif // ENERGY_INTEGRATOR_H
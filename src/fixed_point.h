@@ -0,0 +1,65 @@
+/**
+ * Fixed Point - Decimal formatting of scaled integer values
+ *
+ * Telemetry is carried as integers in native scaled units (e.g. 0.1 W,
+ * 0.01 A) and only turned into text here, at the output edge. This avoids
+ * soft-float division and float printing on targets without an FPU.
+ */
+
+#ifndef FIXED_POINT_H
+#define FIXED_POINT_H
+
+#include <Arduino.h>
+
+static constexpr int32_t FIXED_POINT_POW10[] = { 1, 10, 100, 1000, 10000 };
+
+/**
+ * Format a scaled integer as decimal text
+ *
+ * formatFixedPoint(buf, sizeof(buf), 12345, 1) -> "1234.5"
+ * formatFixedPoint(buf, sizeof(buf), -5, 2)    -> "-0.05"
+ *
+ * @param buffer Output buffer (12 + decimals bytes always suffice)
+ * @param size Buffer size
+ * @param value Scaled value
+ * @param decimals Number of fractional digits (0-4)
+ * @return Length written (without terminator), 0 if the buffer is too small
+ */
+inline size_t formatFixedPoint(char* buffer, size_t size, int32_t value, uint8_t decimals) {
+    char digits[16];
+    uint8_t count = 0;
+
+    // Work on the magnitude as unsigned to cover INT32_MIN
+    bool negative = value < 0;
+    uint32_t magnitude = negative ? 0u - (uint32_t)value : (uint32_t)value;
+
+    // Digits in reverse order, at least one integer digit
+    do {
+        digits[count++] = '0' + magnitude % 10;
+        magnitude /= 10;
+    } while (magnitude > 0 || count <= decimals);
+
+    size_t length = count + negative + (decimals > 0 ? 1 : 0);
+    if (length + 1 > size) {
+        if (size > 0) {
+            buffer[0] = '\0';
+        }
+        return 0;
+    }
+
+    char* out = buffer;
+    if (negative) {
+        *out++ = '-';
+    }
+    while (count > 0) {
+        if (count == decimals) {
+            *out++ = '.';
+        }
+        *out++ = digits[--count];
+    }
+    *out = '\0';
+
+    return length;
+}
+
+#endif // FIXED_POINT_H
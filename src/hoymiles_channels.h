@@ -0,0 +1,184 @@
+/**
+ * Hoymiles Channels - Per-inverter channel statistics for NRF24 hopping
+ *
+ * HM inverters are reachable on the 3/23/40/61/75 hop set. Every inverter
+ * keeps a smoothed success score per channel; polls go out on the best
+ * channel, failures push the score down until another channel takes over.
+ * Every HOYMILES_HOP_EXPLORE_EVERY polls one poll goes to one of the other
+ * channels in turn, so a channel that recovers is noticed again.
+ *
+ * Receiving follows the inverter's hop pattern: it answers on the channel
+ * after the one the request went out on and moves one channel on with
+ * every packet. The DTU listens there first and moves along with each
+ * packet heard, or once a packet is overdue (lost on the air, the
+ * inverter has moved on anyway). The first packet is overdue a little
+ * after its usual delay, learned from the answers heard. Every RX channel
+ * keeps its own counts and score of packets heard versus packets
+ * expected there.
+ */
+
+#ifndef HOYMILES_CHANNELS_H
+#define HOYMILES_CHANNELS_H
+
+#include <Arduino.h>
+
+#define HOYMILES_HOP_CHANNEL_COUNT  5
+#define HOYMILES_HOP_EXPLORE_EVERY  16      // Polls between exploration polls
+
+// Score scale: 1024 = every attempt succeeded, smoothed over ~8 attempts
+#define HOYMILES_HOP_SCORE_MAX      1024
+#define HOYMILES_HOP_SCORE_SHIFT    3
+
+static constexpr uint8_t HOYMILES_HOP_CHANNELS[HOYMILES_HOP_CHANNEL_COUNT] = { 3, 23, 40, 61, 75 };
+
+class HoymilesChannelStats {
+public:
+    HoymilesChannelStats() { reset(); }
+
+    /**
+     * Forget everything; channel 40 (the former fixed channel) starts ahead
+     */
+    void reset() {
+        for (uint8_t i = 0; i < HOYMILES_HOP_CHANNEL_COUNT; i++) {
+            m_score[i] = HOYMILES_HOP_SCORE_MAX / 2;
+            m_attempts[i] = 0;
+            m_successes[i] = 0;
+            m_rxScore[i] = HOYMILES_HOP_SCORE_MAX / 2;
+            m_rxAttempts[i] = 0;
+            m_rxSuccesses[i] = 0;
+        }
+        m_score[2] += 1;
+        m_current = 2;
+        m_explore = 2;
+        m_polls = 0;
+        m_rxCurrent = 3;
+        m_rxFollowing = false;
+        m_rxDelay = 0;
+    }
+
+    /**
+     * Pick the channel for a new poll
+     * @return Channel number
+     */
+    uint8_t select() {
+        m_polls++;
+        m_current = best();
+        if (m_polls % HOYMILES_HOP_EXPLORE_EVERY == 0) {
+            m_explore = (m_explore + 1) % HOYMILES_HOP_CHANNEL_COUNT;
+            if (m_explore == m_current) {
+                m_explore = (m_explore + 1) % HOYMILES_HOP_CHANNEL_COUNT;
+            }
+            m_current = m_explore;
+        }
+        return HOYMILES_HOP_CHANNELS[m_current];
+    }
+
+    /**
+     * Move to the best channel other than the current one (retry after a miss)
+     * @return Channel number
+     */
+    uint8_t hop() {
+        uint8_t next = m_current == 0 ? 1 : 0;
+        for (uint8_t i = 0; i < HOYMILES_HOP_CHANNEL_COUNT; i++) {
+            if (i != m_current && m_score[i] > m_score[next]) {
+                next = i;
+            }
+        }
+        m_current = next;
+        return HOYMILES_HOP_CHANNELS[m_current];
+    }
+
+    /**
+     * Record the outcome of an attempt on the current channel
+     */
+    void record(bool success) {
+        int16_t target = success ? HOYMILES_HOP_SCORE_MAX : 0;
+        m_score[m_current] += (target - m_score[m_current]) >> HOYMILES_HOP_SCORE_SHIFT;
+        m_attempts[m_current]++;
+        if (success) {
+            m_successes[m_current]++;
+        }
+    }
+
+    /**
+     * Start listening for the answer to a transmission on the current channel
+     * @return RX channel of the answer's first packet
+     */
+    uint8_t beginRx() {
+        m_rxCurrent = (m_current + 1) % HOYMILES_HOP_CHANNEL_COUNT;
+        m_rxFollowing = false;
+        return HOYMILES_HOP_CHANNELS[m_rxCurrent];
+    }
+
+    /**
+     * Record a packet heard on the RX channel (true) or one that did not
+     * arrive in time (false), then follow the inverter to its next channel
+     * @return RX channel
+     */
+    uint8_t nextRx(bool heard) {
+        int16_t target = heard ? HOYMILES_HOP_SCORE_MAX : 0;
+        m_rxScore[m_rxCurrent] += (target - m_rxScore[m_rxCurrent]) >> HOYMILES_HOP_SCORE_SHIFT;
+        m_rxAttempts[m_rxCurrent]++;
+        if (heard) {
+            m_rxSuccesses[m_rxCurrent]++;
+        }
+        m_rxFollowing = true;
+        m_rxCurrent = (m_rxCurrent + 1) % HOYMILES_HOP_CHANNEL_COUNT;
+        return HOYMILES_HOP_CHANNELS[m_rxCurrent];
+    }
+
+    /**
+     * true once a packet of the current answer was heard or skipped: its
+     * timing is known, an overdue packet can be skipped
+     */
+    bool isFollowingRx() const { return m_rxFollowing; }
+
+    /**
+     * Delay from a transmission to the first packet of its answer (ms),
+     * smoothed over ~4 answers
+     */
+    void timeFirstRx(uint16_t delay) {
+        m_rxDelay = m_rxDelay ? (uint16_t)((3 * m_rxDelay + delay + 2) / 4) : delay;
+    }
+
+    /**
+     * @return Usual delay of the first packet (ms), 0 before the first answer
+     */
+    uint16_t getFirstRxDelay() const { return m_rxDelay; }
+
+    uint8_t getChannel() const { return HOYMILES_HOP_CHANNELS[m_current]; }
+    int16_t getScore(uint8_t slot) const { return m_score[slot]; }
+    uint16_t getAttempts(uint8_t slot) const { return m_attempts[slot]; }
+    uint16_t getSuccesses(uint8_t slot) const { return m_successes[slot]; }
+
+    uint8_t getRxChannel() const { return HOYMILES_HOP_CHANNELS[m_rxCurrent]; }
+    int16_t getRxScore(uint8_t slot) const { return m_rxScore[slot]; }
+    uint16_t getRxAttempts(uint8_t slot) const { return m_rxAttempts[slot]; }
+    uint16_t getRxSuccesses(uint8_t slot) const { return m_rxSuccesses[slot]; }
+
+private:
+    int16_t m_score[HOYMILES_HOP_CHANNEL_COUNT];
+    uint16_t m_attempts[HOYMILES_HOP_CHANNEL_COUNT];
+    uint16_t m_successes[HOYMILES_HOP_CHANNEL_COUNT];
+    int16_t m_rxScore[HOYMILES_HOP_CHANNEL_COUNT];
+    uint16_t m_rxAttempts[HOYMILES_HOP_CHANNEL_COUNT];     // Packets expected
+    uint16_t m_rxSuccesses[HOYMILES_HOP_CHANNEL_COUNT];    // Packets heard
+    uint8_t m_current;      // Slot in HOYMILES_HOP_CHANNELS
+    uint8_t m_explore;      // Slot of the last exploration poll
+    uint8_t m_polls;
+    uint16_t m_rxDelay;     // First packet of an answer, ms after the transmission
+    uint8_t m_rxCurrent;    // Slot the DTU listens on
+    bool m_rxFollowing;
+
+    uint8_t best() const {
+        uint8_t best = 0;
+        for (uint8_t i = 1; i < HOYMILES_HOP_CHANNEL_COUNT; i++) {
+            if (m_score[i] > m_score[best]) {
+                best = i;
+            }
+        }
+        return best;
+    }
+};
+
+#endif // HOYMILES_CHANNELS_H
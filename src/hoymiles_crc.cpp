@@ -0,0 +1,122 @@
+/**
+ * Hoymiles CRC - Compile-time generated lookup tables
+ */
+
+#include "hoymiles_crc.h"
+
+#if defined(ESP8266)
+    #define HOYMILES_CRC_TABLE_ATTR PROGMEM
+#elif defined(ESP32)
+    #define HOYMILES_CRC_TABLE_ATTR DRAM_ATTR
+#else
+    #define HOYMILES_CRC_TABLE_ATTR
+#endif
+
+namespace {
+
+// Reference bit-at-a-time implementations (the former HoymilesProtocol code)
+constexpr uint8_t crc8Bitwise(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            crc = (crc & 0x01) ? (crc >> 1) ^ 0x8C : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+constexpr uint16_t crc16Bitwise(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            crc = (crc & 0x0001) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+constexpr HoymilesCrc8Table makeCrc8Table() {
+    HoymilesCrc8Table table = {};
+    for (uint16_t i = 0; i < 256; i++) {
+        uint8_t byte = (uint8_t)i;
+        table.entries[i] = crc8Bitwise(&byte, 1);
+    }
+    return table;
+}
+
+constexpr HoymilesCrc16Table makeCrc16Table() {
+    HoymilesCrc16Table table = {};
+    for (uint16_t i = 0; i < 256; i++) {
+        uint16_t crc = i;
+        for (uint8_t j = 0; j < 8; j++) {
+            crc = (crc & 0x0001) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+        table.entries[i] = crc;
+    }
+    return table;
+}
+
+constexpr HoymilesCrc8Table CRC8_TABLE = makeCrc8Table();
+constexpr HoymilesCrc16Table CRC16_TABLE = makeCrc16Table();
+
+// Table-driven kernels as used by HoymilesProtocol, evaluated at compile time
+constexpr uint8_t crc8Table(const uint8_t* data, size_t len) {
+    uint8_t crc = 0;
+    for (size_t i = 0; i < len; i++) {
+        crc = CRC8_TABLE.entries[crc ^ data[i]];
+    }
+    return crc;
+}
+
+constexpr uint16_t crc16Table(const uint8_t* data, size_t len) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < len; i++) {
+        crc = (crc >> 8) ^ CRC16_TABLE.entries[(crc ^ data[i]) & 0xFF];
+    }
+    return crc;
+}
+
+// Known-answer checks: standard check string, a realtime request and a
+// long pattern covering every table entry
+constexpr uint8_t CHECK_STRING[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+constexpr uint8_t CHECK_REQUEST[] = {
+    0x00, 0x2A, 0x0B, 0x47, 0x9B, 0x3C, 0xB9, 0x72, 0x21, 0x23, 0x45
+};
+
+struct CheckPattern {
+    uint8_t bytes[256];
+};
+
+constexpr CheckPattern makeCheckPattern() {
+    CheckPattern pattern = {};
+    for (uint16_t i = 0; i < 256; i++) {
+        pattern.bytes[i] = (uint8_t)(i * 167 + 13);
+    }
+    return pattern;
+}
+
+constexpr CheckPattern CHECK_PATTERN = makeCheckPattern();
+
+static_assert(crc8Bitwise(CHECK_STRING, sizeof(CHECK_STRING)) == 0xA1, "CRC8 reference check value");
+static_assert(crc16Bitwise(CHECK_STRING, sizeof(CHECK_STRING)) == 0x4B37, "CRC16 reference check value");
+
+static_assert(crc8Table(CHECK_STRING, sizeof(CHECK_STRING)) ==
+              crc8Bitwise(CHECK_STRING, sizeof(CHECK_STRING)), "CRC8 table mismatch");
+static_assert(crc8Table(CHECK_REQUEST, sizeof(CHECK_REQUEST)) ==
+              crc8Bitwise(CHECK_REQUEST, sizeof(CHECK_REQUEST)), "CRC8 table mismatch");
+static_assert(crc8Table(CHECK_PATTERN.bytes, sizeof(CHECK_PATTERN.bytes)) ==
+              crc8Bitwise(CHECK_PATTERN.bytes, sizeof(CHECK_PATTERN.bytes)), "CRC8 table mismatch");
+
+static_assert(crc16Table(CHECK_STRING, sizeof(CHECK_STRING)) ==
+              crc16Bitwise(CHECK_STRING, sizeof(CHECK_STRING)), "CRC16 table mismatch");
+static_assert(crc16Table(CHECK_REQUEST, sizeof(CHECK_REQUEST)) ==
+              crc16Bitwise(CHECK_REQUEST, sizeof(CHECK_REQUEST)), "CRC16 table mismatch");
+static_assert(crc16Table(CHECK_PATTERN.bytes, sizeof(CHECK_PATTERN.bytes)) ==
+              crc16Bitwise(CHECK_PATTERN.bytes, sizeof(CHECK_PATTERN.bytes)), "CRC16 table mismatch");
+
+} // namespace
+
+const HoymilesCrc8Table HOYMILES_CRC8_TABLE HOYMILES_CRC_TABLE_ATTR = CRC8_TABLE;
+const HoymilesCrc16Table HOYMILES_CRC16_TABLE HOYMILES_CRC_TABLE_ATTR = CRC16_TABLE;
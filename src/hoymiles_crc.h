@@ -0,0 +1,37 @@
+/**
+ * Hoymiles CRC - Lookup tables for CRC8 and CRC16
+ *
+ * Both tables are generated at compile time from the bitwise definitions
+ * and checked against them (see hoymiles_crc.cpp).
+ * - ESP8266: stored in flash (PROGMEM), read with pgm_read_*
+ * - ESP32:   stored in internal DRAM, safe to use with the flash cache
+ *            disabled (ISR, flash writes)
+ */
+
+#ifndef HOYMILES_CRC_H
+#define HOYMILES_CRC_H
+
+#include <Arduino.h>
+
+// CRC8, polynomial 0x01 (reflected 0x8C), init 0x00
+struct HoymilesCrc8Table {
+    uint8_t entries[256];
+};
+
+// CRC16 Modbus, polynomial 0x8005 (reflected 0xA001), init 0xFFFF
+struct HoymilesCrc16Table {
+    uint16_t entries[256];
+};
+
+extern const HoymilesCrc8Table HOYMILES_CRC8_TABLE;
+extern const HoymilesCrc16Table HOYMILES_CRC16_TABLE;
+
+#ifdef ESP8266
+    #define HOYMILES_CRC8_LOOKUP(i)  pgm_read_byte(&HOYMILES_CRC8_TABLE.entries[i])
+    #define HOYMILES_CRC16_LOOKUP(i) pgm_read_word(&HOYMILES_CRC16_TABLE.entries[i])
+#else
+    #define HOYMILES_CRC8_LOOKUP(i)  (HOYMILES_CRC8_TABLE.entries[i])
+    #define HOYMILES_CRC16_LOOKUP(i) (HOYMILES_CRC16_TABLE.entries[i])
+#endif
+
+#endif // HOYMILES_CRC_H
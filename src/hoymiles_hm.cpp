@@ -7,81 +7,133 @@
 
 #include "hoymiles_hm.h"
 #include "config.h"
+#include "logger.h"
 
 #ifdef RADIO_NRF24
+#include "hoymiles_radio_nrf24.h"
+#endif
 
 HoymilesHM::HoymilesHM()
-    : m_lastPoll(0)
-    , m_pollInterval(HOYMILES_POLL_INTERVAL)
+    : m_scheduler(HOYMILES_POLL_INTERVAL)
     , m_inverterCount(0)
+    , m_pollState(PollState::IDLE)
+    , m_pollIndex(0)
+    , m_stateEntered(0)
+    , m_retransmissions(0)
+    , m_responseTimeout(HOYMILES_HM_RX_TIMEOUT)
+    , m_rxHopped(0)
+#ifdef HOYMILES_RX_TASK
+    , m_rxTask(nullptr)
+#endif
     , m_radio(nullptr)
+    , m_radioReady(false)
+    , m_cycleEnd(nullptr)
+    , m_cycleEndContext(nullptr)
 {
     // Initialize inverter list
     for (uint8_t i = 0; i < HOYMILES_MAX_INVERTERS; i++) {
         m_inverters[i] = 0;
+        m_models[i] = nullptr;
+        m_samples[i].reset(0, nullptr);
     }
 }
 
 void HoymilesHM::begin() {
     DEBUG_PRINTLN("Hoymiles HM: Initializing...");
 
-    // Create RF24 instance
-    m_radio = new RF24(NRF24_CE_PIN, NRF24_CS_PIN);
+#ifdef RADIO_NRF24
+    if (!m_radio) {
+        m_radio = new NRF24Radio();
+    }
+#endif
 
-    // Initialize radio
-    if (!m_radio->begin()) {
-        DEBUG_PRINTLN("Hoymiles HM: ERROR - NRF24 initialization failed!");
+    if (!m_radio || !m_radio->begin()) {
+        DEBUG_PRINTLN("Hoymiles HM: ERROR - Radio initialization failed!");
         return;
     }
+    m_radioReady = true;
+    startRxTask();
 
-    // Configure NRF24 for Hoymiles communication
-    // Hoymiles uses channel 40 (2440 MHz)
-    m_radio->setChannel(40);
-
-    // Use 250kbps for better range (Hoymiles inverters use this)
-    m_radio->setDataRate(RF24_250KBPS);
-
-    // Maximum PA level for long range
-    m_radio->setPALevel(RF24_PA_MAX);
-
-    // Disable auto-acknowledgment (Hoymiles doesn't use it)
-    m_radio->setAutoAck(false);
+    DEBUG_PRINT("Hoymiles HM: Initialized successfully (");
+    DEBUG_PRINT(m_radio->getName());
+    DEBUG_PRINTLN(")");
+}
 
-    // Use 16-bit CRC
-    m_radio->setCRCLength(RF24_CRC_16);
+void HoymilesHM::loop() {
+    if (!m_radioReady) {
+        return;  // Not initialized
+    }
 
-    // Enable dynamic payloads
-    m_radio->enableDynamicPayloads();
+    // With an RX task the ring is filled as packets arrive
+    if (!hasRxTask()) {
+        serviceRx();
+    }
+    stepPollCycle(millis());
+}
 
-    // Set retry delay and count
-    m_radio->setRetries(15, 15);  // Max delay, max retries
+/**
+ * Drain the radio from a task woken by its receive interrupt (ESP32).
+ * Falls back to polling from loop() if the task cannot be created or the
+ * backend has no interrupt (IRQ pin not connected, simulator).
+ */
+void HoymilesHM::startRxTask() {
+#ifdef HOYMILES_RX_TASK
+    if (xTaskCreatePinnedToCore(rxTaskMain, "hoymiles_rx", HOYMILES_RX_TASK_STACK, this,
+                                HOYMILES_RX_TASK_PRIORITY, &m_rxTask, HOYMILES_RX_TASK_CORE) != pdPASS) {
+        m_rxTask = nullptr;
+        DEBUG_PRINTLN("Hoymiles HM: ERROR - cannot start RX task, polling the radio");
+        return;
+    }
 
-    // Open reading pipe 0 (for receiving responses)
-    uint8_t rxAddress[5] = {0xCC, 0xCC, 0xCC, 0xCC, 0xCC};
-    m_radio->openReadingPipe(0, rxAddress);
+    if (!m_radio->setRxTask(m_rxTask)) {
+        vTaskDelete(m_rxTask);
+        m_rxTask = nullptr;
+        return;
+    }
 
-    // Start listening for responses
-    m_radio->startListening();
+    // A packet latched before the task was registered raised no notification
+    xTaskNotifyGive(m_rxTask);
+    DEBUG_PRINTLN("Hoymiles HM: RX drained by the interrupt-driven RX task");
+#endif
+}
 
-    DEBUG_PRINTLN("Hoymiles HM: Initialized successfully");
-    DEBUG_PRINT("  Channel: ");
-    DEBUG_PRINTLN(m_radio->getChannel());
-    DEBUG_PRINT("  Data Rate: ");
-    DEBUG_PRINTLN(m_radio->getDataRate() == RF24_250KBPS ? "250kbps" : "Unknown");
-    DEBUG_PRINT("  PA Level: ");
-    DEBUG_PRINTLN(m_radio->getPALevel());
+bool HoymilesHM::hasRxTask() const {
+#ifdef HOYMILES_RX_TASK
+    return m_rxTask != nullptr;
+#else
+    return false;
+#endif
 }
 
-void HoymilesHM::loop() {
-    if (!m_radio) {
-        return;  // Not initialized
+#ifdef HOYMILES_RX_TASK
+void HoymilesHM::rxTaskMain(void* context) {
+    HoymilesHM* self = static_cast<HoymilesHM*>(context);
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        self->serviceRx();
     }
+}
+#endif
 
-    unsigned long now = millis();
+/**
+ * Move all received frames from the radio into the packet ring (the ring's
+ * only producer: the RX task, or loop() without one)
+ */
+void HoymilesHM::serviceRx() {
+    while (m_radio->available()) {
+        auto* slot = m_rxRing.reserve();
+        if (!slot) {
+            // Ring full: read and discard so the radio keeps accepting
+            uint8_t discard[HOYMILES_HM_MAX_FRAME_SIZE];
+            m_radio->read(discard, sizeof(discard));
+            continue;
+        }
 
-    if (now - m_lastPoll > m_pollInterval) {
-        m_lastPoll = now;
-        pollInverters();
+        uint8_t len = m_radio->read(slot->data, sizeof(slot->data));
+        if (len > 0) {
+            slot->length = len;
+            m_rxRing.commit();
+        }
     }
 }
 
@@ -101,12 +153,19 @@ bool HoymilesHM::addInverter(uint64_t serialNumber) {
 
     // Add to list
     m_inverters[m_inverterCount] = serialNumber;
+    m_models[m_inverterCount] = findHoymilesModel(serialNumber, HOYMILES_MODEL_DEFAULT_HM);
+    m_sessions[m_inverterCount] = HoymilesSession(HOYMILES_HM_RX_TIMEOUT);
+    m_channels[m_inverterCount].reset();
+    m_samples[m_inverterCount].reset(serialNumber, m_models[m_inverterCount]);
+    m_scheduler.add(m_inverterCount, millis());
     m_inverterCount++;
 
     DEBUG_PRINT("Hoymiles HM: Added inverter #");
     DEBUG_PRINT(m_inverterCount);
     DEBUG_PRINT(" with serial ");
     DEBUG_PRINTLN((unsigned long)(serialNumber & 0xFFFFFFFF));
+    DEBUG_PRINT("  Model: ");
+    DEBUG_PRINTLN(m_models[m_inverterCount - 1]->name);
 
     return true;
 }
@@ -118,8 +177,14 @@ void HoymilesHM::removeInverter(uint64_t serialNumber) {
             // Shift remaining inverters down
             for (uint8_t j = i; j < m_inverterCount - 1; j++) {
                 m_inverters[j] = m_inverters[j + 1];
+                m_models[j] = m_models[j + 1];
+                m_sessions[j] = m_sessions[j + 1];
+                m_channels[j] = m_channels[j + 1];
+                m_samples[j] = m_samples[j + 1];
             }
             m_inverters[m_inverterCount - 1] = 0;
+            m_sessions[m_inverterCount - 1] = HoymilesSession(HOYMILES_HM_RX_TIMEOUT);
+            m_scheduler.remove(i);
             m_inverterCount--;
 
             DEBUG_PRINT("Hoymiles HM: Removed inverter ");
@@ -136,176 +201,326 @@ uint8_t HoymilesHM::getInverterCount() {
 }
 
 void HoymilesHM::setPollInterval(uint16_t interval) {
-    m_pollInterval = interval;
+    m_scheduler.setBaseInterval(interval);
     DEBUG_PRINT("Hoymiles HM: Poll interval set to ");
-    DEBUG_PRINT(m_pollInterval);
+    DEBUG_PRINT(interval);
     DEBUG_PRINTLN("ms");
 }
 
-void HoymilesHM::pollInverters() {
-    if (!m_radio || m_inverterCount == 0) {
+void HoymilesHM::setPollState(PollState state) {
+    m_pollState = state;
+    m_stateEntered = millis();
+}
+
+/**
+ * Advance the poll cycle by one step
+ *
+ * Each call performs at most one bounded unit of work (one TX, one RX
+ * FIFO read or one parse) and returns, so loop() never stalls for the
+ * duration of a full poll cycle. MQTT, DNS and heartbeats keep running
+ * between the steps.
+ */
+void HoymilesHM::stepPollCycle(unsigned long now) {
+    // Inverter list may shrink while a cycle is in progress
+    if (m_pollState != PollState::IDLE && m_pollIndex >= m_inverterCount) {
+        setPollState(PollState::IDLE);
         return;
     }
 
-    DEBUG_PRINT("Hoymiles HM: Polling ");
-    DEBUG_PRINT(m_inverterCount);
-    DEBUG_PRINTLN(" inverter(s)...");
+    switch (m_pollState) {
+        case PollState::IDLE: {
+            int8_t next = m_scheduler.nextDue(now);
+            if (next >= 0) {
+                m_pollIndex = next;
+                setPollState(PollState::SEND_REQUEST);
+            } else if (m_scheduler.endCycle(now) && m_cycleEnd) {
+                m_cycleEnd(m_cycleEndContext);
+            }
+            break;
+        }
 
-    // Poll each inverter
-    for (uint8_t i = 0; i < m_inverterCount; i++) {
-        uint64_t serial = m_inverters[i];
-
-        DEBUG_PRINT("  [");
-        DEBUG_PRINT(i + 1);
-        DEBUG_PRINT("/");
-        DEBUG_PRINT(m_inverterCount);
-        DEBUG_PRINT("] Polling ");
-        DEBUG_PRINTLN((unsigned long)(serial & 0xFFFFFFFF));
-
-        // Send request
-        sendRequest(serial);
-
-        // Wait for response
-        if (receiveResponse(serial)) {
-            DEBUG_PRINTLN("    Success!");
-        } else {
-            DEBUG_PRINTLN("    Timeout/No response");
+        case PollState::SEND_REQUEST: {
+            uint64_t serial = m_inverters[m_pollIndex];
+
+            m_retransmissions = 0;
+            m_radio->setChannel(m_channels[m_pollIndex].select());
+
+            LOG_INFO("  [%u/%u] Polling %u (%s, channel %u)",
+                     m_pollIndex + 1, m_inverterCount, (uint32_t)(serial & 0xFFFFFFFF),
+                     HoymilesScheduler::stateName(m_scheduler.getState(m_pollIndex)),
+                     m_channels[m_pollIndex].getChannel());
+
+            sendRequest(m_pollIndex);
+            waitForResponse();
+            break;
+        }
+
+        case PollState::RETRY_REQUEST:
+            m_retransmissions++;
+            m_radio->setChannel(m_channels[m_pollIndex].hop());
+            LOG_INFO("    Retrying on channel %u", m_channels[m_pollIndex].getChannel());
+
+            sendRequest(m_pollIndex);
+            waitForResponse();
+            break;
+
+        case PollState::WAIT_RESPONSE:
+            if (!m_rxRing.empty()) {
+                m_pollState = PollState::PARSE_RESPONSE;  // Keep the wait start time
+            } else if (now - m_stateEntered >= m_responseTimeout) {
+                const HoymilesSession& session = m_sessions[m_pollIndex];
+                bool canRetry = !m_scheduler.isProbe(m_pollIndex) &&
+                                m_retransmissions + 1 < HOYMILES_RETRY_ATTEMPTS;
+                if (session.assembler.hasFragments() && canRetry &&
+                    session.fragmentRetries < HOYMILES_MAX_FRAGMENT_RETRIES) {
+                    setPollState(PollState::REQUEST_FRAGMENT);
+                } else if (!session.assembler.hasFragments() && canRetry) {
+                    // Nothing heard on this channel: count the miss, try another
+                    m_channels[m_pollIndex].record(false);
+                    setPollState(PollState::RETRY_REQUEST);
+                } else {
+                    LOG_INFO("    Timeout/No response");
+                    finishPoll(false, now);
+                }
+            } else if (isRxOverdue(now)) {
+                // Lost on the air, the inverter has moved on anyway
+                LOG_DEBUG("    RX: Nothing on channel %u", m_channels[m_pollIndex].getRxChannel());
+                m_radio->setChannel(m_channels[m_pollIndex].nextRx(false));
+                m_rxHopped = now;
+            }
+            break;
+
+        case PollState::PARSE_RESPONSE: {
+            // Fragments are routed to their sender's session, so a late
+            // answer from a previously polled inverter is still used
+            const auto* slot = m_rxRing.peek();
+            HoymilesFragmentAssembler::Result result;
+            int8_t index = handleFragment(slot->data, slot->length, result);
+            m_rxRing.pop();
+
+            if (index == m_pollIndex && result != HoymilesFragmentAssembler::Result::INVALID) {
+                // Heard: the next packet of the answer comes on the next channel
+                HoymilesChannelStats& channels = m_channels[m_pollIndex];
+                if (!channels.isFollowingRx()) {
+                    channels.timeFirstRx(now - m_stateEntered);
+                }
+                m_radio->setChannel(channels.nextRx(true));
+                m_rxHopped = now;
+            }
+
+            bool complete = result == HoymilesFragmentAssembler::Result::COMPLETE;
+            const HoymilesSession& session = m_sessions[m_pollIndex];
+
+            if (complete && index == m_pollIndex) {
+                finishPoll(completeResponse(index), now);
+            } else if (complete) {
+                // Late answer to an earlier poll of another inverter
+                if (completeResponse(index)) {
+                    m_channels[index].record(true);
+                    m_scheduler.onSuccess(index, now);
+                }
+                m_pollState = PollState::WAIT_RESPONSE;
+            } else if (index == m_pollIndex && result == HoymilesFragmentAssembler::Result::INCOMPLETE &&
+                       session.assembler.hasLastFragment() && m_rxRing.empty() &&
+                       !m_scheduler.isProbe(m_pollIndex) &&
+                       m_retransmissions + 1 < HOYMILES_RETRY_ATTEMPTS &&
+                       session.fragmentRetries < HOYMILES_MAX_FRAGMENT_RETRIES) {
+                // Final fragment seen but gaps remain: fetch only those
+                setPollState(PollState::REQUEST_FRAGMENT);
+            } else {
+                // Keep listening until the timeout expires
+                m_pollState = PollState::WAIT_RESPONSE;
+            }
+            break;
         }
 
-        // Small delay between inverters
-        delay(50);
+        case PollState::REQUEST_FRAGMENT:
+            m_retransmissions++;
+            m_radio->setChannel(m_channels[m_pollIndex].getChannel());
+            sendFragmentRequest(m_pollIndex, m_sessions[m_pollIndex].assembler.getMissingFragment());
+            waitForResponse();
+            break;
+
+        case PollState::NEXT_INVERTER:
+            // Small gap between inverters
+            if (now - m_stateEntered >= HOYMILES_HM_INTER_POLL_GAP) {
+                setPollState(PollState::IDLE);
+            }
+            break;
     }
 }
 
-void HoymilesHM::sendRequest(uint64_t serialNumber) {
-    if (!m_radio) {
-        return;
+/**
+ * Arm the response timeout of the transmission just sent: derived from the
+ * inverter's measured RTT, doubled for every retransmission in this poll.
+ * The answer comes back on the following channels of the hop set.
+ */
+void HoymilesHM::waitForResponse() {
+    m_responseTimeout = m_sessions[m_pollIndex].rtt.getTimeout(m_retransmissions);
+    m_radio->setChannel(m_channels[m_pollIndex].beginRx());
+    m_rxHopped = millis();
+    setPollState(PollState::WAIT_RESPONSE);
+}
+
+/**
+ * Whether the packet expected on the RX channel is overdue: the first one
+ * a little after its usual delay, the others a dwell after the last
+ * channel change, until the final packet of the answer was heard
+ */
+bool HoymilesHM::isRxOverdue(unsigned long now) const {
+    const HoymilesChannelStats& channels = m_channels[m_pollIndex];
+    if (channels.isFollowingRx()) {
+        return !m_sessions[m_pollIndex].assembler.hasLastFragment() &&
+               now - m_rxHopped >= HOYMILES_HM_RX_DWELL;
     }
+    return channels.getFirstRxDelay() > 0 &&
+           now - m_stateEntered >= (unsigned long)channels.getFirstRxDelay() + HOYMILES_HM_RX_FIRST_SLACK;
+}
+
+/**
+ * Close the poll of the current inverter: update its channel statistics
+ * and schedule, then leave the inter-poll gap
+ */
+void HoymilesHM::finishPoll(bool success, unsigned long now) {
+    m_channels[m_pollIndex].record(success);
+    if (success) {
+        m_scheduler.onSuccess(m_pollIndex, now);
+    } else {
+        m_scheduler.onFailure(m_pollIndex, now);
+    }
+    setPollState(PollState::NEXT_INVERTER);
+}
+
+void HoymilesHM::sendRequest(uint8_t index) {
+    uint64_t serialNumber = m_inverters[index];
 
     // Build request packet
     uint8_t packet[HOYMILES_PACKET_MAX_SIZE];
+    // Fragments of the answer echo this request's time counter
     uint8_t packetSize = HoymilesProtocol::buildRealtimeRequest(
         packet,
+        m_sessions[index].beginRequest(millis()),
         HOYMILES_DTU_SERIAL,
         serialNumber
     );
 
-    // Convert serial to NRF24 address
-    uint8_t inverterAddress[5];
-    HoymilesProtocol::serialToAddress(serialNumber, inverterAddress);
+    transmit(serialNumber, packet, packetSize);
+}
 
-    DEBUG_PRINT("    TX Address: ");
-    for (int i = 0; i < 5; i++) {
-        if (inverterAddress[i] < 0x10) DEBUG_PRINT("0");
-        DEBUG_PRINT(inverterAddress[i], HEX);
-        if (i < 4) DEBUG_PRINT(":");
-    }
-    DEBUG_PRINTLN();
-
-    DEBUG_PRINT("    TX Packet (");
-    DEBUG_PRINT(packetSize);
-    DEBUG_PRINT(" bytes): ");
-    for (uint8_t i = 0; i < packetSize; i++) {
-        if (packet[i] < 0x10) DEBUG_PRINT("0");
-        DEBUG_PRINT(packet[i], HEX);
-        DEBUG_PRINT(" ");
-    }
-    DEBUG_PRINTLN();
+void HoymilesHM::sendFragmentRequest(uint8_t index, uint8_t fragmentIndex) {
+    uint64_t serialNumber = m_inverters[index];
 
-    // Stop listening, configure for transmission
-    m_radio->stopListening();
+    LOG_DEBUG("    Requesting missing fragment %u", fragmentIndex);
 
-    // Set inverter address for transmission
-    m_radio->openWritingPipe(inverterAddress);
+    HoymilesSession& session = m_sessions[index];
+    session.beginFragmentRequest(millis());
 
-    // Send packet
-    bool success = m_radio->write(packet, packetSize);
+    uint8_t packet[HOYMILES_PACKET_MAX_SIZE];
+    uint8_t packetSize = HoymilesProtocol::buildFragmentRequest(
+        packet,
+        session.timeCounter,
+        HOYMILES_DTU_SERIAL,
+        serialNumber,
+        fragmentIndex
+    );
 
-    if (success) {
-        DEBUG_PRINTLN("    TX: Packet sent successfully");
-    } else {
-        DEBUG_PRINTLN("    TX: Failed to send packet");
+    transmit(serialNumber, packet, packetSize);
+}
+
+void HoymilesHM::transmit(uint64_t serialNumber, const uint8_t* packet, uint8_t packetSize) {
+    if (!m_radioReady) {
+        return;
     }
 
-    // Switch back to listening mode
-    m_radio->startListening();
+    LOG_HEX("    TX Packet (%u bytes): ", packet, packetSize);
+
+    if (m_radio->transmit(serialNumber, packet, packetSize)) {
+        LOG_DEBUG("    TX: Packet sent successfully");
+    } else {
+        LOG_WARN("    TX: Failed to send packet");
+    }
 }
 
-bool HoymilesHM::receiveResponse(uint64_t serialNumber) {
-    if (!m_radio) {
-        return false;
+/**
+ * Index of the inverter that sent a fragment
+ * @return Inverter index, or -1 for an unknown sender
+ */
+int8_t HoymilesHM::findInverter(const HoymilesProtocol::Fragment& fragment) {
+    for (uint8_t i = 0; i < m_inverterCount; i++) {
+        if (HoymilesProtocol::isFromInverter(fragment, m_inverters[i], HOYMILES_HM_FRAGMENT_HEADER)) {
+            return i;
+        }
     }
+    return -1;
+}
 
-    unsigned long timeout = millis() + 500;  // 500ms timeout
+/**
+ * Parse a received frame and feed it to its sender's session
+ *
+ * @param result Output: reassembly result (INVALID if not a fragment of a known inverter)
+ * @return Index of the sending inverter, or -1
+ */
+int8_t HoymilesHM::handleFragment(const uint8_t* packet, uint8_t len, HoymilesFragmentAssembler::Result& result) {
+    LOG_HEX("    RX Packet (%u bytes): ", packet, len);
 
-    while (millis() < timeout) {
-        if (m_radio->available()) {
-            uint8_t packet[HOYMILES_PACKET_MAX_SIZE];
-            uint8_t len = m_radio->getDynamicPayloadSize();
+    result = HoymilesFragmentAssembler::Result::INVALID;
 
-            if (len > HOYMILES_PACKET_MAX_SIZE) {
-                DEBUG_PRINTLN("    RX: Packet too large!");
-                return false;
-            }
+    HoymilesProtocol::Fragment fragment;
+    if (!HoymilesProtocol::parseFragment(packet, len, HOYMILES_HM_FRAGMENT_HEADER,
+                                         RESP_REALTIME_DATA, fragment)) {
+        LOG_DEBUG("    RX: Invalid packet or CRC error");
+        return -1;
+    }
 
-            // Read packet
-            m_radio->read(packet, len);
+    int8_t index = findInverter(fragment);
+    if (index < 0) {
+        LOG_DEBUG("    RX: Unknown sender");
+        return -1;
+    }
 
-            DEBUG_PRINT("    RX Packet (");
-            DEBUG_PRINT(len);
-            DEBUG_PRINT(" bytes): ");
-            for (uint8_t i = 0; i < len; i++) {
-                if (packet[i] < 0x10) DEBUG_PRINT("0");
-                DEBUG_PRINT(packet[i], HEX);
-                DEBUG_PRINT(" ");
-            }
-            DEBUG_PRINTLN();
-
-            // Parse response
-            float power, voltage, current, frequency, temperature;
-            if (HoymilesProtocol::parseRealtimeResponse(packet, len,
-                                                       power, voltage, current,
-                                                       frequency, temperature)) {
-                DEBUG_PRINT("    Power: ");
-                DEBUG_PRINT(power);
-                DEBUG_PRINTLN(" W");
-
-                DEBUG_PRINT("    Voltage: ");
-                DEBUG_PRINT(voltage);
-                DEBUG_PRINTLN(" V");
-
-                DEBUG_PRINT("    Current: ");
-                DEBUG_PRINT(current);
-                DEBUG_PRINTLN(" A");
-
-                DEBUG_PRINT("    Frequency: ");
-                DEBUG_PRINT(frequency);
-                DEBUG_PRINTLN(" Hz");
-
-                DEBUG_PRINT("    Temperature: ");
-                DEBUG_PRINT(temperature);
-                DEBUG_PRINTLN(" °C");
-
-                // Call callback if set
-                if (m_dataCallback) {
-                    m_dataCallback(serialNumber, power, voltage, current);
-                }
+    result = m_sessions[index].accept(fragment, millis());
+    if (result == HoymilesFragmentAssembler::Result::DUPLICATE) {
+        LOG_DEBUG("    RX: Duplicate fragment");
+    } else if (result == HoymilesFragmentAssembler::Result::INVALID) {
+        LOG_DEBUG("    RX: Stale fragment");
+    }
+    return index;
+}
 
-                return true;
-            } else {
-                DEBUG_PRINTLN("    RX: Invalid packet or CRC error");
-            }
-        }
+/**
+ * Verify and decode a fully reassembled response
+ */
+bool HoymilesHM::completeResponse(uint8_t index) {
+    const HoymilesFragmentAssembler& assembler = m_sessions[index].assembler;
 
-        // Small delay to avoid busy-waiting
-        delay(10);
+    if (assembler.verify() &&
+        parseResponse(index, assembler.getPayload(), assembler.getPayloadLength())) {
+        LOG_INFO("    Success!");
+        return true;
     }
 
+    LOG_WARN("    RX: Payload CRC16 error or too short for model");
     return false;
 }
 
-void HoymilesHM::setDataCallback(std::function<void(uint64_t serial, float power, float voltage, float current)> callback) {
-    m_dataCallback = callback;
-}
+bool HoymilesHM::parseResponse(uint8_t index, const uint8_t* payload, uint8_t len) {
+    // Decoded in place into the inverter's sample slot
+    InverterSample& sample = m_samples[index];
+    if (!m_models[index]->decode(payload, len, sample.data)) {
+        return false;
+    }
+
+    sample.timestamp = millis();
+    sample.sequence++;
+    sample.rssi = m_radio->getRssi();
+
+    LOG_INFO("    Power: %.*d W", HOYMILES_FIELD_DECIMALS[FIELD_POWER], sample.getPower());
+    LOG_INFO("    Voltage: %.*d V", HOYMILES_FIELD_DECIMALS[FIELD_VOLTAGE], sample.getVoltage());
+    LOG_INFO("    Current: %.*d A", HOYMILES_FIELD_DECIMALS[FIELD_CURRENT], sample.getDcCurrent());
+    LOG_INFO("    Frequency: %.*d Hz", HOYMILES_FIELD_DECIMALS[FIELD_FREQUENCY], sample.getFrequency());
+    LOG_INFO("    Temperature: %.*d °C", HOYMILES_FIELD_DECIMALS[FIELD_TEMPERATURE], sample.getTemperature());
 
-#endif // RADIO_NRF24
+    m_subscribers.publish(sample);
+
+    return true;
+}
@@ -1,34 +1,43 @@
 /**
  * Hoymiles HM Protocol - NRF24L01+ Communication
+ *
+ * The radio is accessed through HoymilesRadio (NRF24 backend by default).
  */
 
 #ifndef HOYMILES_HM_H
 #define HOYMILES_HM_H
 
 #include <Arduino.h>
-#include <functional>
-
-#ifdef RADIO_NRF24
-
-#include <RF24.h>
+#include "hoymiles_radio.h"
 #include "hoymiles_protocol.h"
+#include "hoymiles_models.h"
+#include "packet_ring.h"
+#include "hoymiles_scheduler.h"
+#include "inverter_sample.h"
+#include "hoymiles_channels.h"
 
 #define HOYMILES_MAX_INVERTERS  8
 
-// Pin definitions (can be overridden in config.h)
-#ifndef NRF24_CE_PIN
-  #ifdef ESP32
-    #define NRF24_CE_PIN   2
-    #define NRF24_CS_PIN   5
-  #elif defined(ESP8266)
-    #define NRF24_CE_PIN   4  // D2
-    #define NRF24_CS_PIN   5  // D1
-  #endif
-#endif
+// Poll timing (milliseconds)
+#define HOYMILES_HM_RX_TIMEOUT      500  // Response timeout until RTT samples exist
+#define HOYMILES_HM_INTER_POLL_GAP  50   // Quiet time between two inverters
+#define HOYMILES_HM_RX_DWELL        7    // Packet overdue on the RX channel (inverter packet gap ~5 ms)
+#define HOYMILES_HM_RX_FIRST_SLACK  2    // First packet overdue this long after its usual delay
+
+// RX packet ring (HM frames are at most 32 bytes, the NRF24 payload limit)
+#define HOYMILES_HM_MAX_FRAME_SIZE  32
+#define HOYMILES_HM_RX_RING_SLOTS   8
 
 class HoymilesHM {
 public:
     HoymilesHM();
+
+    /**
+     * Use another radio backend (e.g. SimulatedRadio); call before begin().
+     * Without it, begin() creates the NRF24 backend.
+     */
+    void setRadio(HoymilesRadio* radio) { m_radio = radio; }
+
     void begin();
     void loop();
 
@@ -40,29 +49,107 @@ public:
     // Configuration
     void setPollInterval(uint16_t interval);
 
-    // Callback for inverter data
-    void setDataCallback(std::function<void(uint64_t serial, float power, float voltage, float current)> callback);
+    // Diagnostics
+    uint32_t getRxDroppedCount() { return m_rxRing.getDroppedCount(); }
+    const HoymilesScheduler& getScheduler() const { return m_scheduler; }
+    const HoymilesChannelStats& getChannelStats(uint8_t index) const { return m_channels[index]; }
+
+    /**
+     * Register a receiver of decoded samples (up to INVERTER_SAMPLE_MAX_SUBSCRIBERS)
+     * @return false if no subscriber slot is left
+     */
+    bool subscribe(InverterSampleCallback callback, void* context = nullptr) {
+        return m_subscribers.add(callback, context);
+    }
+
+    /**
+     * Called from the polling context once every inverter that was due
+     * has been polled (see HoymilesScheduler::endCycle())
+     */
+    void onCycleEnd(PollCycleCallback callback, void* context = nullptr) {
+        m_cycleEndContext = context;
+        m_cycleEnd = callback;
+    }
+
+    // Latest sample of the inverter at index
+    const InverterSample& getSample(uint8_t index) const { return m_samples[index]; }
 
 private:
-    unsigned long m_lastPoll;
-    uint16_t m_pollInterval;
+    // Poll cycle state machine, advanced by one step per loop() call
+    enum class PollState : uint8_t {
+        IDLE,            // Waiting for the scheduler to report an inverter due
+        SEND_REQUEST,    // Transmit request to current inverter on its best channel
+        RETRY_REQUEST,   // No answer: repeat the request on the next best channel
+        WAIT_RESPONSE,   // Wait (non-blocking) for a response packet
+        PARSE_RESPONSE,  // Reassemble the received fragment, decode when complete
+        REQUEST_FRAGMENT,// Ask for a single missing fragment
+        NEXT_INVERTER    // Inter-poll gap, then back to IDLE
+    };
+
+    HoymilesScheduler m_scheduler;
     uint8_t m_inverterCount;
 
-    // RF24 radio instance
-    RF24* m_radio;
+    // Poll state
+    PollState m_pollState;
+    uint8_t m_pollIndex;
+    unsigned long m_stateEntered;
+    uint8_t m_retransmissions;      // In the current poll, see HOYMILES_RETRY_ATTEMPTS
+    uint16_t m_responseTimeout;     // Of the transmission being waited for
+    unsigned long m_rxHopped;       // millis() of the last RX channel change
+
+    // Received packets, filled by serviceRx() and consumed by the poll cycle
+    PacketRing<HOYMILES_HM_MAX_FRAME_SIZE, HOYMILES_HM_RX_RING_SLOTS> m_rxRing;
+
+#ifdef HOYMILES_RX_TASK
+    // Runs serviceRx() when the radio interrupt fires, nullptr = polled from loop()
+    TaskHandle_t m_rxTask;
+#endif
+
+    // Radio backend
+    HoymilesRadio* m_radio;
+    bool m_radioReady;
 
     // Inverter list
     uint64_t m_inverters[HOYMILES_MAX_INVERTERS];
 
-    // Callback
-    std::function<void(uint64_t serial, float power, float voltage, float current)> m_dataCallback;
+    // Payload layout, resolved from the serial number in addInverter()
+    const HoymilesModel* m_models[HOYMILES_MAX_INVERTERS];
+
+    // Request counters and response reassembly, one per inverter
+    HoymilesSession m_sessions[HOYMILES_MAX_INVERTERS];
+
+    // Channel hopping statistics, one per inverter
+    HoymilesChannelStats m_channels[HOYMILES_MAX_INVERTERS];
+
+    // Latest decoded data, one preallocated slot per inverter
+    InverterSample m_samples[HOYMILES_MAX_INVERTERS];
+    InverterSampleSubscribers m_subscribers;
+    PollCycleCallback m_cycleEnd;
+    void* m_cycleEndContext;
+
+    // Poll state machine
+    void setPollState(PollState state);
+    void stepPollCycle(unsigned long now);
+    void finishPoll(bool success, unsigned long now);
+    void waitForResponse();
+    bool isRxOverdue(unsigned long now) const;
+
+    // RX path
+    void serviceRx();
+    void startRxTask();
+    bool hasRxTask() const;
+#ifdef HOYMILES_RX_TASK
+    static void rxTaskMain(void* context);
+#endif
 
     // Protocol methods
-    void pollInverters();
-    void sendRequest(uint64_t serialNumber);
-    bool receiveResponse(uint64_t serialNumber);
+    void sendRequest(uint8_t index);
+    void sendFragmentRequest(uint8_t index, uint8_t fragmentIndex);
+    void transmit(uint64_t serialNumber, const uint8_t* packet, uint8_t packetSize);
+    int8_t findInverter(const HoymilesProtocol::Fragment& fragment);
+    int8_t handleFragment(const uint8_t* packet, uint8_t len, HoymilesFragmentAssembler::Result& result);
+    bool completeResponse(uint8_t index);
+    bool parseResponse(uint8_t index, const uint8_t* payload, uint8_t len);
 };
 
-#endif // RADIO_NRF24
-
 #endif // HOYMILES_HM_H
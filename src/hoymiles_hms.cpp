@@ -10,93 +10,67 @@
 #include "hoymiles_hms.h"
 #include "hoymiles_protocol.h"
 #include "config.h"
+#include "logger.h"
 
 #ifdef RADIO_CMT2300A
-
-#include <RadioLib.h>
-
-// Pin definitions for CMT2300A
-#ifndef CMT2300A_CS_PIN
-  #ifdef ESP32
-    #define CMT2300A_CS_PIN    15   // SPI CS
-    #define CMT2300A_GPIO1_PIN 21   // GPIO1 (used for interrupts)
-    #define CMT2300A_GPIO2_PIN 22   // GPIO2
-    #define CMT2300A_GPIO3_PIN 23   // GPIO3
-  #elif defined(ESP8266)
-    #define CMT2300A_CS_PIN    15   // D8
-    #define CMT2300A_GPIO1_PIN 4    // D2
-    #define CMT2300A_GPIO2_PIN 5    // D1
-    #define CMT2300A_GPIO3_PIN 12   // D6
-  #endif
+#include "hoymiles_radio_cmt.h"
 #endif
 
-// CMT2300A radio instance
-static CMT2300A* g_radio = nullptr;
-
 HoymilesHMS::HoymilesHMS()
     : m_lastPoll(0)
-    , m_pollInterval(HOYMILES_POLL_INTERVAL)
+    , m_scheduler(HOYMILES_POLL_INTERVAL)
     , m_inverterCount(0)
+    , m_radio(nullptr)
+    , m_radioReady(false)
+    , m_cycleEnd(nullptr)
+    , m_cycleEndContext(nullptr)
 {
     // Initialize inverter array
     for (uint8_t i = 0; i < HOYMILES_MAX_INVERTERS; i++) {
         m_inverters[i] = 0;
+        m_models[i] = nullptr;
+        m_samples[i].reset(0, nullptr);
     }
 }
 
 void HoymilesHMS::begin() {
-    DEBUG_PRINTLN("Hoymiles HMS/HMT: Initializing CMT2300A radio...");
-
-    // Create CMT2300A instance
-    g_radio = new Module(CMT2300A_CS_PIN, CMT2300A_GPIO1_PIN, RADIOLIB_NC, CMT2300A_GPIO2_PIN);
-    CMT2300A radio = new CMT2300A(g_radio);
-
-    // Initialize CMT2300A with 868MHz configuration for Hoymiles HMS
-    int state = radio.begin(
-        868.0,           // Frequency: 868 MHz (European ISM band)
-        38.4,            // Bit rate: 38.4 kbps
-        10.0,            // Frequency deviation: 10 kHz
-        135.0,           // RX bandwidth: 135 kHz
-        10,              // Output power: 10 dBm
-        32               // Preamble length: 32 bits
-    );
-
-    if (state != RADIOLIB_ERR_NONE) {
-        DEBUG_PRINT("Hoymiles HMS/HMT: ERROR - CMT2300A initialization failed! Code: ");
-        DEBUG_PRINTLN(state);
-        return;
-    }
-
-    // Configure radio for Hoymiles protocol
-    // HMS uses GFSK modulation
-    radio.setDataShaping(RADIOLIB_SHAPING_0_5);
+    DEBUG_PRINTLN("Hoymiles HMS/HMT: Initializing radio...");
 
-    // Set sync word (Hoymiles HMS specific)
-    uint8_t syncWord[] = {0xD3, 0x91};
-    radio.setSyncWord(syncWord, 2);
-
-    // Enable CRC
-    radio.setCRC(true);
+#ifdef RADIO_CMT2300A
+    if (!m_radio) {
+        m_radio = new CMT2300ARadio();
+    }
+#endif
 
-    // Put radio in receive mode
-    state = radio.startReceive();
-    if (state != RADIOLIB_ERR_NONE) {
-        DEBUG_PRINT("Hoymiles HMS/HMT: ERROR - Failed to start receive mode! Code: ");
-        DEBUG_PRINTLN(state);
+    if (!m_radio || !m_radio->begin()) {
+        DEBUG_PRINTLN("Hoymiles HMS/HMT: ERROR - Radio initialization failed!");
         return;
     }
+    m_radioReady = true;
 
-    DEBUG_PRINTLN("Hoymiles HMS/HMT: CMT2300A initialized successfully");
-    DEBUG_PRINTLN("Hoymiles HMS/HMT: Radio configured for 868 MHz");
+    DEBUG_PRINT("Hoymiles HMS/HMT: ");
+    DEBUG_PRINT(m_radio->getName());
+    DEBUG_PRINTLN(" initialized successfully");
     DEBUG_PRINTLN("Hoymiles HMS/HMT: Ready to communicate with HMS/HMT inverters");
 }
 
 void HoymilesHMS::loop() {
+    if (!m_radioReady) {
+        return;  // Not initialized
+    }
+
     unsigned long now = millis();
+    if (now - m_lastPoll < HOYMILES_HMS_INTER_POLL_GAP) {
+        return;
+    }
 
-    if (now - m_lastPoll > m_pollInterval) {
-        m_lastPoll = now;
-        pollInverters();
+    // One inverter per call, in the order the scheduler has them due
+    int8_t next = m_scheduler.nextDue(now);
+    if (next >= 0) {
+        pollInverter(next);
+        m_lastPoll = millis();
+    } else if (m_scheduler.endCycle(now) && m_cycleEnd) {
+        m_cycleEnd(m_cycleEndContext);
     }
 }
 
@@ -116,12 +90,18 @@ bool HoymilesHMS::addInverter(uint64_t serialNumber) {
 
     // Add to list
     m_inverters[m_inverterCount] = serialNumber;
+    m_models[m_inverterCount] = findHoymilesModel(serialNumber, HOYMILES_MODEL_DEFAULT_HMS);
+    m_sessions[m_inverterCount] = HoymilesSession(HOYMILES_RESPONSE_TIMEOUT);
+    m_samples[m_inverterCount].reset(serialNumber, m_models[m_inverterCount]);
+    m_scheduler.add(m_inverterCount, millis());
     m_inverterCount++;
 
     DEBUG_PRINT("Hoymiles HMS/HMT: Added inverter #");
     DEBUG_PRINT(m_inverterCount);
     DEBUG_PRINT(" - Serial: ");
     DEBUG_PRINTLN((unsigned long)(serialNumber & 0xFFFFFFFF)); // Print lower 32 bits
+    DEBUG_PRINT("  Model: ");
+    DEBUG_PRINTLN(m_models[m_inverterCount - 1]->name);
 
     return true;
 }
@@ -133,8 +113,13 @@ void HoymilesHMS::removeInverter(uint64_t serialNumber) {
             // Shift remaining inverters
             for (uint8_t j = i; j < m_inverterCount - 1; j++) {
                 m_inverters[j] = m_inverters[j + 1];
+                m_models[j] = m_models[j + 1];
+                m_sessions[j] = m_sessions[j + 1];
+                m_samples[j] = m_samples[j + 1];
             }
             m_inverters[m_inverterCount - 1] = 0;
+            m_sessions[m_inverterCount - 1] = HoymilesSession(HOYMILES_RESPONSE_TIMEOUT);
+            m_scheduler.remove(i);
             m_inverterCount--;
 
             DEBUG_PRINT("Hoymiles HMS/HMT: Removed inverter - Serial: ");
@@ -151,191 +136,231 @@ uint8_t HoymilesHMS::getInverterCount() {
 }
 
 void HoymilesHMS::setPollInterval(uint16_t interval) {
-    m_pollInterval = interval;
+    m_scheduler.setBaseInterval(interval);
     DEBUG_PRINT("Hoymiles HMS/HMT: Poll interval set to ");
-    DEBUG_PRINT(m_pollInterval);
+    DEBUG_PRINT(interval);
     DEBUG_PRINTLN("ms");
 }
 
-void HoymilesHMS::pollInverters() {
-    if (m_inverterCount == 0) {
-        DEBUG_PRINTLN("Hoymiles HMS/HMT: No inverters registered");
-        return;
-    }
+void HoymilesHMS::pollInverter(uint8_t index) {
+    uint64_t serialNumber = m_inverters[index];
 
-    DEBUG_PRINT("Hoymiles HMS/HMT: Polling ");
-    DEBUG_PRINT(m_inverterCount);
-    DEBUG_PRINTLN(" inverter(s)...");
+    LOG_INFO("  [%u/%u] Serial: %u (%s)", index + 1, m_inverterCount,
+             (uint32_t)(serialNumber & 0xFFFFFFFF),
+             HoymilesScheduler::stateName(m_scheduler.getState(index)));
 
-    // Poll each registered inverter
-    for (uint8_t i = 0; i < m_inverterCount; i++) {
-        uint64_t serialNumber = m_inverters[i];
+    // Send request
+    sendRequest(index);
 
-        DEBUG_PRINT("  [");
-        DEBUG_PRINT(i + 1);
-        DEBUG_PRINT("/");
-        DEBUG_PRINT(m_inverterCount);
-        DEBUG_PRINT("] Serial: ");
-        DEBUG_PRINTLN((unsigned long)(serialNumber & 0xFFFFFFFF));
+    // Wait for response
+    bool success = receiveResponse(index);
 
-        // Send request
-        sendRequest(serialNumber);
+    if (success) {
+        LOG_INFO("    ✓ Response received and parsed");
+        m_scheduler.onSuccess(index, millis());
+    } else {
+        LOG_INFO("    ✗ No response or parse error");
+        m_scheduler.onFailure(index, millis());
+    }
+}
 
-        // Wait for response
-        bool success = receiveResponse(serialNumber);
+void HoymilesHMS::sendRequest(uint8_t index) {
+    uint64_t serialNumber = m_inverters[index];
 
-        if (success) {
-            DEBUG_PRINTLN("    ✓ Response received and parsed");
-        } else {
-            DEBUG_PRINTLN("    ✗ No response or parse error");
-        }
+    // Build HMS realtime data request packet; fragments of the answer
+    // echo this request's time counter
+    HoymilesSession& session = m_sessions[index];
+    uint16_t timeCounter = session.beginRequest(millis());
 
-        // Small delay between inverters
-        delay(100);
-    }
+    uint8_t packet[HOYMILES_PACKET_MAX_SIZE];
+    uint8_t packetSize = HoymilesProtocol::buildHMSRealtimeRequest(
+        packet, timeCounter, session.packetCounter, HOYMILES_DTU_SERIAL, serialNumber);
+
+    LOG_DEBUG("Hoymiles HMS/HMT: Sending request (%u bytes) to inverter %u",
+              packetSize, (uint32_t)(serialNumber & 0xFFFFFFFF));
+
+    transmit(serialNumber, packet, packetSize);
 }
 
-void HoymilesHMS::sendRequest(uint64_t serialNumber) {
-    if (!g_radio) {
-        DEBUG_PRINTLN("Hoymiles HMS/HMT: ERROR - Radio not initialized");
-        return;
-    }
+void HoymilesHMS::sendFragmentRequest(uint8_t index, uint8_t fragmentIndex) {
+    HoymilesSession& session = m_sessions[index];
+    session.beginFragmentRequest(millis());
 
-    // Build HMS realtime data request packet
     uint8_t packet[HOYMILES_PACKET_MAX_SIZE];
-    uint8_t packetSize = HoymilesProtocol::buildHMSRealtimeRequest(
-        packet, HOYMILES_DTU_SERIAL, serialNumber);
-
-    DEBUG_PRINT("Hoymiles HMS/HMT: Sending request (");
-    DEBUG_PRINT(packetSize);
-    DEBUG_PRINT(" bytes) to inverter ");
-    DEBUG_PRINTLN((unsigned long)(serialNumber & 0xFFFFFFFF));
-
-    // Debug: Print packet
-    DEBUG_PRINT("    Packet: ");
-    for (uint8_t i = 0; i < packetSize; i++) {
-        if (packet[i] < 0x10) DEBUG_PRINT("0");
-        DEBUG_PRINT(packet[i], HEX);
-        DEBUG_PRINT(" ");
-    }
-    DEBUG_PRINTLN();
+    uint8_t packetSize = HoymilesProtocol::buildHMSFragmentRequest(
+        packet, session.timeCounter,
+        HOYMILES_DTU_SERIAL, m_inverters[index], fragmentIndex);
 
-    // Switch to transmit mode and send packet
-    CMT2300A radio = new CMT2300A(g_radio);
-    int state = radio.transmit(packet, packetSize);
+    LOG_DEBUG("Hoymiles HMS/HMT: Requesting missing fragment %u", fragmentIndex);
 
-    if (state == RADIOLIB_ERR_NONE) {
-        DEBUG_PRINTLN("    Transmission successful");
-    } else {
-        DEBUG_PRINT("    ERROR - Transmission failed! Code: ");
-        DEBUG_PRINTLN(state);
+    transmit(m_inverters[index], packet, packetSize);
+}
+
+void HoymilesHMS::transmit(uint64_t serialNumber, const uint8_t* packet, uint8_t packetSize) {
+    if (!m_radioReady) {
+        LOG_ERROR("Hoymiles HMS/HMT: ERROR - Radio not initialized");
+        return;
     }
 
-    // Return to receive mode
-    radio.startReceive();
+    LOG_HEX("    Packet: ", packet, packetSize);
+
+    if (m_radio->transmit(serialNumber, packet, packetSize)) {
+        LOG_DEBUG("    Transmission successful");
+    }
 }
 
-bool HoymilesHMS::receiveResponse(uint64_t serialNumber) {
-    if (!g_radio) {
-        DEBUG_PRINTLN("Hoymiles HMS/HMT: ERROR - Radio not initialized");
+bool HoymilesHMS::receiveResponse(uint8_t index) {
+    if (!m_radioReady) {
+        LOG_ERROR("Hoymiles HMS/HMT: ERROR - Radio not initialized");
         return false;
     }
 
-    DEBUG_PRINTLN("Hoymiles HMS/HMT: Waiting for response...");
+    LOG_DEBUG("Hoymiles HMS/HMT: Waiting for response...");
 
-    CMT2300A radio = new CMT2300A(g_radio);
+    HoymilesSession& session = m_sessions[index];
+    HoymilesFragmentAssembler& assembler = session.assembler;
 
-    // Wait for response with timeout
-    unsigned long timeout = millis() + 1000; // 1 second timeout (HMS may take longer)
+    // Wait for response; the timeout follows the inverter's measured RTT
+    // and doubles with every retransmission
+    bool probe = m_scheduler.isProbe(index);
+    uint8_t retransmissions = 0;
+    unsigned long sent = millis();
+    uint16_t timeout = session.rtt.getTimeout(0);
     uint8_t packet[HOYMILES_PACKET_MAX_SIZE];
     int packetLength = 0;
 
-    while (millis() < timeout) {
-        // Check if packet received
-        packetLength = radio.getPacketLength();
+    while (true) {
+        if (millis() - sent >= timeout) {
+            // Offline probes stay cheap: one request, no retransmits
+            if (probe || retransmissions + 1 >= HOYMILES_RETRY_ATTEMPTS) {
+                break;
+            }
 
-        if (packetLength > 0) {
-            DEBUG_PRINT("    Packet received (");
-            DEBUG_PRINT(packetLength);
-            DEBUG_PRINTLN(" bytes)");
+            if (assembler.hasFragments()) {
+                // Partial response: ask for the missing fragments only
+                if (session.fragmentRetries >= HOYMILES_MAX_FRAGMENT_RETRIES) {
+                    break;
+                }
+                sendFragmentRequest(index, assembler.getMissingFragment());
+            } else {
+                LOG_INFO("    No answer, repeating request");
+                sendRequest(index);
+            }
 
-            // Read packet
-            int state = radio.readData(packet, packetLength);
+            retransmissions++;
+            sent = millis();
+            timeout = session.rtt.getTimeout(retransmissions);
+        }
 
-            if (state != RADIOLIB_ERR_NONE) {
-                DEBUG_PRINT("    ERROR - Failed to read packet! Code: ");
-                DEBUG_PRINTLN(state);
-                return false;
+        // Check if packet received
+        if (m_radio->available()) {
+            packetLength = m_radio->read(packet, sizeof(packet));
+            if (packetLength == 0) {
+                continue;
             }
 
-            // Debug: Print packet
-            DEBUG_PRINT("    Packet: ");
-            for (int i = 0; i < packetLength; i++) {
-                if (packet[i] < 0x10) DEBUG_PRINT("0");
-                DEBUG_PRINT(packet[i], HEX);
-                DEBUG_PRINT(" ");
+            LOG_HEX("    Packet received (%u bytes): ", packet, packetLength);
+            LOG_DEBUG("    RSSI: %d dBm", m_radio->getRssi());
+
+            HoymilesProtocol::Fragment fragment;
+            if (!HoymilesProtocol::parseFragment(packet, packetLength,
+                                                 HOYMILES_HMS_FRAGMENT_HEADER,
+                                                 HMS_RESP_REALTIME_DATA, fragment)) {
+                LOG_DEBUG("    ERROR - Invalid fragment (CRC or format)");
+                continue;
             }
-            DEBUG_PRINTLN();
 
-            // Print RSSI and SNR
-            DEBUG_PRINT("    RSSI: ");
-            DEBUG_PRINT(radio.getRSSI());
-            DEBUG_PRINT(" dBm, SNR: ");
-            DEBUG_PRINT(radio.getSNR());
-            DEBUG_PRINTLN(" dB");
+            // Route by sender: a late answer from another inverter completes
+            // that inverter's session instead of corrupting this one
+            int8_t sender = findInverter(fragment);
+            if (sender < 0) {
+                LOG_DEBUG("    Fragment from unknown sender");
+                continue;
+            }
 
-            // Parse response
-            float power, voltage, current, frequency, temperature;
-            bool parseSuccess = HoymilesProtocol::parseHMSRealtimeResponse(
-                packet, packetLength,
-                power, voltage, current,
-                frequency, temperature);
-
-            if (parseSuccess) {
-                DEBUG_PRINTLN("    Data parsed successfully:");
-                DEBUG_PRINT("      Power: ");
-                DEBUG_PRINT(power);
-                DEBUG_PRINTLN(" W");
-                DEBUG_PRINT("      Voltage: ");
-                DEBUG_PRINT(voltage);
-                DEBUG_PRINTLN(" V");
-                DEBUG_PRINT("      Current: ");
-                DEBUG_PRINT(current);
-                DEBUG_PRINTLN(" A");
-                DEBUG_PRINT("      Frequency: ");
-                DEBUG_PRINT(frequency);
-                DEBUG_PRINTLN(" Hz");
-                DEBUG_PRINT("      Temperature: ");
-                DEBUG_PRINT(temperature);
-                DEBUG_PRINTLN(" °C");
-
-                // Call data callback if set
-                if (m_dataCallback) {
-                    m_dataCallback(serialNumber, power, voltage, current);
+            auto result = m_sessions[sender].accept(fragment, millis());
+
+            if (sender != index) {
+                if (result == HoymilesFragmentAssembler::Result::COMPLETE &&
+                    m_sessions[sender].assembler.verify()) {
+                    const HoymilesFragmentAssembler& late = m_sessions[sender].assembler;
+                    if (parseResponse(sender, late.getPayload(), late.getPayloadLength())) {
+                        m_scheduler.onSuccess(sender, millis());
+                    }
                 }
+                continue;
+            }
+
+            if (result == HoymilesFragmentAssembler::Result::INCOMPLETE &&
+                assembler.hasLastFragment() && !probe &&
+                retransmissions + 1 < HOYMILES_RETRY_ATTEMPTS &&
+                session.fragmentRetries < HOYMILES_MAX_FRAGMENT_RETRIES) {
+                // Final fragment seen but gaps remain: fetch only those
+                sendFragmentRequest(index, assembler.getMissingFragment());
+                retransmissions++;
+                sent = millis();
+                timeout = session.rtt.getTimeout(retransmissions);
+                continue;
+            }
+
+            if (result != HoymilesFragmentAssembler::Result::COMPLETE) {
+                continue;
+            }
 
-                // Return to receive mode
-                radio.startReceive();
+            if (!assembler.verify()) {
+                LOG_WARN("    ERROR - Payload CRC16 mismatch");
+                break;
+            }
+
+            // Parse response
+            if (parseResponse(index, assembler.getPayload(), assembler.getPayloadLength())) {
                 return true;
             } else {
-                DEBUG_PRINTLN("    ERROR - Failed to parse response (invalid CRC or format)");
+                LOG_WARN("    ERROR - Failed to parse response (payload too short for model)");
+                break;
             }
         }
 
-        // Small delay
-        delay(10);
+        // Short poll step, keeps the RTT measurement fine-grained
+        delay(1);
     }
 
-    DEBUG_PRINTLN("    Timeout - No response received");
-
-    // Return to receive mode
-    radio.startReceive();
+    LOG_INFO("    Timeout - No response received");
     return false;
 }
 
-void HoymilesHMS::setDataCallback(std::function<void(uint64_t serial, float power, float voltage, float current)> callback) {
-    m_dataCallback = callback;
-    DEBUG_PRINTLN("Hoymiles HMS/HMT: Data callback registered");
+/**
+ * Index of the inverter that sent a fragment
+ * @return Inverter index, or -1 for an unknown sender
+ */
+int8_t HoymilesHMS::findInverter(const HoymilesProtocol::Fragment& fragment) {
+    for (uint8_t i = 0; i < m_inverterCount; i++) {
+        if (HoymilesProtocol::isFromInverter(fragment, m_inverters[i], HOYMILES_HMS_FRAGMENT_HEADER)) {
+            return i;
+        }
+    }
+    return -1;
 }
 
-#endif // RADIO_CMT2300A
+bool HoymilesHMS::parseResponse(uint8_t index, const uint8_t* payload, uint8_t len) {
+    // Decoded in place into the inverter's sample slot
+    InverterSample& sample = m_samples[index];
+    if (!m_models[index]->decode(payload, len, sample.data)) {
+        return false;
+    }
+
+    sample.timestamp = millis();
+    sample.sequence++;
+    sample.rssi = m_radio->getRssi();
+
+    LOG_INFO("    Data parsed successfully:");
+    LOG_INFO("      Power: %.*d W", HOYMILES_FIELD_DECIMALS[FIELD_POWER], sample.getPower());
+    LOG_INFO("      Voltage: %.*d V", HOYMILES_FIELD_DECIMALS[FIELD_VOLTAGE], sample.getVoltage());
+    LOG_INFO("      Current: %.*d A", HOYMILES_FIELD_DECIMALS[FIELD_CURRENT], sample.getDcCurrent());
+    LOG_INFO("      Frequency: %.*d Hz", HOYMILES_FIELD_DECIMALS[FIELD_FREQUENCY], sample.getFrequency());
+    LOG_INFO("      Temperature: %.*d °C", HOYMILES_FIELD_DECIMALS[FIELD_TEMPERATURE], sample.getTemperature());
+
+    m_subscribers.publish(sample);
+
+    return true;
+}
@@ -2,18 +2,18 @@
  * Hoymiles HMS/HMT Protocol - CMT2300A Communication
  *
  * Supports HMS-800 to HMS-2000 and HMT series inverters
- * Uses CMT2300A radio module (868MHz)
+ * Uses CMT2300A radio module (868MHz) through HoymilesRadio
  */
 
 #ifndef HOYMILES_HMS_H
 #define HOYMILES_HMS_H
 
 #include <Arduino.h>
-#include <functional>
-
-#ifdef RADIO_CMT2300A
-
+#include "hoymiles_radio.h"
 #include "hoymiles_protocol.h"
+#include "hoymiles_models.h"
+#include "hoymiles_scheduler.h"
+#include "inverter_sample.h"
 
 // Maximum number of inverters to manage
 #ifndef HOYMILES_MAX_INVERTERS
@@ -25,9 +25,19 @@
 #define HOYMILES_POLL_INTERVAL  5000
 #endif
 
+// Quiet time between two polls (milliseconds)
+#define HOYMILES_HMS_INTER_POLL_GAP  100
+
 class HoymilesHMS {
 public:
     HoymilesHMS();
+
+    /**
+     * Use another radio backend (e.g. SimulatedRadio); call before begin().
+     * Without it, begin() creates the CMT2300A backend.
+     */
+    void setRadio(HoymilesRadio* radio) { m_radio = radio; }
+
     void begin();
     void loop();
 
@@ -39,26 +49,58 @@ public:
     // Configuration
     void setPollInterval(uint16_t interval);
 
-    // Callback for inverter data
-    void setDataCallback(std::function<void(uint64_t serial, float power, float voltage, float current)> callback);
+    /**
+     * Register a receiver of decoded samples (up to INVERTER_SAMPLE_MAX_SUBSCRIBERS)
+     * @return false if no subscriber slot is left
+     */
+    bool subscribe(InverterSampleCallback callback, void* context = nullptr) {
+        return m_subscribers.add(callback, context);
+    }
+
+    /**
+     * Called from the polling context once every inverter that was due
+     * has been polled (see HoymilesScheduler::endCycle())
+     */
+    void onCycleEnd(PollCycleCallback callback, void* context = nullptr) {
+        m_cycleEndContext = context;
+        m_cycleEnd = callback;
+    }
+
+    // Latest sample of the inverter at index
+    const InverterSample& getSample(uint8_t index) const { return m_samples[index]; }
 
 private:
     unsigned long m_lastPoll;
-    uint16_t m_pollInterval;
+    HoymilesScheduler m_scheduler;
     uint8_t m_inverterCount;
 
+    // Radio backend
+    HoymilesRadio* m_radio;
+    bool m_radioReady;
+
     // Inverter storage
     uint64_t m_inverters[HOYMILES_MAX_INVERTERS];
 
-    // Callback
-    std::function<void(uint64_t serial, float power, float voltage, float current)> m_dataCallback;
+    // Payload layout, resolved from the serial number in addInverter()
+    const HoymilesModel* m_models[HOYMILES_MAX_INVERTERS];
+
+    // Request counters and response reassembly, one per inverter
+    HoymilesSession m_sessions[HOYMILES_MAX_INVERTERS];
+
+    // Latest decoded data, one preallocated slot per inverter
+    InverterSample m_samples[HOYMILES_MAX_INVERTERS];
+    InverterSampleSubscribers m_subscribers;
+    PollCycleCallback m_cycleEnd;
+    void* m_cycleEndContext;
 
     // Protocol methods
-    void pollInverters();
-    void sendRequest(uint64_t serialNumber);
-    bool receiveResponse(uint64_t serialNumber);
+    void pollInverter(uint8_t index);
+    void sendRequest(uint8_t index);
+    void sendFragmentRequest(uint8_t index, uint8_t fragmentIndex);
+    void transmit(uint64_t serialNumber, const uint8_t* packet, uint8_t packetSize);
+    bool receiveResponse(uint8_t index);
+    int8_t findInverter(const HoymilesProtocol::Fragment& fragment);
+    bool parseResponse(uint8_t index, const uint8_t* payload, uint8_t len);
 };
 
-#endif // RADIO_CMT2300A
-
 #endif // HOYMILES_HMS_H
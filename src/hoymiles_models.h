@@ -0,0 +1,375 @@
+/**
+ * Hoymiles Models - Per-model realtime payload layouts
+ *
+ * Every model family is described by a constexpr table of field
+ * descriptors (offset, width, scale, unit, channel). The decoder is a
+ * template instantiated once per table, so each field read is unrolled
+ * with constant offsets and scale factors. The model is resolved once per
+ * inverter from its serial number; decoding then calls the family's
+ * decoder directly without branching on the model type.
+ *
+ * Adding a model = adding a layout table and one HOYMILES_MODELS entry.
+ */
+
+#ifndef HOYMILES_MODELS_H
+#define HOYMILES_MODELS_H
+
+#include <Arduino.h>
+#include <utility>
+#include "fixed_point.h"
+
+// Largest DC input count of any supported model (HMT-2250)
+#define HOYMILES_MAX_DC_CHANNELS    6
+
+// Decoded quantities. Channel 0 carries the AC side, channels 1..n the DC inputs.
+enum HoymilesField : uint8_t {
+    FIELD_VOLTAGE,
+    FIELD_CURRENT,
+    FIELD_POWER,
+    FIELD_YIELD_DAY,
+    FIELD_YIELD_TOTAL,
+    FIELD_FREQUENCY,
+    FIELD_REACTIVE_POWER,
+    FIELD_POWER_FACTOR,
+    FIELD_TEMPERATURE,
+    FIELD_COUNT
+};
+
+// Fixed-point scale of each field in HoymilesRealtimeData (decimal places),
+// e.g. FIELD_POWER is carried in 0.1 W and FIELD_CURRENT in 0.01 A
+static constexpr uint8_t HOYMILES_FIELD_DECIMALS[FIELD_COUNT] = {
+    1,  // FIELD_VOLTAGE          0.1 V
+    2,  // FIELD_CURRENT          0.01 A
+    1,  // FIELD_POWER            0.1 W
+    0,  // FIELD_YIELD_DAY        1 Wh
+    0,  // FIELD_YIELD_TOTAL      1 Wh
+    2,  // FIELD_FREQUENCY        0.01 Hz
+    1,  // FIELD_REACTIVE_POWER   0.1 var
+    3,  // FIELD_POWER_FACTOR     0.001
+    1   // FIELD_TEMPERATURE      0.1 °C
+};
+
+enum class HoymilesUnit : uint8_t {
+    NONE,
+    VOLT,
+    AMPERE,
+    WATT,
+    WATT_HOUR,
+    HERTZ,
+    VAR,
+    CELSIUS
+};
+
+struct HoymilesFieldDescriptor {
+    HoymilesField field;
+    uint8_t channel;        // 0 = AC, 1..n = DC input
+    uint8_t offset;         // Byte offset in the reassembled payload
+    uint8_t width;          // 2 or 4 bytes, big-endian
+    bool isSigned;
+    uint8_t decimals;       // Raw value / 10^decimals = value in unit
+    HoymilesUnit unit;
+};
+
+/**
+ * Decoded realtime data of one inverter
+ *
+ * Values are scaled integers, see HOYMILES_FIELD_DECIMALS.
+ */
+struct HoymilesRealtimeData {
+    uint8_t dcChannels;
+    int32_t values[HOYMILES_MAX_DC_CHANNELS + 1][FIELD_COUNT];
+
+    int32_t get(uint8_t channel, HoymilesField field) const { return values[channel][field]; }
+
+    int32_t getTotalDcCurrent() const {
+        int32_t total = 0;
+        for (uint8_t ch = 1; ch <= dcChannels; ch++) {
+            total += values[ch][FIELD_CURRENT];
+        }
+        return total;
+    }
+
+    /**
+     * Format one value as decimal text in its unit
+     * @return Length written, see formatFixedPoint()
+     */
+    size_t format(char* buffer, size_t size, uint8_t channel, HoymilesField field) const {
+        return formatFixedPoint(buffer, size, values[channel][field], HOYMILES_FIELD_DECIMALS[field]);
+    }
+};
+
+// ============================================
+// Layout tables
+// ============================================
+
+#define HM_DC(ch, field, offset, width, decimals, unit) \
+    { field, ch, offset, width, false, decimals, HoymilesUnit::unit }
+#define HM_AC(field, offset, isSigned, decimals, unit) \
+    { field, 0, offset, 2, isSigned, decimals, HoymilesUnit::unit }
+
+// AC block shared by all layouts, starting at the given payload offset
+#define HM_AC_FIELDS(base) \
+    HM_AC(FIELD_VOLTAGE,        (base) + 0,  false, 1, VOLT), \
+    HM_AC(FIELD_FREQUENCY,      (base) + 2,  false, 2, HERTZ), \
+    HM_AC(FIELD_POWER,          (base) + 4,  false, 1, WATT), \
+    HM_AC(FIELD_REACTIVE_POWER, (base) + 6,  true,  1, VAR), \
+    HM_AC(FIELD_CURRENT,        (base) + 8,  false, 2, AMPERE), \
+    HM_AC(FIELD_POWER_FACTOR,   (base) + 10, true,  3, NONE), \
+    HM_AC(FIELD_TEMPERATURE,    (base) + 12, true,  1, CELSIUS)
+
+// HM-300/350/400, HMS-300/400/500: one DC input
+struct HoymilesLayout1Ch {
+    static constexpr uint8_t dcChannels = 1;
+    static constexpr HoymilesFieldDescriptor fields[] = {
+        HM_DC(1, FIELD_VOLTAGE,     2,  2, 1, VOLT),
+        HM_DC(1, FIELD_CURRENT,     4,  2, 2, AMPERE),
+        HM_DC(1, FIELD_POWER,       6,  2, 1, WATT),
+        HM_DC(1, FIELD_YIELD_TOTAL, 8,  4, 0, WATT_HOUR),
+        HM_DC(1, FIELD_YIELD_DAY,   12, 2, 0, WATT_HOUR),
+        HM_AC_FIELDS(14)
+    };
+};
+
+// HM-600/700/800, HMS-600/700/800/1000: two DC inputs
+struct HoymilesLayout2Ch {
+    static constexpr uint8_t dcChannels = 2;
+    static constexpr HoymilesFieldDescriptor fields[] = {
+        HM_DC(1, FIELD_VOLTAGE,     2,  2, 1, VOLT),
+        HM_DC(1, FIELD_CURRENT,     4,  2, 2, AMPERE),
+        HM_DC(1, FIELD_POWER,       6,  2, 1, WATT),
+        HM_DC(2, FIELD_VOLTAGE,     8,  2, 1, VOLT),
+        HM_DC(2, FIELD_CURRENT,     10, 2, 2, AMPERE),
+        HM_DC(2, FIELD_POWER,       12, 2, 1, WATT),
+        HM_DC(1, FIELD_YIELD_TOTAL, 14, 4, 0, WATT_HOUR),
+        HM_DC(2, FIELD_YIELD_TOTAL, 18, 4, 0, WATT_HOUR),
+        HM_DC(1, FIELD_YIELD_DAY,   22, 2, 0, WATT_HOUR),
+        HM_DC(2, FIELD_YIELD_DAY,   24, 2, 0, WATT_HOUR),
+        HM_AC_FIELDS(26)
+    };
+};
+
+// HM-1200/1500: four DC inputs, pairs share one voltage measurement
+struct HoymilesLayoutHM4Ch {
+    static constexpr uint8_t dcChannels = 4;
+    static constexpr HoymilesFieldDescriptor fields[] = {
+        HM_DC(1, FIELD_VOLTAGE,     2,  2, 1, VOLT),
+        HM_DC(1, FIELD_CURRENT,     4,  2, 2, AMPERE),
+        HM_DC(2, FIELD_VOLTAGE,     2,  2, 1, VOLT),
+        HM_DC(2, FIELD_CURRENT,     6,  2, 2, AMPERE),
+        HM_DC(1, FIELD_POWER,       8,  2, 1, WATT),
+        HM_DC(2, FIELD_POWER,       10, 2, 1, WATT),
+        HM_DC(1, FIELD_YIELD_TOTAL, 12, 4, 0, WATT_HOUR),
+        HM_DC(2, FIELD_YIELD_TOTAL, 16, 4, 0, WATT_HOUR),
+        HM_DC(1, FIELD_YIELD_DAY,   20, 2, 0, WATT_HOUR),
+        HM_DC(2, FIELD_YIELD_DAY,   22, 2, 0, WATT_HOUR),
+        HM_DC(3, FIELD_VOLTAGE,     24, 2, 1, VOLT),
+        HM_DC(3, FIELD_CURRENT,     26, 2, 2, AMPERE),
+        HM_DC(4, FIELD_VOLTAGE,     24, 2, 1, VOLT),
+        HM_DC(4, FIELD_CURRENT,     28, 2, 2, AMPERE),
+        HM_DC(3, FIELD_POWER,       30, 2, 1, WATT),
+        HM_DC(4, FIELD_POWER,       32, 2, 1, WATT),
+        HM_DC(3, FIELD_YIELD_TOTAL, 34, 4, 0, WATT_HOUR),
+        HM_DC(4, FIELD_YIELD_TOTAL, 38, 4, 0, WATT_HOUR),
+        HM_DC(3, FIELD_YIELD_DAY,   42, 2, 0, WATT_HOUR),
+        HM_DC(4, FIELD_YIELD_DAY,   44, 2, 0, WATT_HOUR),
+        HM_AC_FIELDS(46)
+    };
+};
+
+// HMS-1600/1800/2000: four independent DC inputs, 12-byte block each
+#define HMS_DC_BLOCK(ch, base) \
+    HM_DC(ch, FIELD_VOLTAGE,     (base) + 0, 2, 1, VOLT), \
+    HM_DC(ch, FIELD_CURRENT,     (base) + 2, 2, 2, AMPERE), \
+    HM_DC(ch, FIELD_POWER,       (base) + 4, 2, 1, WATT), \
+    HM_DC(ch, FIELD_YIELD_DAY,   (base) + 6, 2, 0, WATT_HOUR), \
+    HM_DC(ch, FIELD_YIELD_TOTAL, (base) + 8, 4, 0, WATT_HOUR)
+
+struct HoymilesLayoutHMS4Ch {
+    static constexpr uint8_t dcChannels = 4;
+    static constexpr HoymilesFieldDescriptor fields[] = {
+        HMS_DC_BLOCK(1, 2),
+        HMS_DC_BLOCK(2, 14),
+        HMS_DC_BLOCK(3, 26),
+        HMS_DC_BLOCK(4, 38),
+        HM_AC_FIELDS(50)
+    };
+};
+
+// HMT-1600/1800/2250: six DC inputs, pairs share one voltage measurement
+struct HoymilesLayoutHMT6Ch {
+    static constexpr uint8_t dcChannels = 6;
+    static constexpr HoymilesFieldDescriptor fields[] = {
+        HM_DC(1, FIELD_VOLTAGE,     2,  2, 1, VOLT),
+        HM_DC(1, FIELD_CURRENT,     4,  2, 2, AMPERE),
+        HM_DC(2, FIELD_VOLTAGE,     2,  2, 1, VOLT),
+        HM_DC(2, FIELD_CURRENT,     6,  2, 2, AMPERE),
+        HM_DC(1, FIELD_POWER,       8,  2, 1, WATT),
+        HM_DC(2, FIELD_POWER,       10, 2, 1, WATT),
+        HM_DC(1, FIELD_YIELD_TOTAL, 12, 4, 0, WATT_HOUR),
+        HM_DC(2, FIELD_YIELD_TOTAL, 16, 4, 0, WATT_HOUR),
+        HM_DC(1, FIELD_YIELD_DAY,   20, 2, 0, WATT_HOUR),
+        HM_DC(2, FIELD_YIELD_DAY,   22, 2, 0, WATT_HOUR),
+        HM_DC(3, FIELD_VOLTAGE,     24, 2, 1, VOLT),
+        HM_DC(3, FIELD_CURRENT,     26, 2, 2, AMPERE),
+        HM_DC(4, FIELD_VOLTAGE,     24, 2, 1, VOLT),
+        HM_DC(4, FIELD_CURRENT,     28, 2, 2, AMPERE),
+        HM_DC(3, FIELD_POWER,       30, 2, 1, WATT),
+        HM_DC(4, FIELD_POWER,       32, 2, 1, WATT),
+        HM_DC(3, FIELD_YIELD_TOTAL, 34, 4, 0, WATT_HOUR),
+        HM_DC(4, FIELD_YIELD_TOTAL, 38, 4, 0, WATT_HOUR),
+        HM_DC(3, FIELD_YIELD_DAY,   42, 2, 0, WATT_HOUR),
+        HM_DC(4, FIELD_YIELD_DAY,   44, 2, 0, WATT_HOUR),
+        HM_DC(5, FIELD_VOLTAGE,     46, 2, 1, VOLT),
+        HM_DC(5, FIELD_CURRENT,     48, 2, 2, AMPERE),
+        HM_DC(6, FIELD_VOLTAGE,     46, 2, 1, VOLT),
+        HM_DC(6, FIELD_CURRENT,     50, 2, 2, AMPERE),
+        HM_DC(5, FIELD_POWER,       52, 2, 1, WATT),
+        HM_DC(6, FIELD_POWER,       54, 2, 1, WATT),
+        HM_DC(5, FIELD_YIELD_TOTAL, 56, 4, 0, WATT_HOUR),
+        HM_DC(6, FIELD_YIELD_TOTAL, 60, 4, 0, WATT_HOUR),
+        HM_DC(5, FIELD_YIELD_DAY,   64, 2, 0, WATT_HOUR),
+        HM_DC(6, FIELD_YIELD_DAY,   66, 2, 0, WATT_HOUR),
+        HM_AC_FIELDS(68)
+    };
+};
+
+#undef HMS_DC_BLOCK
+#undef HM_AC_FIELDS
+#undef HM_AC
+#undef HM_DC
+
+// ============================================
+// Decoder
+// ============================================
+
+namespace HoymilesDecoder {
+
+template <typename Layout>
+constexpr size_t fieldCount() {
+    return sizeof(Layout::fields) / sizeof(Layout::fields[0]);
+}
+
+// Smallest payload (without CRC16) that contains every field of the layout
+template <typename Layout>
+constexpr uint8_t minPayloadLength() {
+    uint8_t len = 0;
+    for (size_t i = 0; i < fieldCount<Layout>(); i++) {
+        uint8_t end = Layout::fields[i].offset + Layout::fields[i].width;
+        if (end > len) {
+            len = end;
+        }
+    }
+    return len;
+}
+
+template <typename Layout, size_t I>
+inline void decodeField(const uint8_t* payload, HoymilesRealtimeData& data) {
+    constexpr HoymilesFieldDescriptor f = Layout::fields[I];
+    static_assert(f.width == 2 || f.width == 4, "Field width must be 2 or 4 bytes");
+    static_assert(f.channel <= Layout::dcChannels, "Field channel out of range");
+    static_assert(f.decimals < sizeof(FIXED_POINT_POW10) / sizeof(FIXED_POINT_POW10[0]), "Unsupported field scale");
+
+    const uint8_t* p = payload + f.offset;
+    int32_t value;
+    if constexpr (f.width == 4) {
+        value = (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]);
+    } else if constexpr (f.isSigned) {
+        value = (int16_t)((p[0] << 8) | p[1]);
+    } else {
+        value = (uint16_t)((p[0] << 8) | p[1]);
+    }
+
+    // Rescale to the canonical fixed-point unit of the field (no-op for all current tables)
+    constexpr uint8_t target = HOYMILES_FIELD_DECIMALS[f.field];
+    if constexpr (f.decimals < target) {
+        value *= FIXED_POINT_POW10[target - f.decimals];
+    } else if constexpr (f.decimals > target) {
+        value /= FIXED_POINT_POW10[f.decimals - target];
+    }
+
+    data.values[f.channel][f.field] = value;
+}
+
+template <typename Layout, size_t... I>
+inline void decodeFields(const uint8_t* payload, HoymilesRealtimeData& data, std::index_sequence<I...>) {
+    (decodeField<Layout, I>(payload, data), ...);
+}
+
+/**
+ * Decode a realtime payload with the given layout
+ *
+ * @param payload Reassembled, CRC16-verified payload
+ * @param len Payload length (without CRC16)
+ * @param data Output: decoded values
+ * @return false if the payload is shorter than the layout
+ */
+template <typename Layout>
+bool decode(const uint8_t* payload, uint8_t len, HoymilesRealtimeData& data) {
+    static_assert(Layout::dcChannels <= HOYMILES_MAX_DC_CHANNELS, "Too many DC channels");
+
+    if (len < minPayloadLength<Layout>()) {
+        return false;
+    }
+
+    data.dcChannels = Layout::dcChannels;
+    decodeFields<Layout>(payload, data, std::make_index_sequence<fieldCount<Layout>()>{});
+    return true;
+}
+
+} // namespace HoymilesDecoder
+
+// ============================================
+// Model registry
+// ============================================
+
+typedef bool (*HoymilesDecodeFunction)(const uint8_t* payload, uint8_t len, HoymilesRealtimeData& data);
+
+struct HoymilesModel {
+    const char* name;
+    uint16_t serialPrefix;              // Upper 16 bits of the 48-bit serial
+    uint8_t dcChannels;
+    const HoymilesFieldDescriptor* fields;
+    uint8_t fieldCount;
+    HoymilesDecodeFunction decode;
+};
+
+#define HOYMILES_MODEL(name, prefix, Layout) \
+    { name, prefix, Layout::dcChannels, Layout::fields, \
+      (uint8_t)HoymilesDecoder::fieldCount<Layout>(), &HoymilesDecoder::decode<Layout> }
+
+inline constexpr HoymilesModel HOYMILES_MODELS[] = {
+    // HM series (NRF24, 2.4 GHz)
+    HOYMILES_MODEL("HM-300/350/400",     0x1121, HoymilesLayout1Ch),
+    HOYMILES_MODEL("HM-600/700/800",     0x1141, HoymilesLayout2Ch),
+    HOYMILES_MODEL("HM-1200/1500",       0x1161, HoymilesLayoutHM4Ch),
+    // HMS/HMT series (CMT2300A, 868 MHz)
+    HOYMILES_MODEL("HMS-300/400/500",    0x1124, HoymilesLayout1Ch),
+    HOYMILES_MODEL("HMS-600/800/1000",   0x1144, HoymilesLayout2Ch),
+    HOYMILES_MODEL("HMS-1600/1800/2000", 0x1164, HoymilesLayoutHMS4Ch),
+    HOYMILES_MODEL("HMT-1600/1800/2250", 0x1382, HoymilesLayoutHMT6Ch),
+};
+
+#undef HOYMILES_MODEL
+
+/**
+ * Look up the model family of an inverter by its serial number
+ *
+ * @param serialNumber Inverter serial number
+ * @param fallback Model to use if the prefix is unknown
+ * @return Matching model, or fallback
+ */
+inline const HoymilesModel* findHoymilesModel(uint64_t serialNumber, const HoymilesModel* fallback) {
+    uint16_t prefix = (serialNumber >> 32) & 0xFFFF;
+    for (const HoymilesModel& model : HOYMILES_MODELS) {
+        if (model.serialPrefix == prefix) {
+            return &model;
+        }
+    }
+    return fallback;
+}
+
+// Fallbacks for serials with an unknown prefix
+#define HOYMILES_MODEL_DEFAULT_HM   (&HOYMILES_MODELS[1])  // HM-600/700/800
+#define HOYMILES_MODEL_DEFAULT_HMS  (&HOYMILES_MODELS[4])  // HMS-600/800/1000
+
+#endif // HOYMILES_MODELS_H
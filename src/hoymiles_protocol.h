@@ -9,11 +9,25 @@
 #define HOYMILES_PROTOCOL_H
 
 #include <Arduino.h>
+#include "hoymiles_crc.h"
+#include "hoymiles_rtt.h"
 
 // Protocol constants
 #define HOYMILES_PACKET_MAX_SIZE    64
 #define HOYMILES_DTU_SERIAL         99978563001ULL  // Default DTU serial (can be customized)
 
+// Multi-fragment responses
+#define HOYMILES_MAX_FRAGMENTS      8     // Fragment index is 1..8
+#define HOYMILES_FRAGMENT_SIZE      16    // Payload bytes in every fragment except the last
+#define HOYMILES_PAYLOAD_MAX_SIZE   (HOYMILES_MAX_FRAGMENTS * HOYMILES_FRAGMENT_SIZE)
+#define HOYMILES_FRAGMENT_LAST      0x80  // Fragment index flag: final fragment
+#define HOYMILES_FRAGMENT_REQUEST   0x80  // Request flag: retransmit a single fragment
+#define HOYMILES_MAX_FRAGMENT_RETRIES 3   // Per poll, before giving up on an inverter
+
+// Fragment frame header length (time counter, response code, serial, fragment index)
+#define HOYMILES_HM_FRAGMENT_HEADER   8   // 4-byte inverter serial
+#define HOYMILES_HMS_FRAGMENT_HEADER  12  // 8-byte inverter serial
+
 // Command types - HM Series (2.4GHz)
 #define CMD_GET_REALTIME_DATA       0x0B
 #define RESP_REALTIME_DATA          0x8B
@@ -35,14 +49,19 @@ public:
     static uint8_t crc8(const uint8_t* data, uint8_t len) {
         uint8_t crc = 0;
         for (uint8_t i = 0; i < len; i++) {
-            crc ^= data[i];
-            for (uint8_t j = 0; j < 8; j++) {
-                if (crc & 0x01) {
-                    crc = (crc >> 1) ^ 0x8C;
-                } else {
-                    crc >>= 1;
-                }
-            }
+            crc = HOYMILES_CRC8_LOOKUP(crc ^ data[i]);
+        }
+        return crc;
+    }
+
+    /**
+     * Calculate CRC16 checksum (Modbus, polynomial 0xA001, init 0xFFFF)
+     * Covers the reassembled payload of multi-fragment responses
+     */
+    static uint16_t crc16(const uint8_t* data, uint16_t len) {
+        uint16_t crc = 0xFFFF;
+        for (uint16_t i = 0; i < len; i++) {
+            crc = (crc >> 8) ^ HOYMILES_CRC16_LOOKUP((crc ^ data[i]) & 0xFF);
         }
         return crc;
     }
@@ -65,24 +84,23 @@ public:
      * Build realtime data request packet for HM series (NRF24)
      *
      * Packet structure:
-     * [0-1]   : Time counter (increments with each request)
+     * [0-1]   : Time counter (per inverter, see HoymilesSession)
      * [2]     : Command (0x0B for realtime data)
      * [3-6]   : DTU serial number (4 bytes)
      * [7-10]  : Inverter serial number (4 bytes)
      * [11]    : CRC8 checksum
      *
      * @param packet Output buffer (minimum 12 bytes)
+     * @param timeCounter Time counter of this request
      * @param dtuSerial DTU serial number
      * @param inverterSerial Inverter serial number
      * @return Packet size (always 12)
      */
-    static uint8_t buildRealtimeRequest(uint8_t* packet, uint64_t dtuSerial, uint64_t inverterSerial) {
-        static uint16_t timeCounter = 0;
-
+    static uint8_t buildRealtimeRequest(uint8_t* packet, uint16_t timeCounter,
+                                        uint64_t dtuSerial, uint64_t inverterSerial) {
         // Time counter (2 bytes)
         packet[0] = (timeCounter >> 8) & 0xFF;
         packet[1] = timeCounter & 0xFF;
-        timeCounter++;
 
         // Command
         packet[2] = CMD_GET_REALTIME_DATA;
@@ -106,57 +124,113 @@ public:
     }
 
     /**
-     * Parse realtime data response from HM series inverter
+     * Build single-fragment retransmit request for HM series (NRF24)
      *
-     * Response structure (varies by inverter model):
-     * [0-1]   : Time counter (echo from request)
-     * [2]     : Response code (0x8B)
-     * [3-6]   : Inverter serial number
-     * [7-8]   : DC Power (W * 10)
-     * [9-10]  : AC Power (W * 10)
-     * [11-12] : DC Voltage (V * 10)
-     * [13-14] : DC Current (A * 100)
-     * [15-16] : AC Voltage (V * 10)
-     * [17-18] : AC Frequency (Hz * 100)
-     * [19-20] : Temperature (°C * 10)
-     * [21-22] : Grid voltage (V * 10)
-     * [...]   : Additional fields depending on model
-     * [n-1]   : CRC8 checksum
+     * Same layout as the realtime request, echoing the time counter of the
+     * original request, plus:
+     * [11]    : Fragment request (0x80 | fragment index)
+     * [12]    : CRC8 checksum
      *
-     * @param packet Response packet buffer
-     * @param len Packet length
-     * @param power Output: AC power in watts
-     * @param voltage Output: AC voltage in volts
-     * @param current Output: DC current in amps
-     * @param frequency Output: AC frequency in Hz
-     * @param temperature Output: Inverter temperature in °C
-     * @return true if packet valid and parsed successfully
+     * @param packet Output buffer (minimum 13 bytes)
+     * @param timeCounter Time counter of the request being completed
+     * @param dtuSerial DTU serial number
+     * @param inverterSerial Inverter serial number
+     * @param fragmentIndex Missing fragment (1-based)
+     * @return Packet size (always 13)
+     */
+    static uint8_t buildFragmentRequest(uint8_t* packet, uint16_t timeCounter,
+                                        uint64_t dtuSerial, uint64_t inverterSerial,
+                                        uint8_t fragmentIndex) {
+        writeBigEndian(&packet[0], timeCounter, 2);
+        packet[2] = CMD_GET_REALTIME_DATA;
+        writeBigEndian(&packet[3], dtuSerial, 4);
+        writeBigEndian(&packet[7], inverterSerial, 4);
+        packet[11] = HOYMILES_FRAGMENT_REQUEST | fragmentIndex;
+        packet[12] = crc8(packet, 12);
+
+        return 13;
+    }
+
+    /**
+     * Time counter of a request packet (first two bytes, both series)
+     */
+    static uint16_t getTimeCounter(const uint8_t* packet) {
+        return (packet[0] << 8) | packet[1];
+    }
+
+    /**
+     * One received fragment of a multi-fragment response
      */
-    static bool parseRealtimeResponse(const uint8_t* packet, uint8_t len,
-                                     float& power, float& voltage, float& current,
-                                     float& frequency, float& temperature) {
-        // Minimum packet size check
-        if (len < 23) {
+    struct Fragment {
+        uint64_t sender;        // Inverter serial (low 4 bytes HM, 8 bytes HMS)
+        uint16_t timeCounter;   // Echo of the request time counter
+        uint8_t index;          // 1-based fragment index
+        bool last;              // Final fragment of the response
+        const uint8_t* data;    // Payload chunk (points into the frame)
+        uint8_t length;         // Payload chunk length
+    };
+
+    /**
+     * Check whether a fragment was sent by the given inverter
+     */
+    static bool isFromInverter(const Fragment& fragment, uint64_t inverterSerial, uint8_t headerLen) {
+        uint8_t serialBits = 8 * (headerLen - 4);
+        uint64_t mask = serialBits >= 64 ? ~0ULL : (1ULL << serialBits) - 1;
+        return (inverterSerial & mask) == fragment.sender;
+    }
+
+    /**
+     * Validate a fragment frame and locate its payload chunk
+     *
+     * Frame structure (HM: 4-byte serial, HMS: 8-byte serial):
+     * [0-1]         : Time counter (echo from request)
+     * [2]           : Response code (0x8B HM / 0x91 HMS)
+     * [3..h-2]      : Inverter serial number (low bytes, MSB first)
+     * [h-1]         : Fragment index (bit 7 set on the final fragment)
+     * [h..n-2]      : Payload chunk (16 bytes, final fragment may be shorter)
+     * [n-1]         : CRC8 checksum
+     *
+     * @param frame Received frame
+     * @param len Frame length
+     * @param headerLen HOYMILES_HM_FRAGMENT_HEADER or HOYMILES_HMS_FRAGMENT_HEADER
+     * @param responseCode Expected response code
+     * @param fragment Output: fragment description
+     * @return true if the frame is a valid fragment
+     */
+    static bool parseFragment(const uint8_t* frame, uint8_t len, uint8_t headerLen,
+                              uint8_t responseCode, Fragment& fragment) {
+        if (len < headerLen + 2 || len > headerLen + HOYMILES_FRAGMENT_SIZE + 1) {
             return false;
         }
 
-        // Verify response code
-        if (packet[2] != RESP_REALTIME_DATA) {
+        if (frame[2] != responseCode) {
             return false;
         }
 
-        // Verify CRC
-        uint8_t crc = crc8(packet, len - 1);
-        if (crc != packet[len - 1]) {
+        if (crc8(frame, len - 1) != frame[len - 1]) {
             return false;
         }
 
-        // Parse data fields
-        power = ((packet[9] << 8) | packet[10]) / 10.0f;       // AC Power
-        voltage = ((packet[15] << 8) | packet[16]) / 10.0f;    // AC Voltage
-        current = ((packet[13] << 8) | packet[14]) / 100.0f;   // DC Current
-        frequency = ((packet[17] << 8) | packet[18]) / 100.0f; // Frequency
-        temperature = ((packet[19] << 8) | packet[20]) / 10.0f; // Temperature
+        // Sender serial
+        fragment.sender = 0;
+        for (uint8_t i = 3; i < headerLen - 1; i++) {
+            fragment.sender = (fragment.sender << 8) | frame[i];
+        }
+
+        fragment.timeCounter = getTimeCounter(frame);
+        fragment.index = frame[headerLen - 1] & ~HOYMILES_FRAGMENT_LAST;
+        fragment.last = (frame[headerLen - 1] & HOYMILES_FRAGMENT_LAST) != 0;
+        fragment.data = &frame[headerLen];
+        fragment.length = len - headerLen - 1;
+
+        if (fragment.index == 0 || fragment.index > HOYMILES_MAX_FRAGMENTS) {
+            return false;
+        }
+
+        // Only the final fragment may be short
+        if (!fragment.last && fragment.length != HOYMILES_FRAGMENT_SIZE) {
+            return false;
+        }
 
         return true;
     }
@@ -170,26 +244,25 @@ public:
      * - Longer packets with more fields
      *
      * Packet structure:
-     * [0-1]   : Time counter
+     * [0-1]   : Time counter (per inverter, see HoymilesSession)
      * [2]     : Command (0x11 for HMS realtime data)
      * [3-10]  : DTU serial number (8 bytes for HMS)
      * [11-18] : Inverter serial number (8 bytes)
-     * [19]    : Packet counter
+     * [19]    : Packet counter (per inverter)
      * [20]    : CRC8 checksum
      *
      * @param packet Output buffer (minimum 21 bytes)
+     * @param timeCounter Time counter of this request
+     * @param packetCounter Packet counter of this request
      * @param dtuSerial DTU serial number (full 64-bit)
      * @param inverterSerial Inverter serial number (full 64-bit)
      * @return Packet size (always 21)
      */
-    static uint8_t buildHMSRealtimeRequest(uint8_t* packet, uint64_t dtuSerial, uint64_t inverterSerial) {
-        static uint16_t timeCounter = 0;
-        static uint8_t packetCounter = 0;
-
+    static uint8_t buildHMSRealtimeRequest(uint8_t* packet, uint16_t timeCounter, uint8_t packetCounter,
+                                           uint64_t dtuSerial, uint64_t inverterSerial) {
         // Time counter (2 bytes)
         packet[0] = (timeCounter >> 8) & 0xFF;
         packet[1] = timeCounter & 0xFF;
-        timeCounter++;
 
         // Command for HMS
         packet[2] = HMS_CMD_GET_REALTIME_DATA;
@@ -215,7 +288,7 @@ public:
         packet[18] = inverterSerial & 0xFF;
 
         // Packet counter
-        packet[19] = packetCounter++;
+        packet[19] = packetCounter;
 
         // CRC8 checksum
         packet[20] = crc8(packet, 20);
@@ -224,66 +297,232 @@ public:
     }
 
     /**
-     * Parse realtime data response from HMS/HMT series inverter
+     * Build single-fragment retransmit request for HMS/HMT series (CMT2300A)
      *
-     * HMS response structure (longer than HM):
-     * [0-1]   : Time counter
-     * [2]     : Response code (0x91)
-     * [3-10]  : Inverter serial number (8 bytes)
-     * [11-12] : DC Power Channel 1 (W * 10)
-     * [13-14] : DC Power Channel 2 (W * 10)
-     * [15-16] : AC Power (W * 10)
-     * [17-18] : DC Voltage Channel 1 (V * 10)
-     * [19-20] : DC Voltage Channel 2 (V * 10)
-     * [21-22] : DC Current Channel 1 (A * 100)
-     * [23-24] : DC Current Channel 2 (A * 100)
-     * [25-26] : AC Voltage (V * 10)
-     * [27-28] : AC Frequency (Hz * 100)
-     * [29-30] : Temperature (°C * 10)
-     * [...]   : Additional fields
-     * [n-1]   : CRC8 checksum
+     * Same layout as the HMS realtime request, echoing the time counter of
+     * the original request, with the packet counter replaced by:
+     * [19]    : Fragment request (0x80 | fragment index)
+     * [20]    : CRC8 checksum
      *
-     * @param packet Response packet buffer
-     * @param len Packet length
-     * @param power Output: Total AC power in watts
-     * @param voltage Output: AC voltage in volts
-     * @param current Output: Total DC current in amps (sum of channels)
-     * @param frequency Output: AC frequency in Hz
-     * @param temperature Output: Inverter temperature in °C
-     * @return true if packet valid and parsed successfully
+     * @param packet Output buffer (minimum 21 bytes)
+     * @param timeCounter Time counter of the request being completed
+     * @param dtuSerial DTU serial number (full 64-bit)
+     * @param inverterSerial Inverter serial number (full 64-bit)
+     * @param fragmentIndex Missing fragment (1-based)
+     * @return Packet size (always 21)
      */
-    static bool parseHMSRealtimeResponse(const uint8_t* packet, uint8_t len,
-                                        float& power, float& voltage, float& current,
-                                        float& frequency, float& temperature) {
-        // Minimum packet size check (HMS packets are longer)
-        if (len < 32) {
-            return false;
+    static uint8_t buildHMSFragmentRequest(uint8_t* packet, uint16_t timeCounter,
+                                           uint64_t dtuSerial, uint64_t inverterSerial,
+                                           uint8_t fragmentIndex) {
+        writeBigEndian(&packet[0], timeCounter, 2);
+        packet[2] = HMS_CMD_GET_REALTIME_DATA;
+        writeBigEndian(&packet[3], dtuSerial, 8);
+        writeBigEndian(&packet[11], inverterSerial, 8);
+        packet[19] = HOYMILES_FRAGMENT_REQUEST | fragmentIndex;
+        packet[20] = crc8(packet, 20);
+
+        return 21;
+    }
+
+private:
+    static void writeBigEndian(uint8_t* dst, uint64_t value, uint8_t bytes) {
+        for (uint8_t i = 0; i < bytes; i++) {
+            dst[i] = (value >> (8 * (bytes - 1 - i))) & 0xFF;
         }
+    }
+};
 
-        // Verify response code
-        if (packet[2] != HMS_RESP_REALTIME_DATA) {
-            return false;
+/**
+ * Reassembles one multi-fragment response
+ *
+ * The payload layout depends on the inverter model, see hoymiles_models.h.
+ * Fragments are placed by index into a preallocated buffer and tracked in
+ * a bitmap, so they may arrive in any order and duplicates are ignored.
+ * When fragments are missing, getMissingFragment() names the one to
+ * request individually instead of repeating the full realtime request.
+ * The reassembled payload ends with a CRC16 (big-endian) over all
+ * preceding bytes.
+ */
+class HoymilesFragmentAssembler {
+public:
+    enum class Result : uint8_t {
+        INCOMPLETE,     // Accepted, more fragments needed
+        COMPLETE,       // All fragments received
+        DUPLICATE,      // Already had this fragment
+        INVALID         // Belongs to another request or inconsistent
+    };
+
+    HoymilesFragmentAssembler() { reset(0); }
+
+    /**
+     * Start a new response
+     * @param timeCounter Time counter of the request the fragments answer
+     */
+    void reset(uint16_t timeCounter) {
+        m_timeCounter = timeCounter;
+        m_received = 0;
+        m_lastIndex = 0;
+        m_lastLength = 0;
+    }
+
+    Result addFragment(const HoymilesProtocol::Fragment& fragment) {
+        if (fragment.timeCounter != m_timeCounter) {
+            return Result::INVALID;
+        }
+
+        uint8_t bit = 1 << (fragment.index - 1);
+        if (m_received & bit) {
+            return Result::DUPLICATE;
+        }
+
+        if (fragment.last) {
+            // Fragments beyond the final one must not exist
+            if (m_received >> fragment.index) {
+                return Result::INVALID;
+            }
+            m_lastIndex = fragment.index;
+            m_lastLength = fragment.length;
+        } else if (m_lastIndex && fragment.index > m_lastIndex) {
+            return Result::INVALID;
+        }
+
+        memcpy(&m_buffer[(fragment.index - 1) * HOYMILES_FRAGMENT_SIZE],
+               fragment.data, fragment.length);
+        m_received |= bit;
+
+        return isComplete() ? Result::COMPLETE : Result::INCOMPLETE;
+    }
+
+    bool isComplete() const {
+        return m_lastIndex && m_received == (uint8_t)((1u << m_lastIndex) - 1);
+    }
+
+    bool hasFragments() const { return m_received != 0; }
+    bool hasLastFragment() const { return m_lastIndex != 0; }
+    uint16_t getTimeCounter() const { return m_timeCounter; }
+
+    /**
+     * Lowest fragment index still missing
+     *
+     * If the final fragment has not been seen yet, the fragment after the
+     * highest one received is requested (its reply reveals the count).
+     *
+     * @return 1-based fragment index, or 0 if nothing is missing
+     */
+    uint8_t getMissingFragment() const {
+        uint8_t limit = m_lastIndex ? m_lastIndex : HOYMILES_MAX_FRAGMENTS;
+        for (uint8_t i = 0; i < limit; i++) {
+            if (!(m_received & (1 << i))) {
+                return i + 1;
+            }
         }
+        return 0;
+    }
 
-        // Verify CRC
-        uint8_t crc = crc8(packet, len - 1);
-        if (crc != packet[len - 1]) {
+    /**
+     * Verify the CRC16 of a complete payload
+     */
+    bool verify() const {
+        uint8_t total = getTotalLength();
+        if (!isComplete() || total < 2) {
             return false;
         }
+        uint16_t expected = (m_buffer[total - 2] << 8) | m_buffer[total - 1];
+        return HoymilesProtocol::crc16(m_buffer, total - 2) == expected;
+    }
 
-        // Parse data fields
-        power = ((packet[15] << 8) | packet[16]) / 10.0f;      // AC Power
-        voltage = ((packet[25] << 8) | packet[26]) / 10.0f;    // AC Voltage
+    /**
+     * Reassembled payload (valid after verify())
+     */
+    const uint8_t* getPayload() const { return m_buffer; }
 
-        // Sum DC current from both channels
-        float current1 = ((packet[21] << 8) | packet[22]) / 100.0f;
-        float current2 = ((packet[23] << 8) | packet[24]) / 100.0f;
-        current = current1 + current2;
+    /**
+     * Payload length without the trailing CRC16
+     */
+    uint8_t getPayloadLength() const {
+        uint8_t total = getTotalLength();
+        return total >= 2 ? total - 2 : 0;
+    }
 
-        frequency = ((packet[27] << 8) | packet[28]) / 100.0f; // Frequency
-        temperature = ((packet[29] << 8) | packet[30]) / 10.0f; // Temperature
+private:
+    uint8_t m_buffer[HOYMILES_PAYLOAD_MAX_SIZE];
+    uint16_t m_timeCounter;
+    uint8_t m_received;     // Bitmap, bit n = fragment n + 1
+    uint8_t m_lastIndex;    // Index of the final fragment, 0 if not yet seen
+    uint8_t m_lastLength;   // Payload bytes in the final fragment
 
-        return true;
+    uint8_t getTotalLength() const {
+        return m_lastIndex ? (m_lastIndex - 1) * HOYMILES_FRAGMENT_SIZE + m_lastLength : 0;
+    }
+};
+
+/**
+ * Protocol state of one inverter
+ *
+ * Owned by the radio driver, one per inverter. Request counters are per
+ * inverter, so a response can be matched to the request it answers by
+ * sender and time counter, and requests to several inverters can be in
+ * flight at the same time.
+ */
+struct HoymilesSession {
+    uint16_t timeCounter;           // Counter of the request in flight
+    uint8_t packetCounter;          // HMS packet counter
+    unsigned long requestStart;     // millis() of the request in flight
+    unsigned long lastRequest;      // millis() of the last (re)transmission
+    uint8_t fragmentRetries;        // Single-fragment requests sent for this request
+    bool hasCompleted;
+    uint16_t lastCompleted;         // Time counter of the last complete response
+    HoymilesFragmentAssembler assembler;    // Pending-fragment map and buffer
+    HoymilesRttEstimator rtt;       // Request-to-complete-response time
+
+    explicit HoymilesSession(uint16_t initialTimeout = HOYMILES_RESPONSE_TIMEOUT)
+        : timeCounter(0), packetCounter(0), requestStart(0), lastRequest(0), fragmentRetries(0)
+        , hasCompleted(false), lastCompleted(0), rtt(initialTimeout) {}
+
+    /**
+     * Start a new request: advance the counters and reset reassembly
+     * @return Time counter to put into the request
+     */
+    uint16_t beginRequest(unsigned long now) {
+        timeCounter++;
+        packetCounter++;
+        requestStart = now;
+        lastRequest = now;
+        fragmentRetries = 0;
+        assembler.reset(timeCounter);
+        return timeCounter;
+    }
+
+    /**
+     * Record a retransmission of a missing fragment
+     */
+    void beginFragmentRequest(unsigned long now) {
+        lastRequest = now;
+        fragmentRetries++;
+    }
+
+    /**
+     * Feed a fragment addressed to this inverter
+     *
+     * Fragments of a response that was already completed (retransmissions,
+     * radio echoes) are reported as DUPLICATE; fragments answering an older
+     * request as INVALID. A response completed without fragment
+     * retransmissions is an RTT sample.
+     */
+    HoymilesFragmentAssembler::Result accept(const HoymilesProtocol::Fragment& fragment, unsigned long now) {
+        if (hasCompleted && fragment.timeCounter == lastCompleted) {
+            return HoymilesFragmentAssembler::Result::DUPLICATE;
+        }
+
+        auto result = assembler.addFragment(fragment);
+        if (result == HoymilesFragmentAssembler::Result::COMPLETE) {
+            hasCompleted = true;
+            lastCompleted = fragment.timeCounter;
+            if (fragmentRetries == 0) {
+                rtt.sample(now - requestStart);
+            }
+        }
+        return result;
     }
 };
 
@@ -0,0 +1,75 @@
+/**
+ * Hoymiles Radio - Transceiver abstraction used by the protocol drivers
+ *
+ * The HM and HMS drivers only talk to the air through this interface, so
+ * the poll logic is independent of the actual transceiver. Backends:
+ * - NRF24Radio     (hoymiles_radio_nrf24.h)  HM series, 2.4 GHz
+ * - CMT2300ARadio  (hoymiles_radio_cmt.h)    HMS/HMT series, 868 MHz
+ * - SimulatedRadio (hoymiles_radio_sim.h)    virtual inverters, no hardware
+ */
+
+#ifndef HOYMILES_RADIO_H
+#define HOYMILES_RADIO_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#ifdef HOYMILES_RX_TASK
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#endif
+
+class HoymilesRadio {
+public:
+    virtual ~HoymilesRadio() {}
+
+    /**
+     * Initialize the transceiver and enter receive mode
+     * @return false if the hardware did not respond
+     */
+    virtual bool begin() = 0;
+
+    /**
+     * Send one packet to an inverter, then return to receive mode
+     * @param inverterSerial Addressed inverter (NRF24 derives the pipe address from it)
+     * @return true if the packet left the radio
+     */
+    virtual bool transmit(uint64_t inverterSerial, const uint8_t* packet, uint8_t len) = 0;
+
+    /**
+     * Check for a received packet (non-blocking)
+     */
+    virtual bool available() = 0;
+
+    /**
+     * Read the next received packet
+     * @param buffer Output buffer
+     * @param size Buffer size
+     * @return Packet length, 0 if the packet was invalid or too large and has been dropped
+     */
+    virtual uint8_t read(uint8_t* buffer, uint8_t size) = 0;
+
+    virtual void setChannel(uint8_t channel) = 0;
+    virtual uint8_t getChannel() = 0;
+
+    /**
+     * Signal strength of the last received packet (dBm)
+     */
+    virtual int16_t getRssi() = 0;
+
+    virtual const char* getName() = 0;
+
+#ifdef HOYMILES_RX_TASK
+    /**
+     * Notify this task from the receive interrupt (packet arrived)
+     * @return false if the backend has no receive interrupt; the caller then
+     *         keeps polling available()
+     */
+    virtual bool setRxTask(TaskHandle_t task) {
+        (void)task;
+        return false;
+    }
+#endif
+};
+
+#endif // HOYMILES_RADIO_H
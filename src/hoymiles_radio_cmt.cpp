@@ -0,0 +1,195 @@
+/**
+ * Hoymiles Radio - CMT2300A backend (HMS/HMT series, 868 MHz)
+ *
+ * Uses CMT2300A radio module via RadioLib
+ */
+
+#include "hoymiles_radio_cmt.h"
+#include "config.h"
+#include "spi_arbiter.h"
+#include "logger.h"
+
+#ifdef RADIO_CMT2300A
+
+// Set by GPIO1 (packet ready), cleared when the packet is read
+static volatile bool s_packetReady = false;
+
+CMT2300ARadio::CMT2300ARadio()
+    : m_module(nullptr)
+    , m_radio(nullptr)
+    , m_channel(CMT2300A_DEFAULT_CHANNEL)
+    , m_irqEnabled(false)
+{
+}
+
+bool CMT2300ARadio::begin() {
+    SpiBusLock bus;
+
+    // Allocated once; a repeated begin() reconfigures the same instance
+    if (!m_radio) {
+        m_module = new Module(CMT2300A_CS_PIN, CMT2300A_GPIO1_PIN, RADIOLIB_NC, CMT2300A_GPIO2_PIN);
+        m_radio = new CMT2300A(m_module);
+    }
+
+    // Initialize CMT2300A with 868MHz configuration for Hoymiles HMS
+    int state = m_radio->begin(
+        868.0,           // Frequency: 868 MHz (European ISM band)
+        38.4,            // Bit rate: 38.4 kbps
+        10.0,            // Frequency deviation: 10 kHz
+        135.0,           // RX bandwidth: 135 kHz
+        10,              // Output power: 10 dBm
+        32               // Preamble length: 32 bits
+    );
+
+    if (state != RADIOLIB_ERR_NONE) {
+        DEBUG_PRINT("CMT2300A: ERROR - initialization failed! Code: ");
+        DEBUG_PRINTLN(state);
+        return false;
+    }
+
+    // HMS uses GFSK modulation
+    m_radio->setDataShaping(RADIOLIB_SHAPING_0_5);
+
+    // Set sync word (Hoymiles HMS specific)
+    uint8_t syncWord[] = {0xD3, 0x91};
+    m_radio->setSyncWord(syncWord, 2);
+
+    // Enable CRC
+    m_radio->setCRC(true);
+
+#ifdef CMT2300A_GPIO1_PIN
+    // GPIO1 signals packet-ready; the FIFO is only read when it fired
+    m_radio->setPacketReceivedAction(onPacketReceived);
+    m_irqEnabled = true;
+#endif
+
+    // Put radio in receive mode
+    state = m_radio->startReceive();
+    if (state != RADIOLIB_ERR_NONE) {
+        DEBUG_PRINT("CMT2300A: ERROR - Failed to start receive mode! Code: ");
+        DEBUG_PRINTLN(state);
+        return false;
+    }
+
+    DEBUG_PRINT("  RX mode: ");
+    DEBUG_PRINTLN(m_irqEnabled ? "IRQ" : "polled");
+
+    return true;
+}
+
+/**
+ * GPIO1 handler
+ *
+ * Only latches the event: SPI must not be used from interrupt context.
+ */
+void IRAM_ATTR CMT2300ARadio::onPacketReceived() {
+    s_packetReady = true;
+}
+
+bool CMT2300ARadio::transmit(uint64_t inverterSerial, const uint8_t* packet, uint8_t len) {
+    if (!m_radio) {
+        return false;
+    }
+
+    // HMS frames carry the full serial, no per-inverter address
+    (void)inverterSerial;
+
+    int state;
+    if (m_irqEnabled) {
+        // Only the FIFO load and mode switches hold the bus; the airtime
+        // is waited out unlocked so the NRF24 can be serviced meanwhile
+        {
+            SpiBusLock bus;
+            s_packetReady = false;
+            state = m_radio->startTransmit(packet, len);
+        }
+        if (state == RADIOLIB_ERR_NONE && !waitTransmitDone()) {
+            state = RADIOLIB_ERR_TX_TIMEOUT;
+        }
+
+        // GPIO1 pulsed for TX done; only packets received from here on count
+        SpiBusLock bus;
+        m_radio->finishTransmit();
+        s_packetReady = false;
+        m_radio->startReceive();
+    } else {
+        SpiBusLock bus;
+        state = m_radio->transmit(packet, len);
+        m_radio->startReceive();
+    }
+
+    if (state != RADIOLIB_ERR_NONE) {
+        LOG_ERROR("    ERROR - Transmission failed! Code: %d", state);
+    }
+
+    return state == RADIOLIB_ERR_NONE;
+}
+
+/**
+ * Wait for the GPIO1 TX-done pulse (latched by onPacketReceived)
+ */
+bool CMT2300ARadio::waitTransmitDone() {
+    unsigned long start = millis();
+    while (!s_packetReady) {
+        if (millis() - start >= CMT2300A_TX_TIMEOUT) {
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+bool CMT2300ARadio::available() {
+    if (!m_radio) {
+        return false;
+    }
+
+    // With the interrupt there is no SPI traffic until a packet is ready
+    if (m_irqEnabled) {
+        return s_packetReady;
+    }
+    SpiBusLock bus;
+    return m_radio->getPacketLength() > 0;
+}
+
+uint8_t CMT2300ARadio::read(uint8_t* buffer, uint8_t size) {
+    s_packetReady = false;
+
+    SpiBusLock bus;
+    size_t len = m_radio->getPacketLength();
+
+    if (len == 0 || len > size || len > CMT2300A_MAX_PAYLOAD_SIZE) {
+        LOG_WARN("    RX: Invalid packet size!");
+        m_radio->startReceive();
+        return 0;
+    }
+
+    int state = m_radio->readData(buffer, len);
+    m_radio->startReceive();
+
+    if (state != RADIOLIB_ERR_NONE) {
+        LOG_ERROR("    ERROR - Failed to read packet! Code: %d", state);
+        return 0;
+    }
+
+    return len;
+}
+
+void CMT2300ARadio::setChannel(uint8_t channel) {
+    m_channel = channel;
+    if (m_radio) {
+        SpiBusLock bus;
+        m_radio->setFrequency(CMT2300A_BASE_FREQUENCY + channel * CMT2300A_CHANNEL_SPACING);
+        m_radio->startReceive();
+    }
+}
+
+int16_t CMT2300ARadio::getRssi() {
+    if (!m_radio) {
+        return 0;
+    }
+    SpiBusLock bus;
+    return (int16_t)m_radio->getRSSI();
+}
+
+#endif // RADIO_CMT2300A
@@ -0,0 +1,75 @@
+/**
+ * Hoymiles Radio - CMT2300A backend (HMS/HMT series, 868 MHz)
+ */
+
+#ifndef HOYMILES_RADIO_CMT_H
+#define HOYMILES_RADIO_CMT_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#ifdef RADIO_CMT2300A
+
+#include <RadioLib.h>
+#include "hoymiles_radio.h"
+
+// Channel plan: 860 MHz base, 250 kHz spacing
+#define CMT2300A_BASE_FREQUENCY     860.0
+#define CMT2300A_CHANNEL_SPACING    0.25
+#define CMT2300A_DEFAULT_CHANNEL    32      // 868.0 MHz
+
+// Largest frame on the 868 MHz link (HMS fragment: 12 header + 16 data + CRC8)
+#define CMT2300A_MAX_PAYLOAD_SIZE   32
+
+// Longest wait for TX done (a 32-byte frame takes ~10 ms at 38.4 kbps)
+#define CMT2300A_TX_TIMEOUT         50      // ms
+
+// Pin definitions (can be overridden in config.h)
+#ifndef CMT2300A_CS_PIN
+  #ifdef ESP32
+    #define CMT2300A_CS_PIN    15   // SPI CS
+  #elif defined(ESP8266)
+    #define CMT2300A_CS_PIN    15   // D8
+  #endif
+#endif
+
+#ifndef CMT2300A_GPIO1_PIN
+  #ifdef ESP32
+    #define CMT2300A_GPIO1_PIN 21   // GPIO1 (used for interrupts)
+    #define CMT2300A_GPIO2_PIN 22   // GPIO2
+  #elif defined(ESP8266)
+    #define CMT2300A_GPIO1_PIN 4    // D2
+    #define CMT2300A_GPIO2_PIN 5    // D1
+  #endif
+#endif
+
+class CMT2300ARadio : public HoymilesRadio {
+public:
+    CMT2300ARadio();
+
+    bool begin() override;
+    bool transmit(uint64_t inverterSerial, const uint8_t* packet, uint8_t len) override;
+    bool available() override;
+    uint8_t read(uint8_t* buffer, uint8_t size) override;
+    void setChannel(uint8_t channel) override;
+    uint8_t getChannel() override { return m_channel; }
+    int16_t getRssi() override;
+    const char* getName() override { return "CMT2300A"; }
+
+    bool isIrqEnabled() const { return m_irqEnabled; }
+
+private:
+    // Created once in begin() and kept for the lifetime of the firmware
+    Module* m_module;
+    CMT2300A* m_radio;
+    uint8_t m_channel;
+    bool m_irqEnabled;
+
+    bool waitTransmitDone();
+
+    static void onPacketReceived();
+};
+
+#endif // RADIO_CMT2300A
+
+#endif // HOYMILES_RADIO_CMT_H
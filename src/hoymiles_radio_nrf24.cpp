@@ -0,0 +1,228 @@
+/**
+ * Hoymiles Radio - NRF24L01+ backend (HM series, 2.4 GHz)
+ */
+
+#include "hoymiles_radio_nrf24.h"
+#include "hoymiles_protocol.h"
+#include "config.h"
+#include "spi_arbiter.h"
+#include "logger.h"
+
+#ifdef RADIO_NRF24
+
+// Set by the NRF24 IRQ line (RX_DR), cleared when the FIFO is drained
+static volatile bool s_rxIrqPending = false;
+
+#ifdef HOYMILES_RX_TASK
+// Woken by the IRQ to drain the FIFO (see HoymilesHM::rxTaskMain())
+static TaskHandle_t volatile s_rxTask = nullptr;
+#endif
+
+NRF24Radio::NRF24Radio()
+    : m_radio(nullptr)
+    , m_irqEnabled(false)
+    , m_draining(false)
+{
+}
+
+bool NRF24Radio::begin() {
+    SpiBusLock bus;
+
+    m_radio = new RF24(NRF24_CE_PIN, NRF24_CS_PIN);
+
+    if (!m_radio->begin()) {
+        DEBUG_PRINTLN("NRF24: ERROR - initialization failed!");
+        delete m_radio;
+        m_radio = nullptr;
+        return false;
+    }
+
+    // Hoymiles HM configuration
+    m_radio->setChannel(NRF24_DEFAULT_CHANNEL);
+
+    // Use 250kbps for better range (Hoymiles inverters use this)
+    m_radio->setDataRate(RF24_250KBPS);
+
+    // Maximum PA level for long range
+    m_radio->setPALevel(RF24_PA_MAX);
+
+    // Disable auto-acknowledgment (Hoymiles doesn't use it)
+    m_radio->setAutoAck(false);
+
+    // Use 16-bit CRC
+    m_radio->setCRCLength(RF24_CRC_16);
+
+    // Enable dynamic payloads
+    m_radio->enableDynamicPayloads();
+
+    // Set retry delay and count
+    m_radio->setRetries(15, 15);  // Max delay, max retries
+
+    // Open reading pipe 0 (for receiving responses)
+    uint8_t rxAddress[5] = {0xCC, 0xCC, 0xCC, 0xCC, 0xCC};
+    m_radio->openReadingPipe(0, rxAddress);
+
+    // Start listening for responses
+    m_radio->startListening();
+
+#ifdef NRF24_IRQ_PIN
+    // Only RX_DR drives the IRQ line (TX_DS and MAX_RT masked)
+    m_radio->maskIRQ(true, true, false);
+    pinMode(NRF24_IRQ_PIN, INPUT_PULLUP);
+    attachInterrupt(digitalPinToInterrupt(NRF24_IRQ_PIN), onRadioIrq, FALLING);
+    m_irqEnabled = true;
+#endif
+
+    DEBUG_PRINT("  Channel: ");
+    DEBUG_PRINTLN(m_radio->getChannel());
+    DEBUG_PRINT("  Data Rate: ");
+    DEBUG_PRINTLN(m_radio->getDataRate() == RF24_250KBPS ? "250kbps" : "Unknown");
+    DEBUG_PRINT("  PA Level: ");
+    DEBUG_PRINTLN(m_radio->getPALevel());
+    DEBUG_PRINT("  RX mode: ");
+    DEBUG_PRINTLN(m_irqEnabled ? "IRQ" : "polled");
+
+    return true;
+}
+
+/**
+ * NRF24 IRQ handler
+ *
+ * SPI must not be used from interrupt context (the Arduino SPI driver
+ * takes a lock), so the handler only latches the event. With an RX task
+ * (ESP32) it also wakes that task, which drains the FIFO through
+ * available()/read() right away; otherwise the FIFO is drained on the
+ * next tick.
+ */
+void IRAM_ATTR NRF24Radio::onRadioIrq() {
+    s_rxIrqPending = true;
+
+#ifdef HOYMILES_RX_TASK
+    TaskHandle_t task = s_rxTask;
+    if (task) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(task, &woken);
+        if (woken) {
+            portYIELD_FROM_ISR();
+        }
+    }
+#endif
+}
+
+#ifdef HOYMILES_RX_TASK
+bool NRF24Radio::setRxTask(TaskHandle_t task) {
+    if (!m_irqEnabled) {
+        return false;
+    }
+    s_rxTask = task;
+    return true;
+}
+#endif
+
+bool NRF24Radio::transmit(uint64_t inverterSerial, const uint8_t* packet, uint8_t len) {
+    if (!m_radio) {
+        return false;
+    }
+
+    // Convert serial to NRF24 address
+    uint8_t inverterAddress[5];
+    HoymilesProtocol::serialToAddress(inverterSerial, inverterAddress);
+
+    LOG_DEBUG("    TX Address: %02X:%02X:%02X:%02X:%02X", inverterAddress[0], inverterAddress[1],
+              inverterAddress[2], inverterAddress[3], inverterAddress[4]);
+
+    SpiBusLock bus;
+
+    // Stop listening, configure for transmission
+    m_radio->stopListening();
+    m_radio->openWritingPipe(inverterAddress);
+
+    bool success = m_radio->write(packet, len);
+
+    // Switch back to listening mode
+    m_radio->startListening();
+
+    return success;
+}
+
+/**
+ * With the IRQ line connected, the radio is only touched over SPI when it
+ * has actually received something; without it the FIFO is polled.
+ */
+bool NRF24Radio::available() {
+    if (!m_radio) {
+        return false;
+    }
+
+    if (m_irqEnabled && !m_draining) {
+        if (!s_rxIrqPending) {
+            return false;
+        }
+        s_rxIrqPending = false;
+
+        SpiBusLock bus;
+
+        // Clear RX_DR before draining: a packet arriving during the drain
+        // raises the IRQ again instead of being left behind in the FIFO
+        bool txOk, txFail, rxReady;
+        m_radio->whatHappened(txOk, txFail, rxReady);
+        m_draining = true;
+    }
+
+    SpiBusLock bus;
+    bool ready = m_radio->available();
+    if (!ready) {
+        m_draining = false;
+    }
+    return ready;
+}
+
+uint8_t NRF24Radio::read(uint8_t* buffer, uint8_t size) {
+    SpiBusLock bus;
+    uint8_t len = m_radio->getDynamicPayloadSize();
+
+    if (len == 0 || len > NRF24_MAX_PAYLOAD_SIZE) {
+        LOG_WARN("    RX: Invalid packet size!");
+        m_radio->flush_rx();
+        return 0;
+    }
+
+    if (len > size) {
+        // Read and discard so the FIFO keeps accepting
+        uint8_t discard[NRF24_MAX_PAYLOAD_SIZE];
+        m_radio->read(discard, len);
+        return 0;
+    }
+
+    m_radio->read(buffer, len);
+    return len;
+}
+
+void NRF24Radio::setChannel(uint8_t channel) {
+    if (m_radio) {
+        SpiBusLock bus;
+        m_radio->setChannel(channel);
+    }
+}
+
+uint8_t NRF24Radio::getChannel() {
+    if (!m_radio) {
+        return NRF24_DEFAULT_CHANNEL;
+    }
+    SpiBusLock bus;
+    return m_radio->getChannel();
+}
+
+/**
+ * The NRF24 has no RSSI register, only the received power detector (RPD,
+ * set above -64 dBm), so this is a coarse two-level estimate
+ */
+int16_t NRF24Radio::getRssi() {
+    if (!m_radio) {
+        return 0;
+    }
+    SpiBusLock bus;
+    return m_radio->testRPD() ? -64 : -80;
+}
+
+#endif // RADIO_NRF24
@@ -0,0 +1,61 @@
+/**
+ * Hoymiles Radio - NRF24L01+ backend (HM series, 2.4 GHz)
+ */
+
+#ifndef HOYMILES_RADIO_NRF24_H
+#define HOYMILES_RADIO_NRF24_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#ifdef RADIO_NRF24
+
+#include <RF24.h>
+#include "hoymiles_radio.h"
+
+// NRF24 payloads are at most 32 bytes
+#define NRF24_MAX_PAYLOAD_SIZE      32
+
+// Default channel (2440 MHz)
+#define NRF24_DEFAULT_CHANNEL       40
+
+// Pin definitions (can be overridden in config.h)
+#ifndef NRF24_CE_PIN
+  #ifdef ESP32
+    #define NRF24_CE_PIN   2
+    #define NRF24_CS_PIN   5
+  #elif defined(ESP8266)
+    #define NRF24_CE_PIN   4  // D2
+    #define NRF24_CS_PIN   5  // D1
+  #endif
+#endif
+
+class NRF24Radio : public HoymilesRadio {
+public:
+    NRF24Radio();
+
+    bool begin() override;
+    bool transmit(uint64_t inverterSerial, const uint8_t* packet, uint8_t len) override;
+    bool available() override;
+    uint8_t read(uint8_t* buffer, uint8_t size) override;
+    void setChannel(uint8_t channel) override;
+    uint8_t getChannel() override;
+    int16_t getRssi() override;
+    const char* getName() override { return "NRF24L01+"; }
+#ifdef HOYMILES_RX_TASK
+    bool setRxTask(TaskHandle_t task) override;
+#endif
+
+    bool isIrqEnabled() const { return m_irqEnabled; }
+
+private:
+    RF24* m_radio;
+    bool m_irqEnabled;
+    bool m_draining;    // RX_DR acknowledged, FIFO not yet empty
+
+    static void onRadioIrq();
+};
+
+#endif // RADIO_NRF24
+
+#endif // HOYMILES_RADIO_NRF24_H
@@ -0,0 +1,281 @@
+/**
+ * Hoymiles Radio - Simulated backend
+ */
+
+#include "hoymiles_radio_sim.h"
+
+// Reported values in the descriptors' own scale, DC inputs and AC side
+static const int32_t SIM_DC_VALUES[FIELD_COUNT] = {
+    345,        // FIELD_VOLTAGE          34.5 V
+    812,        // FIELD_CURRENT          8.12 A
+    2801,       // FIELD_POWER            280.1 W
+    1234,       // FIELD_YIELD_DAY        1234 Wh
+    567890,     // FIELD_YIELD_TOTAL      567890 Wh
+    0, 0, 0, 0
+};
+
+static const int32_t SIM_AC_VALUES[FIELD_COUNT] = {
+    2301,       // FIELD_VOLTAGE          230.1 V
+    235,        // FIELD_CURRENT          2.35 A
+    5402,       // FIELD_POWER            540.2 W
+    0, 0,
+    5000,       // FIELD_FREQUENCY        50.00 Hz
+    -12,        // FIELD_REACTIVE_POWER   -1.2 var
+    1000,       // FIELD_POWER_FACTOR     1.000
+    352         // FIELD_TEMPERATURE      35.2 °C
+};
+
+SimulatedRadio::SimulatedRadio(bool hmsSeries, uint32_t seed)
+    : m_hms(hmsSeries)
+    , m_channel(hmsSeries ? HOYMILES_SIM_DEFAULT_CHANNEL_HMS : HOYMILES_SIM_DEFAULT_CHANNEL_HM)
+    , m_lastRssi(0)
+    , m_random(seed ? seed : 1)
+    , m_nodeCount(0)
+{
+    for (uint8_t i = 0; i < HOYMILES_SIM_QUEUE_SIZE; i++) {
+        m_frames[i].used = false;
+    }
+    for (uint16_t i = 0; i < HOYMILES_SIM_CHANNELS; i++) {
+        m_channelLoss[i] = 0;
+    }
+    resetStats();
+}
+
+bool SimulatedRadio::addInverter(const SimulatedInverter& inverter) {
+    if (m_nodeCount >= HOYMILES_SIM_MAX_INVERTERS) {
+        return false;
+    }
+
+    Node& node = m_nodes[m_nodeCount++];
+    node.config = inverter;
+    node.model = findHoymilesModel(inverter.serial,
+                                   m_hms ? HOYMILES_MODEL_DEFAULT_HMS : HOYMILES_MODEL_DEFAULT_HM);
+    node.timeCounter = 0;
+    node.answered = false;
+    node.payloadLength = 0;
+    return true;
+}
+
+SimulatedInverter* SimulatedRadio::getInverter(uint64_t serial) {
+    Node* node = findNode(serial);
+    return node ? &node->config : nullptr;
+}
+
+void SimulatedRadio::setChannelLoss(uint8_t channel, uint8_t percent) {
+    if (channel < HOYMILES_SIM_CHANNELS) {
+        m_channelLoss[channel] = percent;
+    }
+}
+
+void SimulatedRadio::resetStats() {
+    m_stats = Stats();
+}
+
+bool SimulatedRadio::transmit(uint64_t inverterSerial, const uint8_t* packet, uint8_t len) {
+    uint8_t requestLength = m_hms ? 21 : 12;
+    uint8_t command = m_hms ? HMS_CMD_GET_REALTIME_DATA : CMD_GET_REALTIME_DATA;
+
+    if (len < requestLength || len > requestLength + 1 || packet[2] != command ||
+        HoymilesProtocol::crc8(packet, len - 1) != packet[len - 1]) {
+        return true;  // On air, but nobody will answer
+    }
+
+    Node* node = findNode(inverterSerial);
+    if (!node || !node->config.online ||
+        (node->config.channel != HOYMILES_SIM_ANY_CHANNEL && node->config.channel != m_channel) ||
+        chance(node->config.requestLoss) || chance(channelLoss(m_channel))) {
+        m_stats.requestsLost++;
+        return true;
+    }
+
+    uint16_t timeCounter = HoymilesProtocol::getTimeCounter(packet);
+    unsigned long firstAt = millis() + node->config.latency;
+
+    // Single-fragment retransmit: HM appends the request byte, HMS puts it
+    // in place of the packet counter and echoes the answered time counter
+    uint8_t fragmentByte = m_hms ? packet[19] : packet[11];
+    bool fragmentRequest = m_hms ? (node->answered && timeCounter == node->timeCounter &&
+                                    (fragmentByte & HOYMILES_FRAGMENT_REQUEST))
+                                 : len == requestLength + 1;
+
+    if (fragmentRequest) {
+        uint8_t index = fragmentByte & ~HOYMILES_FRAGMENT_REQUEST;
+        uint8_t count = (node->payloadLength + HOYMILES_FRAGMENT_SIZE - 1) / HOYMILES_FRAGMENT_SIZE;
+        if (!node->answered || timeCounter != node->timeCounter || index == 0 || index > count) {
+            m_stats.requestsLost++;
+            return true;
+        }
+        m_stats.fragmentRequests++;
+        queueFragment(*node, index, firstAt, answerChannel(m_channel, 1));
+        return true;
+    }
+
+    m_stats.requests++;
+    node->timeCounter = timeCounter;
+    node->answered = true;
+    buildPayload(*node);
+
+    uint8_t count = (node->payloadLength + HOYMILES_FRAGMENT_SIZE - 1) / HOYMILES_FRAGMENT_SIZE;
+    uint8_t requestChannel = m_channel;
+    for (uint8_t index = 1; index <= count; index++) {
+        queueFragment(*node, index, firstAt + (index - 1) * node->config.fragmentGap,
+                      answerChannel(requestChannel, index));
+    }
+    return true;
+}
+
+bool SimulatedRadio::available() {
+    return nextDueFrame(millis()) >= 0;
+}
+
+uint8_t SimulatedRadio::read(uint8_t* buffer, uint8_t size) {
+    int8_t slot = nextDueFrame(millis());
+    if (slot < 0) {
+        return 0;
+    }
+
+    Frame& frame = m_frames[slot];
+    frame.used = false;
+    if (frame.length > size) {
+        return 0;
+    }
+
+    memcpy(buffer, frame.data, frame.length);
+    m_lastRssi = frame.rssi;
+    m_stats.framesSent++;
+    return frame.length;
+}
+
+/**
+ * xorshift32, enough for loss decisions and independent of the platform PRNG
+ */
+bool SimulatedRadio::chance(uint8_t percent) {
+    if (percent == 0) {
+        return false;
+    }
+    m_random ^= m_random << 13;
+    m_random ^= m_random >> 17;
+    m_random ^= m_random << 5;
+    return m_random % 100 < percent;
+}
+
+uint8_t SimulatedRadio::channelLoss(uint8_t channel) const {
+    return channel < HOYMILES_SIM_CHANNELS ? m_channelLoss[channel] : 0;
+}
+
+SimulatedRadio::Node* SimulatedRadio::findNode(uint64_t serial) {
+    for (uint8_t i = 0; i < m_nodeCount; i++) {
+        if (m_nodes[i].config.serial == serial) {
+            return &m_nodes[i];
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Encode the model's realtime payload from the sample values, CRC16 appended
+ */
+void SimulatedRadio::buildPayload(Node& node) {
+    uint8_t length = 0;
+    for (uint8_t i = 0; i < node.model->fieldCount; i++) {
+        const HoymilesFieldDescriptor& f = node.model->fields[i];
+        if (f.offset + f.width > length) {
+            length = f.offset + f.width;
+        }
+    }
+
+    memset(node.payload, 0, length);
+    for (uint8_t i = 0; i < node.model->fieldCount; i++) {
+        const HoymilesFieldDescriptor& f = node.model->fields[i];
+        uint32_t value = (uint32_t)(f.channel == 0 ? SIM_AC_VALUES[f.field] : SIM_DC_VALUES[f.field]);
+        for (uint8_t b = 0; b < f.width; b++) {
+            node.payload[f.offset + b] = (value >> (8 * (f.width - 1 - b))) & 0xFF;
+        }
+    }
+
+    uint16_t crc = HoymilesProtocol::crc16(node.payload, length);
+    node.payload[length] = crc >> 8;
+    node.payload[length + 1] = crc & 0xFF;
+    node.payloadLength = length + 2;
+}
+
+/**
+ * Channel of the given packet (1 = first) of an answer to a request heard
+ * on requestChannel
+ */
+uint8_t SimulatedRadio::answerChannel(uint8_t requestChannel, uint8_t packet) const {
+    if (!m_hms) {
+        for (uint8_t slot = 0; slot < HOYMILES_HOP_CHANNEL_COUNT; slot++) {
+            if (HOYMILES_HOP_CHANNELS[slot] == requestChannel) {
+                return HOYMILES_HOP_CHANNELS[(slot + packet) % HOYMILES_HOP_CHANNEL_COUNT];
+            }
+        }
+    }
+    return requestChannel;
+}
+
+void SimulatedRadio::queueFragment(const Node& node, uint8_t index, unsigned long deliverAt, uint8_t channel) {
+    if (chance(node.config.fragmentLoss) || chance(channelLoss(channel))) {
+        m_stats.framesLost++;
+        return;
+    }
+
+    Frame* frame = nullptr;
+    for (uint8_t i = 0; i < HOYMILES_SIM_QUEUE_SIZE; i++) {
+        if (!m_frames[i].used) {
+            frame = &m_frames[i];
+            break;
+        }
+    }
+    if (!frame) {
+        m_stats.framesLost++;
+        return;
+    }
+
+    uint8_t count = (node.payloadLength + HOYMILES_FRAGMENT_SIZE - 1) / HOYMILES_FRAGMENT_SIZE;
+    uint8_t offset = (index - 1) * HOYMILES_FRAGMENT_SIZE;
+    uint8_t chunk = index < count ? HOYMILES_FRAGMENT_SIZE : node.payloadLength - offset;
+    uint8_t serialBytes = m_hms ? 8 : 4;
+    uint8_t* p = frame->data;
+
+    *p++ = node.timeCounter >> 8;
+    *p++ = node.timeCounter & 0xFF;
+    *p++ = m_hms ? HMS_RESP_REALTIME_DATA : RESP_REALTIME_DATA;
+    for (uint8_t b = 0; b < serialBytes; b++) {
+        *p++ = (node.config.serial >> (8 * (serialBytes - 1 - b))) & 0xFF;
+    }
+    *p++ = index | (index == count ? HOYMILES_FRAGMENT_LAST : 0);
+    memcpy(p, &node.payload[offset], chunk);
+    p += chunk;
+    *p = HoymilesProtocol::crc8(frame->data, p - frame->data);
+    p++;
+
+    frame->used = true;
+    frame->deliverAt = deliverAt;
+    frame->channel = channel;
+    frame->rssi = node.config.rssi;
+    frame->length = p - frame->data;
+}
+
+/**
+ * Oldest frame due for delivery; frames on a channel the DTU does not
+ * listen on when they arrive are missed
+ */
+int8_t SimulatedRadio::nextDueFrame(unsigned long now) {
+    int8_t next = -1;
+    for (uint8_t i = 0; i < HOYMILES_SIM_QUEUE_SIZE; i++) {
+        Frame& frame = m_frames[i];
+        if (!frame.used || (long)(now - frame.deliverAt) < 0) {
+            continue;
+        }
+        if (frame.channel != m_channel) {
+            frame.used = false;
+            m_stats.framesMissed++;
+            continue;
+        }
+        if (next < 0 || (long)(frame.deliverAt - m_frames[next].deliverAt) < 0) {
+            next = i;
+        }
+    }
+    return next;
+}
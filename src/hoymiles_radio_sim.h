@@ -0,0 +1,141 @@
+/**
+ * Hoymiles Radio - Simulated backend
+ *
+ * Models a set of virtual inverters on the air: each one answers realtime
+ * requests with a correctly framed, fragmented and CRC-protected response
+ * for its model (resolved from the serial prefix), after a configurable
+ * latency and with configurable request/fragment loss. Inverters can be
+ * bound to one channel, and every channel can be given a loss rate, to
+ * exercise channel selection.
+ *
+ * HM inverters answer on the NRF24 hop set (hoymiles_channels.h): the
+ * first packet of an answer goes out on the channel after the request's,
+ * every further packet one channel on. A packet is only received if the
+ * DTU listens on its channel when it arrives. HMS inverters answer on the
+ * request's channel.
+ *
+ * Runs anywhere millis() does, so the poll and scheduler logic of the
+ * drivers can be exercised and measured without radio hardware. The
+ * pseudo-random loss is seeded, so runs are reproducible.
+ */
+
+#ifndef HOYMILES_RADIO_SIM_H
+#define HOYMILES_RADIO_SIM_H
+
+#include <Arduino.h>
+#include "hoymiles_radio.h"
+#include "hoymiles_protocol.h"
+#include "hoymiles_models.h"
+#include "hoymiles_channels.h"
+
+#define HOYMILES_SIM_MAX_INVERTERS  8
+#define HOYMILES_SIM_QUEUE_SIZE     16      // Frames in flight
+#define HOYMILES_SIM_FRAME_SIZE     32
+#define HOYMILES_SIM_CHANNELS       128
+#define HOYMILES_SIM_ANY_CHANNEL    0xFF
+
+// Default channels (NRF24 2440 MHz, CMT2300A 868.0 MHz)
+#define HOYMILES_SIM_DEFAULT_CHANNEL_HM   40
+#define HOYMILES_SIM_DEFAULT_CHANNEL_HMS  32
+
+/**
+ * Behaviour of one virtual inverter
+ */
+struct SimulatedInverter {
+    uint64_t serial;
+    uint16_t latency;       // ms from request to the first fragment
+    uint16_t fragmentGap;   // ms between two fragments
+    uint8_t requestLoss;    // % of requests the inverter does not hear
+    uint8_t fragmentLoss;   // % of response fragments lost on the way back
+    uint8_t channel;        // Channel the inverter listens on, HOYMILES_SIM_ANY_CHANNEL = all
+    int16_t rssi;           // Reported for its frames (dBm)
+    bool online;            // false = silent (e.g. night)
+};
+
+class SimulatedRadio : public HoymilesRadio {
+public:
+    struct Stats {
+        uint32_t requests;          // Realtime requests heard
+        uint32_t fragmentRequests;  // Single-fragment retransmits heard
+        uint32_t requestsLost;      // Not heard (offline, loss, wrong channel)
+        uint32_t framesSent;        // Fragments delivered to the DTU
+        uint32_t framesLost;        // Fragments lost on the way back
+        uint32_t framesMissed;      // Fragments sent while the DTU listened on another channel
+    };
+
+    /**
+     * @param hmsSeries false = HM framing (4-byte serial), true = HMS/HMT framing (8-byte serial)
+     * @param seed Seed of the loss generator
+     */
+    explicit SimulatedRadio(bool hmsSeries, uint32_t seed = 1);
+
+    /**
+     * Add a virtual inverter
+     * @return false if the simulator is full
+     */
+    bool addInverter(const SimulatedInverter& inverter);
+
+    /**
+     * Behaviour of a virtual inverter, may be changed at any time
+     * @return nullptr if the serial is unknown
+     */
+    SimulatedInverter* getInverter(uint64_t serial);
+
+    /**
+     * Additional loss (%) for every frame on a channel, both directions
+     */
+    void setChannelLoss(uint8_t channel, uint8_t percent);
+
+    const Stats& getStats() const { return m_stats; }
+    void resetStats();
+
+    // HoymilesRadio
+    bool begin() override { return true; }
+    bool transmit(uint64_t inverterSerial, const uint8_t* packet, uint8_t len) override;
+    bool available() override;
+    uint8_t read(uint8_t* buffer, uint8_t size) override;
+    void setChannel(uint8_t channel) override { m_channel = channel; }
+    uint8_t getChannel() override { return m_channel; }
+    int16_t getRssi() override { return m_lastRssi; }
+    const char* getName() override { return "Simulated"; }
+
+private:
+    struct Node {
+        SimulatedInverter config;
+        const HoymilesModel* model;
+        uint16_t timeCounter;       // Of the last request answered
+        bool answered;
+        uint8_t payloadLength;      // Including CRC16
+        uint8_t payload[HOYMILES_PAYLOAD_MAX_SIZE];
+    };
+
+    struct Frame {
+        bool used;
+        unsigned long deliverAt;
+        uint8_t channel;
+        int16_t rssi;
+        uint8_t length;
+        uint8_t data[HOYMILES_SIM_FRAME_SIZE];
+    };
+
+    bool m_hms;
+    uint8_t m_channel;
+    int16_t m_lastRssi;
+    uint32_t m_random;
+
+    Node m_nodes[HOYMILES_SIM_MAX_INVERTERS];
+    uint8_t m_nodeCount;
+    Frame m_frames[HOYMILES_SIM_QUEUE_SIZE];
+    uint8_t m_channelLoss[HOYMILES_SIM_CHANNELS];
+    Stats m_stats;
+
+    bool chance(uint8_t percent);
+    uint8_t channelLoss(uint8_t channel) const;
+    Node* findNode(uint64_t serial);
+    void buildPayload(Node& node);
+    uint8_t answerChannel(uint8_t requestChannel, uint8_t packet) const;
+    void queueFragment(const Node& node, uint8_t index, unsigned long deliverAt, uint8_t channel);
+    int8_t nextDueFrame(unsigned long now);
+};
+
+#endif // HOYMILES_RADIO_SIM_H
@@ -0,0 +1,86 @@
+/**
+ * Hoymiles RTT - Response timeout from measured round-trip times
+ *
+ * Smoothed round-trip time and mean deviation per inverter, updated as in
+ * TCP (RFC 6298): srtt += (rtt - srtt) / 8, rttvar += (|rtt - srtt| - rttvar) / 4.
+ * The response timeout is srtt + 4 * rttvar (at least srtt + a fixed
+ * slack for loop jitter), so a healthy inverter that answers in 40 ms is
+ * released after roughly 60 ms instead of the fixed worst-case wait.
+ *
+ * Only requests answered without any retransmission are sampled (Karn's
+ * rule); every retransmission of the same poll doubles the timeout.
+ */
+
+#ifndef HOYMILES_RTT_H
+#define HOYMILES_RTT_H
+
+#include <Arduino.h>
+#include "config.h"     // HOYMILES_RESPONSE_TIMEOUT, upper bound of every response timeout
+
+#define HOYMILES_RTT_MIN_TIMEOUT    30      // Lower bound of every response timeout (ms)
+#define HOYMILES_RTT_MIN_SLACK      20      // Minimum margin above srtt (ms)
+
+class HoymilesRttEstimator {
+public:
+    /**
+     * @param initialTimeout Timeout until the first sample arrives (ms)
+     */
+    explicit HoymilesRttEstimator(uint16_t initialTimeout = HOYMILES_RESPONSE_TIMEOUT)
+        : m_srtt8(0), m_rttvar4(0), m_initialTimeout(initialTimeout), m_samples(0) {}
+
+    /**
+     * Add one round-trip measurement (ms)
+     */
+    void sample(uint32_t rtt) {
+        if (rtt > HOYMILES_RESPONSE_TIMEOUT) {
+            rtt = HOYMILES_RESPONSE_TIMEOUT;
+        }
+
+        if (m_samples == 0) {
+            m_srtt8 = rtt << 3;
+            m_rttvar4 = rtt << 1;
+        } else {
+            // Scaled by 8 (srtt) and 4 (rttvar), so the gains are additions
+            int32_t err = (int32_t)rtt - (m_srtt8 >> 3);
+            m_srtt8 += err;
+            if (err < 0) {
+                err = -err;
+            }
+            m_rttvar4 += err - (m_rttvar4 >> 2);
+        }
+
+        if (m_samples < 0xFFFF) {
+            m_samples++;
+        }
+    }
+
+    /**
+     * Response timeout for the given retransmission of a poll (0 = first request)
+     */
+    uint16_t getTimeout(uint8_t retransmission = 0) const {
+        uint32_t timeout = m_initialTimeout;
+        if (m_samples > 0) {
+            uint32_t margin = m_rttvar4 > HOYMILES_RTT_MIN_SLACK ? m_rttvar4 : HOYMILES_RTT_MIN_SLACK;
+            timeout = (m_srtt8 >> 3) + margin;
+        }
+
+        timeout <<= retransmission < 8 ? retransmission : 8;
+
+        if (timeout < HOYMILES_RTT_MIN_TIMEOUT) {
+            return HOYMILES_RTT_MIN_TIMEOUT;
+        }
+        return timeout > HOYMILES_RESPONSE_TIMEOUT ? HOYMILES_RESPONSE_TIMEOUT : timeout;
+    }
+
+    bool hasSamples() const { return m_samples > 0; }
+    uint16_t getSmoothedRtt() const { return m_srtt8 >> 3; }
+    uint16_t getDeviation() const { return m_rttvar4 >> 2; }
+
+private:
+    int32_t m_srtt8;            // Smoothed RTT * 8
+    int32_t m_rttvar4;          // RTT mean deviation * 4
+    uint16_t m_initialTimeout;
+    uint16_t m_samples;
+};
+
+#endif // HOYMILES_RTT_H
@@ -0,0 +1,142 @@
+/**
+ * Hoymiles Scheduler - Per-inverter poll timing
+ */
+
+#include "hoymiles_scheduler.h"
+
+HoymilesScheduler::HoymilesScheduler(uint16_t baseInterval)
+    : m_baseInterval(baseInterval)
+    , m_count(0)
+    , m_cycleOpen(false)
+    , m_cycleStart(0)
+{
+}
+
+void HoymilesScheduler::add(uint8_t index, unsigned long now) {
+    if (index >= HOYMILES_MAX_INVERTERS) {
+        return;
+    }
+
+    m_entries[index].nextPoll = now;
+    m_entries[index].failures = 0;
+    m_entries[index].state = InverterLinkState::DEGRADED;  // Unknown until it answers
+    m_entries[index].polled = false;
+
+    if (index >= m_count) {
+        m_count = index + 1;
+    }
+}
+
+void HoymilesScheduler::remove(uint8_t index) {
+    if (index >= m_count) {
+        return;
+    }
+
+    for (uint8_t i = index; i < m_count - 1; i++) {
+        m_entries[i] = m_entries[i + 1];
+    }
+    m_count--;
+}
+
+int8_t HoymilesScheduler::nextDue(unsigned long now) const {
+    int8_t next = -1;
+    for (uint8_t i = 0; i < m_count; i++) {
+        if ((long)(now - m_entries[i].nextPoll) < 0) {
+            continue;
+        }
+        if (next < 0 || (long)(m_entries[i].nextPoll - m_entries[next].nextPoll) < 0) {
+            next = i;
+        }
+    }
+    return next;
+}
+
+void HoymilesScheduler::onSuccess(uint8_t index, unsigned long now) {
+    Entry& entry = m_entries[index];
+    entry.failures = 0;
+    entry.state = InverterLinkState::ONLINE;
+    entry.nextPoll = now + getOnlineInterval();
+    markPolled(entry, now);
+}
+
+void HoymilesScheduler::onFailure(uint8_t index, unsigned long now) {
+    Entry& entry = m_entries[index];
+    if (entry.failures < 0xFF) {
+        entry.failures++;
+    }
+    markPolled(entry, now);
+
+    if (entry.failures < HOYMILES_SCHEDULER_OFFLINE_AFTER) {
+        entry.state = InverterLinkState::DEGRADED;
+        entry.nextPoll = now + m_baseInterval;
+        return;
+    }
+
+    // Exponential backoff: base, 2x, 4x, ... up to the cap
+    entry.state = InverterLinkState::OFFLINE;
+    uint8_t shift = entry.failures - HOYMILES_SCHEDULER_OFFLINE_AFTER;
+    uint32_t backoff = HOYMILES_SCHEDULER_MAX_BACKOFF;
+    if (shift < 16 && ((uint32_t)m_baseInterval << shift) < HOYMILES_SCHEDULER_MAX_BACKOFF) {
+        backoff = (uint32_t)m_baseInterval << shift;
+    }
+    entry.nextPoll = now + backoff;
+}
+
+void HoymilesScheduler::markPolled(Entry& entry, unsigned long now) {
+    if (!m_cycleOpen) {
+        m_cycleOpen = true;
+        m_cycleStart = now;
+    }
+    entry.polled = true;
+}
+
+bool HoymilesScheduler::endCycle(unsigned long now) {
+    if (!m_cycleOpen || nextDue(now) >= 0) {
+        return false;
+    }
+
+    // Polls drift apart, so the rest of this cycle may not be due yet
+    long horizon = (long)getOnlineInterval();
+    for (uint8_t i = 0; i < m_count; i++) {
+        if (!m_entries[i].polled && (long)(m_entries[i].nextPoll - m_cycleStart) < horizon) {
+            return false;
+        }
+    }
+
+    for (uint8_t i = 0; i < m_count; i++) {
+        m_entries[i].polled = false;
+    }
+    m_cycleOpen = false;
+    return true;
+}
+
+/**
+ * Interval for online inverters: the base interval scaled by the share of
+ * inverters that still need regular polls
+ */
+uint32_t HoymilesScheduler::getOnlineInterval() const {
+    uint8_t active = 0;
+    for (uint8_t i = 0; i < m_count; i++) {
+        if (m_entries[i].state != InverterLinkState::OFFLINE) {
+            active++;
+        }
+    }
+
+    if (active == 0 || active == m_count) {
+        return m_baseInterval;
+    }
+
+    uint32_t interval = (uint32_t)m_baseInterval * active / m_count;
+    uint32_t floor = m_baseInterval < HOYMILES_SCHEDULER_MIN_INTERVAL ? m_baseInterval
+                                                                      : HOYMILES_SCHEDULER_MIN_INTERVAL;
+    return interval < floor ? floor : interval;
+}
+
+const char* HoymilesScheduler::stateName(InverterLinkState state) {
+    switch (state) {
+        case InverterLinkState::ONLINE:   return "online";
+        case InverterLinkState::DEGRADED: return "degraded";
+        case InverterLinkState::OFFLINE:  return "offline";
+    }
+    return "unknown";
+}
@@ -0,0 +1,112 @@
+/**
+ * Hoymiles Scheduler - Per-inverter poll timing
+ *
+ * Every inverter has its own due time and link state:
+ * - ONLINE:   answered the last poll
+ * - DEGRADED: missed fewer than HOYMILES_SCHEDULER_OFFLINE_AFTER polls in a row,
+ *             retried at the base interval
+ * - OFFLINE:  probed with exponential backoff (e.g. at night), one cheap
+ *             request without fragment retries per probe
+ *
+ * Airtime not spent on offline inverters goes to the online ones: their
+ * interval shrinks in proportion to the share of inverters that are not
+ * offline, down to HOYMILES_SCHEDULER_MIN_INTERVAL.
+ *
+ * A poll cycle starts with the first poll after the previous one ended and
+ * ends when no inverter is due and every inverter due within one online
+ * interval of the start has been polled (offline inverters in backoff are
+ * not waited for). Consumers that group samples per cycle (BATCH messages)
+ * use that instead of a timer.
+ */
+
+#ifndef HOYMILES_SCHEDULER_H
+#define HOYMILES_SCHEDULER_H
+
+#include <Arduino.h>
+
+#ifndef HOYMILES_MAX_INVERTERS
+#define HOYMILES_MAX_INVERTERS  8
+#endif
+
+#define HOYMILES_SCHEDULER_MIN_INTERVAL   1000     // Fastest poll of one inverter (ms)
+#define HOYMILES_SCHEDULER_OFFLINE_AFTER  3        // Missed polls before OFFLINE
+#define HOYMILES_SCHEDULER_MAX_BACKOFF    300000   // Longest probe interval (ms)
+
+/**
+ * End of a poll cycle: plain function plus an opaque context (no captures, no heap)
+ */
+typedef void (*PollCycleCallback)(void* context);
+
+enum class InverterLinkState : uint8_t {
+    ONLINE,
+    DEGRADED,
+    OFFLINE
+};
+
+class HoymilesScheduler {
+public:
+    explicit HoymilesScheduler(uint16_t baseInterval);
+
+    /**
+     * Nominal interval per inverter with all inverters online (ms)
+     */
+    void setBaseInterval(uint16_t interval) { m_baseInterval = interval; }
+    uint16_t getBaseInterval() const { return m_baseInterval; }
+
+    /**
+     * Register an inverter at index (due immediately)
+     */
+    void add(uint8_t index, unsigned long now);
+
+    /**
+     * Unregister the inverter at index, later entries move down by one
+     */
+    void remove(uint8_t index);
+
+    /**
+     * Most overdue inverter
+     * @return Index, or -1 if no inverter is due
+     */
+    int8_t nextDue(unsigned long now) const;
+
+    /**
+     * Record the outcome of a poll and schedule the next one
+     */
+    void onSuccess(uint8_t index, unsigned long now);
+    void onFailure(uint8_t index, unsigned long now);
+
+    /**
+     * Close the poll cycle once no inverter is due any more
+     * @return true once per cycle, after at least one poll
+     */
+    bool endCycle(unsigned long now);
+
+    /**
+     * Next poll of this inverter is a backoff probe (no fragment retries)
+     */
+    bool isProbe(uint8_t index) const { return m_entries[index].state == InverterLinkState::OFFLINE; }
+
+    InverterLinkState getState(uint8_t index) const { return m_entries[index].state; }
+    uint8_t getFailures(uint8_t index) const { return m_entries[index].failures; }
+    uint32_t getOnlineInterval() const;
+
+    static const char* stateName(InverterLinkState state);
+
+private:
+    struct Entry {
+        unsigned long nextPoll;
+        uint8_t failures;       // Consecutive missed polls
+        InverterLinkState state;
+        bool polled;            // In the current poll cycle
+    };
+
+    uint16_t m_baseInterval;
+    uint8_t m_count;
+    bool m_cycleOpen;           // Polled since the last cycle end
+    unsigned long m_cycleStart; // First poll of the current cycle
+
+    void markPolled(Entry& entry, unsigned long now);
+    Entry m_entries[HOYMILES_MAX_INVERTERS];
+};
+
+#endif // HOYMILES_SCHEDULER_H
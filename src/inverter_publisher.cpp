@@ -0,0 +1,501 @@
+/**
+ * Inverter Publisher - MQTT topics and payloads for inverter data
+ */
+
+#include "inverter_publisher.h"
+#include "fixed_point.h"
+#include "logger.h"
+#include <time.h>
+
+static_assert(INVERTER_PUBLISHER_BATCH_SIZE <= TELEMETRY_SPOOL_MAX_PAYLOAD, "Batches must fit a spool frame");
+
+static_assert(HoymilesDecoder::fieldCount<HoymilesLayoutHMT6Ch>() + 2 <= INVERTER_PUBLISHER_MAX_FIELDS,
+              "INVERTER_PUBLISHER_MAX_FIELDS too small for the largest layout");
+
+// OpenDTU field names, by HoymilesField
+static const char* const INVERTER_FIELD_NAMES[FIELD_COUNT] = {
+    "voltage",
+    "current",
+    "power",
+    "yieldday",
+    "yieldtotal",
+    "frequency",
+    "reactivepower",
+    "powerfactor",
+    "temperature"
+};
+
+// Rollup payload names, by RollupQuantity
+static const char* const ROLLUP_QUANTITY_NAMES[ROLLUP_QUANTITY_COUNT] = {
+    "power",
+    "voltage",
+    "current",
+    "temperature"
+};
+
+// Default deadbands { absolute (fixed-point unit), relative (0.1 %) }
+static constexpr uint16_t INVERTER_DEFAULT_DEADBANDS[FIELD_COUNT][2] = {
+    { 5,  0 },      // FIELD_VOLTAGE          0.5 V
+    { 5,  10 },     // FIELD_CURRENT          0.05 A or 1 %
+    { 10, 10 },     // FIELD_POWER            1 W or 1 %
+    { 0,  0 },      // FIELD_YIELD_DAY        every Wh
+    { 10, 0 },      // FIELD_YIELD_TOTAL      10 Wh
+    { 2,  0 },      // FIELD_FREQUENCY        0.02 Hz
+    { 10, 10 },     // FIELD_REACTIVE_POWER   1 var or 1 %
+    { 5,  0 },      // FIELD_POWER_FACTOR     0.005
+    { 5,  0 }       // FIELD_TEMPERATURE      0.5 °C
+};
+
+InverterPublisher::InverterPublisher(MqttClient& client)
+    : m_client(client)
+    , m_layout(InverterTopicLayout::JSON)
+    , m_encoding(InverterPayloadEncoding::JSON)
+    , m_baseLength(0)
+    , m_topicCount(0)
+    , m_maxAge(INVERTER_PUBLISHER_MAX_AGE)
+    , m_batchLength(0)
+    , m_batchCount(0)
+    , m_batchStart(0)
+    , m_batchHold(INVERTER_PUBLISHER_BATCH_HOLD)
+    , m_spool(nullptr)
+    , m_energy(nullptr)
+    , m_qos(0)
+    , m_lastReplay(0)
+#ifdef MQTT_TASK
+    , m_droppedSeen(0)
+#endif
+{
+    m_base[0] = '\0';
+    m_payload[0] = '\0';
+    m_rollup[0] = '\0';
+    m_batchTopic[0] = '\0';
+
+    for (uint8_t i = 0; i < FIELD_COUNT; i++) {
+        m_deadbands[i].absolute = INVERTER_DEFAULT_DEADBANDS[i][0];
+        m_deadbands[i].relativePermille = INVERTER_DEFAULT_DEADBANDS[i][1];
+    }
+}
+
+bool InverterPublisher::begin(const char* baseTopic, InverterTopicLayout layout) {
+    m_topicCount = 0;
+    m_baseLength = 0;
+    m_batchLength = 0;
+    m_batchCount = 0;
+    m_layout = layout;
+
+    size_t length = strlen(baseTopic);
+    if (length + 1 > sizeof(m_base)) {
+        DEBUG_PRINTLN("Inverter Publisher: ERROR - base topic too long");
+        return false;
+    }
+
+    if (layout == InverterTopicLayout::BATCH &&
+        (size_t)snprintf(m_batchTopic, sizeof(m_batchTopic), "%s/data", baseTopic) >= sizeof(m_batchTopic)) {
+        DEBUG_PRINTLN("Inverter Publisher: ERROR - base topic too long");
+        return false;
+    }
+
+    memcpy(m_base, baseTopic, length + 1);
+    m_baseLength = length;
+    return true;
+}
+
+void InverterPublisher::setEncoding(InverterPayloadEncoding encoding) {
+    m_encoding = encoding;
+    m_topicCount = 0;
+}
+
+void InverterPublisher::setDeadband(HoymilesField field, uint16_t absolute, uint16_t relativePermille) {
+    if (field < FIELD_COUNT) {
+        m_deadbands[field].absolute = absolute;
+        m_deadbands[field].relativePermille = relativePermille;
+    }
+}
+
+/**
+ * Table entry of an inverter, its topic rendered on the first publish
+ * @return Entry, or nullptr if the table is full or the topic too long
+ */
+InverterPublisher::TopicEntry* InverterPublisher::entryFor(uint64_t serial) {
+    for (uint8_t i = 0; i < m_topicCount; i++) {
+        if (m_topics[i].serial == serial) {
+            return &m_topics[i];
+        }
+    }
+
+    if (m_topicCount >= INVERTER_PUBLISHER_MAX_TOPICS) {
+        LOG_ERROR("Inverter Publisher: topic table full");
+        return nullptr;
+    }
+
+    TopicEntry& entry = m_topics[m_topicCount];
+    int length;
+    if (m_layout == InverterTopicLayout::BATCH) {
+        // Elements carry the serial themselves
+        entry.topic[0] = '\0';
+        length = 0;
+    } else if (m_layout == InverterTopicLayout::FIELDS) {
+        // OpenDTU prints the 48-bit serial as 12 hex digits
+        length = snprintf(entry.topic, sizeof(entry.topic), "%s/%04lX%08lX", m_base,
+                          (unsigned long)((serial >> 32) & 0xFFFF), (unsigned long)(serial & 0xFFFFFFFF));
+    } else {
+        // Same topic layout as before: decimal lower 32 bits of the serial
+        length = snprintf(entry.topic, sizeof(entry.topic), "%s/%lu/%s",
+                          m_base, (unsigned long)(serial & 0xFFFFFFFF),
+                          m_encoding == InverterPayloadEncoding::CBOR ? "cbor" : "data");
+    }
+    if (length < 0 || (size_t)length >= sizeof(entry.topic)) {
+        LOG_ERROR("Inverter Publisher: topic too long");
+        return nullptr;
+    }
+
+    entry.serial = serial;
+    entry.primed = false;
+    entry.batched = false;
+    entry.lastRefresh = 0;
+    m_topicCount++;
+    return &entry;
+}
+
+bool InverterPublisher::publish(const InverterSample& sample) {
+    if (!isReady()) {
+        return false;
+    }
+
+    TopicEntry* entry = entryFor(sample.serial);
+    if (!entry) {
+        return false;
+    }
+
+    switch (m_layout) {
+        case InverterTopicLayout::FIELDS:
+            return publishFields(*entry, sample);
+        case InverterTopicLayout::BATCH:
+            return appendBatch(*entry, sample);
+        default:
+            if (m_encoding == InverterPayloadEncoding::CBOR) {
+                return publishCbor(*entry, sample);
+            }
+            return publishJson(*entry, sample);
+    }
+}
+
+void InverterPublisher::loop() {
+    uint32_t now = millis();
+
+    if (m_batchCount > 0 && (uint32_t)(now - m_batchStart) >= m_batchHold) {
+        flush();
+    }
+
+    // One spooled message per interval, oldest first; kept on failure
+    if (m_spool && m_client.isConnected() && (uint32_t)(now - m_lastReplay) >= TELEMETRY_SPOOL_REPLAY_INTERVAL) {
+        const char* topic;
+        const uint8_t* payload;
+        size_t length;
+        if (m_spool->peek(topic, payload, length)) {
+            m_lastReplay = now;
+            if (m_client.publish(topic, payload, length, false, m_qos)) {
+                m_spool->pop();
+            }
+        }
+    }
+}
+
+/**
+ * Publish, or spool if the client is offline or the publish fails
+ * @return false if the message was lost
+ */
+bool InverterPublisher::send(const char* topic, const uint8_t* payload, size_t length) {
+    // Also while a backlog replays: the payloads carry their sample time
+    if (m_client.isConnected() && m_client.publish(topic, payload, length, false, m_qos)) {
+        return true;
+    }
+    return m_spool && m_spool->append(topic, payload, length);
+}
+
+bool InverterPublisher::flush() {
+    if (m_batchCount == 0) {
+        return true;
+    }
+
+    // appendBatch() always leaves room for the closing bracket
+    m_batch[m_batchLength++] = ']';
+    m_batch[m_batchLength] = '\0';
+
+    bool sent = send(m_batchTopic, (const uint8_t*)m_batch, m_batchLength);
+    if (!sent) {
+        LOG_WARN("Inverter Publisher: batch of %u dropped", m_batchCount);
+    }
+
+    for (uint8_t i = 0; i < m_topicCount; i++) {
+        m_topics[i].batched = false;
+    }
+    m_batchLength = 0;
+    m_batchCount = 0;
+    return sent;
+}
+
+/**
+ * Add a sample to the pending BATCH message, sending the message first if
+ * the inverter is already in it or the element does not fit
+ */
+bool InverterPublisher::appendBatch(TopicEntry& entry, const InverterSample& sample) {
+    bool sent = true;
+    if (entry.batched) {
+        sent = flush();
+    }
+
+    char powerText[16], voltageText[16], currentText[16];
+    formatFixedPoint(powerText, sizeof(powerText), sample.getPower(), HOYMILES_FIELD_DECIMALS[FIELD_POWER]);
+    formatFixedPoint(voltageText, sizeof(voltageText), sample.getVoltage(), HOYMILES_FIELD_DECIMALS[FIELD_VOLTAGE]);
+    formatFixedPoint(currentText, sizeof(currentText), sample.getDcCurrent(), HOYMILES_FIELD_DECIMALS[FIELD_CURRENT]);
+
+    char timeText[24], energyText[24];
+    formatTime(timeText, sizeof(timeText), sample);
+    formatEnergy(energyText, sizeof(energyText), sample);
+
+    char element[INVERTER_PUBLISHER_PAYLOAD_SIZE + 24];
+    int length = snprintf(element, sizeof(element), "{\"serial\":%lu,%s\"power\":%s,\"voltage\":%s,\"current\":%s%s}",
+                          (unsigned long)(sample.serial & 0xFFFFFFFF), timeText, powerText, voltageText, currentText, energyText);
+    if (length < 0 || (size_t)length >= sizeof(element)) {
+        return false;
+    }
+
+    // Separator or opening bracket, element, closing bracket, terminator
+    if (m_batchLength + length + 3 > sizeof(m_batch)) {
+        sent = flush() && sent;
+    }
+
+    m_batch[m_batchLength++] = m_batchCount == 0 ? '[' : ',';
+    memcpy(m_batch + m_batchLength, element, length);
+    m_batchLength += length;
+
+    if (m_batchCount == 0) {
+        m_batchStart = millis();
+    }
+    m_batchCount++;
+    entry.batched = true;
+    return sent;
+}
+
+/**
+ * Unix time the sample was received, from its millis() timestamp
+ * @return false while SNTP has not set the clock yet
+ */
+bool InverterPublisher::captureTime(const InverterSample& sample, uint32_t& captured) {
+    time_t now = time(nullptr);
+    if (now < NTP_VALID_AFTER) {
+        return false;
+    }
+    captured = (uint32_t)now - (uint32_t)(millis() - sample.timestamp) / 1000;
+    return true;
+}
+
+/**
+ * '"ts":<Unix time>,' for the JSON payloads, empty without a valid clock
+ */
+void InverterPublisher::formatTime(char* buffer, size_t size, const InverterSample& sample) {
+    buffer[0] = '\0';
+    uint32_t captured;
+    if (captureTime(sample, captured)) {
+        snprintf(buffer, size, "\"ts\":%lu,", (unsigned long)captured);
+    }
+}
+
+/**
+ * ',"energy":<kWh>' for the JSON payloads, empty without an energy source
+ */
+void InverterPublisher::formatEnergy(char* buffer, size_t size, const InverterSample& sample) const {
+    buffer[0] = '\0';
+    if (!m_energy) {
+        return;
+    }
+
+    char energyText[16];
+    formatFixedPoint(energyText, sizeof(energyText), (int32_t)m_energy->getEnergy(sample.serial, 0), 3);
+    snprintf(buffer, size, ",\"energy\":%s", energyText);
+}
+
+bool InverterPublisher::publishJson(TopicEntry& entry, const InverterSample& sample) {
+    char powerText[16], voltageText[16], currentText[16];
+    formatFixedPoint(powerText, sizeof(powerText), sample.getPower(), HOYMILES_FIELD_DECIMALS[FIELD_POWER]);
+    formatFixedPoint(voltageText, sizeof(voltageText), sample.getVoltage(), HOYMILES_FIELD_DECIMALS[FIELD_VOLTAGE]);
+    formatFixedPoint(currentText, sizeof(currentText), sample.getDcCurrent(), HOYMILES_FIELD_DECIMALS[FIELD_CURRENT]);
+
+    char timeText[24], energyText[24];
+    formatTime(timeText, sizeof(timeText), sample);
+    formatEnergy(energyText, sizeof(energyText), sample);
+
+    int length = snprintf(m_payload, sizeof(m_payload), "{%s\"power\":%s,\"voltage\":%s,\"current\":%s%s}",
+                          timeText, powerText, voltageText, currentText, energyText);
+    if (length < 0 || (size_t)length >= sizeof(m_payload)) {
+        LOG_ERROR("Inverter Publisher: payload too long");
+        return false;
+    }
+
+    return send(entry.topic, (const uint8_t*)m_payload, length);
+}
+
+/**
+ * Send the values that left their deadband, or all of them when the entry
+ * is new or older than the max age
+ * @return false if a publish failed (the value is retried with the next sample)
+ */
+bool InverterPublisher::publishFields(TopicEntry& entry, const InverterSample& sample) {
+    const HoymilesModel* model = sample.model;
+    if (!model || !m_client.isConnected()) {
+        return false;
+    }
+
+#ifdef MQTT_TASK
+    // A dropped message may have been one of the cached values
+    uint32_t dropped = m_client.getDroppedCount();
+    if (dropped != m_droppedSeen) {
+        m_droppedSeen = dropped;
+        for (uint8_t i = 0; i < m_topicCount; i++) {
+            m_topics[i].primed = false;
+        }
+    }
+#endif
+
+    uint32_t now = millis();
+    bool refresh = !entry.primed || (uint32_t)(now - entry.lastRefresh) >= m_maxAge;
+    bool complete = true;
+
+    auto update = [&](uint8_t slot, uint8_t channel, HoymilesField field, int32_t value) {
+        if (!refresh && !exceedsDeadband(field, entry.values[slot], value)) {
+            return;
+        }
+        if (publishField(entry, channel, field, value)) {
+            entry.values[slot] = value;
+        } else {
+            complete = false;
+        }
+    };
+
+    for (uint8_t i = 0; i < model->fieldCount; i++) {
+        const HoymilesFieldDescriptor& f = model->fields[i];
+        update(i, f.channel, f.field, sample.data.get(f.channel, f.field));
+    }
+
+    // OpenDTU also reports the inverter's yields on the AC channel
+    update(model->fieldCount, 0, FIELD_YIELD_DAY, sample.getYieldDay());
+    update(model->fieldCount + 1, 0, FIELD_YIELD_TOTAL, sample.getYieldTotal());
+
+    if (refresh && complete) {
+        entry.primed = true;
+        entry.lastRefresh = now;
+    }
+    return complete;
+}
+
+bool InverterPublisher::publishField(const TopicEntry& entry, uint8_t channel, HoymilesField field, int32_t value) {
+    char topic[INVERTER_PUBLISHER_TOPIC_SIZE + 24];
+    snprintf(topic, sizeof(topic), "%s/%u/%s", entry.topic, (unsigned)channel, INVERTER_FIELD_NAMES[field]);
+
+    // OpenDTU publishes the total yield in kWh
+    uint8_t decimals = field == FIELD_YIELD_TOTAL ? 3 : HOYMILES_FIELD_DECIMALS[field];
+    size_t length = formatFixedPoint(m_payload, sizeof(m_payload), value, decimals);
+
+    // Retained like OpenDTU, so subscribers see all values right away. Not
+    // spooled: a value that is not accepted is sent again with the next sample
+    return m_client.publish(topic, (const uint8_t*)m_payload, length, true, m_qos);
+}
+
+bool InverterPublisher::exceedsDeadband(HoymilesField field, int32_t last, int32_t value) const {
+    const Deadband& deadband = m_deadbands[field];
+
+    int64_t delta = (int64_t)value - last;
+    if (delta < 0) {
+        delta = -delta;
+    }
+
+    int64_t threshold = deadband.absolute;
+    int64_t relative = (last < 0 ? -(int64_t)last : (int64_t)last) * deadband.relativePermille / 1000;
+    if (relative > threshold) {
+        threshold = relative;
+    }
+
+    return delta > threshold;
+}
+
+bool InverterPublisher::publishCbor(TopicEntry& entry, const InverterSample& sample) {
+    uint8_t* payload = (uint8_t*)m_payload;
+    CborWriter cbor(payload, sizeof(m_payload));
+
+    uint32_t captured = 0;
+    bool timed = captureTime(sample, captured);
+
+    cbor.writeMap(5 + (m_energy ? 1 : 0) + (timed ? 1 : 0));
+    cbor.writeUInt(CBOR_KEY_VERSION);
+    cbor.writeUInt(INVERTER_CBOR_SCHEMA_VERSION);
+    cbor.writeUInt(CBOR_KEY_SERIAL);
+    cbor.writeUInt(sample.serial);
+    cbor.writeUInt(CBOR_KEY_POWER);
+    cbor.writeInt(sample.getPower());
+    cbor.writeUInt(CBOR_KEY_VOLTAGE);
+    cbor.writeInt(sample.getVoltage());
+    cbor.writeUInt(CBOR_KEY_CURRENT);
+    cbor.writeInt(sample.getDcCurrent());
+    if (m_energy) {
+        cbor.writeUInt(CBOR_KEY_ENERGY);
+        cbor.writeUInt(m_energy->getEnergy(sample.serial, 0));
+    }
+    if (timed) {
+        cbor.writeUInt(CBOR_KEY_TIME);
+        cbor.writeUInt(captured);
+    }
+
+    if (!cbor.ok()) {
+        return false;
+    }
+    return send(entry.topic, payload, cbor.length());
+}
+
+bool InverterPublisher::publishRollup(const Rollup& rollup) {
+    if (!isReady()) {
+        return false;
+    }
+
+    char topic[INVERTER_PUBLISHER_TOPIC_SIZE + 24];
+    int length;
+    if (m_layout == InverterTopicLayout::FIELDS) {
+        TopicEntry* entry = entryFor(rollup.serial);
+        if (!entry) {
+            return false;
+        }
+        length = snprintf(topic, sizeof(topic), "%s/rollup/%lu", entry->topic, (unsigned long)rollup.period);
+    } else {
+        length = snprintf(topic, sizeof(topic), "%s/%lu/rollup/%lu", m_base,
+                          (unsigned long)(rollup.serial & 0xFFFFFFFF), (unsigned long)rollup.period);
+    }
+    if (length < 0 || (size_t)length >= sizeof(topic)) {
+        return false;
+    }
+
+    size_t used = snprintf(m_rollup, sizeof(m_rollup), "{\"ts\":%lu,\"period\":%lu,\"count\":%lu",
+                           (unsigned long)rollup.start, (unsigned long)rollup.period, (unsigned long)rollup.count);
+
+    for (uint8_t q = 0; q < ROLLUP_QUANTITY_COUNT && used < sizeof(m_rollup); q++) {
+        const RollupStat& stat = rollup.values[q];
+        uint8_t decimals = HOYMILES_FIELD_DECIMALS[ROLLUP_FIELDS[q]];
+
+        char minText[16], maxText[16], meanText[16], lastText[16];
+        formatFixedPoint(minText, sizeof(minText), stat.min, decimals);
+        formatFixedPoint(maxText, sizeof(maxText), stat.max, decimals);
+        formatFixedPoint(meanText, sizeof(meanText), rollup.mean((RollupQuantity)q), decimals);
+        formatFixedPoint(lastText, sizeof(lastText), stat.last, decimals);
+
+        used += snprintf(m_rollup + used, sizeof(m_rollup) - used, ",\"%s\":{\"min\":%s,\"max\":%s,\"mean\":%s,\"last\":%s}",
+                         ROLLUP_QUANTITY_NAMES[q], minText, maxText, meanText, lastText);
+    }
+
+    if (used + 2 > sizeof(m_rollup)) {
+        LOG_ERROR("Inverter Publisher: rollup too long");
+        return false;
+    }
+    m_rollup[used++] = '}';
+    m_rollup[used] = '\0';
+
+    return send(topic, (const uint8_t*)m_rollup, used);
+}
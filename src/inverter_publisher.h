@@ -0,0 +1,271 @@
+/**
+ * Inverter Publisher - MQTT topics and payloads for inverter data
+ *
+ * Topics are rendered once per inverter into fixed buffers (the base topic
+ * once at startup), payloads into one reusable buffer with snprintf. A
+ * publish therefore performs no heap allocation and no configuration
+ * (NVS) reads, which keeps the ESP8266 heap from fragmenting.
+ *
+ * Topic layouts:
+ *   JSON    <base>/<serial>/data  {"ts":..,"power":..,"voltage":..,"current":..[,"energy":..]}
+ *   FIELDS  <base>/<serial>/<channel>/<field>, one plain value per topic as
+ *           published by OpenDTU (channel 0 = AC, 1..n = DC inputs)
+ *   BATCH   <base>/data  [{"serial":..,"ts":..,"power":..,"voltage":..,"current":..[,"energy":..]}, ...]
+ *           one message per poll cycle instead of one per inverter, which
+ *           saves the per-message MQTT, TLS record and TCP segment overhead
+ *
+ * In the FIELDS layout a value is only sent when it moved by more than its
+ * deadband since it was last published, the larger of an absolute step and
+ * a share of the last value. All values of an inverter are sent again once
+ * the max age has passed, so retained topics never go stale. With the
+ * MQTT task, a value counts as published once it is queued; if the outbox
+ * drops messages, the cache of every inverter is invalidated and all
+ * values are sent again with the next sample.
+ *
+ * "ts" is the Unix time the inverter's response was received. It is left
+ * out while SNTP has not set the clock yet.
+ *
+ * The JSON layout can carry CBOR instead of text (setEncoding()), on
+ * <base>/<serial>/cbor. Schema version 2 is a map with integer keys and
+ * the fixed-point integers of the JSON payload:
+ *   { 0: version, 1: serial (48 bit), 2: power (0.1 W),
+ *     3: voltage (0.1 V), 4: current (0.01 A)[, 5: energy (Wh)][, 6: ts] }
+ * New fields get new keys; the version changes when the meaning of an
+ * existing key or of the message order does (version 2: messages may
+ * arrive out of sample order, see below).
+ *
+ * With an energy source attached, JSON, CBOR and BATCH payloads carry the
+ * AC energy integrated on the device ("energy", kWh in JSON), which counts
+ * every sample even when the consumer does not receive all of them.
+ *
+ * Rollups (RollupEngine) go to <serial topic>/rollup/<seconds>, i.e.
+ * <base>/<serial>/rollup/900 (FIELDS: the 12-digit serial topic), as JSON
+ * in every layout and encoding, in the fixed-point units of the samples:
+ *   {"ts":<window start, Unix time>,"period":900,"count":450,
+ *    "power":{"min":..,"max":..,"mean":..,"last":..},"voltage":{..},
+ *    "current":{..},"temperature":{..}}
+ *
+ * A BATCH message is sent by flush(), which main calls when a radio driver
+ * reports the end of its poll cycle (HoymilesScheduler::endCycle()). It is
+ * also sent when an inverter reports a second time, when the next element
+ * would not fit the buffer, or from loop() once the oldest element is older
+ * than the batch hold time (set to the configured poll interval).
+ *
+ * With a spool attached, JSON, CBOR and BATCH messages that cannot be sent
+ * are stored and replayed from loop() at TELEMETRY_SPOOL_REPLAY_INTERVAL,
+ * well above the rate of live messages. New messages are sent right away
+ * while the backlog replays, so live data is never held back behind it;
+ * consumers order samples by "ts". Retained per-field values are not
+ * spooled: a late replay would overwrite newer state, and the deadband
+ * cache already resends them.
+ *
+ * Those same messages (and their replays) go out at the QoS set with
+ * setQos(). At QoS 1 the MQTT task keeps them until the broker
+ * acknowledged them; when its in-flight window and outbox are full,
+ * publish() fails and they spill into the spool. Retained per-field values
+ * always use QoS 0.
+ */
+
+#ifndef INVERTER_PUBLISHER_H
+#define INVERTER_PUBLISHER_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "mqtt_client.h"
+#include "inverter_sample.h"
+#include "cbor_writer.h"
+#include "telemetry_spool.h"
+#include "energy_integrator.h"
+#include "rollup_engine.h"
+
+#define INVERTER_PUBLISHER_TOPIC_SIZE     96
+#define INVERTER_PUBLISHER_PAYLOAD_SIZE   128
+
+// Rollup payload: four quantities with min/max/mean/last
+#define INVERTER_PUBLISHER_ROLLUP_SIZE    384
+
+// Cached values per inverter: every layout field plus the AC yield sums
+#define INVERTER_PUBLISHER_MAX_FIELDS     40
+
+// Batch buffer, below MQTT_MAX_PACKET_SIZE minus topic and MQTT header
+#ifndef INVERTER_PUBLISHER_BATCH_SIZE
+  #ifdef ESP8266
+    #define INVERTER_PUBLISHER_BATCH_SIZE 768
+  #else
+    #define INVERTER_PUBLISHER_BATCH_SIZE 1536
+  #endif
+#endif
+
+#ifndef INVERTER_PUBLISHER_MAX_AGE
+  #define INVERTER_PUBLISHER_MAX_AGE      300000  // ms until unchanged values are sent again
+#endif
+
+#ifndef INVERTER_PUBLISHER_BATCH_HOLD
+  #define INVERTER_PUBLISHER_BATCH_HOLD   HOYMILES_POLL_INTERVAL  // Until setBatchHold()
+#endif
+
+// HM and HMS inverters share the topic table on dual-radio builds
+#if defined(RADIO_NRF24) && defined(RADIO_CMT2300A)
+  #define INVERTER_PUBLISHER_MAX_TOPICS   (2 * HOYMILES_MAX_INVERTERS)
+#else
+  #define INVERTER_PUBLISHER_MAX_TOPICS   HOYMILES_MAX_INVERTERS
+#endif
+
+// Stored as MqttConfig::topic_layout, keep the values
+enum class InverterTopicLayout : uint8_t {
+    JSON = 0,
+    FIELDS = 1,
+    BATCH = 2
+};
+
+// Stored as MyPVLogConfig::payload_encoding, keep the values
+enum class InverterPayloadEncoding : uint8_t {
+    JSON = 0,
+    CBOR = 1
+};
+
+#define INVERTER_CBOR_SCHEMA_VERSION    2
+
+enum InverterCborKey : uint8_t {
+    CBOR_KEY_VERSION = 0,
+    CBOR_KEY_SERIAL = 1,
+    CBOR_KEY_POWER = 2,
+    CBOR_KEY_VOLTAGE = 3,
+    CBOR_KEY_CURRENT = 4,
+    CBOR_KEY_ENERGY = 5,
+    CBOR_KEY_TIME = 6
+};
+
+class InverterPublisher {
+public:
+    explicit InverterPublisher(MqttClient& client);
+
+    /**
+     * Set the topic root, e.g. "<prefix>/<mac>" or "opendtu/<dtu_id>"
+     * @return false if it does not fit the topic buffer
+     */
+    bool begin(const char* baseTopic, InverterTopicLayout layout = InverterTopicLayout::JSON);
+
+    /**
+     * Publish one sample in the configured layout
+     * @return false if nothing could be sent
+     */
+    bool publish(const InverterSample& sample);
+
+    /**
+     * Publish the rollup of a closed window (spooled like samples)
+     * @return false if it could be neither sent nor spooled
+     */
+    bool publishRollup(const Rollup& rollup);
+
+    /**
+     * Payload encoding of the JSON layout (topics are rendered anew)
+     */
+    void setEncoding(InverterPayloadEncoding encoding);
+
+    /**
+     * Store messages that cannot be sent (nullptr = drop them)
+     */
+    void setSpool(TelemetrySpool* spool) { m_spool = spool; }
+
+    /**
+     * Add the integrated AC energy to the payloads (nullptr = leave it out)
+     */
+    void setEnergySource(const EnergyIntegrator* energy) { m_energy = energy; }
+
+    /**
+     * QoS of the JSON, CBOR, BATCH and rollup messages (0 or 1)
+     */
+    void setQos(uint8_t qos) { m_qos = qos > 0 ? 1 : 0; }
+
+    /**
+     * Send a BATCH message that has been held for too long and replay
+     * spooled messages
+     */
+    void loop();
+
+    /**
+     * Send the pending BATCH message now
+     * @return false if the publish failed (the batch is dropped)
+     */
+    bool flush();
+
+    /**
+     * @param hold ms a BATCH message waits for the end of its poll cycle (the poll interval)
+     */
+    void setBatchHold(uint32_t hold) { m_batchHold = hold; }
+
+    /**
+     * Deadband of a field (FIELDS layout)
+     * @param absolute Smallest change in the field's fixed-point unit (HOYMILES_FIELD_DECIMALS)
+     * @param relativePermille Smallest change relative to the last published value, in 0.1 %
+     */
+    void setDeadband(HoymilesField field, uint16_t absolute, uint16_t relativePermille);
+
+    /**
+     * @param maxAge ms after which all values are sent regardless of deadbands (0 = every sample)
+     */
+    void setMaxAge(uint32_t maxAge) { m_maxAge = maxAge; }
+
+    bool isReady() const { return m_baseLength > 0; }
+
+private:
+    struct TopicEntry {
+        uint64_t serial;
+        char topic[INVERTER_PUBLISHER_TOPIC_SIZE];      // JSON: full topic, FIELDS: "<base>/<serial>", BATCH: unused
+        bool primed;                                    // values[] holds published values
+        bool batched;                                   // In the pending BATCH message
+        uint32_t lastRefresh;                           // millis() of the last full publish
+        int32_t values[INVERTER_PUBLISHER_MAX_FIELDS];  // Last published, by layout field index
+    };
+
+    struct Deadband {
+        uint16_t absolute;
+        uint16_t relativePermille;
+    };
+
+    MqttClient& m_client;
+    InverterTopicLayout m_layout;
+    InverterPayloadEncoding m_encoding;
+
+    char m_base[INVERTER_PUBLISHER_TOPIC_SIZE];
+    size_t m_baseLength;
+
+    TopicEntry m_topics[INVERTER_PUBLISHER_MAX_TOPICS];
+    uint8_t m_topicCount;
+
+    Deadband m_deadbands[FIELD_COUNT];
+    uint32_t m_maxAge;
+
+    char m_payload[INVERTER_PUBLISHER_PAYLOAD_SIZE];
+    char m_rollup[INVERTER_PUBLISHER_ROLLUP_SIZE];
+
+    char m_batchTopic[INVERTER_PUBLISHER_TOPIC_SIZE];
+    char m_batch[INVERTER_PUBLISHER_BATCH_SIZE];
+    size_t m_batchLength;
+    uint8_t m_batchCount;
+    uint32_t m_batchStart;                              // millis() of the first element
+    uint32_t m_batchHold;
+
+    TelemetrySpool* m_spool;
+    const EnergyIntegrator* m_energy;
+    uint8_t m_qos;
+    uint32_t m_lastReplay;
+#ifdef MQTT_TASK
+    uint32_t m_droppedSeen;                             // Outbox drops when values[] was last valid
+#endif
+
+    TopicEntry* entryFor(uint64_t serial);
+    bool send(const char* topic, const uint8_t* payload, size_t length);
+    static bool captureTime(const InverterSample& sample, uint32_t& captured);
+    static void formatTime(char* buffer, size_t size, const InverterSample& sample);
+    void formatEnergy(char* buffer, size_t size, const InverterSample& sample) const;
+    bool publishJson(TopicEntry& entry, const InverterSample& sample);
+    bool publishCbor(TopicEntry& entry, const InverterSample& sample);
+    bool publishFields(TopicEntry& entry, const InverterSample& sample);
+    bool appendBatch(TopicEntry& entry, const InverterSample& sample);
+    bool publishField(const TopicEntry& entry, uint8_t channel, HoymilesField field, int32_t value);
+    bool exceedsDeadband(HoymilesField field, int32_t last, int32_t value) const;
+};
+
+#endif // INVERTER_PUBLISHER_H
@@ -0,0 +1,105 @@
+/**
+ * Inverter Sample - Decoded telemetry of one inverter response
+ *
+ * Every driver owns one preallocated sample per inverter. A completed
+ * response is decoded straight into that slot and the slot is handed to
+ * the subscribers by const reference, so the full data set (AC side, all
+ * DC inputs, yields, temperature) reaches consumers without copies or
+ * heap allocation. Values are fixed-point, see HOYMILES_FIELD_DECIMALS.
+ *
+ * Subscribers run in the driver's context and must not keep the reference:
+ * the slot is overwritten by the inverter's next response.
+ */
+
+#ifndef INVERTER_SAMPLE_H
+#define INVERTER_SAMPLE_H
+
+#include <Arduino.h>
+#include "hoymiles_models.h"
+
+#define INVERTER_SAMPLE_MAX_SUBSCRIBERS 4
+
+struct InverterSample {
+    uint64_t serial;
+    const HoymilesModel* model; // Layout of data (name, DC channels, field table)
+    uint32_t timestamp;         // millis() when the response was completed
+    uint32_t sequence;          // Samples of this inverter so far (gaps = missed by a subscriber)
+    int16_t rssi;               // dBm as reported by the radio backend
+    HoymilesRealtimeData data;  // Channel 0 = AC, 1..dcChannels = DC inputs
+
+    /**
+     * Prepare the slot for a newly added inverter
+     */
+    void reset(uint64_t inverterSerial, const HoymilesModel* inverterModel) {
+        serial = inverterSerial;
+        model = inverterModel;
+        timestamp = 0;
+        sequence = 0;
+        rssi = 0;
+        memset(&data, 0, sizeof(data));
+        data.dcChannels = inverterModel ? inverterModel->dcChannels : 0;
+    }
+
+    // AC side shortcuts (same scale as HoymilesRealtimeData)
+    int32_t getPower() const { return data.get(0, FIELD_POWER); }
+    int32_t getVoltage() const { return data.get(0, FIELD_VOLTAGE); }
+    int32_t getFrequency() const { return data.get(0, FIELD_FREQUENCY); }
+    int32_t getTemperature() const { return data.get(0, FIELD_TEMPERATURE); }
+    int32_t getDcCurrent() const { return data.getTotalDcCurrent(); }
+
+    int32_t getYieldDay() const {
+        int32_t total = 0;
+        for (uint8_t ch = 1; ch <= data.dcChannels; ch++) {
+            total += data.get(ch, FIELD_YIELD_DAY);
+        }
+        return total;
+    }
+
+    int32_t getYieldTotal() const {
+        int32_t total = 0;
+        for (uint8_t ch = 1; ch <= data.dcChannels; ch++) {
+            total += data.get(ch, FIELD_YIELD_TOTAL);
+        }
+        return total;
+    }
+};
+
+/**
+ * Subscriber: plain function plus an opaque context (no captures, no heap)
+ */
+typedef void (*InverterSampleCallback)(void* context, const InverterSample& sample);
+
+class InverterSampleSubscribers {
+public:
+    InverterSampleSubscribers() : m_count(0) {}
+
+    /**
+     * @return false if all subscriber slots are taken
+     */
+    bool add(InverterSampleCallback callback, void* context) {
+        if (!callback || m_count >= INVERTER_SAMPLE_MAX_SUBSCRIBERS) {
+            return false;
+        }
+        m_entries[m_count].callback = callback;
+        m_entries[m_count].context = context;
+        m_count++;
+        return true;
+    }
+
+    void publish(const InverterSample& sample) const {
+        for (uint8_t i = 0; i < m_count; i++) {
+            m_entries[i].callback(m_entries[i].context, sample);
+        }
+    }
+
+private:
+    struct Entry {
+        InverterSampleCallback callback;
+        void* context;
+    };
+
+    Entry m_entries[INVERTER_SAMPLE_MAX_SUBSCRIBERS];
+    uint8_t m_count;
+};
+
+#endif // INVERTER_SAMPLE_H
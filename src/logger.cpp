@@ -0,0 +1,331 @@
+/**
+ * Logger - Deferred binary logging
+ */
+
+#include "logger.h"
+#include "fixed_point.h"
+
+#ifdef ESP32
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+#define LOG_TASK_STACK          3072
+#define LOG_TASK_PRIORITY       1       // Same as loop(), below the radio tasks
+#define LOG_TASK_CORE           0
+#define LOG_DRAIN_INTERVAL      20      // ms between drains
+
+// Producers are loop() and the radio tasks; a record is copied in a few
+// hundred nanoseconds, so a spinlock is cheaper than a mutex here
+static portMUX_TYPE s_logMux = portMUX_INITIALIZER_UNLOCKED;
+#define LOG_LOCK()      portENTER_CRITICAL(&s_logMux)
+#define LOG_UNLOCK()    portEXIT_CRITICAL(&s_logMux)
+#else
+// Single-threaded, no logging from interrupts
+#define LOG_LOCK()
+#define LOG_UNLOCK()
+#endif
+
+#define LOG_DRAIN_PER_LOOP      4       // Records per loop() call without a log task
+#define LOG_UART_FIFO_SIZE      128     // ESP8266 UART TX FIFO, bytes
+
+static const char LOG_LEVEL_CHARS[] = { '-', 'E', 'W', 'I', 'D' };
+static const char LOG_HEX_DIGITS[] = "0123456789ABCDEF";
+
+LogRecord Logger::s_ring[LOG_RING_SIZE];
+volatile uint16_t Logger::s_head = 0;
+volatile uint16_t Logger::s_tail = 0;
+volatile uint32_t Logger::s_dropped = 0;
+LogSink Logger::s_sink = nullptr;
+void* Logger::s_sinkContext = nullptr;
+
+#ifdef ESP32
+static void logTask(void*) {
+    for (;;) {
+        Logger::drain(LOG_RING_SIZE);
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL));
+    }
+}
+#endif
+
+void Logger::begin() {
+#ifdef ESP32
+    xTaskCreatePinnedToCore(logTask, "log", LOG_TASK_STACK, nullptr,
+                            LOG_TASK_PRIORITY, nullptr, LOG_TASK_CORE);
+#endif
+}
+
+void Logger::loop() {
+#ifndef ESP32
+    // Without a log task the UART write happens in loop() itself, so only
+    // take records whose line fits into the free TX FIFO: println() then
+    // returns at once instead of waiting for the UART during a poll
+    reportDropped();
+    for (uint16_t i = 0; i < LOG_DRAIN_PER_LOOP; i++) {
+        if (!outputIfRoom()) {
+            break;
+        }
+    }
+#endif
+}
+
+void Logger::setSink(LogSink sink, void* context) {
+    s_sinkContext = context;
+    s_sink = sink;
+}
+
+void Logger::write(uint8_t level, const char* format, const uintptr_t* args, uint8_t count) {
+    uint32_t now = millis();
+
+    LOG_LOCK();
+    uint16_t head = s_head;
+    if ((uint16_t)(head - s_tail) >= LOG_RING_SIZE) {
+        // Ring full: keep the older records, count the loss
+        s_dropped++;
+        LOG_UNLOCK();
+        return;
+    }
+
+    LogRecord& record = s_ring[head & (LOG_RING_SIZE - 1)];
+    record.time = now;
+    record.format = format;
+    record.level = level;
+    record.count = count;
+    record.hex = false;
+    memcpy(record.args, args, count * sizeof(uintptr_t));
+    s_head = head + 1;
+    LOG_UNLOCK();
+}
+
+void Logger::hex(uint8_t level, const char* format, const uint8_t* data, uint8_t len) {
+    uint32_t now = millis();
+
+    LOG_LOCK();
+    uint16_t head = s_head;
+    if ((uint16_t)(head - s_tail) >= LOG_RING_SIZE) {
+        s_dropped++;
+        LOG_UNLOCK();
+        return;
+    }
+
+    LogRecord& record = s_ring[head & (LOG_RING_SIZE - 1)];
+    record.time = now;
+    record.format = format;
+    record.level = level;
+    record.count = len;
+    record.hex = true;
+    memcpy(record.data, data, len < LOG_MAX_DATA ? len : LOG_MAX_DATA);
+    s_head = head + 1;
+    LOG_UNLOCK();
+}
+
+uint16_t Logger::drain(uint16_t maxRecords) {
+    reportDropped();
+
+    uint16_t written = 0;
+    while (written < maxRecords) {
+        LogRecord record;
+
+        LOG_LOCK();
+        uint16_t tail = s_tail;
+        if (tail == s_head) {
+            LOG_UNLOCK();
+            break;
+        }
+        record = s_ring[tail & (LOG_RING_SIZE - 1)];
+        s_tail = tail + 1;
+        LOG_UNLOCK();
+
+        // Formatting and the UART wait happen outside the lock
+        output(record);
+        written++;
+    }
+    return written;
+}
+
+void Logger::reportDropped() {
+    static uint32_t reported = 0;
+
+    uint32_t dropped = s_dropped;
+    if (dropped != reported) {
+        char line[48];
+        snprintf(line, sizeof(line), "log: %lu records dropped", (unsigned long)(dropped - reported));
+        reported = dropped;
+        emit(LOG_LEVEL_WARN, line);
+    }
+}
+
+#ifndef ESP32
+bool Logger::outputIfRoom() {
+    // Single consumer without a log task: the record stays queued until written
+    uint16_t tail = s_tail;
+    if (tail == s_head) {
+        return false;
+    }
+    const LogRecord& record = s_ring[tail & (LOG_RING_SIZE - 1)];
+
+    char line[LOG_LINE_SIZE];
+    size_t length = formatLine(record, line, sizeof(line));
+#if DEBUG_ENABLED
+    // println() adds CR LF; lines longer than the FIFO wait until it is empty
+    size_t needed = length + 2 < LOG_UART_FIFO_SIZE ? length + 2 : LOG_UART_FIFO_SIZE;
+    if ((size_t)DEBUG_SERIAL.availableForWrite() < needed) {
+        return false;
+    }
+#else
+    (void)length;
+#endif
+
+    s_tail = tail + 1;
+    emit(record.level, line);
+    return true;
+}
+#endif
+
+void Logger::output(const LogRecord& record) {
+    char line[LOG_LINE_SIZE];
+    formatLine(record, line, sizeof(line));
+    emit(record.level, line);
+}
+
+void Logger::emit(uint8_t level, const char* line) {
+#if DEBUG_ENABLED
+    DEBUG_SERIAL.println(line);
+#endif
+    if (s_sink) {
+        s_sink(s_sinkContext, level, line);
+    }
+}
+
+size_t Logger::formatLine(const LogRecord& record, char* line, size_t size) {
+    size_t n = snprintf(line, size, "%lu.%03lu %c ",
+                        (unsigned long)(record.time / 1000), (unsigned long)(record.time % 1000),
+                        LOG_LEVEL_CHARS[record.level <= LOG_LEVEL_DEBUG ? record.level : 0]);
+
+    if (record.hex) {
+        uintptr_t length = record.count;
+        n += format(line + n, size - n, record.format, &length, 1);
+
+        uint8_t shown = record.count < LOG_MAX_DATA ? record.count : LOG_MAX_DATA;
+        for (uint8_t i = 0; i < shown && n + 4 < size; i++) {
+            line[n++] = LOG_HEX_DIGITS[record.data[i] >> 4];
+            line[n++] = LOG_HEX_DIGITS[record.data[i] & 0x0F];
+            line[n++] = ' ';
+        }
+        if (shown < record.count && n + 4 < size) {
+            line[n++] = '.';
+            line[n++] = '.';
+            line[n++] = '.';
+        }
+        line[n] = '\0';
+    } else {
+        n += format(line + n, size - n, record.format, record.args, record.count);
+    }
+    return n;
+}
+
+/**
+ * Minimal printf subset on stored word arguments, see logger.h
+ */
+size_t Logger::format(char* line, size_t size, const char* fmt, const uintptr_t* args, uint8_t count) {
+    size_t n = 0;
+    uint8_t next = 0;
+
+    auto put = [&](char c) {
+        if (n + 1 < size) {
+            line[n++] = c;
+        }
+    };
+
+    for (const char* p = fmt; *p; p++) {
+        if (*p != '%') {
+            put(*p);
+            continue;
+        }
+
+        p++;
+        if (*p == '%') {
+            put('%');
+            continue;
+        }
+
+        bool zeroPad = false;
+        uint8_t width = 0;
+        int8_t decimals = -1;
+
+        if (*p == '0') {
+            zeroPad = true;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') {
+            width = width * 10 + (*p++ - '0');
+        }
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                decimals = next < count ? (int8_t)args[next++] : 0;
+                p++;
+            } else {
+                decimals = 0;
+                while (*p >= '0' && *p <= '9') {
+                    decimals = decimals * 10 + (*p++ - '0');
+                }
+            }
+            if (decimals > 4) {
+                decimals = 4;
+            }
+        }
+        if (*p == '\0') {
+            break;
+        }
+
+        uintptr_t value = next < count ? args[next++] : 0;
+        char text[24];
+
+        switch (*p) {
+            case 'd':
+                if (decimals >= 0) {
+                    formatFixedPoint(text, sizeof(text), (int32_t)value, decimals);
+                } else {
+                    snprintf(text, sizeof(text), "%ld", (long)(int32_t)value);
+                }
+                break;
+            case 'u':
+                snprintf(text, sizeof(text), "%lu", (unsigned long)(uint32_t)value);
+                break;
+            case 'x':
+                snprintf(text, sizeof(text), "%lx", (unsigned long)(uint32_t)value);
+                break;
+            case 'X':
+                snprintf(text, sizeof(text), "%lX", (unsigned long)(uint32_t)value);
+                break;
+            case 'c':
+                text[0] = (char)value;
+                text[1] = '\0';
+                break;
+            case 's': {
+                const char* s = value ? (const char*)value : "(null)";
+                while (*s) {
+                    put(*s++);
+                }
+                continue;
+            }
+            default:
+                put('%');
+                put(*p);
+                continue;
+        }
+
+        size_t length = strlen(text);
+        for (size_t i = length; i < width; i++) {
+            put(zeroPad ? '0' : ' ');
+        }
+        for (size_t i = 0; i < length; i++) {
+            put(text[i]);
+        }
+    }
+
+    if (size > 0) {
+        line[n] = '\0';
+    }
+    return n;
+}
@@ -0,0 +1,147 @@
+/**
+ * Logger - Deferred binary logging
+ *
+ * Hot paths (radio TX/RX, poll state machine) must not wait for the UART:
+ * at 115200 baud a hex dump of one packet takes several milliseconds. The
+ * LOG_* macros therefore only copy the format string address (the format
+ * "ID") and up to LOG_MAX_ARGS word-sized arguments into a RAM ring. The
+ * text is produced later by Logger::drain(), from a low-priority task on
+ * ESP32 and from loop() on ESP8266.
+ *
+ * Records above LOG_LEVEL (config.h) are removed at compile time, including
+ * the evaluation of their arguments.
+ *
+ * Format strings must be literals (only their address is stored). Supported
+ * conversions, all taking one argument:
+ *   %d %u %x %X %c   with optional zero padding width, e.g. %02X
+ *   %s               static string (literal or constant table entry)
+ *   %.Nd / %.*d      fixed-point value with N decimals (see fixed_point.h),
+ *                    '*' takes the number of decimals from an extra argument
+ *                    before the value, as in printf
+ */
+
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <Arduino.h>
+#include <type_traits>
+#include "config.h"
+
+#define LOG_MAX_ARGS    6       // Word-sized arguments per record
+#define LOG_MAX_DATA    32      // Bytes per hex dump record (longer dumps are cut)
+#define LOG_LINE_SIZE   160     // Longest formatted line
+
+#ifndef LOG_RING_SIZE
+  #ifdef ESP8266
+    #define LOG_RING_SIZE   32
+  #else
+    #define LOG_RING_SIZE   64
+  #endif
+#endif
+
+/**
+ * Receives every formatted line in the drain context (the web server keeps
+ * the latest ones for GET /api/log)
+ */
+typedef void (*LogSink)(void* context, uint8_t level, const char* line);
+
+struct LogRecord {
+    uint32_t time;              // millis() when logged
+    const char* format;
+    uint8_t level;
+    uint8_t count;              // Arguments, or dump length for LOG_HEX
+    bool hex;
+    union {
+        uintptr_t args[LOG_MAX_ARGS];
+        uint8_t data[LOG_MAX_DATA];
+    };
+};
+
+class Logger {
+    static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of two");
+
+public:
+    /**
+     * Start draining (ESP32: creates the log task)
+     */
+    static void begin();
+
+    /**
+     * Drain from loop() where there is no log task (ESP8266), without
+     * blocking on the UART
+     */
+    static void loop();
+
+    /**
+     * Format and output queued records
+     * @param maxRecords Upper bound of records handled in this call
+     * @return Number of records written
+     */
+    static uint16_t drain(uint16_t maxRecords);
+
+    static void setSink(LogSink sink, void* context);
+
+    static uint32_t getDroppedCount() { return s_dropped; }
+
+    /**
+     * Queue a record (use the LOG_* macros)
+     */
+    template <typename... Args>
+    static void log(uint8_t level, const char* format, Args... args) {
+        static_assert(sizeof...(Args) <= LOG_MAX_ARGS, "Too many log arguments");
+        const uintptr_t values[sizeof...(Args) + 1] = { toArg(args)..., 0 };
+        write(level, format, values, sizeof...(Args));
+    }
+
+    /**
+     * Queue a hex dump; the format may use %u for the dump length
+     */
+    static void hex(uint8_t level, const char* format, const uint8_t* data, uint8_t len);
+
+private:
+    static LogRecord s_ring[LOG_RING_SIZE];
+    static volatile uint16_t s_head;
+    static volatile uint16_t s_tail;
+    static volatile uint32_t s_dropped;
+    static LogSink s_sink;
+    static void* s_sinkContext;
+
+    template <typename T>
+    static uintptr_t toArg(T value) {
+        if constexpr (std::is_pointer<T>::value) {
+            return (uintptr_t)value;
+        } else {
+            static_assert(sizeof(T) <= sizeof(uintptr_t), "Log arguments must fit a word (cast 64-bit serials)");
+            // Sign-extended, so %d sees negative values unchanged
+            return (uintptr_t)(intptr_t)value;
+        }
+    }
+
+    static void write(uint8_t level, const char* format, const uintptr_t* args, uint8_t count);
+    static size_t format(char* line, size_t size, const char* fmt, const uintptr_t* args, uint8_t count);
+    static size_t formatLine(const LogRecord& record, char* line, size_t size);
+    static void output(const LogRecord& record);
+    static void emit(uint8_t level, const char* line);
+    static void reportDropped();
+#ifndef ESP32
+    /**
+     * Output the oldest record if its line fits into the free UART TX FIFO
+     * @return false if the ring is empty or the UART has no room
+     */
+    static bool outputIfRoom();
+#endif
+};
+
+#define LOG_AT(level, ...) \
+    do { if ((level) <= LOG_LEVEL) Logger::log((level), __VA_ARGS__); } while (0)
+
+#define LOG_HEX_AT(level, format, data, len) \
+    do { if ((level) <= LOG_LEVEL) Logger::hex((level), (format), (data), (len)); } while (0)
+
+#define LOG_ERROR(...)  LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#define LOG_WARN(...)   LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#define LOG_INFO(...)   LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#define LOG_DEBUG(...)  LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define LOG_HEX(format, data, len)  LOG_HEX_AT(LOG_LEVEL_DEBUG, format, data, len)
+
+#endif // LOGGER_H
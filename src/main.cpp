@@ -17,6 +17,14 @@
 #include "mqtt_client.h"
 #include "mypvlog_api.h"
 #include "ota_updater.h"
+#include "spi_arbiter.h"
+#include "logger.h"
+#include "inverter_sample.h"
+#include "inverter_publisher.h"
+#include "telemetry_spool.h"
+#include "sample_history.h"
+#include "energy_integrator.h"
+#include "rollup_engine.h"
 
 #ifdef RADIO_NRF24
 #include "hoymiles_hm.h"
@@ -26,6 +34,13 @@
 #include "hoymiles_hms.h"
 #endif
 
+#ifdef HOYMILES_RADIO_TASKS
+#include <atomic>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+#include <freertos/task.h>
+#endif
+
 // ============================================
 // Global Instances
 // ============================================
@@ -34,15 +49,26 @@ WiFiManager wifiManager;
 WebServer webServer;
 ConfigManager configManager;
 MqttClient mqttClient;
+InverterPublisher inverterPublisher(mqttClient);
+TelemetrySpool telemetrySpool;
+EnergyIntegrator energyIntegrator;
+RollupEngine rollupEngine;
+
+// Means of the long rollup window; written from loop() only
+#define ROLLUP_HISTORY_PSRAM_CAPACITY 8192  // 85 days of 15-minute rollups of one inverter
+SampleHistory rollupHistory;
 MypvlogAPI mypvlogAPI;
 OTAUpdater otaUpdater;
 
+// One history ring per driver: each ring has a single writer (its radio task)
 #ifdef RADIO_NRF24
 HoymilesHM hoymilesHM;
+SampleHistory historyHM;
 #endif
 
 #ifdef RADIO_CMT2300A
 HoymilesHMS hoymilesHMS;
+SampleHistory historyHMS;
 #endif
 
 // ============================================
@@ -81,40 +107,124 @@ void onOTAProgress(OTAStatus status, int progress, const String& message) {
 // Inverter Data Callback
 // ============================================
 
-void onInverterData(uint64_t serial, float power, float voltage, float current) {
-    DEBUG_PRINT("Inverter ");
-    DEBUG_PRINT((unsigned long)serial);
-    DEBUG_PRINT(": Power=");
-    DEBUG_PRINT(power);
-    DEBUG_PRINT("W, Voltage=");
-    DEBUG_PRINT(voltage);
-    DEBUG_PRINT("V, Current=");
-    DEBUG_PRINT(current);
-    DEBUG_PRINTLN("A");
-
-    // Publish to MQTT if connected
-    if (mqttClient.isConnected()) {
-        String topic;
-        OperationMode mode = configManager.getMode();
+/**
+ * Publish one inverter sample (JSON or per-field topics, see InverterPublisher)
+ */
+void publishInverterData(const InverterSample& sample) {
+    LOG_INFO("Inverter %u: Power=%.1dW, Voltage=%.1dV, Current=%.2dA",
+             (uint32_t)(sample.serial & 0xFFFFFFFF), sample.getPower(), sample.getVoltage(), sample.getDcCurrent());
 
-        if (mode == OperationMode::GENERIC_MQTT) {
-            MqttConfig config = configManager.getMqttConfig();
-            topic = config.topic_prefix + "/" + wifiManager.getMacAddress() + "/" + String((unsigned long)serial);
-        } else if (mode == OperationMode::MYPVLOG_DIRECT) {
-            MyPVLogConfig config = configManager.getMyPVLogConfig();
-            topic = "opendtu/" + config.dtu_id + "/" + String((unsigned long)serial);
-        }
+    // Integrated before publishing, so the payload includes this sample
+    energyIntegrator.update(sample);
+    rollupEngine.update(sample);
 
-        if (topic.length() > 0) {
-            String payload = "{\"power\":" + String(power) +
-                           ",\"voltage\":" + String(voltage) +
-                           ",\"current\":" + String(current) + "}";
+    // Topics were rendered at startup, payloads go into a static buffer;
+    // while the broker is unreachable, messages go to the spool
+    inverterPublisher.publish(sample);
+}
 
-            mqttClient.publish(topic + "/data", payload);
-        }
+/**
+ * Rollup subscriber: every closed window goes to MQTT, the long ones also
+ * into the rollup history
+ */
+void onRollup(void*, const Rollup& rollup) {
+    inverterPublisher.publishRollup(rollup);
+
+    if (rollup.period == ROLLUP_WINDOW_LONG) {
+        SampleHistoryRecord record;
+        record.time = rollup.start;
+        record.serial = rollup.serial;
+        record.power = rollup.mean(ROLLUP_POWER);
+        record.voltage = (uint16_t)constrain(rollup.mean(ROLLUP_VOLTAGE), 0, 0xFFFF);
+        record.current = (uint16_t)constrain(rollup.mean(ROLLUP_CURRENT), 0, 0xFFFF);
+        record.temperature = (int16_t)rollup.mean(ROLLUP_TEMPERATURE);
+        record.yieldDay = 0;
+        rollupHistory.append(record);
     }
 }
 
+#ifdef HOYMILES_RADIO_TASKS
+/**
+ * The radio tasks hand copies of their samples to loop(), which owns the
+ * MQTT client (per-field topics need the whole sample, not just AC values)
+ */
+#define INVERTER_READING_QUEUE_SIZE 8
+
+QueueHandle_t inverterReadings = nullptr;
+
+// Set by a radio task after the last sample of its poll cycle was queued
+std::atomic<bool> pollCycleEnded(false);
+#endif
+
+/**
+ * Sample subscriber of the radio drivers
+ */
+void onInverterSample(void*, const InverterSample& sample) {
+#ifdef HOYMILES_RADIO_TASKS
+    // Never block a radio task; a sample is dropped if loop() falls behind
+    xQueueSend(inverterReadings, &sample, 0);
+#else
+    publishInverterData(sample);
+#endif
+}
+
+/**
+ * Poll cycle end of a radio driver: the BATCH message is complete
+ */
+void onPollCycleEnd(void*) {
+#ifdef HOYMILES_RADIO_TASKS
+    // Flushed by loop() once it has published the samples queued before this
+    pollCycleEnded.store(true);
+#else
+    inverterPublisher.flush();
+#endif
+}
+
+/**
+ * Base poll interval of the radio drivers in the given mode (ms)
+ */
+uint16_t pollIntervalFor(OperationMode mode) {
+    return mode == OperationMode::MYPVLOG_DIRECT ? HOYMILES_POLL_INTERVAL_FAST : HOYMILES_POLL_INTERVAL;
+}
+
+// ============================================
+// Radio Tasks (dual-radio ESP32 builds)
+// ============================================
+
+#ifdef HOYMILES_RADIO_TASKS
+
+/**
+ * HM and HMS are polled from their own tasks so one radio's response wait
+ * does not hold up the other. Their samples reach loop() through the
+ * inverterReadings queue (see onInverterSample()).
+ */
+void hoymilesHMTask(void*) {
+    for (;;) {
+        hoymilesHM.loop();
+        vTaskDelay(1);
+    }
+}
+
+void hoymilesHMSTask(void*) {
+    for (;;) {
+        hoymilesHMS.loop();
+        vTaskDelay(1);
+    }
+}
+
+void startRadioTasks() {
+    inverterReadings = xQueueCreate(INVERTER_READING_QUEUE_SIZE, sizeof(InverterSample));
+
+    xTaskCreatePinnedToCore(hoymilesHMTask, "hoymiles_hm", HOYMILES_RADIO_TASK_STACK, nullptr,
+                            HOYMILES_RADIO_TASK_PRIORITY, nullptr, HOYMILES_RADIO_TASK_CORE);
+    xTaskCreatePinnedToCore(hoymilesHMSTask, "hoymiles_hms", HOYMILES_RADIO_TASK_STACK, nullptr,
+                            HOYMILES_RADIO_TASK_PRIORITY, nullptr, HOYMILES_RADIO_TASK_CORE);
+
+    Serial.println("Hoymiles: HM and HMS polling in separate tasks");
+}
+
+#endif // HOYMILES_RADIO_TASKS
+
 // ============================================
 // Setup Function
 // ============================================
@@ -124,6 +234,9 @@ void setup() {
     Serial.begin(115200);
     while (!Serial && millis() < 3000); // Wait up to 3s for serial
 
+    // Deferred log output (radio hot paths only queue records)
+    Logger::begin();
+
     Serial.println();
     Serial.println("========================================");
     Serial.println("  mypvlog Firmware v" VERSION);
@@ -181,6 +294,9 @@ void setup() {
     // Will create AP if no credentials saved, or connect to saved WiFi
     wifiManager.begin();
 
+    // Wall clock (UTC) for the rollup windows; SNTP retries until WiFi is up
+    configTime(0, 0, NTP_SERVER);
+
     // Step 3: Initialize Web Server
     // Serves setup wizard in AP mode, or local UI in client mode
     webServer.begin();
@@ -212,8 +328,9 @@ void setup() {
         Serial.println("========================================");
     }
 
-    // Step 4: Initialize MQTT (if configured and WiFi connected)
-    if (configManager.isConfigured() && wifiManager.isConnected()) {
+    // Step 4: Initialize MQTT (if configured); without WiFi the client
+    // connects later and messages are spooled until then
+    if (configManager.isConfigured()) {
         Serial.println();
         Serial.println("Initializing MQTT...");
 
@@ -221,41 +338,101 @@ void setup() {
             MqttConfig mqttConfig = configManager.getMqttConfig();
             mqttClient.begin(mqttConfig, mqttConfig.ssl);
 
+            InverterTopicLayout layout = (InverterTopicLayout)mqttConfig.topic_layout;
+            if (layout == InverterTopicLayout::FIELDS) {
+                // Inverter topics: <prefix>/<serial>/<channel>/<field> (OpenDTU)
+                inverterPublisher.begin(mqttConfig.topic_prefix.c_str(), layout);
+            } else {
+                // Inverter topics: <prefix>/<mac>/<serial>/data, batches: <prefix>/<mac>/data
+                String baseTopic = mqttConfig.topic_prefix + "/" + wifiManager.getMacAddress();
+                inverterPublisher.begin(baseTopic.c_str(),
+                                        layout == InverterTopicLayout::BATCH ? layout : InverterTopicLayout::JSON);
+            }
+            inverterPublisher.setQos(mqttConfig.qos);
+            #ifdef MQTT_TASK
+            mqttClient.setInflightWindow(mqttConfig.inflight_window);
+            #endif
+
             Serial.print("  Broker: ");
             Serial.print(mqttConfig.host);
             Serial.print(":");
             Serial.println(mqttConfig.port);
             Serial.print("  SSL: ");
             Serial.println(mqttConfig.ssl ? "Yes" : "No");
+            Serial.print("  Topics: ");
+            Serial.println(layout == InverterTopicLayout::FIELDS ? "per field (OpenDTU)" :
+                           layout == InverterTopicLayout::BATCH ? "batch per poll cycle" : "JSON");
+            Serial.print("  QoS: ");
+            Serial.println(mqttConfig.qos);
         } else if (mode == OperationMode::MYPVLOG_DIRECT) {
             MyPVLogConfig pvlogConfig = configManager.getMyPVLogConfig();
             mqttClient.beginMyPVLog(pvlogConfig);
 
+            // Inverter topics: opendtu/<dtu_id>/<serial>/data (or /cbor)
+            String baseTopic = "opendtu/" + pvlogConfig.dtu_id;
+            inverterPublisher.begin(baseTopic.c_str());
+            inverterPublisher.setEncoding((InverterPayloadEncoding)pvlogConfig.payload_encoding);
+            // At least once: the cloud integrates and bills on what arrives
+            inverterPublisher.setQos(1);
+
             Serial.println("  Broker: mqtt.mypvlog.net:8883 (SSL)");
             Serial.print("  DTU ID: ");
             Serial.println(pvlogConfig.dtu_id);
+            Serial.print("  Encoding: ");
+            Serial.println(pvlogConfig.payload_encoding == (uint8_t)InverterPayloadEncoding::CBOR ? "CBOR" : "JSON");
+        }
+
+        // Messages sent while the broker is unreachable are kept on LittleFS
+        // (mounted by the web server)
+        if (telemetrySpool.begin()) {
+            inverterPublisher.setSpool(&telemetrySpool);
         }
+        inverterPublisher.setEnergySource(&energyIntegrator);
+        // Batches are sent at the end of each poll cycle; the hold only
+        // covers a cycle end that never comes
+        inverterPublisher.setBatchHold(pollIntervalFor(mode));
 
         // Try to connect
-        if (mqttClient.connect()) {
+        if (!wifiManager.isConnected()) {
+            Serial.println("  Status: Waiting for WiFi");
+        } else if (mqttClient.connect()) {
             Serial.println("  Status: Connected!");
         } else {
             Serial.print("  Status: Connection failed - ");
             Serial.println(mqttClient.getLastError());
         }
+
+        #ifdef MQTT_TASK
+        // From here on, reconnects and sends happen in the MQTT task
+        mqttClient.startTask();
+        #endif
     }
 
     // Step 5: Initialize Hoymiles Protocol (if configured)
+    SpiArbiter::begin();
+
+    if (configManager.isConfigured()) {
+        // Energy counters of the last checkpoint, before the first sample
+        energyIntegrator.begin();
+
+        rollupEngine.addWindow(ROLLUP_WINDOW_SHORT);
+        rollupEngine.addWindow(ROLLUP_WINDOW_LONG);
+        rollupEngine.subscribe(onRollup);
+        rollupHistory.begin(ROLLUP_HISTORY_PSRAM_CAPACITY);
+    }
+
     #ifdef RADIO_NRF24
     if (configManager.isConfigured()) {
         Serial.println();
         hoymilesHM.begin();
-        hoymilesHM.setDataCallback(onInverterData);
+        hoymilesHM.subscribe(onInverterSample);
+        hoymilesHM.onCycleEnd(onPollCycleEnd);
+        if (historyHM.begin()) {
+            hoymilesHM.subscribe(SampleHistory::onSample, &historyHM);
+        }
 
         // Set poll interval based on mode
-        if (mode == OperationMode::MYPVLOG_DIRECT) {
-            hoymilesHM.setPollInterval(HOYMILES_POLL_INTERVAL_FAST);
-        }
+        hoymilesHM.setPollInterval(pollIntervalFor(mode));
 
         Serial.println("Hoymiles HM: Ready");
     }
@@ -265,17 +442,25 @@ void setup() {
     if (configManager.isConfigured()) {
         Serial.println();
         hoymilesHMS.begin();
-        hoymilesHMS.setDataCallback(onInverterData);
+        hoymilesHMS.subscribe(onInverterSample);
+        hoymilesHMS.onCycleEnd(onPollCycleEnd);
+        if (historyHMS.begin()) {
+            hoymilesHMS.subscribe(SampleHistory::onSample, &historyHMS);
+        }
 
         // Set poll interval based on mode
-        if (mode == OperationMode::MYPVLOG_DIRECT) {
-            hoymilesHMS.setPollInterval(HOYMILES_POLL_INTERVAL_FAST);
-        }
+        hoymilesHMS.setPollInterval(pollIntervalFor(mode));
 
         Serial.println("Hoymiles HMS/HMT: Ready");
     }
     #endif
 
+    #ifdef HOYMILES_RADIO_TASKS
+    if (configManager.isConfigured()) {
+        startRadioTasks();
+    }
+    #endif
+
     // Check for firmware updates (mypvlog Direct mode only)
     if (mode == OperationMode::MYPVLOG_DIRECT && wifiManager.isConnected()) {
         Serial.println();
@@ -330,18 +515,41 @@ void setup() {
 // ============================================
 
 void loop() {
+    // Flush queued log records (ESP8266; ESP32 drains from the log task)
+    Logger::loop();
+
     // Handle WiFi (reconnection, AP mode)
     wifiManager.loop();
 
     // Handle web server (HTTP requests, captive portal DNS)
     webServer.loop();
 
-    // Handle MQTT (reconnection, message processing)
+    // Handle MQTT (reconnection, message processing; no-op with the MQTT task)
     if (configManager.isConfigured() && wifiManager.isConnected()) {
         mqttClient.loop();
     }
 
+    // Send a batch whose poll cycle did not complete in time, replay the spool,
+    // checkpoint the energy counters, close rollup windows
+    if (configManager.isConfigured()) {
+        inverterPublisher.loop();
+        energyIntegrator.loop();
+        rollupEngine.loop();
+    }
+
     // Handle inverter polling (if configured)
+    #ifdef HOYMILES_RADIO_TASKS
+    // Polled by the radio tasks; publish what they queued. The cycle flag is
+    // read first: a cycle that ended by now has all its samples in the queue
+    bool cycleEnded = pollCycleEnded.exchange(false);
+    static InverterSample reading;
+    while (inverterReadings && xQueueReceive(inverterReadings, &reading, 0) == pdTRUE) {
+        publishInverterData(reading);
+    }
+    if (cycleEnded) {
+        inverterPublisher.flush();
+    }
+    #else
     #ifdef RADIO_NRF24
     if (configManager.isConfigured()) {
         hoymilesHM.loop();
@@ -353,6 +561,7 @@ void loop() {
         hoymilesHMS.loop();
     }
     #endif
+    #endif
 
     // mypvlog Direct mode: Send heartbeat
     if (configManager.getMode() == OperationMode::MYPVLOG_DIRECT &&
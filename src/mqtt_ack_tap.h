@@ -0,0 +1,152 @@
+/**
+ * MQTT Ack Tap - Transport wrapper that reports PUBACK packets
+ *
+ * PubSubClient publishes at QoS 0 only and discards the PUBACKs a broker
+ * sends for QoS 1 messages. The tap sits between PubSubClient and the
+ * network client (WiFiClient, WiFiClientSecure), forwards every call, and
+ * follows the inbound packet framing byte by byte as PubSubClient reads
+ * it:
+ *   fixed header (type << 4 | flags), remaining length (1-4 bytes, 7 bits
+ *   each), body
+ * A PUBACK (type 4, remaining length 2) carries the packet identifier of
+ * the acknowledged message, which is passed to the ack callback.
+ *
+ * Used by the MQTT task only, header-only like cbor_writer.h.
+ */
+
+#ifndef MQTT_ACK_TAP_H
+#define MQTT_ACK_TAP_H
+
+#include <Arduino.h>
+#include <Client.h>
+
+#define MQTT_PACKET_PUBACK      4
+
+/**
+ * Called with the packet identifier of each PUBACK (plain function plus an
+ * opaque context, like InverterSampleCallback)
+ */
+typedef void (*MqttAckCallback)(void* context, uint16_t packetId);
+
+class MqttAckTap : public Client {
+public:
+    MqttAckTap()
+        : m_client(nullptr)
+        , m_callback(nullptr)
+        , m_context(nullptr)
+    {
+        reset();
+    }
+
+    /**
+     * Network client to forward to (before the first connect)
+     */
+    void setClient(Client& client) { m_client = &client; }
+
+    void onAck(MqttAckCallback callback, void* context) {
+        m_callback = callback;
+        m_context = context;
+    }
+
+    int connect(IPAddress ip, uint16_t port) override {
+        reset();
+        return m_client->connect(ip, port);
+    }
+
+    int connect(const char* host, uint16_t port) override {
+        reset();
+        return m_client->connect(host, port);
+    }
+
+    size_t write(uint8_t b) override { return m_client->write(b); }
+    size_t write(const uint8_t* buf, size_t size) override { return m_client->write(buf, size); }
+    int available() override { return m_client->available(); }
+    int peek() override { return m_client->peek(); }
+    void flush() override { m_client->flush(); }
+    void stop() override { m_client->stop(); }
+    uint8_t connected() override { return m_client->connected(); }
+    operator bool() override { return m_client && (bool)*m_client; }
+
+    int read() override {
+        int b = m_client->read();
+        if (b >= 0) {
+            consume((uint8_t)b);
+        }
+        return b;
+    }
+
+    int read(uint8_t* buf, size_t size) override {
+        int count = m_client->read(buf, size);
+        for (int i = 0; i < count; i++) {
+            consume(buf[i]);
+        }
+        return count;
+    }
+
+private:
+    enum class State : uint8_t {
+        HEADER,
+        LENGTH,
+        BODY
+    };
+
+    Client* m_client;
+    MqttAckCallback m_callback;
+    void* m_context;
+
+    State m_state;
+    uint8_t m_type;
+    uint8_t m_lengthBytes;
+    uint32_t m_remaining;       // Body bytes of the current packet
+    uint32_t m_position;        // Body bytes read so far
+    uint16_t m_packetId;
+
+    void reset() {
+        m_state = State::HEADER;
+        m_type = 0;
+        m_lengthBytes = 0;
+        m_remaining = 0;
+        m_position = 0;
+        m_packetId = 0;
+    }
+
+    void consume(uint8_t b) {
+        switch (m_state) {
+            case State::HEADER:
+                m_type = b >> 4;
+                m_state = State::LENGTH;
+                m_lengthBytes = 0;
+                m_remaining = 0;
+                break;
+
+            case State::LENGTH:
+                m_remaining |= (uint32_t)(b & 0x7F) << (7 * m_lengthBytes++);
+                if (b & 0x80) {
+                    if (m_lengthBytes >= 4) {
+                        reset();    // Malformed, resynchronize on the next byte
+                    }
+                } else if (m_remaining == 0) {
+                    m_state = State::HEADER;
+                } else {
+                    m_state = State::BODY;
+                    m_position = 0;
+                    m_packetId = 0;
+                }
+                break;
+
+            case State::BODY:
+                if (m_position < 2) {
+                    m_packetId = (m_packetId << 8) | b;
+                }
+                if (++m_position == m_remaining) {
+                    if (m_type == MQTT_PACKET_PUBACK && m_remaining == 2 && m_callback) {
+                        m_callback(m_context, m_packetId);
+                    }
+                    m_state = State::HEADER;
+                }
+                break;
+        }
+    }
+};
+
+#endif // MQTT_ACK_TAP_H
@@ -4,6 +4,13 @@
 
 #include "mqtt_client.h"
 #include "config.h"
+#include "logger.h"
+
+#ifdef MQTT_TASK
+#define MQTT_TASK_BURST         8       // Messages sent per round before PubSubClient::loop() runs again
+#define MQTT_TASK_IDLE_WAIT     10      // ms the task sleeps without new messages (keepalive, reconnect, PUBACKs)
+#define MQTT_PUBLISH_QOS1       0x32    // PUBLISH, QoS 1
+#endif
 
 // Static instance pointer for callback
 static MqttClient* instance = nullptr;
@@ -15,6 +22,17 @@ MqttClient::MqttClient()
     , m_initialized(false)
     , m_lastReconnectAttempt(0)
     , m_reconnectInterval(MQTT_RECONNECT_INTERVAL)
+#ifdef MQTT_TASK
+    , m_task(nullptr)
+    , m_connected(false)
+    , m_reportedDrops(0)
+    , m_inflightFirst(0)
+    , m_inflightCount(0)
+    , m_inflightWindow(MQTT_DEFAULT_INFLIGHT_WINDOW)
+    , m_sendCursor(0)
+    , m_nextPacketId(1)
+    , m_retransmits(0)
+#endif
 {
     instance = this;
 }
@@ -33,9 +51,9 @@ void MqttClient::begin(const MqttConfig& config, bool useSSL) {
     if (m_useSSL) {
         DEBUG_PRINTLN("MQTT Client: Using SSL/TLS");
         m_wifiClientSecure.setInsecure(); // For now, don't validate certificates
-        m_mqttClient = new PubSubClient(m_wifiClientSecure);
+        m_mqttClient = new PubSubClient(transport(m_wifiClientSecure));
     } else {
-        m_mqttClient = new PubSubClient(m_wifiClient);
+        m_mqttClient = new PubSubClient(transport(m_wifiClient));
     }
 
     m_mqttClient->setServer(m_broker.c_str(), m_port);
@@ -65,7 +83,7 @@ void MqttClient::beginMyPVLog(const MyPVLogConfig& config) {
     // Always use SSL for MyPVLog
     DEBUG_PRINTLN("MQTT Client: Using SSL/TLS (MyPVLog)");
     m_wifiClientSecure.setInsecure(); // TODO: Add certificate pinning
-    m_mqttClient = new PubSubClient(m_wifiClientSecure);
+    m_mqttClient = new PubSubClient(transport(m_wifiClientSecure));
 
     m_mqttClient->setServer(m_broker.c_str(), m_port);
     m_mqttClient->setCallback(staticCallback);
@@ -81,6 +99,19 @@ void MqttClient::beginMyPVLog(const MyPVLogConfig& config) {
     DEBUG_PRINTLN(m_clientId);
 }
 
+/**
+ * Network client for PubSubClient; the MQTT task reads PUBACKs through the tap
+ */
+Client& MqttClient::transport(Client& client) {
+#ifdef MQTT_TASK
+    m_tap.setClient(client);
+    m_tap.onAck(onAck, this);
+    return m_tap;
+#else
+    return client;
+#endif
+}
+
 bool MqttClient::connect() {
     if (!m_initialized) {
         m_lastError = "Not initialized";
@@ -129,6 +160,11 @@ void MqttClient::disconnect() {
 }
 
 bool MqttClient::isConnected() {
+#ifdef MQTT_TASK
+    if (m_task) {
+        return m_connected.load(std::memory_order_relaxed);
+    }
+#endif
     return m_mqttClient && m_mqttClient->connected();
 }
 
@@ -136,6 +172,11 @@ void MqttClient::loop() {
     if (!m_initialized) {
         return;
     }
+#ifdef MQTT_TASK
+    if (m_task) {
+        return;     // The MQTT task does this
+    }
+#endif
 
     // Handle MQTT messages
     if (m_mqttClient->connected()) {
@@ -165,12 +206,25 @@ bool MqttClient::publish(const String& topic, const String& payload, bool retain
 }
 
 bool MqttClient::publish(const String& topic, const char* payload, bool retained) {
+    return publish(topic.c_str(), payload, retained);
+}
+
+/**
+ * Allocation-free variant, topic and payload are sent as they are
+ */
+bool MqttClient::publish(const char* topic, const char* payload, bool retained) {
+#ifdef MQTT_TASK
+    if (m_task) {
+        return enqueue(topic, (const uint8_t*)payload, strlen(payload), retained, 0);
+    }
+#endif
+
     if (!isConnected()) {
         DEBUG_PRINTLN("MQTT Client: Cannot publish, not connected");
         return false;
     }
 
-    bool success = m_mqttClient->publish(topic.c_str(), payload, retained);
+    bool success = m_mqttClient->publish(topic, payload, retained);
 
     if (success) {
         DEBUG_PRINT("MQTT Client: Published to ");
@@ -185,7 +239,46 @@ bool MqttClient::publish(const String& topic, const char* payload, bool retained
     return success;
 }
 
+/**
+ * Binary payload (e.g. CBOR), allocation-free like the text variant
+ * @param qos 0 or 1; QoS 1 needs the MQTT task, otherwise the message goes out at QoS 0
+ */
+bool MqttClient::publish(const char* topic, const uint8_t* payload, size_t length, bool retained, uint8_t qos) {
+#ifdef MQTT_TASK
+    if (m_task) {
+        return enqueue(topic, payload, length, retained, qos);
+    }
+#endif
+    (void)qos;
+
+    if (!isConnected()) {
+        DEBUG_PRINTLN("MQTT Client: Cannot publish, not connected");
+        return false;
+    }
+
+    bool success = m_mqttClient->publish(topic, payload, length, retained);
+
+    if (success) {
+        DEBUG_PRINT("MQTT Client: Published ");
+        DEBUG_PRINT(length);
+        DEBUG_PRINT(" bytes to ");
+        DEBUG_PRINTLN(topic);
+    } else {
+        DEBUG_PRINT("MQTT Client: Publish failed to ");
+        DEBUG_PRINTLN(topic);
+    }
+
+    return success;
+}
+
 bool MqttClient::subscribe(const String& topic) {
+#ifdef MQTT_TASK
+    if (m_task) {
+        DEBUG_PRINTLN("MQTT Client: Cannot subscribe, connection owned by the MQTT task");
+        return false;
+    }
+#endif
+
     if (!isConnected()) {
         DEBUG_PRINTLN("MQTT Client: Cannot subscribe, not connected");
         return false;
@@ -208,6 +301,250 @@ void MqttClient::setCallback(std::function<void(String topic, String payload)> c
     m_messageCallback = callback;
 }
 
+#ifdef MQTT_TASK
+
+bool MqttClient::startTask() {
+    if (!m_initialized || m_task) {
+        return m_task != nullptr;
+    }
+
+    m_connected.store(m_mqttClient->connected(), std::memory_order_relaxed);
+    m_sendCursor = m_outbox.front();
+    if (xTaskCreatePinnedToCore(taskMain, "mqtt", MQTT_TASK_STACK, this,
+                                MQTT_TASK_PRIORITY, &m_task, MQTT_TASK_CORE) != pdPASS) {
+        m_task = nullptr;
+        DEBUG_PRINTLN("MQTT Client: ERROR - cannot start MQTT task");
+        return false;
+    }
+
+    DEBUG_PRINTLN("MQTT Client: Connection handled by the MQTT task");
+    return true;
+}
+
+void MqttClient::setInflightWindow(uint8_t window) {
+    m_inflightWindow = constrain(window, 1, MQTT_INFLIGHT_MAX);
+}
+
+/**
+ * Queue a message for the MQTT task (loop() only, the outbox's single producer)
+ * @return false if not connected, the message is too large, or the outbox
+ *         has no room (the caller spools it)
+ */
+bool MqttClient::enqueue(const char* topic, const uint8_t* payload, size_t length, bool retained, uint8_t qos) {
+    if (!m_connected.load(std::memory_order_relaxed)) {
+        return false;
+    }
+
+    bool queued = m_outbox.push(topic, payload, length, retained, qos);
+    xTaskNotifyGive(m_task);
+    return queued;
+}
+
+void MqttClient::taskMain(void* context) {
+    MqttClient* self = static_cast<MqttClient*>(context);
+    for (;;) {
+        if (self->service()) {
+            vTaskDelay(1);
+        } else {
+            // Woken early by enqueue()
+            ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(MQTT_TASK_IDLE_WAIT));
+        }
+    }
+}
+
+/**
+ * PUBACK seen by the tap (MQTT task, inside PubSubClient::loop())
+ */
+void MqttClient::onAck(void* context, uint16_t packetId) {
+    MqttClient* self = static_cast<MqttClient*>(context);
+    for (uint8_t i = 0; i < self->m_inflightCount; i++) {
+        InflightEntry& entry = self->m_inflight[(self->m_inflightFirst + i) % MQTT_INFLIGHT_MAX];
+        if (entry.packetId == packetId && !entry.acked) {
+            entry.acked = true;
+            return;
+        }
+    }
+}
+
+/**
+ * One round of the MQTT task: keep the connection up, read acknowledgements,
+ * send queued messages
+ * @return true if messages are waiting and the window is open
+ */
+bool MqttClient::service() {
+    if (!m_mqttClient->connected()) {
+        m_connected.store(false, std::memory_order_relaxed);
+
+        // Blocks only this task (TCP connect, TLS handshake)
+        unsigned long now = millis();
+        if (now - m_lastReconnectAttempt > m_reconnectInterval) {
+            m_lastReconnectAttempt = now;
+            reconnect();
+            if (m_mqttClient->connected()) {
+                restartWindow();
+            }
+        }
+        m_connected.store(m_mqttClient->connected(), std::memory_order_relaxed);
+        return false;
+    }
+
+    // PubSubClient::loop() reads one packet per call
+    for (uint8_t i = 0; i <= MQTT_INFLIGHT_MAX && m_mqttClient->connected(); i++) {
+        m_mqttClient->loop();
+        if (m_tap.available() <= 0) {
+            break;
+        }
+    }
+    releaseAcked();
+
+    if (m_inflightCount > 0) {
+        const InflightEntry& oldest = m_inflight[m_inflightFirst];
+        if (!oldest.acked && (uint32_t)(millis() - oldest.sentAt) >= MQTT_INFLIGHT_TIMEOUT) {
+            LOG_WARN("MQTT Client: No PUBACK, reconnecting");
+            m_mqttClient->disconnect();
+            m_connected.store(false, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    // A message that fails stays queued and is sent after the reconnect
+    bool more = false;
+    for (uint8_t i = 0; i < MQTT_TASK_BURST; i++) {
+        if (m_inflightCount >= m_inflightWindow) {
+            break;
+        }
+        if (!sendNext()) {
+            break;
+        }
+        more = i + 1 == MQTT_TASK_BURST;
+    }
+    releaseAcked();
+
+    m_connected.store(m_mqttClient->connected(), std::memory_order_relaxed);
+
+    uint32_t dropped = m_outbox.getDroppedCount();
+    if (dropped != m_reportedDrops) {
+        LOG_WARN("MQTT Client: %u messages dropped, outbox full", dropped - m_reportedDrops);
+        m_reportedDrops = dropped;
+    }
+    return more;
+}
+
+/**
+ * Send the message at the send cursor and add it to the in-flight window
+ * @return false if there is none or the write failed
+ */
+bool MqttClient::sendNext() {
+    if (!m_outbox.peek(m_sendCursor, m_sending)) {
+        return false;
+    }
+
+    uint16_t packetId = 0;
+    bool sent;
+    if (m_sending.qos > 0) {
+        packetId = m_nextPacketId;
+        m_nextPacketId = m_nextPacketId == 0xFFFF ? 1 : m_nextPacketId + 1;
+        sent = writePublish(m_sending, packetId);
+    } else {
+        sent = m_mqttClient->publish(m_sending.topic, m_sending.payload, m_sending.length, m_sending.retained);
+    }
+
+    if (!sent) {
+        LOG_WARN("MQTT Client: Publish failed, message kept");
+        return false;
+    }
+
+    InflightEntry& entry = m_inflight[(m_inflightFirst + m_inflightCount) % MQTT_INFLIGHT_MAX];
+    entry.position = m_sending.position;
+    entry.next = m_sending.next;
+    entry.packetId = packetId;
+    entry.acked = packetId == 0;    // QoS 0 is done once written
+    entry.sentAt = millis();
+    m_inflightCount++;
+    m_sendCursor = m_sending.next;
+    return true;
+}
+
+/**
+ * Write a QoS 1 PUBLISH packet in one piece (PubSubClient only builds QoS 0)
+ */
+bool MqttClient::writePublish(const MqttOutboxMessage& message, uint16_t packetId) {
+    size_t topicLength = strlen(message.topic);
+    uint32_t remaining = 2 + topicLength + 2 + message.length;
+
+    size_t length = 0;
+    m_packet[length++] = MQTT_PUBLISH_QOS1 | (message.retained ? 1 : 0);
+    do {
+        uint8_t digit = remaining & 0x7F;
+        remaining >>= 7;
+        m_packet[length++] = remaining > 0 ? (digit | 0x80) : digit;
+    } while (remaining > 0);
+
+    m_packet[length++] = topicLength >> 8;
+    m_packet[length++] = topicLength & 0xFF;
+    memcpy(m_packet + length, message.topic, topicLength);
+    length += topicLength;
+    m_packet[length++] = packetId >> 8;
+    m_packet[length++] = packetId & 0xFF;
+    memcpy(m_packet + length, message.payload, message.length);
+    length += message.length;
+
+    // Through PubSubClient, so it counts as activity for the keepalive
+    return m_mqttClient->write(m_packet, length) == length;
+}
+
+/**
+ * Remove acknowledged messages from the front of the window and the outbox
+ */
+void MqttClient::releaseAcked() {
+    while (m_inflightCount > 0 && m_inflight[m_inflightFirst].acked) {
+        const InflightEntry& entry = m_inflight[m_inflightFirst];
+        m_outbox.release(entry.position, entry.next);
+        m_inflightFirst = (m_inflightFirst + 1) % MQTT_INFLIGHT_MAX;
+        m_inflightCount--;
+    }
+}
+
+/**
+ * After a reconnect: send the unacknowledged QoS 1 messages of the window
+ * again, oldest first, with their packet identifiers. Entries that are
+ * done (QoS 0 messages already written, QoS 1 messages the broker
+ * acknowledged) only wait for an older message to be released and are
+ * not repeated.
+ *
+ * DUP stays 0: PubSubClient connects with a clean session, so the broker
+ * discarded the old session and its packet identifiers, and the resend is
+ * a new delivery there rather than a duplicate of a PUBLISH it still
+ * holds (MQTT 3.1.1, 3.3.1.1 and 4.4).
+ */
+void MqttClient::restartWindow() {
+    uint32_t resent = 0;
+    for (uint8_t i = 0; i < m_inflightCount; i++) {
+        InflightEntry& entry = m_inflight[(m_inflightFirst + i) % MQTT_INFLIGHT_MAX];
+        if (entry.acked) {
+            continue;
+        }
+
+        // QoS 1 records are never dropped, so the record is still there
+        if (!m_outbox.peek(entry.position, m_sending) || m_sending.position != entry.position ||
+            !writePublish(m_sending, entry.packetId)) {
+            // Left unacknowledged; the next reconnect sends it again
+            LOG_WARN("MQTT Client: Resend failed");
+            m_mqttClient->disconnect();
+            break;
+        }
+        entry.sentAt = millis();
+        resent++;
+    }
+
+    if (resent > 0) {
+        m_retransmits.fetch_add(resent, std::memory_order_relaxed);
+        LOG_INFO("MQTT Client: %u unacknowledged messages sent again", resent);
+    }
+}
+
+#endif // MQTT_TASK
+
 String MqttClient::getLastError() {
     return m_lastError;
 }
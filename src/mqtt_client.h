@@ -4,6 +4,20 @@
  * Supports:
  * - Generic MQTT mode (user-configured broker)
  * - MyPVLog Direct mode (cloud broker with SSL)
+ *
+ * With MQTT_TASK (ESP32) the connection is handed to its own task after
+ * startup: publish() then only copies the message into the outbox and
+ * returns, the task connects, reconnects and sends. isConnected() reports
+ * the task's last view of the connection.
+ *
+ * The MQTT task also publishes at QoS 1, which PubSubClient cannot: it
+ * writes the PUBLISH packet itself (packet identifier 1-65535, in turn) and
+ * learns about the PUBACKs from MqttAckTap. Up to the in-flight window of
+ * messages go out before the first acknowledgement; a message leaves the
+ * outbox only once it and all before it are acknowledged. After a
+ * reconnect (clean session) everything unacknowledged is sent again, and a
+ * missing PUBACK (MQTT_INFLIGHT_TIMEOUT) forces that reconnect: delivery is
+ * at least once. Without the task (ESP8266) messages go out at QoS 0.
  */
 
 #ifndef MQTT_CLIENT_H
@@ -11,8 +25,23 @@
 
 #include <Arduino.h>
 #include <PubSubClient.h>
+#include "config.h"
 #include "config_manager.h"
 
+#ifdef MQTT_TASK
+    #include <atomic>
+    #include <freertos/FreeRTOS.h>
+    #include <freertos/task.h>
+    #include "mqtt_outbox.h"
+    #include "mqtt_ack_tap.h"
+
+    #define MQTT_INFLIGHT_MAX       16      // Largest window
+    #define MQTT_INFLIGHT_TIMEOUT   20000   // ms without PUBACK before reconnecting
+
+    // PUBLISH packet: fixed header, topic, packet identifier, payload
+    #define MQTT_PUBLISH_MAX_SIZE   (5 + 2 + MQTT_OUTBOX_MAX_TOPIC + 2 + MQTT_OUTBOX_MAX_PAYLOAD)
+#endif
+
 #ifdef ESP32
     #include <WiFi.h>
     #include <WiFiClientSecure.h>
@@ -35,9 +64,30 @@ public:
     bool isConnected();
     void loop();
 
+#ifdef MQTT_TASK
+    /**
+     * Hand connection handling and sending to the MQTT task (after begin()
+     * and the first connect(); subscribe before)
+     */
+    bool startTask();
+
+    /**
+     * QoS 1 messages sent ahead of the acknowledgements, 1-MQTT_INFLIGHT_MAX
+     * (before startTask())
+     */
+    void setInflightWindow(uint8_t window);
+
+    uint32_t getDroppedCount() const { return m_outbox.getDroppedCount(); }
+    uint32_t getRejectedCount() const { return m_outbox.getRejectedCount(); }
+    uint32_t getRefusedCount() const { return m_outbox.getRefusedCount(); }
+    uint32_t getRetransmitCount() const { return m_retransmits.load(std::memory_order_relaxed); }
+#endif
+
     // Publishing
     bool publish(const String& topic, const String& payload, bool retained = false);
     bool publish(const String& topic, const char* payload, bool retained = false);
+    bool publish(const char* topic, const char* payload, bool retained = false);
+    bool publish(const char* topic, const uint8_t* payload, size_t length, bool retained = false, uint8_t qos = 0);
 
     // Subscribing
     bool subscribe(const String& topic);
@@ -70,7 +120,44 @@ private:
     // Callback
     std::function<void(String topic, String payload)> m_messageCallback;
 
+#ifdef MQTT_TASK
+    // Sent, not yet released from the outbox (task-owned)
+    struct InflightEntry {
+        uint32_t position;              // Outbox record
+        uint32_t next;
+        uint16_t packetId;              // 0 for QoS 0
+        bool acked;
+        uint32_t sentAt;                // millis()
+    };
+
+    MqttAckTap m_tap;
+    MqttOutbox m_outbox;
+    MqttOutboxMessage m_sending;        // Task-owned copy of the message being sent
+    uint8_t m_packet[MQTT_PUBLISH_MAX_SIZE];
+    TaskHandle_t m_task;
+    std::atomic<bool> m_connected;      // Written by the task
+    uint32_t m_reportedDrops;
+
+    InflightEntry m_inflight[MQTT_INFLIGHT_MAX];
+    uint8_t m_inflightFirst;
+    uint8_t m_inflightCount;
+    uint8_t m_inflightWindow;
+    uint32_t m_sendCursor;              // Outbox position of the next message to send
+    uint16_t m_nextPacketId;
+    std::atomic<uint32_t> m_retransmits;
+
+    static void taskMain(void* context);
+    static void onAck(void* context, uint16_t packetId);
+    bool service();
+    bool sendNext();
+    bool writePublish(const MqttOutboxMessage& message, uint16_t packetId);
+    void releaseAcked();
+    void restartWindow();
+    bool enqueue(const char* topic, const uint8_t* payload, size_t length, bool retained, uint8_t qos);
+#endif
+
     // Internal methods
+    Client& transport(Client& client);
     void reconnect();
     static void staticCallback(char* topic, byte* payload, unsigned int length);
     void handleMessage(char* topic, byte* payload, unsigned int length);
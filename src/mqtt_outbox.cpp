@@ -0,0 +1,183 @@
+/**
+ * MQTT Outbox - Bounded lock-free queue of outgoing MQTT messages
+ */
+
+#include "mqtt_outbox.h"
+
+#define OUTBOX_MASK         (MQTT_OUTBOX_SIZE - 1)
+#define OUTBOX_WRAP_MARKER  0xFFFF
+#define OUTBOX_RETAINED     0x8000
+#define OUTBOX_QOS1         0x4000
+#define OUTBOX_LENGTH       0x3FFF
+
+static uint32_t alignRecord(uint32_t length) {
+    return (length + 3) & ~3u;
+}
+
+MqttOutbox::MqttOutbox()
+    : m_head(0)
+    , m_tail(0)
+    , m_dropped(0)
+    , m_rejected(0)
+    , m_refused(0)
+{
+}
+
+/**
+ * Bytes from position to the next record (the wrap marker spans the rest of the ring)
+ */
+uint32_t MqttOutbox::recordLength(uint32_t position) const {
+    uint16_t header[2];
+    memcpy(header, m_ring + (position & OUTBOX_MASK), sizeof(header));
+
+    if (header[0] == OUTBOX_WRAP_MARKER) {
+        return MQTT_OUTBOX_SIZE - (position & OUTBOX_MASK);
+    }
+    return alignRecord(MQTT_OUTBOX_RECORD_HEADER + header[0] + (header[1] & OUTBOX_LENGTH));
+}
+
+/**
+ * Drop the oldest record to make room (producer)
+ * @return false if the oldest record is QoS 1
+ */
+bool MqttOutbox::dropOldest(uint32_t head) {
+    uint32_t tail = m_tail.load(std::memory_order_acquire);
+    if (tail == head) {
+        return true;    // Emptied by the consumer meanwhile
+    }
+
+    // Records between tail and head were written by the producer itself and
+    // are intact; if the consumer releases this one first, the CAS just fails
+    uint16_t header[2];
+    memcpy(header, m_ring + (tail & OUTBOX_MASK), sizeof(header));
+    if (header[0] != OUTBOX_WRAP_MARKER && (header[1] & OUTBOX_QOS1)) {
+        return false;
+    }
+    if (m_tail.compare_exchange_strong(tail, tail + recordLength(tail), std::memory_order_acq_rel) &&
+        header[0] != OUTBOX_WRAP_MARKER) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+bool MqttOutbox::push(const char* topic, const uint8_t* payload, size_t length, bool retained, uint8_t qos) {
+    size_t topicLength = strlen(topic);
+    if (topicLength == 0 || topicLength > MQTT_OUTBOX_MAX_TOPIC || length > MQTT_OUTBOX_MAX_PAYLOAD) {
+        m_rejected.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    uint32_t head = m_head.load(std::memory_order_relaxed);
+    uint32_t offset = head & OUTBOX_MASK;
+    uint32_t size = alignRecord(MQTT_OUTBOX_RECORD_HEADER + topicLength + length);
+
+    // Records never wrap: skip the rest of the ring if the record does not fit
+    uint32_t padding = MQTT_OUTBOX_SIZE - offset < size ? MQTT_OUTBOX_SIZE - offset : 0;
+
+    // An empty ring always has room (static_assert in the header)
+    while (head + padding + size - m_tail.load(std::memory_order_acquire) > MQTT_OUTBOX_SIZE) {
+        if (!dropOldest(head)) {
+            m_refused.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+
+    if (padding > 0) {
+        const uint16_t marker = OUTBOX_WRAP_MARKER;
+        memcpy(m_ring + offset, &marker, sizeof(marker));
+        offset = 0;
+    }
+
+    const uint16_t header[2] = {
+        (uint16_t)topicLength,
+        (uint16_t)(length | (retained ? OUTBOX_RETAINED : 0) | (qos > 0 ? OUTBOX_QOS1 : 0))
+    };
+    memcpy(m_ring + offset, header, sizeof(header));
+    memcpy(m_ring + offset + MQTT_OUTBOX_RECORD_HEADER, topic, topicLength);
+    memcpy(m_ring + offset + MQTT_OUTBOX_RECORD_HEADER + topicLength, payload, length);
+
+    // Publish the record only after it is complete
+    m_head.store(head + padding + size, std::memory_order_release);
+    return true;
+}
+
+bool MqttOutbox::peek(uint32_t position, MqttOutboxMessage& message) {
+    for (;;) {
+        // Records before the tail may be overwritten already
+        uint32_t tail = m_tail.load(std::memory_order_acquire);
+        if ((int32_t)(position - tail) < 0) {
+            position = tail;
+        }
+        if (position == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        uint32_t offset = position & OUTBOX_MASK;
+        uint16_t header[2];
+        memcpy(header, m_ring + offset, sizeof(header));
+
+        if (header[0] == OUTBOX_WRAP_MARKER) {
+            // Follow the marker only if it was not overwritten meanwhile
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if ((int32_t)(position - m_tail.load(std::memory_order_relaxed)) >= 0) {
+                position += MQTT_OUTBOX_SIZE - offset;
+            }
+            continue;
+        }
+
+        // The lengths may be torn if the producer is overwriting this record;
+        // clamp them for the copy, the tail check below rejects it anyway
+        uint16_t topicLength = header[0] <= MQTT_OUTBOX_MAX_TOPIC ? header[0] : MQTT_OUTBOX_MAX_TOPIC;
+        uint16_t length = header[1] & OUTBOX_LENGTH;
+        if (length > MQTT_OUTBOX_MAX_PAYLOAD) {
+            length = MQTT_OUTBOX_MAX_PAYLOAD;
+        }
+        if (offset + MQTT_OUTBOX_RECORD_HEADER + topicLength + length > MQTT_OUTBOX_SIZE) {
+            continue;
+        }
+
+        memcpy(message.topic, m_ring + offset + MQTT_OUTBOX_RECORD_HEADER, topicLength);
+        message.topic[topicLength] = '\0';
+        memcpy(message.payload, m_ring + offset + MQTT_OUTBOX_RECORD_HEADER + topicLength, length);
+
+        // The copy counts only if the producer did not drop the record meanwhile
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if ((int32_t)(position - m_tail.load(std::memory_order_relaxed)) < 0) {
+            continue;
+        }
+
+        message.length = length;
+        message.retained = (header[1] & OUTBOX_RETAINED) != 0;
+        message.qos = (header[1] & OUTBOX_QOS1) ? 1 : 0;
+        message.position = position;
+        message.next = position + alignRecord(MQTT_OUTBOX_RECORD_HEADER + topicLength + length);
+        return true;
+    }
+}
+
+bool MqttOutbox::release(uint32_t position, uint32_t next) {
+    for (;;) {
+        uint32_t tail = m_tail.load(std::memory_order_acquire);
+        if ((int32_t)(next - tail) <= 0) {
+            return true;    // QoS 0, dropped by the producer meanwhile
+        }
+        if (tail == position) {
+            if (m_tail.compare_exchange_strong(tail, next, std::memory_order_acq_rel)) {
+                return true;
+            }
+            continue;
+        }
+
+        // peek() skipped a wrap marker in front of the record
+        uint16_t topicLength;
+        memcpy(&topicLength, m_ring + (tail & OUTBOX_MASK), sizeof(topicLength));
+        if (topicLength != OUTBOX_WRAP_MARKER || tail + recordLength(tail) != position) {
+            return false;
+        }
+        m_tail.compare_exchange_strong(tail, position, std::memory_order_acq_rel);
+    }
+}
+
+bool MqttOutbox::isEmpty() const {
+    return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_acquire);
+}
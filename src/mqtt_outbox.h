@@ -0,0 +1,122 @@
+/**
+ * MQTT Outbox - Bounded lock-free queue of outgoing MQTT messages
+ *
+ * Hands preformatted messages (topic, payload, retained flag, QoS) from
+ * loop() to the MQTT task, which owns the network connection. Exactly one
+ * producer (loop()) and one consumer (the MQTT task).
+ *
+ * Messages are stored back to back in a byte ring, so small per-field
+ * messages and large batches share the same memory:
+ *   record:  topic length (uint16),
+ *            payload length | retained << 15 | QoS 1 << 14 (uint16),
+ *            topic, payload, padding to 4 bytes
+ * A record never wraps; the space left at the end of the ring is filled
+ * with a wrap marker (topic length 0xFFFF) instead.
+ *
+ * The consumer reads ahead of the tail: it sends the messages at its own
+ * cursor and releases them (moves the tail) only once they are delivered,
+ * for QoS 1 when the broker acknowledged them. Records between the tail and
+ * the cursor are the in-flight window, kept for a resend after reconnect.
+ *
+ * When the ring is full the producer drops the oldest QoS 0 messages
+ * (drop-oldest: fresh telemetry matters more than stale). Both sides
+ * therefore advance the tail, each with a compare-and-swap. The consumer
+ * copies a message out and checks that the tail did not pass it meanwhile
+ * (the copy could be torn otherwise). QoS 1 messages are never dropped:
+ * while one is the oldest, push() refuses new messages instead, and the
+ * caller keeps them elsewhere (the telemetry spool).
+ * Neither side ever blocks or waits for the other.
+ */
+
+#ifndef MQTT_OUTBOX_H
+#define MQTT_OUTBOX_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+
+#ifndef MQTT_OUTBOX_SIZE
+  #define MQTT_OUTBOX_SIZE          8192    // Bytes, power of two
+#endif
+
+#define MQTT_OUTBOX_MAX_TOPIC       127
+
+// Largest message, same as the batch buffer (INVERTER_PUBLISHER_BATCH_SIZE)
+#ifndef MQTT_OUTBOX_MAX_PAYLOAD
+  #ifdef ESP8266
+    #define MQTT_OUTBOX_MAX_PAYLOAD 768
+  #else
+    #define MQTT_OUTBOX_MAX_PAYLOAD 1536
+  #endif
+#endif
+
+#define MQTT_OUTBOX_RECORD_HEADER   4
+
+static_assert((MQTT_OUTBOX_SIZE & (MQTT_OUTBOX_SIZE - 1)) == 0, "MQTT_OUTBOX_SIZE must be a power of two");
+static_assert(MQTT_OUTBOX_MAX_PAYLOAD < 0x4000, "Payload length shares its field with the retained and QoS flags");
+static_assert(2 * (MQTT_OUTBOX_RECORD_HEADER + MQTT_OUTBOX_MAX_TOPIC + MQTT_OUTBOX_MAX_PAYLOAD + 3) <= MQTT_OUTBOX_SIZE,
+              "MQTT_OUTBOX_SIZE too small for two of the largest messages");
+
+/**
+ * A message as copied out by the consumer
+ */
+struct MqttOutboxMessage {
+    char topic[MQTT_OUTBOX_MAX_TOPIC + 1];
+    uint8_t payload[MQTT_OUTBOX_MAX_PAYLOAD];
+    uint16_t length;
+    bool retained;
+    uint8_t qos;            // 0 or 1
+
+    uint32_t position;      // Ring position of the record, for release()
+    uint32_t next;          // Position after it, the next peek()
+};
+
+class MqttOutbox {
+public:
+    MqttOutbox();
+
+    /**
+     * Queue a message, dropping the oldest QoS 0 ones if there is no room
+     * (producer only)
+     * @return false if the message is too large, or there is no room left
+     *         in front of an unacknowledged QoS 1 message
+     */
+    bool push(const char* topic, const uint8_t* payload, size_t length, bool retained, uint8_t qos = 0);
+
+    /**
+     * Position of the oldest message, where sending starts (consumer only)
+     */
+    uint32_t front() const { return m_tail.load(std::memory_order_acquire); }
+
+    /**
+     * Copy the message at position, or the oldest one if it was dropped
+     * (consumer only)
+     * @return false if there is no message at or after position
+     */
+    bool peek(uint32_t position, MqttOutboxMessage& message);
+
+    /**
+     * Remove the oldest message once it was delivered (consumer only)
+     * @return false if it is not the oldest message
+     */
+    bool release(uint32_t position, uint32_t next);
+
+    bool isEmpty() const;
+    uint32_t getDroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }    // Overflow, oldest first
+    uint32_t getRejectedCount() const { return m_rejected.load(std::memory_order_relaxed); }  // Too large to queue
+    uint32_t getRefusedCount() const { return m_refused.load(std::memory_order_relaxed); }    // No room, QoS 1 pending
+
+private:
+    alignas(4) uint8_t m_ring[MQTT_OUTBOX_SIZE];
+
+    std::atomic<uint32_t> m_head;   // Written by the producer only
+    std::atomic<uint32_t> m_tail;   // Compare-and-swap by both sides
+    std::atomic<uint32_t> m_dropped;
+    std::atomic<uint32_t> m_rejected;
+    std::atomic<uint32_t> m_refused;
+
+    uint32_t recordLength(uint32_t position) const;
+    bool dropOldest(uint32_t head);
+};
+
+#endif // MQTT_OUTBOX_H
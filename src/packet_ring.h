@@ -0,0 +1,84 @@
+/**
+ * Packet Ring - Fixed-size lock-free ring of radio packet buffers
+ *
+ * Single-producer / single-consumer: the radio RX drain writes into the
+ * ring (the RX task woken by the radio interrupt on ESP32, otherwise
+ * loop()), the protocol layer reads from it. No heap use, no locks; head
+ * and tail are only ever written by one side each.
+ */
+
+#ifndef PACKET_RING_H
+#define PACKET_RING_H
+
+#include <Arduino.h>
+#include <atomic>
+
+template <uint8_t SLOT_SIZE, uint8_t SLOT_COUNT>
+class PacketRing {
+    static_assert((SLOT_COUNT & (SLOT_COUNT - 1)) == 0, "SLOT_COUNT must be a power of two");
+
+public:
+    struct Slot {
+        uint8_t length;
+        uint8_t data[SLOT_SIZE];
+    };
+
+    PacketRing() : m_head(0), m_tail(0), m_dropped(0) {}
+
+    /**
+     * Producer: get the next free slot to fill in place
+     * @return Free slot, or nullptr if the ring is full
+     */
+    Slot* reserve() {
+        uint8_t head = m_head.load(std::memory_order_relaxed);
+        if ((uint8_t)(head - m_tail.load(std::memory_order_acquire)) >= SLOT_COUNT) {
+            m_dropped++;
+            return nullptr;
+        }
+        return &m_slots[head & (SLOT_COUNT - 1)];
+    }
+
+    /**
+     * Producer: publish the slot returned by reserve()
+     */
+    void commit() {
+        m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * Consumer: oldest unread packet
+     * @return Slot, or nullptr if the ring is empty
+     */
+    const Slot* peek() const {
+        uint8_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail == m_head.load(std::memory_order_acquire)) {
+            return nullptr;
+        }
+        return &m_slots[tail & (SLOT_COUNT - 1)];
+    }
+
+    /**
+     * Consumer: release the slot returned by peek()
+     */
+    void pop() {
+        m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    /**
+     * Consumer: discard all unread packets
+     */
+    void clear() {
+        m_tail.store(m_head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    bool empty() const { return peek() == nullptr; }
+    uint32_t getDroppedCount() const { return m_dropped; }
+
+private:
+    Slot m_slots[SLOT_COUNT];
+    std::atomic<uint8_t> m_head;
+    std::atomic<uint8_t> m_tail;
+    uint32_t m_dropped;
+};
+
+#endif // PACKET_RING_H
@@ -0,0 +1,161 @@
+/**
+ * Rollup Engine - Running aggregates over wall-clock windows
+ */
+
+#include "rollup_engine.h"
+#include "logger.h"
+#include <time.h>
+
+#define ROLLUP_CHECK_INTERVAL   1000    // ms between loop() checks
+
+RollupEngine::RollupEngine()
+    : m_windowCount(0)
+    , m_inverterCount(0)
+    , m_subscriberCount(0)
+    , m_lastCheck(0)
+{
+}
+
+bool RollupEngine::addWindow(uint32_t seconds) {
+    if (seconds == 0 || m_windowCount >= ROLLUP_MAX_WINDOWS) {
+        return false;
+    }
+    m_windows[m_windowCount++] = seconds;
+    return true;
+}
+
+bool RollupEngine::subscribe(RollupCallback callback, void* context) {
+    if (!callback || m_subscriberCount >= ROLLUP_MAX_SUBSCRIBERS) {
+        return false;
+    }
+    m_subscribers[m_subscriberCount].callback = callback;
+    m_subscribers[m_subscriberCount].context = context;
+    m_subscriberCount++;
+    return true;
+}
+
+/**
+ * @return false while SNTP has not set the clock yet
+ */
+bool RollupEngine::wallClock(uint32_t& now) {
+    time_t t = time(nullptr);
+    if (t < NTP_VALID_AFTER) {
+        return false;
+    }
+    now = (uint32_t)t;
+    return true;
+}
+
+/**
+ * Row of an inverter in the slot table, added on its first sample
+ * @return Row, or -1 if the table is full
+ */
+int RollupEngine::indexOf(uint64_t serial) {
+    for (uint8_t i = 0; i < m_inverterCount; i++) {
+        if (m_serials[i] == serial) {
+            return i;
+        }
+    }
+
+    if (m_inverterCount >= ROLLUP_MAX_INVERTERS) {
+        return -1;
+    }
+
+    m_serials[m_inverterCount] = serial;
+    for (uint8_t w = 0; w < ROLLUP_MAX_WINDOWS; w++) {
+        m_slots[m_inverterCount][w].open = false;
+        m_slots[m_inverterCount][w].closedEnd = 0;
+    }
+    return m_inverterCount++;
+}
+
+void RollupEngine::update(const InverterSample& sample) {
+    uint32_t now;
+    if (m_windowCount == 0 || !wallClock(now)) {
+        return;
+    }
+
+    int row = indexOf(sample.serial);
+    if (row < 0) {
+        LOG_ERROR("Rollup Engine: inverter table full");
+        return;
+    }
+
+    // Samples may have waited in the radio queue; place them by capture time
+    uint32_t time = now - (uint32_t)(millis() - sample.timestamp) / 1000;
+
+    const int32_t values[ROLLUP_QUANTITY_COUNT] = {
+        sample.getPower(),
+        sample.getVoltage(),
+        sample.getDcCurrent(),
+        sample.getTemperature()
+    };
+
+    for (uint8_t w = 0; w < m_windowCount; w++) {
+        Slot& slot = m_slots[row][w];
+        uint32_t period = m_windows[w];
+        uint32_t start = time - time % period;
+
+        if (time < slot.closedEnd || (slot.open && start < slot.rollup.start)) {
+            continue;   // Window already closed
+        }
+        if (slot.open && start != slot.rollup.start) {
+            close(slot);
+        }
+
+        Rollup& rollup = slot.rollup;
+        if (!slot.open) {
+            rollup.serial = sample.serial;
+            rollup.start = start;
+            rollup.period = period;
+            rollup.count = 0;
+            for (uint8_t q = 0; q < ROLLUP_QUANTITY_COUNT; q++) {
+                rollup.values[q] = { values[q], values[q], values[q], 0 };
+            }
+            slot.open = true;
+        }
+
+        for (uint8_t q = 0; q < ROLLUP_QUANTITY_COUNT; q++) {
+            RollupStat& stat = rollup.values[q];
+            if (values[q] < stat.min) {
+                stat.min = values[q];
+            }
+            if (values[q] > stat.max) {
+                stat.max = values[q];
+            }
+            stat.last = values[q];
+            stat.sum += values[q];
+        }
+        rollup.count++;
+    }
+}
+
+void RollupEngine::loop() {
+    uint32_t ms = millis();
+    if ((uint32_t)(ms - m_lastCheck) < ROLLUP_CHECK_INTERVAL) {
+        return;
+    }
+    m_lastCheck = ms;
+
+    uint32_t now;
+    if (!wallClock(now)) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < m_inverterCount; i++) {
+        for (uint8_t w = 0; w < m_windowCount; w++) {
+            Slot& slot = m_slots[i][w];
+            if (slot.open && now >= slot.rollup.start + slot.rollup.period + ROLLUP_CLOSE_DELAY) {
+                close(slot);
+            }
+        }
+    }
+}
+
+void RollupEngine::close(Slot& slot) {
+    slot.open = false;
+    slot.closedEnd = slot.rollup.start + slot.rollup.period;
+    for (uint8_t i = 0; i < m_subscriberCount; i++) {
+        m_subscribers[i].callback(m_subscribers[i].context, slot.rollup);
+    }
+}
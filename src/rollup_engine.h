@@ -0,0 +1,155 @@
+/**
+ * Rollup Engine - Running aggregates over wall-clock windows
+ *
+ * For each inverter and each configured window (e.g. 1 and 15 minutes)
+ * the engine keeps min, max, sum and last of the AC power, AC voltage, DC
+ * current and temperature, updated in O(1) per sample without storing the
+ * samples. Windows are aligned to Unix time (a 15-minute window covers
+ * hh:00-hh:15, hh:15-hh:30, ...), so rollups of different inverters and
+ * devices line up.
+ *
+ * A window is closed, and its rollup handed to the subscribers, when the
+ * first sample of a later window arrives, or from loop() once the window
+ * ended ROLLUP_CLOSE_DELAY ago (inverter stopped answering, last window of
+ * the day). Samples that arrive after their window was closed are left out.
+ *
+ * The wall clock comes from SNTP (NTP_SERVER). Until it is synchronized
+ * (NTP_VALID_AFTER) samples are not aggregated.
+ *
+ * update() and loop() run in loop(), as do the subscribers.
+ */
+
+#ifndef ROLLUP_ENGINE_H
+#define ROLLUP_ENGINE_H
+
+#include <Arduino.h>
+#include "config.h"
+#include "inverter_sample.h"
+
+#ifndef ROLLUP_WINDOW_SHORT
+  #define ROLLUP_WINDOW_SHORT       60      // s
+#endif
+
+#ifndef ROLLUP_WINDOW_LONG
+  #define ROLLUP_WINDOW_LONG        900     // s
+#endif
+
+#define ROLLUP_MAX_WINDOWS          2
+#define ROLLUP_MAX_SUBSCRIBERS      2
+#define ROLLUP_CLOSE_DELAY          5       // s after the window end, for the last poll's response
+
+// HM and HMS inverters are aggregated together on dual-radio builds
+#if defined(RADIO_NRF24) && defined(RADIO_CMT2300A)
+  #define ROLLUP_MAX_INVERTERS      (2 * HOYMILES_MAX_INVERTERS)
+#else
+  #define ROLLUP_MAX_INVERTERS      HOYMILES_MAX_INVERTERS
+#endif
+
+enum RollupQuantity : uint8_t {
+    ROLLUP_POWER,           // AC, 0.1 W
+    ROLLUP_VOLTAGE,         // AC, 0.1 V
+    ROLLUP_CURRENT,         // DC total, 0.01 A
+    ROLLUP_TEMPERATURE,     // 0.1 °C
+    ROLLUP_QUANTITY_COUNT
+};
+
+// Fixed-point scale of each quantity, by RollupQuantity
+static constexpr HoymilesField ROLLUP_FIELDS[ROLLUP_QUANTITY_COUNT] = {
+    FIELD_POWER,
+    FIELD_VOLTAGE,
+    FIELD_CURRENT,
+    FIELD_TEMPERATURE
+};
+
+struct RollupStat {
+    int32_t min;
+    int32_t max;
+    int32_t last;
+    int64_t sum;
+};
+
+/**
+ * Aggregates of one inverter over one window
+ */
+struct Rollup {
+    uint64_t serial;
+    uint32_t start;         // Unix time of the window start
+    uint32_t period;        // Window length, s
+    uint32_t count;         // Samples in the window
+    RollupStat values[ROLLUP_QUANTITY_COUNT];
+
+    /**
+     * Mean of a quantity, rounded to its fixed-point unit
+     */
+    int32_t mean(RollupQuantity quantity) const {
+        if (count == 0) {
+            return 0;
+        }
+        int64_t sum = values[quantity].sum;
+        int64_t half = count / 2;
+        return (int32_t)((sum < 0 ? sum - half : sum + half) / (int64_t)count);
+    }
+};
+
+/**
+ * Subscriber: plain function plus an opaque context, like InverterSampleCallback
+ */
+typedef void (*RollupCallback)(void* context, const Rollup& rollup);
+
+class RollupEngine {
+public:
+    RollupEngine();
+
+    /**
+     * Add a window (call before the first sample)
+     * @return false if all window slots are taken or the length is 0
+     */
+    bool addWindow(uint32_t seconds);
+
+    /**
+     * @return false if all subscriber slots are taken
+     */
+    bool subscribe(RollupCallback callback, void* context = nullptr);
+
+    /**
+     * Add one sample to the open windows of its inverter
+     */
+    void update(const InverterSample& sample);
+
+    /**
+     * Close windows that ended without a sample of a later window
+     */
+    void loop();
+
+    uint8_t getWindowCount() const { return m_windowCount; }
+
+private:
+    struct Slot {
+        Rollup rollup;
+        bool open;
+        uint32_t closedEnd;     // End of the last closed window, later samples only
+    };
+
+    struct Subscriber {
+        RollupCallback callback;
+        void* context;
+    };
+
+    uint32_t m_windows[ROLLUP_MAX_WINDOWS];
+    uint8_t m_windowCount;
+
+    uint64_t m_serials[ROLLUP_MAX_INVERTERS];
+    Slot m_slots[ROLLUP_MAX_INVERTERS][ROLLUP_MAX_WINDOWS];
+    uint8_t m_inverterCount;
+
+    Subscriber m_subscribers[ROLLUP_MAX_SUBSCRIBERS];
+    uint8_t m_subscriberCount;
+
+    uint32_t m_lastCheck;   // millis() of the last loop() check
+
+    int indexOf(uint64_t serial);
+    void close(Slot& slot);
+    static bool wallClock(uint32_t& now);
+};
+
+#endif // ROLLUP_ENGINE_H
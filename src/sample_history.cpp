@@ -0,0 +1,194 @@
+/**
+ * Sample History - Ring of past inverter samples at poll resolution
+ */
+
+#include "sample_history.h"
+
+#ifdef BOARD_HAS_PSRAM
+#include <esp_heap_caps.h>
+#endif
+
+static uint16_t clampU16(int32_t value) {
+    return value < 0 ? 0 : value > 0xFFFF ? 0xFFFF : (uint16_t)value;
+}
+
+SampleHistory::SampleHistory()
+    : m_capacity(0)
+    , m_mask(0)
+    , m_head(0)
+    , m_time(nullptr)
+    , m_serial(nullptr)
+    , m_serialHigh(nullptr)
+    , m_power(nullptr)
+    , m_voltage(nullptr)
+    , m_current(nullptr)
+    , m_temperature(nullptr)
+    , m_yieldDay(nullptr)
+{
+#ifndef BOARD_HAS_PSRAM
+    m_capacity = SAMPLE_HISTORY_CAPACITY;
+    m_mask = SAMPLE_HISTORY_CAPACITY - 1;
+    m_time = m_storage.time;
+    m_serial = m_storage.serial;
+    m_serialHigh = m_storage.serialHigh;
+    m_power = m_storage.power;
+    m_voltage = m_storage.voltage;
+    m_current = m_storage.current;
+    m_temperature = m_storage.temperature;
+    m_yieldDay = m_storage.yieldDay;
+#endif
+}
+
+bool SampleHistory::begin(uint32_t maxCapacity) {
+#ifdef BOARD_HAS_PSRAM
+    if (m_capacity > 0) {
+        return true;
+    }
+    if (maxCapacity == 0) {
+        maxCapacity = SAMPLE_HISTORY_PSRAM_CAPACITY;
+    }
+
+    // Largest power-of-two ring the free PSRAM can hold
+    for (uint32_t capacity = maxCapacity; capacity >= SAMPLE_HISTORY_MIN_CAPACITY; capacity >>= 1) {
+        void* arrays[8] = {
+            heap_caps_malloc(capacity * sizeof(uint32_t), MALLOC_CAP_SPIRAM),
+            heap_caps_malloc(capacity * sizeof(uint32_t), MALLOC_CAP_SPIRAM),
+            heap_caps_malloc(capacity * sizeof(uint16_t), MALLOC_CAP_SPIRAM),
+            heap_caps_malloc(capacity * sizeof(int32_t), MALLOC_CAP_SPIRAM),
+            heap_caps_malloc(capacity * sizeof(uint16_t), MALLOC_CAP_SPIRAM),
+            heap_caps_malloc(capacity * sizeof(uint16_t), MALLOC_CAP_SPIRAM),
+            heap_caps_malloc(capacity * sizeof(int16_t), MALLOC_CAP_SPIRAM),
+            heap_caps_malloc(capacity * sizeof(uint32_t), MALLOC_CAP_SPIRAM)
+        };
+
+        bool complete = true;
+        for (void* array : arrays) {
+            complete = complete && array != nullptr;
+        }
+        if (!complete) {
+            for (void* array : arrays) {
+                heap_caps_free(array);
+            }
+            continue;
+        }
+
+        m_time = (uint32_t*)arrays[0];
+        m_serial = (uint32_t*)arrays[1];
+        m_serialHigh = (uint16_t*)arrays[2];
+        m_power = (int32_t*)arrays[3];
+        m_voltage = (uint16_t*)arrays[4];
+        m_current = (uint16_t*)arrays[5];
+        m_temperature = (int16_t*)arrays[6];
+        m_yieldDay = (uint32_t*)arrays[7];
+        m_mask = capacity - 1;
+        m_capacity = capacity;
+
+        DEBUG_PRINT("Sample History: ");
+        DEBUG_PRINT(capacity);
+        DEBUG_PRINTLN(" records in PSRAM");
+        return true;
+    }
+
+    DEBUG_PRINTLN("Sample History: ERROR - no PSRAM available");
+    return false;
+#else
+    (void)maxCapacity;
+    return true;
+#endif
+}
+
+void SampleHistory::record(const InverterSample& sample) {
+    if (m_capacity == 0) {
+        return;
+    }
+
+    SampleHistoryRecord record;
+    record.time = sample.timestamp;
+    record.serial = sample.serial;
+    record.power = sample.getPower();
+    record.voltage = clampU16(sample.getVoltage());
+    record.current = clampU16(sample.getDcCurrent());
+    record.temperature = (int16_t)sample.getTemperature();
+    record.yieldDay = (uint32_t)sample.getYieldDay();
+    append(record);
+}
+
+void SampleHistory::append(const SampleHistoryRecord& record) {
+    if (m_capacity == 0) {
+        return;
+    }
+
+    uint32_t head = m_head.load(std::memory_order_relaxed);
+    uint32_t slot = head & m_mask;
+
+    m_time[slot] = record.time;
+    m_serial[slot] = (uint32_t)(record.serial & 0xFFFFFFFF);
+    m_serialHigh[slot] = (uint16_t)(record.serial >> 32);
+    m_power[slot] = record.power;
+    m_voltage[slot] = record.voltage;
+    m_current[slot] = record.current;
+    m_temperature[slot] = record.temperature;
+    m_yieldDay[slot] = record.yieldDay;
+
+    // Publish the slot only after it is complete
+    m_head.store(head + 1, std::memory_order_release);
+}
+
+void SampleHistory::onSample(void* context, const InverterSample& sample) {
+    static_cast<SampleHistory*>(context)->record(sample);
+}
+
+uint32_t SampleHistory::getCount() const {
+    uint32_t head = m_head.load(std::memory_order_acquire);
+    return m_capacity > 0 ? head - oldest(head) : 0;
+}
+
+SampleHistoryCursor SampleHistory::snapshot(uint32_t maxRecords) const {
+    uint32_t head = m_head.load(std::memory_order_acquire);
+    if (m_capacity == 0) {
+        return { head, head, 0 };
+    }
+
+    uint32_t first = oldest(head);
+    if (head - first > maxRecords) {
+        first = head - maxRecords;
+    }
+    return { first, head, 0 };
+}
+
+void SampleHistory::refresh(SampleHistoryCursor& cursor) const {
+    cursor.end = m_head.load(std::memory_order_acquire);
+}
+
+bool SampleHistory::read(SampleHistoryCursor& cursor, SampleHistoryRecord& record) const {
+    while (cursor.next < cursor.end) {
+        uint32_t index = cursor.next;
+
+        uint32_t first = oldest(m_head.load(std::memory_order_acquire));
+        if (index < first) {
+            uint32_t resume = first < cursor.end ? first : cursor.end;
+            cursor.skipped += resume - index;
+            cursor.next = resume;
+            continue;
+        }
+
+        uint32_t slot = index & m_mask;
+        record.time = m_time[slot];
+        record.serial = ((uint64_t)m_serialHigh[slot] << 32) | m_serial[slot];
+        record.power = m_power[slot];
+        record.voltage = m_voltage[slot];
+        record.current = m_current[slot];
+        record.temperature = m_temperature[slot];
+        record.yieldDay = m_yieldDay[slot];
+
+        // The copy counts only if the writer did not reach the slot meanwhile
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (index < oldest(m_head.load(std::memory_order_relaxed))) {
+            continue;
+        }
+
+        cursor.next = index + 1;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,147 @@
+/**
+ * Sample History - Ring of past inverter samples at poll resolution
+ *
+ * Stored as a struct of arrays: one array per value, so a consumer that
+ * only needs power over time touches only the time and power arrays, and
+ * no per-record padding is spent. On boards with PSRAM (BOARD_HAS_PSRAM)
+ * the arrays are allocated there at startup, as large as the free PSRAM
+ * allows up to SAMPLE_HISTORY_PSRAM_CAPACITY records (days of history).
+ * Other boards use a small ring in internal RAM sized at compile time.
+ *
+ * Each ring has exactly one writer (the subscriber of one radio driver,
+ * i.e. one radio task) and takes no lock: the writer fills a slot and then
+ * publishes it by advancing the head with a release store. Readers take a
+ * snapshot cursor (the head at that moment) and copy records out. A copy
+ * is valid if the writer has not reached the slot again by the time the
+ * copy is done; otherwise the cursor skips ahead to the oldest record
+ * still present, so readers never block the radio task and never see a
+ * torn record.
+ */
+
+#ifndef SAMPLE_HISTORY_H
+#define SAMPLE_HISTORY_H
+
+#include <Arduino.h>
+#include <atomic>
+#include "config.h"
+#include "inverter_sample.h"
+
+#ifdef BOARD_HAS_PSRAM
+  #ifndef SAMPLE_HISTORY_PSRAM_CAPACITY
+    #define SAMPLE_HISTORY_PSRAM_CAPACITY   131072  // Records per ring, 24 B each (3.1 MB)
+  #endif
+  #define SAMPLE_HISTORY_MIN_CAPACITY       1024    // Smallest PSRAM ring before giving up
+#else
+  #ifndef SAMPLE_HISTORY_CAPACITY
+    #ifdef ESP8266
+      #define SAMPLE_HISTORY_CAPACITY       128
+    #else
+      #define SAMPLE_HISTORY_CAPACITY       512
+    #endif
+  #endif
+#endif
+
+/**
+ * One history entry, as copied out by a reader
+ */
+struct SampleHistoryRecord {
+    uint32_t time;          // millis() of the sample (rollups: Unix time of the window start)
+    uint64_t serial;        // Inverter serial (48 bits)
+    int32_t power;          // AC, 0.1 W
+    uint16_t voltage;       // AC, 0.1 V
+    uint16_t current;       // DC total, 0.01 A
+    int16_t temperature;    // 0.1 °C
+    uint32_t yieldDay;      // Wh (rollups: 0)
+};
+
+/**
+ * Read position of one consumer; records [next, end) are in its snapshot
+ */
+struct SampleHistoryCursor {
+    uint32_t next;
+    uint32_t end;
+    uint32_t skipped;       // Records overwritten before they could be read
+};
+
+class SampleHistory {
+public:
+    SampleHistory();
+
+    /**
+     * Allocate the ring (PSRAM builds)
+     * @param maxCapacity Upper bound of the PSRAM ring in records, a power of
+     *                    two (0 = SAMPLE_HISTORY_PSRAM_CAPACITY)
+     * @return false if no memory could be allocated
+     */
+    bool begin(uint32_t maxCapacity = 0);
+
+    /**
+     * Append a sample (the ring's single writer only)
+     */
+    void record(const InverterSample& sample);
+
+    /**
+     * Append a prepared record, e.g. a rollup (the ring's single writer only)
+     */
+    void append(const SampleHistoryRecord& record);
+
+    /**
+     * InverterSampleCallback adapter, context = SampleHistory*
+     */
+    static void onSample(void* context, const InverterSample& sample);
+
+    /**
+     * Cursor over everything currently stored, or the newest maxRecords
+     */
+    SampleHistoryCursor snapshot(uint32_t maxRecords = 0xFFFFFFFF) const;
+
+    /**
+     * Extend a cursor to the records written since it was taken
+     */
+    void refresh(SampleHistoryCursor& cursor) const;
+
+    /**
+     * Copy the next record of the cursor
+     * @return false when the cursor is exhausted
+     */
+    bool read(SampleHistoryCursor& cursor, SampleHistoryRecord& record) const;
+
+    uint32_t getCapacity() const { return m_capacity; }
+    uint32_t getCount() const;
+
+private:
+    uint32_t m_capacity;    // Power of two
+    uint32_t m_mask;
+    std::atomic<uint32_t> m_head;   // Records written so far
+
+    uint32_t* m_time;
+    uint32_t* m_serial;             // Serial bits 0..31
+    uint16_t* m_serialHigh;         // Serial bits 32..47
+    int32_t* m_power;
+    uint16_t* m_voltage;
+    uint16_t* m_current;
+    int16_t* m_temperature;
+    uint32_t* m_yieldDay;
+
+#ifndef BOARD_HAS_PSRAM
+    static_assert((SAMPLE_HISTORY_CAPACITY & (SAMPLE_HISTORY_CAPACITY - 1)) == 0,
+                  "SAMPLE_HISTORY_CAPACITY must be a power of two");
+
+    struct Storage {
+        uint32_t time[SAMPLE_HISTORY_CAPACITY];
+        uint32_t serial[SAMPLE_HISTORY_CAPACITY];
+        uint16_t serialHigh[SAMPLE_HISTORY_CAPACITY];
+        int32_t power[SAMPLE_HISTORY_CAPACITY];
+        uint16_t voltage[SAMPLE_HISTORY_CAPACITY];
+        uint16_t current[SAMPLE_HISTORY_CAPACITY];
+        int16_t temperature[SAMPLE_HISTORY_CAPACITY];
+        uint32_t yieldDay[SAMPLE_HISTORY_CAPACITY];
+    };
+    Storage m_storage;
+#endif
+
+    // Record 'head' may be in progress and shares its slot with head - capacity
+    uint32_t oldest(uint32_t head) const { return head >= m_capacity ? head - m_capacity + 1 : 0; }
+};
+
+#endif // SAMPLE_HISTORY_H
@@ -0,0 +1,32 @@
+/**
+ * SPI Arbiter - Shared SPI bus between the NRF24 and CMT2300A radios
+ */
+
+#include "spi_arbiter.h"
+
+#if defined(HOYMILES_RADIO_TASKS) || defined(HOYMILES_RX_TASK)
+
+SemaphoreHandle_t SpiArbiter::s_mutex = nullptr;
+
+void SpiArbiter::begin() {
+    if (!s_mutex) {
+        s_mutex = xSemaphoreCreateMutex();
+    }
+}
+
+/**
+ * Before begin() there is only the setup task, so the bus is not locked
+ */
+void SpiArbiter::lock() {
+    if (s_mutex) {
+        xSemaphoreTake(s_mutex, portMAX_DELAY);
+    }
+}
+
+void SpiArbiter::unlock() {
+    if (s_mutex) {
+        xSemaphoreGive(s_mutex);
+    }
+}
+
+#endif // HOYMILES_RADIO_TASKS || HOYMILES_RX_TASK
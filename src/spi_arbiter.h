@@ -0,0 +1,64 @@
+/**
+ * SPI Arbiter - Shared SPI bus between the NRF24 and CMT2300A radios
+ *
+ * On dual-radio builds each protocol driver runs in its own task
+ * (HOYMILES_RADIO_TASKS). Both transceivers sit on the same SPI bus, so
+ * every SPI transaction of a radio backend is wrapped in an SpiBusLock.
+ * Only the bus access is serialized: waiting for a response holds no lock,
+ * so 2.4 GHz and 868 MHz polls overlap in time.
+ *
+ * The NRF24 RX task (HOYMILES_RX_TASK) reads the radio while the poll
+ * cycle may be transmitting on it, so it takes the same lock.
+ *
+ * Without either the lock compiles to nothing.
+ */
+
+#ifndef SPI_ARBITER_H
+#define SPI_ARBITER_H
+
+#include <Arduino.h>
+#include "config.h"
+
+#if defined(HOYMILES_RADIO_TASKS) || defined(HOYMILES_RX_TASK)
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
+
+class SpiArbiter {
+public:
+    /**
+     * Create the bus mutex; call once before the radio and RX tasks start
+     */
+    static void begin();
+
+    static void lock();
+    static void unlock();
+
+private:
+    static SemaphoreHandle_t s_mutex;
+};
+
+#else
+
+class SpiArbiter {
+public:
+    static void begin() {}
+    static void lock() {}
+    static void unlock() {}
+};
+
+#endif // HOYMILES_RADIO_TASKS || HOYMILES_RX_TASK
+
+/**
+ * Holds the SPI bus for the lifetime of the object
+ */
+class SpiBusLock {
+public:
+    SpiBusLock() { SpiArbiter::lock(); }
+    ~SpiBusLock() { SpiArbiter::unlock(); }
+
+    SpiBusLock(const SpiBusLock&) = delete;
+    SpiBusLock& operator=(const SpiBusLock&) = delete;
+};
+
+#endif // SPI_ARBITER_H
@@ -0,0 +1,289 @@
+/**
+ * Telemetry Spool - Store-and-forward of MQTT messages on LittleFS
+ */
+
+#include "telemetry_spool.h"
+#include "hoymiles_protocol.h"
+#include "logger.h"
+
+#define SPOOL_FRAME_MAGIC       0xA7
+#define SPOOL_SEGMENT_VERSION   1
+
+static const char* const SPOOL_PATHS[2] = { "/spool0.bin", "/spool1.bin" };
+
+static void putLE16(uint8_t* p, uint16_t value) {
+    p[0] = value & 0xFF;
+    p[1] = value >> 8;
+}
+
+static uint16_t getLE16(const uint8_t* p) {
+    return p[0] | (p[1] << 8);
+}
+
+TelemetrySpool::TelemetrySpool()
+    : m_active(0)
+    , m_read(0)
+    , m_readOffset(TELEMETRY_SPOOL_SEGMENT_HEADER)
+    , m_peekLength(0)
+    , m_evicted(0)
+    , m_ready(false)
+{
+    m_segments[0] = { 0, 0 };
+    m_segments[1] = { 0, 0 };
+    m_topic[0] = '\0';
+}
+
+const char* TelemetrySpool::pathOf(uint8_t segment) {
+    return SPOOL_PATHS[segment];
+}
+
+bool TelemetrySpool::begin() {
+    m_ready = false;
+
+    for (uint8_t i = 0; i < 2; i++) {
+        m_segments[i] = { 0, 0 };
+
+        fs::File file = LittleFS.open(pathOf(i), "r");
+        if (!file) {
+            continue;
+        }
+
+        uint8_t header[TELEMETRY_SPOOL_SEGMENT_HEADER];
+        bool valid = file.read(header, sizeof(header)) == sizeof(header) &&
+                     header[0] == 'S' && header[1] == 'P' && header[2] == 'L' &&
+                     header[3] == SPOOL_SEGMENT_VERSION;
+        if (valid) {
+            m_segments[i].generation = header[4] | (header[5] << 8) |
+                                       ((uint32_t)header[6] << 16) | ((uint32_t)header[7] << 24);
+            m_segments[i].end = scanSegment(file);
+        }
+        file.close();
+
+        if (!valid || m_segments[i].generation == 0) {
+            // Header never completed: nothing in this file was written
+            m_segments[i] = { 0, 0 };
+            LittleFS.remove(pathOf(i));
+        }
+    }
+
+    if (m_segments[0].generation == 0 && m_segments[1].generation == 0) {
+        if (!createSegment(0, 1)) {
+            DEBUG_PRINTLN("Telemetry Spool: ERROR - cannot create spool file");
+            return false;
+        }
+        m_active = 0;
+        m_read = 0;
+    } else {
+        m_active = m_segments[1].generation > m_segments[0].generation ? 1 : 0;
+        uint8_t older = 1 - m_active;
+        m_read = m_segments[older].generation != 0 ? older : m_active;
+    }
+
+    m_readOffset = TELEMETRY_SPOOL_SEGMENT_HEADER;
+    m_peekLength = 0;
+    m_ready = true;
+
+    if (!isEmpty()) {
+        DEBUG_PRINT("Telemetry Spool: ");
+        DEBUG_PRINT(m_segments[0].end + m_segments[1].end);
+        DEBUG_PRINTLN(" bytes to replay");
+    }
+    return true;
+}
+
+bool TelemetrySpool::createSegment(uint8_t segment, uint32_t generation) {
+    m_segments[segment] = { 0, 0 };
+
+    fs::File file = LittleFS.open(pathOf(segment), "w");
+    if (!file) {
+        return false;
+    }
+
+    const uint8_t header[TELEMETRY_SPOOL_SEGMENT_HEADER] = {
+        'S', 'P', 'L', SPOOL_SEGMENT_VERSION,
+        (uint8_t)generation, (uint8_t)(generation >> 8), (uint8_t)(generation >> 16), (uint8_t)(generation >> 24)
+    };
+    bool written = file.write(header, sizeof(header)) == sizeof(header);
+    file.close();
+
+    if (written) {
+        m_segments[segment] = { generation, TELEMETRY_SPOOL_SEGMENT_HEADER };
+    }
+    return written;
+}
+
+void TelemetrySpool::removeSegment(uint8_t segment) {
+    LittleFS.remove(pathOf(segment));
+    m_segments[segment] = { 0, 0 };
+}
+
+/**
+ * @return Offset after the last frame that passes its CRC
+ */
+uint32_t TelemetrySpool::scanSegment(fs::File& file) {
+    uint32_t offset = TELEMETRY_SPOOL_SEGMENT_HEADER;
+    uint32_t frameLength;
+    while (readFrame(file, offset, frameLength)) {
+        offset += frameLength;
+    }
+    return offset;
+}
+
+/**
+ * Read and check the frame at offset into m_frame
+ */
+bool TelemetrySpool::readFrame(fs::File& file, uint32_t offset, uint32_t& frameLength) {
+    if (!file.seek(offset) ||
+        file.read(m_frame, TELEMETRY_SPOOL_FRAME_HEADER) != TELEMETRY_SPOOL_FRAME_HEADER ||
+        m_frame[0] != SPOOL_FRAME_MAGIC) {
+        return false;
+    }
+
+    uint8_t topicLength = m_frame[2];
+    uint16_t payloadLength = getLE16(m_frame + 4);
+    if (topicLength == 0 || topicLength > TELEMETRY_SPOOL_MAX_TOPIC || payloadLength > TELEMETRY_SPOOL_MAX_PAYLOAD) {
+        return false;
+    }
+
+    uint32_t dataLength = topicLength + payloadLength;
+    if (file.read(m_frame + TELEMETRY_SPOOL_FRAME_HEADER, dataLength + 2) != dataLength + 2) {
+        return false;
+    }
+
+    uint32_t crcOffset = TELEMETRY_SPOOL_FRAME_HEADER + dataLength;
+    if (HoymilesProtocol::crc16(m_frame, crcOffset) != getLE16(m_frame + crcOffset)) {
+        return false;
+    }
+
+    frameLength = crcOffset + 2;
+    return true;
+}
+
+bool TelemetrySpool::append(const char* topic, const uint8_t* payload, size_t length) {
+    if (!m_ready) {
+        return false;
+    }
+
+    size_t topicLength = strlen(topic);
+    if (topicLength == 0 || topicLength > TELEMETRY_SPOOL_MAX_TOPIC || length > TELEMETRY_SPOOL_MAX_PAYLOAD) {
+        return false;
+    }
+
+    uint32_t frameLength = TELEMETRY_SPOOL_FRAME_OVERHEAD + topicLength + length;
+
+    if (m_segments[m_active].end + frameLength > TELEMETRY_SPOOL_SEGMENT_SIZE) {
+        // Rotate: the older segment makes room, unreplayed or not
+        uint8_t next = 1 - m_active;
+        if (m_segments[next].generation != 0) {
+            m_evicted++;
+            LOG_WARN("Telemetry Spool: oldest segment evicted");
+            removeSegment(next);
+        }
+        if (!createSegment(next, m_segments[m_active].generation + 1)) {
+            LOG_ERROR("Telemetry Spool: cannot create segment");
+            return false;
+        }
+        if (m_read == next) {
+            m_read = m_active;
+            m_readOffset = TELEMETRY_SPOOL_SEGMENT_HEADER;
+        }
+        m_active = next;
+        m_peekLength = 0;
+    }
+
+    m_frame[0] = SPOOL_FRAME_MAGIC;
+    m_frame[1] = 0;
+    m_frame[2] = (uint8_t)topicLength;
+    m_frame[3] = 0;
+    putLE16(m_frame + 4, (uint16_t)length);
+    memcpy(m_frame + TELEMETRY_SPOOL_FRAME_HEADER, topic, topicLength);
+    memcpy(m_frame + TELEMETRY_SPOOL_FRAME_HEADER + topicLength, payload, length);
+    uint32_t crcOffset = frameLength - 2;
+    putLE16(m_frame + crcOffset, HoymilesProtocol::crc16(m_frame, crcOffset));
+
+    // Written at the end of the valid frames, over a torn tail if there is one
+    Segment& segment = m_segments[m_active];
+    fs::File file = LittleFS.open(pathOf(m_active), "r+");
+    if (!file) {
+        return false;
+    }
+    bool written = file.seek(segment.end) && file.write(m_frame, frameLength) == frameLength;
+    file.close();
+
+    if (!written) {
+        LOG_ERROR("Telemetry Spool: write failed");
+        return false;
+    }
+
+    segment.end += frameLength;
+    m_peekLength = 0;   // m_frame was reused
+    return true;
+}
+
+bool TelemetrySpool::peek(const char*& topic, const uint8_t*& payload, size_t& length) {
+    m_peekLength = 0;
+    if (!m_ready) {
+        return false;
+    }
+    if (m_read != m_active && m_readOffset >= m_segments[m_read].end) {
+        // Older segment without frames left (recovered empty at startup)
+        pop();
+    }
+    if (isEmpty()) {
+        return false;
+    }
+
+    fs::File file = LittleFS.open(pathOf(m_read), "r");
+    if (!file) {
+        return false;
+    }
+    uint32_t frameLength;
+    bool valid = readFrame(file, m_readOffset, frameLength);
+    file.close();
+
+    if (!valid) {
+        // Frames were validated at startup or by our own write; skip the rest
+        LOG_ERROR("Telemetry Spool: unreadable frame, segment skipped");
+        m_segments[m_read].end = m_readOffset;
+        pop();
+        return false;
+    }
+
+    uint8_t topicLength = m_frame[2];
+    memcpy(m_topic, m_frame + TELEMETRY_SPOOL_FRAME_HEADER, topicLength);
+    m_topic[topicLength] = '\0';
+
+    topic = m_topic;
+    payload = m_frame + TELEMETRY_SPOOL_FRAME_HEADER + topicLength;
+    length = getLE16(m_frame + 4);
+    m_peekLength = frameLength;
+    return true;
+}
+
+void TelemetrySpool::pop() {
+    m_readOffset += m_peekLength;
+    m_peekLength = 0;
+
+    if (m_readOffset < m_segments[m_read].end) {
+        return;
+    }
+
+    if (m_read != m_active) {
+        // Older segment fully replayed
+        removeSegment(m_read);
+        m_read = m_active;
+        m_readOffset = TELEMETRY_SPOOL_SEGMENT_HEADER;
+    } else if (m_segments[m_active].end > TELEMETRY_SPOOL_SEGMENT_HEADER) {
+        // Everything replayed: start over so a reset does not replay it again
+        createSegment(m_active, m_segments[m_active].generation + 1);
+        m_readOffset = TELEMETRY_SPOOL_SEGMENT_HEADER;
+    }
+}
+
+bool TelemetrySpool::isEmpty() const {
+    if (m_read != m_active) {
+        return m_readOffset >= m_segments[m_read].end &&
+               m_segments[m_active].end <= TELEMETRY_SPOOL_SEGMENT_HEADER;
+    }
+    return m_readOffset >= m_segments[m_active].end;
+}
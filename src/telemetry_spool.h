@@ -0,0 +1,110 @@
+/**
+ * Telemetry Spool - Store-and-forward of MQTT messages on LittleFS
+ *
+ * Messages that cannot be sent (broker or WiFi down) are appended to a
+ * spool and replayed oldest-first once the connection is back.
+ *
+ * The spool consists of two segment files used in rotation. Frames are
+ * only ever appended to the newer segment. When it is full, the older one
+ * is discarded together with any frames not yet replayed, and its slot
+ * becomes the new segment. This bounds the spool to two segments and
+ * evicts the oldest data first without rewriting files.
+ *
+ * Segment:  "SPL" version, generation (uint32 LE), then frames
+ * Frame:    0xA7, reserved, topic length, reserved, payload length (uint16 LE),
+ *           topic, payload, CRC16 Modbus of all preceding frame bytes (LE)
+ *
+ * A frame torn by a reset fails its CRC. At startup each segment is
+ * scanned up to its first invalid frame, and new frames are written from
+ * there, over the torn bytes. Replay is at-least-once: after a reset, the
+ * frames already replayed from the oldest segment are sent again.
+ */
+
+#ifndef TELEMETRY_SPOOL_H
+#define TELEMETRY_SPOOL_H
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include "config.h"
+
+#ifndef TELEMETRY_SPOOL_SEGMENT_SIZE
+  #if defined(ESP32S3)
+    #define TELEMETRY_SPOOL_SEGMENT_SIZE  524288  // 1.9 MB filesystem
+  #elif defined(ESP32)
+    #define TELEMETRY_SPOOL_SEGMENT_SIZE  49152   // 192 KB filesystem, shared with the web UI
+  #else
+    #define TELEMETRY_SPOOL_SEGMENT_SIZE  32768
+  #endif
+#endif
+
+// Largest message, same as the batch buffer (INVERTER_PUBLISHER_BATCH_SIZE)
+#ifndef TELEMETRY_SPOOL_MAX_PAYLOAD
+  #ifdef ESP8266
+    #define TELEMETRY_SPOOL_MAX_PAYLOAD   768
+  #else
+    #define TELEMETRY_SPOOL_MAX_PAYLOAD   1536
+  #endif
+#endif
+
+#define TELEMETRY_SPOOL_MAX_TOPIC         127
+#define TELEMETRY_SPOOL_REPLAY_INTERVAL   100     // ms between replayed messages (10/s)
+
+#define TELEMETRY_SPOOL_FRAME_HEADER      6
+#define TELEMETRY_SPOOL_FRAME_OVERHEAD    (TELEMETRY_SPOOL_FRAME_HEADER + 2)
+#define TELEMETRY_SPOOL_SEGMENT_HEADER    8
+
+class TelemetrySpool {
+public:
+    TelemetrySpool();
+
+    /**
+     * Recover both segments (LittleFS must be mounted)
+     * @return false if the filesystem cannot be used
+     */
+    bool begin();
+
+    /**
+     * Append one message, evicting the older segment when needed
+     */
+    bool append(const char* topic, const uint8_t* payload, size_t length);
+
+    /**
+     * Oldest frame not yet replayed; pointers stay valid until the next call
+     * @return false if the spool is empty
+     */
+    bool peek(const char*& topic, const uint8_t*& payload, size_t& length);
+
+    /**
+     * Drop the frame returned by peek() (after it was sent)
+     */
+    void pop();
+
+    bool isEmpty() const;
+    bool isReady() const { return m_ready; }
+    uint32_t getEvictedCount() const { return m_evicted; }  // Segments discarded unreplayed
+
+private:
+    struct Segment {
+        uint32_t generation;    // 0 = no file
+        uint32_t end;           // Offset after the last valid frame
+    };
+
+    Segment m_segments[2];
+    uint8_t m_active;           // Segment that receives new frames
+    uint8_t m_read;             // Segment of the oldest unreplayed frame
+    uint32_t m_readOffset;
+    uint32_t m_peekLength;      // Frame size of the last peek(), 0 = none
+    uint32_t m_evicted;
+    bool m_ready;
+
+    uint8_t m_frame[TELEMETRY_SPOOL_FRAME_OVERHEAD + TELEMETRY_SPOOL_MAX_TOPIC + TELEMETRY_SPOOL_MAX_PAYLOAD];
+    char m_topic[TELEMETRY_SPOOL_MAX_TOPIC + 1];
+
+    static const char* pathOf(uint8_t segment);
+    bool createSegment(uint8_t segment, uint32_t generation);
+    void removeSegment(uint8_t segment);
+    uint32_t scanSegment(fs::File& file);
+    bool readFrame(fs::File& file, uint32_t offset, uint32_t& frameLength);
+};
+
+#endif // TELEMETRY_SPOOL_H
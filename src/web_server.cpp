@@ -5,12 +5,17 @@
  * - Serves web UI from LittleFS
  * - Captive portal for AP mode
  * - REST API endpoints for configuration
+ * - Recent log lines (GET /api/log, fed by the Logger sink)
  * - CORS support for development
  */
 
 #include "web_server.h"
 #include "config.h"
 #include "wifi_manager.h"
+#include "sample_history.h"
+#include "mqtt_client.h"
+#include "logger.h"
+#include "fixed_point.h"
 
 #ifdef ESP32
     #include <WiFi.h>
@@ -29,9 +34,27 @@
 #include <ArduinoJson.h>
 #include <Preferences.h>
 
+#define HISTORY_DEFAULT_RECORDS  60
+#define HISTORY_MAX_RECORDS      120     // Per radio and request (response is built in RAM)
+
+#ifdef ESP8266
+    #define WEB_LOG_LINES        8
+#else
+    #define WEB_LOG_LINES        32
+#endif
+
 // External references
 extern WiFiManager wifiManager;
 
+#ifdef RADIO_NRF24
+extern SampleHistory historyHM;
+#endif
+#ifdef RADIO_CMT2300A
+extern SampleHistory historyHMS;
+#endif
+extern SampleHistory rollupHistory;
+extern MqttClient mqttClient;
+
 // Web server and DNS server instances
 AsyncWebServer* server = nullptr;
 DNSServer* dnsServer = nullptr;
@@ -39,6 +62,30 @@ DNSServer* dnsServer = nullptr;
 // Configuration storage
 Preferences configPrefs;
 
+// Recent log lines for /api/log, written by the Logger sink
+static char s_logLines[WEB_LOG_LINES][LOG_LINE_SIZE];
+static uint32_t s_logCount = 0;         // Lines written since boot
+
+#ifdef ESP32
+// The log task writes while the async web server reads
+static portMUX_TYPE s_logLinesMux = portMUX_INITIALIZER_UNLOCKED;
+#define LOG_LINES_LOCK()    portENTER_CRITICAL(&s_logLinesMux)
+#define LOG_LINES_UNLOCK()  portEXIT_CRITICAL(&s_logLinesMux)
+#else
+// Drained from loop(); async callbacks do not preempt it
+#define LOG_LINES_LOCK()
+#define LOG_LINES_UNLOCK()
+#endif
+
+static void onLogLine(void*, uint8_t, const char* line) {
+    LOG_LINES_LOCK();
+    char* slot = s_logLines[s_logCount % WEB_LOG_LINES];
+    strncpy(slot, line, LOG_LINE_SIZE - 1);
+    slot[LOG_LINE_SIZE - 1] = '\0';
+    s_logCount++;
+    LOG_LINES_UNLOCK();
+}
+
 WebServer::WebServer()
     : m_started(false)
 {
@@ -61,6 +108,9 @@ void WebServer::begin() {
     // Setup all routes
     setupRoutes();
 
+    // Keep the latest formatted log lines for the log view
+    Logger::setSink(onLogLine, nullptr);
+
     // Start DNS server for captive portal (only in AP mode)
     if (wifiManager.isAPMode()) {
         dnsServer = new DNSServer();
@@ -83,6 +133,8 @@ void WebServer::loop() {
 }
 
 void WebServer::stop() {
+    Logger::setSink(nullptr, nullptr);
+
     if (server) {
         server->end();
         delete server;
@@ -246,6 +298,15 @@ void WebServer::setupRoutes() {
         doc["wifi_connected"] = wifiManager.isConnected();
         doc["wifi_ap_mode"] = wifiManager.isAPMode();
 
+        // MQTT status
+        doc["mqtt_connected"] = mqttClient.isConnected();
+        #ifdef MQTT_TASK
+        doc["mqtt_dropped"] = mqttClient.getDroppedCount();
+        doc["mqtt_rejected"] = mqttClient.getRejectedCount();
+        doc["mqtt_refused"] = mqttClient.getRefusedCount();
+        doc["mqtt_retransmits"] = mqttClient.getRetransmitCount();
+        #endif
+
         // Configuration
         configPrefs.begin("config", true);
         doc["mode"] = configPrefs.getString("mode", "");
@@ -256,6 +317,107 @@ void WebServer::setupRoutes() {
         request->send(200, "application/json", response);
     });
 
+    // ============================================
+    // API: Sample History
+    // ============================================
+
+    server->on("/api/history", HTTP_GET, [](AsyncWebServerRequest *request) {
+        uint32_t limit = HISTORY_DEFAULT_RECORDS;
+        if (request->hasParam("limit")) {
+            limit = request->getParam("limit")->value().toInt();
+            if (limit == 0 || limit > HISTORY_MAX_RECORDS) {
+                limit = HISTORY_MAX_RECORDS;
+            }
+        }
+
+        JsonDocument doc;
+        JsonArray records = doc["records"].to<JsonArray>();
+        uint32_t skipped = 0;
+
+        // Newest records of each radio, oldest first; the radio tasks keep writing meanwhile
+        auto addHistory = [&](const SampleHistory& history, const char* radio) {
+            SampleHistoryCursor cursor = history.snapshot(limit);
+            SampleHistoryRecord record;
+            while (history.read(cursor, record)) {
+                JsonObject entry = records.add<JsonObject>();
+                entry["radio"] = radio;
+                entry["time"] = record.time;
+                // 12 hex digits as on the inverter label (OpenDTU format)
+                char serial[13];
+                snprintf(serial, sizeof(serial), "%04lX%08lX",
+                         (unsigned long)((record.serial >> 32) & 0xFFFF), (unsigned long)(record.serial & 0xFFFFFFFF));
+                entry["serial"] = serial;
+                // Fixed-point values as JSON numbers, no float conversion
+                char text[16];
+                formatFixedPoint(text, sizeof(text), record.power, HOYMILES_FIELD_DECIMALS[FIELD_POWER]);
+                entry["power"] = serialized(text);
+                formatFixedPoint(text, sizeof(text), record.voltage, HOYMILES_FIELD_DECIMALS[FIELD_VOLTAGE]);
+                entry["voltage"] = serialized(text);
+                formatFixedPoint(text, sizeof(text), record.current, HOYMILES_FIELD_DECIMALS[FIELD_CURRENT]);
+                entry["current"] = serialized(text);
+                formatFixedPoint(text, sizeof(text), record.temperature, HOYMILES_FIELD_DECIMALS[FIELD_TEMPERATURE]);
+                entry["temperature"] = serialized(text);
+                entry["yield_day"] = record.yieldDay;
+            }
+            skipped += cursor.skipped;
+        };
+
+        if (request->hasParam("rollup")) {
+            // 15-minute means; time is the Unix time of the window start
+            addHistory(rollupHistory, "rollup");
+            doc["capacity_rollup"] = rollupHistory.getCapacity();
+        } else {
+            #ifdef RADIO_NRF24
+            addHistory(historyHM, "hm");
+            doc["capacity_hm"] = historyHM.getCapacity();
+            #endif
+            #ifdef RADIO_CMT2300A
+            addHistory(historyHMS, "hms");
+            doc["capacity_hms"] = historyHMS.getCapacity();
+            #endif
+        }
+        doc["skipped"] = skipped;
+
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+
+    // ============================================
+    // API: Recent Log Lines
+    // ============================================
+
+    server->on("/api/log", HTTP_GET, [](AsyncWebServerRequest *request) {
+        JsonDocument doc;
+        JsonArray lines = doc["lines"].to<JsonArray>();
+
+        // Oldest first; each line is copied out under the lock, the JSON
+        // is built outside it
+        LOG_LINES_LOCK();
+        uint32_t end = s_logCount;
+        LOG_LINES_UNLOCK();
+        uint32_t start = end > WEB_LOG_LINES ? end - WEB_LOG_LINES : 0;
+
+        char line[LOG_LINE_SIZE];
+        for (uint32_t i = start; i < end; i++) {
+            LOG_LINES_LOCK();
+            bool overwritten = s_logCount - i > WEB_LOG_LINES;
+            if (!overwritten) {
+                memcpy(line, s_logLines[i % WEB_LOG_LINES], sizeof(line));
+            }
+            LOG_LINES_UNLOCK();
+            if (!overwritten) {
+                lines.add(line);
+            }
+        }
+        doc["total"] = end;
+        doc["dropped"] = Logger::getDroppedCount();
+
+        String response;
+        serializeJson(doc, response);
+        request->send(200, "application/json", response);
+    });
+
     // ============================================
     // API: MQTT Configuration (Generic Mode)
     // ============================================
@@ -278,6 +440,9 @@ void WebServer::setupRoutes() {
             String username = doc["username"] | "";
             String password = doc["password"] | "";
             String topic = doc["topic"] | "opendtu";
+            String layout = doc["layout"] | "json";
+            uint8_t qos = doc["qos"] | 0;
+            uint8_t window = doc["window"] | MQTT_DEFAULT_INFLIGHT_WINDOW;
 
             if (host.length() == 0) {
                 request->send(400, "application/json", "{\"success\":false,\"error\":\"Host required\"}");
@@ -293,6 +458,9 @@ void WebServer::setupRoutes() {
             configPrefs.putString("mqtt_user", username);
             configPrefs.putString("mqtt_pass", password);
             configPrefs.putString("mqtt_topic", topic);
+            configPrefs.putUChar("mqtt_layout", layout == "fields" ? 1 : layout == "batch" ? 2 : 0);
+            configPrefs.putUChar("mqtt_qos", qos > 0 ? 1 : 0);
+            configPrefs.putUChar("mqtt_window", window);
             configPrefs.end();
 
             DEBUG_PRINTLN("Web Server: MQTT configuration saved");
@@ -0,0 +1,198 @@
+/**
+ * Host shim - Minimal Arduino core for the native test environment
+ *
+ * Only what the host-built modules use. Time is virtual: millis() returns
+ * a counter that delay() and shimAdvance() move forward, so tests control
+ * timeouts and poll intervals exactly and never sleep, and time(nullptr)
+ * follows the same counter. Header-only (C++17 inline variables), nothing
+ * to link.
+ */
+
+#ifndef SHIM_ARDUINO_H
+#define SHIM_ARDUINO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <string>
+
+#define HEX 16
+#define DEC 10
+
+#define INPUT           0x00
+#define OUTPUT          0x01
+#define INPUT_PULLUP    0x02
+#define RISING          0x01
+#define FALLING         0x02
+
+#define IRAM_ATTR
+#define PROGMEM
+#define pgm_read_byte(p)    (*(const uint8_t*)(p))
+#define pgm_read_word(p)    (*(const uint16_t*)(p))
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+typedef uint8_t byte;
+
+// Virtual clock ------------------------------------------------------------
+
+inline unsigned long g_shimMillis = 1;
+
+/**
+ * Called whenever virtual time moves; tests use it to play the part of
+ * peripherals and interrupts that act while the firmware waits
+ */
+inline void (*g_shimOnTick)() = nullptr;
+
+inline unsigned long millis() { return g_shimMillis; }
+inline unsigned long micros() { return g_shimMillis * 1000UL; }
+inline void yield() {}
+
+inline void delay(unsigned long ms) {
+    g_shimMillis += ms;
+    if (g_shimOnTick) {
+        g_shimOnTick();
+    }
+}
+
+/**
+ * Let time pass without calling into the code under test
+ */
+inline void shimAdvance(unsigned long ms) { delay(ms); }
+
+/**
+ * Wall clock as set by SNTP: Unix time g_shimEpoch at millis() 0. Set it to
+ * 0 for a clock that was never synchronized (time starts at 1970 on boot).
+ * A better match for time(nullptr) than the C library's time(time_t*).
+ */
+inline time_t g_shimEpoch = 1767225600;     // 2026-01-01 00:00:00 UTC
+
+inline time_t time(decltype(nullptr)) { return g_shimEpoch + (time_t)(g_shimMillis / 1000); }
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline int digitalPinToInterrupt(int pin) { return pin; }
+inline void attachInterrupt(int, void (*)(), int) {}
+inline void detachInterrupt(int) {}
+
+inline void configTime(long, int, const char*, const char* = nullptr, const char* = nullptr) {}
+
+// String -------------------------------------------------------------------
+
+class String {
+public:
+    String() {}
+    String(const char* s) : m_s(s ? s : "") {}
+    String(const std::string& s) : m_s(s) {}
+    String(char c) : m_s(1, c) {}
+    String(int v) : m_s(std::to_string(v)) {}
+    String(unsigned int v) : m_s(std::to_string(v)) {}
+    String(long v) : m_s(std::to_string(v)) {}
+    String(unsigned long v) : m_s(std::to_string(v)) {}
+    String(float v, unsigned char decimals = 2) : String((double)v, decimals) {}
+    String(double v, unsigned char decimals = 2) {
+        char text[48];
+        snprintf(text, sizeof(text), "%.*f", decimals, v);
+        m_s = text;
+    }
+
+    const char* c_str() const { return m_s.c_str(); }
+    unsigned int length() const { return m_s.size(); }
+    bool reserve(unsigned int size) { m_s.reserve(size); return true; }
+    char operator[](unsigned int i) const { return i < m_s.size() ? m_s[i] : '\0'; }
+
+    String& operator+=(const String& s) { m_s += s.m_s; return *this; }
+    String& operator+=(const char* s) { m_s += s; return *this; }
+    String& operator+=(char c) { m_s += c; return *this; }
+    friend String operator+(const String& a, const String& b) { return String(a.m_s + b.m_s); }
+    friend String operator+(const char* a, const String& b) { return String(std::string(a) + b.m_s); }
+    friend String operator+(const String& a, const char* b) { return String(a.m_s + b); }
+
+    bool operator==(const String& s) const { return m_s == s.m_s; }
+    bool operator==(const char* s) const { return m_s == s; }
+    bool operator!=(const String& s) const { return m_s != s.m_s; }
+    bool operator!=(const char* s) const { return m_s != s; }
+
+    int indexOf(char c) const {
+        size_t i = m_s.find(c);
+        return i == std::string::npos ? -1 : (int)i;
+    }
+    bool startsWith(const String& s) const { return m_s.compare(0, s.m_s.size(), s.m_s) == 0; }
+    String substring(unsigned int from, unsigned int to = ~0u) const {
+        return from >= m_s.size() ? String() : String(m_s.substr(from, to - from));
+    }
+    void replace(const char* find, const char* with) {
+        size_t n = strlen(find);
+        for (size_t i = n ? m_s.find(find) : std::string::npos; i != std::string::npos;
+             i = m_s.find(find, i + strlen(with))) {
+            m_s.replace(i, n, with);
+        }
+    }
+    void toUpperCase() {
+        for (char& c : m_s) {
+            if (c >= 'a' && c <= 'z') {
+                c -= 'a' - 'A';
+            }
+        }
+    }
+    long toInt() const { return atol(m_s.c_str()); }
+
+private:
+    std::string m_s;
+};
+
+// Print / Serial -----------------------------------------------------------
+
+class Print {
+public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t b) = 0;
+    virtual size_t write(const uint8_t* buffer, size_t size) {
+        size_t n = 0;
+        while (size--) {
+            n += write(*buffer++);
+        }
+        return n;
+    }
+
+    // Output is discarded on the host; test reports use printf
+    template <typename T> size_t print(const T&) { return 0; }
+    template <typename T> size_t print(const T&, int) { return 0; }
+    template <typename T> size_t println(const T&) { return 0; }
+    template <typename T> size_t println(const T&, int) { return 0; }
+    size_t println() { return 0; }
+    size_t printf(const char*, ...) { return 0; }
+};
+
+class Stream : public Print {
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HardwareSerial : public Stream {
+public:
+    void begin(unsigned long) {}
+    size_t write(uint8_t) override { return 1; }
+    int available() override { return 0; }
+    int read() override { return -1; }
+    int peek() override { return -1; }
+    int availableForWrite() { return 128; }
+    operator bool() { return true; }
+};
+
+inline HardwareSerial Serial;
+
+class EspClass {
+public:
+    uint32_t getFreeHeap() { return 0; }
+    uint32_t getMaxAllocHeap() { return 0; }
+    void restart() {}
+};
+
+inline EspClass ESP;
+
+#endif // SHIM_ARDUINO_H
@@ -0,0 +1,61 @@
+/**
+ * Host shim - WiFi station and TCP client
+ *
+ * mqtt_client.h takes this header on every non-ESP32 target, the host
+ * included. PubSubClient.h records publishes without using the socket;
+ * reads return what the shim broker sends back (PUBACKs).
+ */
+
+#ifndef SHIM_ESP8266WIFI_H
+#define SHIM_ESP8266WIFI_H
+
+#include <Client.h>
+#include "shim_broker.h"
+
+#define WL_CONNECTED 3
+
+class WiFiClient : public Client {
+public:
+    int connect(IPAddress, uint16_t) override { return 0; }
+    int connect(const char*, uint16_t) override { return 0; }
+    size_t write(uint8_t) override { return 1; }
+    size_t write(const uint8_t*, size_t size) override { return size; }
+    int available() override { return (int)g_shimBroker.inbound.size(); }
+    int peek() override { return g_shimBroker.inbound.empty() ? -1 : g_shimBroker.inbound.front(); }
+
+    int read() override {
+        if (g_shimBroker.inbound.empty()) {
+            return -1;
+        }
+        uint8_t b = g_shimBroker.inbound.front();
+        g_shimBroker.inbound.pop_front();
+        return b;
+    }
+
+    int read(uint8_t* buffer, size_t size) override {
+        size_t count = 0;
+        while (count < size && !g_shimBroker.inbound.empty()) {
+            buffer[count++] = (uint8_t)read();
+        }
+        return (int)count;
+    }
+
+    void flush() override {}
+    void stop() override {}
+    uint8_t connected() override { return 0; }
+    operator bool() override { return false; }
+    void setNoDelay(bool) {}
+};
+
+class WiFiClass {
+public:
+    String macAddress() { return String("24:0A:C4:00:00:01"); }
+    int status() { return WL_CONNECTED; }
+    bool isConnected() { return true; }
+    IPAddress localIP() { return IPAddress(); }
+    int8_t RSSI() { return -60; }
+};
+
+inline WiFiClass WiFi;
+
+#endif // SHIM_ESP8266WIFI_H
@@ -0,0 +1,114 @@
+/**
+ * Host shim - LittleFS kept in memory
+ *
+ * Files live in g_shimFs and survive remounts. writeBudget simulates a
+ * power cut: once that many bytes have been written, later writes are cut
+ * short (torn frame) and then fail, like a device that lost power mid-write.
+ * A negative budget means unlimited.
+ */
+
+#ifndef SHIM_LITTLEFS_H
+#define SHIM_LITTLEFS_H
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+struct ShimFs {
+    std::map<std::string, std::vector<uint8_t>> files;
+    long writeBudget = -1;
+
+    void clear() {
+        files.clear();
+        writeBudget = -1;
+    }
+};
+
+inline ShimFs g_shimFs;
+
+namespace fs {
+
+class File {
+public:
+    File() {}
+    File(std::vector<uint8_t>* data, bool writable) : m_data(data), m_writable(writable) {}
+
+    explicit operator bool() const { return m_data != nullptr; }
+
+    size_t size() const { return m_data ? m_data->size() : 0; }
+    size_t position() const { return m_position; }
+
+    bool seek(uint32_t position) {
+        if (!m_data || position > m_data->size()) {
+            return false;
+        }
+        m_position = position;
+        return true;
+    }
+
+    size_t read(uint8_t* buffer, size_t size) {
+        if (!m_data || m_position >= m_data->size()) {
+            return 0;
+        }
+        size_t n = std::min(size, m_data->size() - m_position);
+        memcpy(buffer, m_data->data() + m_position, n);
+        m_position += n;
+        return n;
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) {
+        if (!m_data || !m_writable) {
+            return 0;
+        }
+        size_t n = size;
+        if (g_shimFs.writeBudget >= 0) {
+            n = std::min(n, (size_t)g_shimFs.writeBudget);
+            g_shimFs.writeBudget -= n;
+        }
+        if (m_data->size() < m_position + n) {
+            m_data->resize(m_position + n);
+        }
+        memcpy(m_data->data() + m_position, buffer, n);
+        m_position += n;
+        return n;
+    }
+
+    void flush() {}
+    void close() { m_data = nullptr; }
+
+private:
+    std::vector<uint8_t>* m_data = nullptr;
+    size_t m_position = 0;
+    bool m_writable = false;
+};
+
+class FS {
+public:
+    bool begin(bool = false) { return true; }
+    void end() {}
+
+    File open(const char* path, const char* mode) {
+        if (mode[0] == 'w') {
+            std::vector<uint8_t>& data = g_shimFs.files[path];
+            data.clear();
+            return File(&data, true);
+        }
+        auto it = g_shimFs.files.find(path);
+        if (it == g_shimFs.files.end()) {
+            return File();
+        }
+        return File(&it->second, mode[1] == '+');
+    }
+
+    bool exists(const char* path) { return g_shimFs.files.count(path) > 0; }
+    bool remove(const char* path) { return g_shimFs.files.erase(path) > 0; }
+};
+
+} // namespace fs
+
+using fs::FS;
+using fs::File;
+
+inline fs::FS LittleFS;
+
+#endif // SHIM_LITTLEFS_H
@@ -0,0 +1,103 @@
+/**
+ * Host shim - NVS key/value store kept in memory
+ *
+ * Namespaces survive end()/begin() like flash does; tests reset them with
+ * g_shimNvs.clear() to simulate a fresh device.
+ */
+
+#ifndef SHIM_PREFERENCES_H
+#define SHIM_PREFERENCES_H
+
+#include <Arduino.h>
+#include <map>
+#include <vector>
+
+inline std::map<std::string, std::map<std::string, std::vector<uint8_t>>> g_shimNvs;
+
+class Preferences {
+public:
+    bool begin(const char* name, bool readOnly = false) {
+        m_space = &g_shimNvs[name];
+        m_readOnly = readOnly;
+        return true;
+    }
+    void end() { m_space = nullptr; }
+
+    bool clear() { return writable() && (m_space->clear(), true); }
+    bool remove(const char* key) { return writable() && m_space->erase(key) > 0; }
+    bool isKey(const char* key) { return m_space && m_space->count(key) > 0; }
+
+    size_t putBytes(const char* key, const void* value, size_t length) {
+        if (!writable()) {
+            return 0;
+        }
+        const uint8_t* bytes = (const uint8_t*)value;
+        (*m_space)[key].assign(bytes, bytes + length);
+        return length;
+    }
+    size_t getBytesLength(const char* key) {
+        const std::vector<uint8_t>* value = find(key);
+        return value ? value->size() : 0;
+    }
+    size_t getBytes(const char* key, void* buffer, size_t length) {
+        const std::vector<uint8_t>* value = find(key);
+        if (!value || value->size() > length) {
+            return 0;
+        }
+        memcpy(buffer, value->data(), value->size());
+        return value->size();
+    }
+
+    size_t putString(const char* key, const String& value) {
+        return putBytes(key, value.c_str(), value.length() + 1) ? value.length() : 0;
+    }
+    String getString(const char* key, const String& defaultValue = String()) {
+        const std::vector<uint8_t>* value = find(key);
+        return value ? String((const char*)value->data()) : defaultValue;
+    }
+
+    size_t putBool(const char* key, bool value) { return put(key, value); }
+    bool getBool(const char* key, bool defaultValue = false) { return get(key, defaultValue); }
+    size_t putUChar(const char* key, uint8_t value) { return put(key, value); }
+    uint8_t getUChar(const char* key, uint8_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putUShort(const char* key, uint16_t value) { return put(key, value); }
+    uint16_t getUShort(const char* key, uint16_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putInt(const char* key, int32_t value) { return put(key, value); }
+    int32_t getInt(const char* key, int32_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putUInt(const char* key, uint32_t value) { return put(key, value); }
+    uint32_t getUInt(const char* key, uint32_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putULong64(const char* key, uint64_t value) { return put(key, value); }
+    uint64_t getULong64(const char* key, uint64_t defaultValue = 0) { return get(key, defaultValue); }
+    size_t putFloat(const char* key, float value) { return put(key, value); }
+    float getFloat(const char* key, float defaultValue = 0) { return get(key, defaultValue); }
+
+private:
+    std::map<std::string, std::vector<uint8_t>>* m_space = nullptr;
+    bool m_readOnly = false;
+
+    bool writable() const { return m_space && !m_readOnly; }
+
+    const std::vector<uint8_t>* find(const char* key) const {
+        if (!m_space) {
+            return nullptr;
+        }
+        auto it = m_space->find(key);
+        return it == m_space->end() ? nullptr : &it->second;
+    }
+
+    template <typename T>
+    size_t put(const char* key, T value) { return putBytes(key, &value, sizeof(T)); }
+
+    template <typename T>
+    T get(const char* key, T defaultValue) {
+        const std::vector<uint8_t>* value = find(key);
+        if (!value || value->size() != sizeof(T)) {
+            return defaultValue;
+        }
+        T result;
+        memcpy(&result, value->data(), sizeof(T));
+        return result;
+    }
+};
+
+#endif // SHIM_PREFERENCES_H
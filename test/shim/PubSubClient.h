@@ -0,0 +1,108 @@
+/**
+ * Host shim - PubSubClient that delivers to an in-process broker
+ *
+ * Publishes go to g_shimBroker (shim_broker.h). Raw packets written with
+ * write() are parsed there, and loop() reads one inbound packet (PUBACK)
+ * through the network client, like the library does, so a transport
+ * wrapper such as MqttAckTap sees the bytes. A connection lasts until
+ * disconnect() or the broker's kick().
+ */
+
+#ifndef SHIM_PUBSUBCLIENT_H
+#define SHIM_PUBSUBCLIENT_H
+
+#include <Arduino.h>
+#include <Client.h>
+#include <functional>
+#include "shim_broker.h"
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char*, uint8_t*, unsigned int)> callback
+
+#define MQTT_CONNECTED          0
+#define MQTT_CONNECTION_LOST    -3
+
+class PubSubClient {
+public:
+    PubSubClient() : m_client(nullptr) {}
+    PubSubClient(Client& client) : m_client(&client) {}
+
+    PubSubClient& setServer(const char*, uint16_t) { return *this; }
+    PubSubClient& setCallback(MQTT_CALLBACK_SIGNATURE) { (void)callback; return *this; }
+    PubSubClient& setKeepAlive(uint16_t) { return *this; }
+    PubSubClient& setSocketTimeout(uint16_t) { return *this; }
+    bool setBufferSize(uint16_t) { return true; }
+
+    bool connect(const char*) { return open(); }
+    bool connect(const char*, const char*, const char*) { return open(); }
+
+    void disconnect() {
+        m_open = false;
+        if (m_client) {
+            m_client->stop();
+        }
+    }
+
+    bool connected() { return g_shimBroker.online && m_open && m_session == g_shimBroker.session; }
+    int state() { return connected() ? MQTT_CONNECTED : MQTT_CONNECTION_LOST; }
+
+    bool loop() {
+        if (!connected()) {
+            return false;
+        }
+        if (m_client && m_client->available() > 0) {
+            m_client->read();                   // Fixed header
+            uint32_t remaining = 0;
+            int digit;
+            uint8_t shift = 0;
+            do {
+                digit = m_client->read();
+                remaining |= (uint32_t)(digit & 0x7F) << shift;
+                shift += 7;
+            } while (digit >= 0 && (digit & 0x80));
+            while (remaining-- > 0 && m_client->read() >= 0) {
+            }
+        }
+        return true;
+    }
+
+    bool publish(const char* topic, const char* payload) {
+        return publish(topic, (const uint8_t*)payload, strlen(payload), false);
+    }
+    bool publish(const char* topic, const char* payload, bool retained) {
+        return publish(topic, (const uint8_t*)payload, strlen(payload), retained);
+    }
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length) {
+        return publish(topic, payload, length, false);
+    }
+    bool publish(const char* topic, const uint8_t* payload, unsigned int length, bool retained) {
+        return connected() && g_shimBroker.record(topic, strlen(topic), payload, length, retained, 0, 0);
+    }
+
+    size_t write(const uint8_t* buffer, size_t size) {
+        return connected() && g_shimBroker.receive(buffer, size) ? size : 0;
+    }
+
+    bool subscribe(const char*) { return connected(); }
+    bool subscribe(const char*, uint8_t) { return connected(); }
+
+private:
+    Client* m_client;
+    bool m_open = true;
+    uint32_t m_session = 0;
+
+    bool open() {
+        if (m_client) {
+            m_client->connect("broker", 1883);  // Resets a transport wrapper
+        }
+        if (!g_shimBroker.online) {
+            return false;
+        }
+        g_shimBroker.connects++;
+        g_shimBroker.inbound.clear();
+        m_open = true;
+        m_session = g_shimBroker.session;
+        return true;
+    }
+};
+
+#endif // SHIM_PUBSUBCLIENT_H
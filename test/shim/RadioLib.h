@@ -0,0 +1,178 @@
+/**
+ * Host shim - RadioLib CMT2300A driver on a simulated link
+ *
+ * Models what CMT2300ARadio relies on: single-packet receive (the radio
+ * leaves RX when a packet is ready and needs startReceive() again), the
+ * GPIO1 interrupt on packet ready and on TX done, and TX airtime. The
+ * other end of the link is the test: it receives every transmitted packet
+ * through g_shimCmt.onTransmit and hands packets in with deliver().
+ */
+
+#ifndef SHIM_RADIOLIB_H
+#define SHIM_RADIOLIB_H
+
+#include <Arduino.h>
+
+#define RADIOLIB_ERR_NONE               0
+#define RADIOLIB_ERR_PACKET_TOO_LONG    -4
+#define RADIOLIB_ERR_TX_TIMEOUT         -5
+#define RADIOLIB_NC                     0xFFFFFFFF
+#define RADIOLIB_SHAPING_0_5            0x02
+
+#define SHIM_CMT_MAX_PACKET             64
+
+class Module {
+public:
+    Module(uint32_t cs, uint32_t irq, uint32_t rst, uint32_t gpio) {
+        (void)cs;
+        (void)irq;
+        (void)rst;
+        (void)gpio;
+    }
+};
+
+struct ShimCmt {
+    // Test side of the link
+    void (*onTransmit)(void* context, const uint8_t* data, size_t len) = nullptr;
+    void* context = nullptr;
+    uint16_t airtime = 2;           // ms from start of TX to TX done
+
+    // Radio state
+    void (*action)() = nullptr;     // GPIO1 handler
+    bool receiving = false;
+    bool transmitting = false;
+    unsigned long txDoneAt = 0;
+    float frequency = 0;
+    uint8_t rx[SHIM_CMT_MAX_PACKET];
+    size_t rxLength = 0;
+
+    uint32_t instances = 0;         // CMT2300A objects constructed
+    uint32_t transmits = 0;
+    uint32_t delivered = 0;
+
+    /**
+     * Ready for a packet: in RX and the last one has been read
+     */
+    bool canReceive() const { return receiving && rxLength == 0; }
+
+    /**
+     * A packet arrives over the air; raises GPIO1
+     */
+    bool deliver(const uint8_t* data, size_t len) {
+        if (!canReceive() || len == 0 || len > SHIM_CMT_MAX_PACKET) {
+            return false;
+        }
+        memcpy(rx, data, len);
+        rxLength = len;
+        receiving = false;
+        delivered++;
+        if (action) {
+            action();
+        }
+        return true;
+    }
+
+    /**
+     * Complete a transmission whose airtime has passed; raises GPIO1
+     */
+    void service() {
+        if (transmitting && millis() >= txDoneAt) {
+            transmitting = false;
+            if (action) {
+                action();
+            }
+        }
+    }
+
+    void reset() { *this = ShimCmt(); }
+};
+
+inline ShimCmt g_shimCmt;
+
+class CMT2300A {
+public:
+    explicit CMT2300A(Module*) { g_shimCmt.instances++; }
+
+    int16_t begin(float freq, float br, float freqDev, float rxBw, int8_t power, uint16_t preambleLength) {
+        (void)br;
+        (void)freqDev;
+        (void)rxBw;
+        (void)power;
+        (void)preambleLength;
+        g_shimCmt.frequency = freq;
+        return RADIOLIB_ERR_NONE;
+    }
+
+    int16_t setDataShaping(uint8_t) { return RADIOLIB_ERR_NONE; }
+    int16_t setSyncWord(uint8_t*, size_t) { return RADIOLIB_ERR_NONE; }
+    int16_t setCRC(bool) { return RADIOLIB_ERR_NONE; }
+
+    int16_t setFrequency(float freq) {
+        g_shimCmt.frequency = freq;
+        return RADIOLIB_ERR_NONE;
+    }
+
+    int16_t standby() {
+        g_shimCmt.receiving = false;
+        return RADIOLIB_ERR_NONE;
+    }
+
+    int16_t startReceive() {
+        g_shimCmt.transmitting = false;
+        g_shimCmt.receiving = true;
+        g_shimCmt.rxLength = 0;
+        return RADIOLIB_ERR_NONE;
+    }
+
+    int16_t startTransmit(const uint8_t* data, size_t len) {
+        if (len > SHIM_CMT_MAX_PACKET) {
+            return RADIOLIB_ERR_PACKET_TOO_LONG;
+        }
+        g_shimCmt.receiving = false;
+        g_shimCmt.transmitting = true;
+        g_shimCmt.txDoneAt = millis() + g_shimCmt.airtime;
+        g_shimCmt.transmits++;
+        if (g_shimCmt.onTransmit) {
+            g_shimCmt.onTransmit(g_shimCmt.context, data, len);
+        }
+        return RADIOLIB_ERR_NONE;
+    }
+
+    int16_t finishTransmit() {
+        g_shimCmt.transmitting = false;
+        return RADIOLIB_ERR_NONE;
+    }
+
+    /**
+     * Blocking transmit: start, wait for the airtime, finish
+     */
+    int16_t transmit(const uint8_t* data, size_t len) {
+        int16_t state = startTransmit(data, len);
+        if (state != RADIOLIB_ERR_NONE) {
+            return state;
+        }
+        while (g_shimCmt.transmitting) {
+            delay(1);
+            g_shimCmt.service();
+        }
+        return finishTransmit();
+    }
+
+    size_t getPacketLength(bool update = true) {
+        (void)update;
+        return g_shimCmt.rxLength;
+    }
+
+    int16_t readData(uint8_t* data, size_t len) {
+        memcpy(data, g_shimCmt.rx, len < g_shimCmt.rxLength ? len : g_shimCmt.rxLength);
+        g_shimCmt.rxLength = 0;
+        return RADIOLIB_ERR_NONE;
+    }
+
+    float getRSSI() { return -70.0f; }
+
+    void setPacketReceivedAction(void (*func)()) { g_shimCmt.action = func; }
+    void clearPacketReceivedAction() { g_shimCmt.action = nullptr; }
+};
+
+#endif // SHIM_RADIOLIB_H
@@ -0,0 +1,16 @@
+/**
+ * Host shim - TLS client (same as the plain client)
+ */
+
+#ifndef SHIM_WIFICLIENTSECURE_H
+#define SHIM_WIFICLIENTSECURE_H
+
+#include <ESP8266WiFi.h>
+
+class WiFiClientSecure : public WiFiClient {
+public:
+    void setInsecure() {}
+    void setCACert(const char*) {}
+};
+
+#endif // SHIM_WIFICLIENTSECURE_H
@@ -0,0 +1,23 @@
+/**
+ * Host shim - FreeRTOS types and constants
+ *
+ * One tick is one millisecond of the virtual clock.
+ */
+
+#ifndef SHIM_FREERTOS_H
+#define SHIM_FREERTOS_H
+
+#include <stdint.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+
+#define pdFALSE             0
+#define pdTRUE              1
+#define pdFAIL              0
+#define pdPASS              1
+#define portMAX_DELAY       0xFFFFFFFFUL
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+
+#endif // SHIM_FREERTOS_H
@@ -0,0 +1,123 @@
+/**
+ * Host shim - FreeRTOS tasks, run one at a time under the test's control
+ *
+ * Each task is a thread that runs only while the test gives it a turn
+ * with shimRunTasks(), and hands the turn back wherever it would block
+ * (vTaskDelay(), ulTaskNotifyTake() without a pending notification).
+ * Test and tasks never run at the same time, so the interleaving is the
+ * same on every run, and blocking does not move the virtual clock: the
+ * test advances millis() between turns.
+ *
+ * Tasks never end. shimResetTasks() forgets them; their threads stay
+ * parked until the process exits, so the objects they work on may be
+ * destroyed afterwards.
+ */
+
+#ifndef SHIM_FREERTOS_TASK_H
+#define SHIM_FREERTOS_TASK_H
+
+#include <freertos/FreeRTOS.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+typedef void (*TaskFunction_t)(void*);
+
+struct ShimTask {
+    TaskFunction_t function;
+    void* parameter;
+    uint32_t notifications;
+    bool running;
+};
+
+typedef ShimTask* TaskHandle_t;
+
+struct ShimScheduler {
+    std::mutex mutex;
+    std::condition_variable turn;
+    std::vector<ShimTask*> tasks;
+};
+
+// Never destroyed: parked threads still wait on it at exit
+inline ShimScheduler& g_shimScheduler = *new ShimScheduler();
+inline thread_local ShimTask* t_shimTask = nullptr;
+
+/**
+ * Give the turn back to the test and wait for the next one (task side)
+ */
+inline void shimTaskBlock() {
+    ShimTask* task = t_shimTask;
+    std::unique_lock<std::mutex> lock(g_shimScheduler.mutex);
+    task->running = false;
+    g_shimScheduler.turn.notify_all();
+    g_shimScheduler.turn.wait(lock, [task] { return task->running; });
+}
+
+/**
+ * Give every task the given number of turns, in creation order (test side)
+ */
+inline void shimRunTasks(uint32_t turns = 1) {
+    for (uint32_t i = 0; i < turns; i++) {
+        for (ShimTask* task : g_shimScheduler.tasks) {
+            std::unique_lock<std::mutex> lock(g_shimScheduler.mutex);
+            task->running = true;
+            g_shimScheduler.turn.notify_all();
+            g_shimScheduler.turn.wait(lock, [task] { return !task->running; });
+        }
+    }
+}
+
+inline void shimResetTasks() {
+    std::lock_guard<std::mutex> lock(g_shimScheduler.mutex);
+    g_shimScheduler.tasks.clear();
+}
+
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char*, uint32_t, void* parameter,
+                                          UBaseType_t, TaskHandle_t* handle, BaseType_t) {
+    ShimTask* task = new ShimTask{ function, parameter, 0, false };
+    g_shimScheduler.tasks.push_back(task);
+
+    std::thread([task] {
+        t_shimTask = task;
+        {
+            std::unique_lock<std::mutex> lock(g_shimScheduler.mutex);
+            g_shimScheduler.turn.wait(lock, [task] { return task->running; });
+        }
+        task->function(task->parameter);
+        for (;;) {
+            shimTaskBlock();    // A FreeRTOS task must not return
+        }
+    }).detach();
+
+    if (handle) {
+        *handle = task;
+    }
+    return pdPASS;
+}
+
+inline void vTaskDelay(TickType_t) {
+    shimTaskBlock();
+}
+
+inline void xTaskNotifyGive(TaskHandle_t task) {
+    std::lock_guard<std::mutex> lock(g_shimScheduler.mutex);
+    task->notifications++;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t) {
+    ShimTask* task = t_shimTask;
+    std::unique_lock<std::mutex> lock(g_shimScheduler.mutex);
+    if (task->notifications == 0) {
+        // The next turn wakes it, as a notification or the timeout would
+        task->running = false;
+        g_shimScheduler.turn.notify_all();
+        g_shimScheduler.turn.wait(lock, [task] { return task->running; });
+    }
+
+    uint32_t value = task->notifications;
+    task->notifications = clearOnExit || value == 0 ? 0 : value - 1;
+    return value;
+}
+
+#endif // SHIM_FREERTOS_TASK_H
@@ -0,0 +1,132 @@
+/**
+ * Host shim - in-process MQTT broker
+ *
+ * Every publish is appended to g_shimBroker.messages while the broker is
+ * online; tests switch it off to simulate outages. ShimMessage is a plain
+ * struct, so after messages.reserve() recording does not allocate and
+ * allocation counters see only the code under test.
+ *
+ * QoS 1 PUBLISH packets written as raw bytes (the MQTT task) are parsed
+ * and acknowledged with a PUBACK in inbound, which WiFiClient hands back
+ * to the reader. With autoAck off the test sends the PUBACKs itself with
+ * ack(), in any order or not at all. kick() closes every open connection
+ * the way a broker restart does; online = false only refuses new ones and
+ * stops delivery.
+ */
+
+#ifndef SHIM_BROKER_H
+#define SHIM_BROKER_H
+
+#include <Arduino.h>
+#include <deque>
+#include <vector>
+
+#ifndef MQTT_MAX_PACKET_SIZE
+#define MQTT_MAX_PACKET_SIZE 2048
+#endif
+
+struct ShimMessage {
+    char topic[128];
+    uint8_t payload[MQTT_MAX_PACKET_SIZE];
+    size_t length;
+    bool retained;
+    uint8_t qos;
+    uint16_t packetId;                  // 0 for QoS 0
+};
+
+struct ShimBroker {
+    bool online = true;
+    bool autoAck = true;                // PUBACK each QoS 1 message at once
+    uint32_t session = 0;               // Connections opened before the last kick() are lost
+    uint32_t connects = 0;
+    std::vector<ShimMessage> messages;
+    std::deque<uint8_t> inbound;        // Bytes to the client
+
+    void clear() {
+        messages.clear();
+        inbound.clear();
+    }
+
+    void kick() {
+        session++;
+        inbound.clear();
+    }
+
+    void ack(uint16_t packetId) {
+        const uint8_t puback[] = { 0x40, 0x02, (uint8_t)(packetId >> 8), (uint8_t)packetId };
+        inbound.insert(inbound.end(), puback, puback + sizeof(puback));
+    }
+
+    bool record(const char* topic, size_t topicLength, const uint8_t* payload, size_t length,
+                bool retained, uint8_t qos, uint16_t packetId) {
+        if (!online || topicLength >= sizeof(ShimMessage::topic) || length > MQTT_MAX_PACKET_SIZE) {
+            return false;
+        }
+        messages.emplace_back();
+        ShimMessage& message = messages.back();
+        memcpy(message.topic, topic, topicLength);
+        message.topic[topicLength] = '\0';
+        memcpy(message.payload, payload, length);
+        message.length = length;
+        message.retained = retained;
+        message.qos = qos;
+        message.packetId = packetId;
+        return true;
+    }
+
+    /**
+     * One PUBLISH packet, as the client wrote it
+     * @return false if it is not a complete, well-formed PUBLISH
+     */
+    bool receive(const uint8_t* packet, size_t size) {
+        if (size < 2 || (packet[0] >> 4) != 3) {
+            return false;
+        }
+        uint8_t qos = (packet[0] >> 1) & 0x03;
+        bool retained = packet[0] & 0x01;
+
+        size_t at = 1;
+        uint32_t remaining = 0;
+        for (uint8_t shift = 0; ; shift += 7) {
+            if (at >= size || shift > 21) {
+                return false;
+            }
+            uint8_t digit = packet[at++];
+            remaining |= (uint32_t)(digit & 0x7F) << shift;
+            if (!(digit & 0x80)) {
+                break;
+            }
+        }
+        if (at + remaining != size || remaining < 2) {
+            return false;
+        }
+
+        size_t topicLength = (packet[at] << 8) | packet[at + 1];
+        at += 2;
+        const char* topic = (const char*)packet + at;
+        at += topicLength;
+        uint16_t packetId = 0;
+        if (qos > 0) {
+            if (at + 2 > size) {
+                return false;
+            }
+            packetId = (packet[at] << 8) | packet[at + 1];
+            at += 2;
+        }
+        if (at > size || (qos > 0 && packetId == 0)) {
+            return false;
+        }
+
+        if (!record(topic, topicLength, packet + at, size - at, retained, qos, packetId)) {
+            return false;
+        }
+        if (qos > 0 && autoAck) {
+            ack(packetId);
+        }
+        return true;
+    }
+};
+
+inline ShimBroker g_shimBroker;
+
+#endif // SHIM_BROKER_H
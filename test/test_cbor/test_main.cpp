@@ -0,0 +1,342 @@
+/**
+ * CBOR payload - round trip against the JSON payload
+ *
+ * The same samples are published with the JSON and the CBOR encoding of
+ * the JSON layout. A minimal decoder for the subset CborWriter produces
+ * (integers and maps) reads the CBOR back; it must carry the same
+ * fixed-point values and capture time as the JSON text, plus the full
+ * serial. Reports the payload sizes and the encode time per sample.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include "inverter_publisher.h"
+#include "config_manager.h"
+#include "cbor_writer.h"
+
+#define CBOR_BENCH_SAMPLES  200000
+
+static MqttClient s_client;
+
+// Decoder -------------------------------------------------------------------
+
+struct CborReader {
+    const uint8_t* data;
+    size_t length;
+    size_t position;
+    bool error;
+
+    /**
+     * Read one item head
+     * @return Major type; value holds the argument (negative: -1 - value)
+     */
+    uint8_t readHead(uint64_t& value) {
+        if (position >= length) {
+            error = true;
+            return 0xFF;
+        }
+        uint8_t head = data[position++];
+        uint8_t info = head & 0x1F;
+        value = 0;
+        if (info < 24) {
+            value = info;
+        } else if (info <= 27) {
+            uint8_t bytes = 1 << (info - 24);
+            if (position + bytes > length) {
+                error = true;
+                return 0xFF;
+            }
+            for (uint8_t i = 0; i < bytes; i++) {
+                value = (value << 8) | data[position++];
+            }
+        } else {
+            error = true;
+        }
+        return head >> 5;
+    }
+
+    bool readInt(int64_t& result) {
+        uint64_t value;
+        uint8_t major = readHead(value);
+        if (major == 0) {
+            result = (int64_t)value;
+        } else if (major == 1) {
+            result = -1 - (int64_t)value;
+        } else {
+            error = true;
+        }
+        return !error;
+    }
+};
+
+struct DecodedSample {
+    int64_t values[8];      // By InverterCborKey
+    bool present[8];
+};
+
+static bool decodeCbor(const uint8_t* data, size_t length, DecodedSample& sample) {
+    memset(&sample, 0, sizeof(sample));
+    CborReader reader = { data, length, 0, false };
+
+    uint64_t pairs;
+    if (reader.readHead(pairs) != 5) {
+        return false;
+    }
+    for (uint64_t i = 0; i < pairs; i++) {
+        int64_t key, value;
+        if (!reader.readInt(key) || !reader.readInt(value) || key < 0 || key >= 8) {
+            return false;
+        }
+        sample.values[key] = value;
+        sample.present[key] = true;
+    }
+    return !reader.error && reader.position == length;
+}
+
+/**
+ * Fixed-point value of a JSON number, e.g. "-12.3" with 1 decimal = -123
+ */
+static bool jsonValue(const char* json, const char* key, uint8_t decimals, int64_t& result) {
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char* p = strstr(json, pattern);
+    if (!p) {
+        return false;
+    }
+    p += strlen(pattern);
+
+    bool negative = *p == '-';
+    if (negative) {
+        p++;
+    }
+    int64_t value = 0;
+    while (*p >= '0' && *p <= '9') {
+        value = value * 10 + (*p++ - '0');
+    }
+    uint8_t fraction = 0;
+    if (*p == '.') {
+        p++;
+        while (*p >= '0' && *p <= '9' && fraction < decimals) {
+            value = value * 10 + (*p++ - '0');
+            fraction++;
+        }
+    }
+    for (; fraction < decimals; fraction++) {
+        value *= 10;
+    }
+    result = negative ? -value : value;
+    return true;
+}
+
+// Fixture -------------------------------------------------------------------
+
+static InverterSample makeSample(uint64_t serial, int32_t power, int32_t voltage, int32_t current) {
+    InverterSample sample;
+    sample.reset(serial, findHoymilesModel(serial, nullptr));
+    sample.data.values[0][FIELD_POWER] = power;
+    sample.data.values[0][FIELD_VOLTAGE] = voltage;
+    sample.data.values[1][FIELD_CURRENT] = current;
+    sample.timestamp = millis();
+    return sample;
+}
+
+/**
+ * Publish a sample with the given encoding
+ * @return The broker's copy of the message
+ */
+static const ShimMessage& publishAs(InverterPayloadEncoding encoding, const InverterSample& sample) {
+    static InverterPublisher publisher(s_client);
+    publisher.begin("pvlog/dtu1");
+    publisher.setEncoding(encoding);
+
+    g_shimBroker.clear();
+    TEST_ASSERT_TRUE(publisher.publish(sample));
+    TEST_ASSERT_EQUAL_UINT32(1, g_shimBroker.messages.size());
+    return g_shimBroker.messages[0];
+}
+
+static void checkRoundTrip(const InverterSample& sample) {
+    char json[INVERTER_PUBLISHER_PAYLOAD_SIZE + 1];
+    const ShimMessage& text = publishAs(InverterPayloadEncoding::JSON, sample);
+    memcpy(json, text.payload, text.length);
+    json[text.length] = '\0';
+
+    const ShimMessage& binary = publishAs(InverterPayloadEncoding::CBOR, sample);
+    TEST_ASSERT_NOT_NULL(strstr(binary.topic, "/cbor"));
+
+    DecodedSample decoded;
+    TEST_ASSERT_TRUE(decodeCbor(binary.payload, binary.length, decoded));
+
+    int64_t ts, power, voltage, current;
+    TEST_ASSERT_TRUE(jsonValue(json, "ts", 0, ts));
+    TEST_ASSERT_TRUE(jsonValue(json, "power", HOYMILES_FIELD_DECIMALS[FIELD_POWER], power));
+    TEST_ASSERT_TRUE(jsonValue(json, "voltage", HOYMILES_FIELD_DECIMALS[FIELD_VOLTAGE], voltage));
+    TEST_ASSERT_TRUE(jsonValue(json, "current", HOYMILES_FIELD_DECIMALS[FIELD_CURRENT], current));
+
+    TEST_ASSERT_EQUAL_INT32(INVERTER_CBOR_SCHEMA_VERSION, (int32_t)decoded.values[CBOR_KEY_VERSION]);
+    TEST_ASSERT_TRUE(decoded.present[CBOR_KEY_SERIAL]);
+    TEST_ASSERT_TRUE((uint64_t)decoded.values[CBOR_KEY_SERIAL] == sample.serial);
+    TEST_ASSERT_EQUAL_INT32((int32_t)power, (int32_t)decoded.values[CBOR_KEY_POWER]);
+    TEST_ASSERT_EQUAL_INT32((int32_t)voltage, (int32_t)decoded.values[CBOR_KEY_VOLTAGE]);
+    TEST_ASSERT_EQUAL_INT32((int32_t)current, (int32_t)decoded.values[CBOR_KEY_CURRENT]);
+    TEST_ASSERT_EQUAL_INT32(sample.getPower(), (int32_t)decoded.values[CBOR_KEY_POWER]);
+    TEST_ASSERT_FALSE(decoded.present[CBOR_KEY_ENERGY]);
+
+    // Unix time of the capture, not of the publish
+    uint32_t captured = (uint32_t)time(nullptr) - (uint32_t)(millis() - sample.timestamp) / 1000;
+    TEST_ASSERT_EQUAL_UINT32(captured, (uint32_t)ts);
+    TEST_ASSERT_TRUE(decoded.present[CBOR_KEY_TIME]);
+    TEST_ASSERT_EQUAL_UINT32(captured, (uint32_t)decoded.values[CBOR_KEY_TIME]);
+}
+
+void setUp() {
+    g_shimBroker.online = true;
+    g_shimBroker.clear();
+}
+
+void tearDown() {}
+
+// Tests ---------------------------------------------------------------------
+
+void test_matches_json() {
+    checkRoundTrip(makeSample(0x114172000001ULL, 5402, 2301, 2344));
+    checkRoundTrip(makeSample(0x116172000002ULL, 0, 0, 0));
+    // One, two and four byte integer heads
+    checkRoundTrip(makeSample(0x138212345678ULL, 23, 255, 65535));
+    checkRoundTrip(makeSample(0x138212345678ULL, 65536, 24, 256));
+}
+
+void test_negative_power() {
+    // Night consumption and sensor offsets report below zero
+    checkRoundTrip(makeSample(0x114172000001ULL, -1, 2301, 0));
+    checkRoundTrip(makeSample(0x114172000001ULL, -123, 2301, -5));
+    checkRoundTrip(makeSample(0x114172000001ULL, -70000, 2301, 12));
+}
+
+void test_capture_time() {
+    shimAdvance(60000);
+    InverterSample sample = makeSample(0x114172000001ULL, 5402, 2301, 2344);
+    checkRoundTrip(sample);
+
+    // Published 30 s after the response arrived, e.g. at the end of a batch
+    shimAdvance(30000);
+    checkRoundTrip(sample);
+    DecodedSample decoded;
+    const ShimMessage& binary = publishAs(InverterPayloadEncoding::CBOR, sample);
+    TEST_ASSERT_TRUE(decodeCbor(binary.payload, binary.length, decoded));
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)time(nullptr) - 30, (uint32_t)decoded.values[CBOR_KEY_TIME]);
+
+    // Without SNTP the time is left out rather than wrong
+    time_t epoch = g_shimEpoch;
+    g_shimEpoch = 0;
+    const ShimMessage& text = publishAs(InverterPayloadEncoding::JSON, sample);
+    TEST_ASSERT_EQUAL_INT(0, strncmp((const char*)text.payload, "{\"power\":", 9));
+    const ShimMessage& untimed = publishAs(InverterPayloadEncoding::CBOR, sample);
+    TEST_ASSERT_TRUE(decodeCbor(untimed.payload, untimed.length, decoded));
+    TEST_ASSERT_FALSE(decoded.present[CBOR_KEY_TIME]);
+    TEST_ASSERT_TRUE(decoded.present[CBOR_KEY_POWER]);
+    g_shimEpoch = epoch;
+}
+
+void test_64_bit_serial() {
+    // Serials above 32 bits survive (the JSON topic only carries the low 32)
+    checkRoundTrip(makeSample(0x141182FFFFFFULL, 5402, 2301, 2344));
+
+    uint8_t buffer[16];
+    CborWriter cbor(buffer, sizeof(buffer));
+    cbor.writeUInt(0xFFFFFFFFFFFFFFFFULL);
+    TEST_ASSERT_TRUE(cbor.ok());
+    TEST_ASSERT_EQUAL_UINT32(9, cbor.length());
+
+    CborReader reader = { buffer, cbor.length(), 0, false };
+    uint64_t value;
+    TEST_ASSERT_EQUAL_UINT8(0, reader.readHead(value));
+    TEST_ASSERT_TRUE(value == 0xFFFFFFFFFFFFFFFFULL);
+}
+
+void test_overflow_is_reported() {
+    uint8_t buffer[8] = { 0 };
+    CborWriter cbor(buffer, 4);
+    cbor.writeMap(5);
+    TEST_ASSERT_TRUE(cbor.ok());
+    cbor.writeUInt(0x114172000001ULL);
+
+    TEST_ASSERT_FALSE(cbor.ok());
+    TEST_ASSERT_TRUE(cbor.length() <= 4);
+    // Nothing beyond the given size is touched
+    TEST_ASSERT_EQUAL_UINT8(0, buffer[4]);
+
+    // Later writes do not clear the error
+    cbor.writeUInt(1);
+    TEST_ASSERT_FALSE(cbor.ok());
+}
+
+void test_size_and_encode_time() {
+    InverterSample sample = makeSample(0x114172000001ULL, 5402, 2301, 2344);
+    size_t jsonSize = publishAs(InverterPayloadEncoding::JSON, sample).length;
+    size_t cborSize = publishAs(InverterPayloadEncoding::CBOR, sample).length;
+
+    // Encoding only, as in the publisher
+    volatile size_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < CBOR_BENCH_SAMPLES; i++) {
+        char power[16], voltage[16], current[16], out[INVERTER_PUBLISHER_PAYLOAD_SIZE];
+        formatFixedPoint(power, sizeof(power), 5402 + (int32_t)(i & 7), 1);
+        formatFixedPoint(voltage, sizeof(voltage), 2301, 1);
+        formatFixedPoint(current, sizeof(current), 2344, 2);
+        sink += snprintf(out, sizeof(out), "{\"ts\":%lu,\"power\":%s,\"voltage\":%s,\"current\":%s}",
+                         (unsigned long)1767225600 + (i >> 3), power, voltage, current);
+    }
+    auto middle = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < CBOR_BENCH_SAMPLES; i++) {
+        uint8_t out[INVERTER_PUBLISHER_PAYLOAD_SIZE];
+        CborWriter cbor(out, sizeof(out));
+        cbor.writeMap(6);
+        cbor.writeUInt(CBOR_KEY_VERSION);
+        cbor.writeUInt(INVERTER_CBOR_SCHEMA_VERSION);
+        cbor.writeUInt(CBOR_KEY_SERIAL);
+        cbor.writeUInt(0x114172000001ULL);
+        cbor.writeUInt(CBOR_KEY_POWER);
+        cbor.writeInt(5402 + (int32_t)(i & 7));
+        cbor.writeUInt(CBOR_KEY_VOLTAGE);
+        cbor.writeInt(2301);
+        cbor.writeUInt(CBOR_KEY_CURRENT);
+        cbor.writeInt(2344);
+        cbor.writeUInt(CBOR_KEY_TIME);
+        cbor.writeUInt(1767225600 + (i >> 3));
+        sink += cbor.length();
+    }
+    auto end = std::chrono::steady_clock::now();
+    (void)sink;
+
+    double jsonNs = std::chrono::duration<double, std::nano>(middle - start).count() / CBOR_BENCH_SAMPLES;
+    double cborNs = std::chrono::duration<double, std::nano>(end - middle).count() / CBOR_BENCH_SAMPLES;
+
+    char line[128];
+    snprintf(line, sizeof(line), "JSON %u bytes, %.0f ns per sample; CBOR %u bytes, %.0f ns per sample",
+             (unsigned)jsonSize, jsonNs, (unsigned)cborSize, cborNs);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_TRUE(cborSize < jsonSize);
+}
+
+int main() {
+    g_shimBroker.messages.reserve(4);
+
+    MqttConfig config;
+    config.host = "broker.local";
+    config.port = 1883;
+    config.ssl = false;
+    s_client.begin(config);
+    s_client.connect();
+
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_json);
+    RUN_TEST(test_negative_power);
+    RUN_TEST(test_capture_time);
+    RUN_TEST(test_64_bit_serial);
+    RUN_TEST(test_overflow_is_reported);
+    RUN_TEST(test_size_and_encode_time);
+    return UNITY_END();
+}
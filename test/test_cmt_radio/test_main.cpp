@@ -0,0 +1,56 @@
+/**
+ * CMT2300A backend - transmit completes on the GPIO1 TX-done latch
+ *
+ * transmit() starts the frame, waits for TX done with the SPI bus free
+ * and returns the radio to receive mode. A TX-done pulse that never
+ * comes ends the wait after CMT2300A_TX_TIMEOUT.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <RadioLib.h>
+#include "hoymiles_radio_cmt.h"
+
+static const uint8_t FRAME[] = { 0x15, 0x11, 0x44, 0x82, 0x00, 0x80, 0x12, 0x34, 0x56, 0x78, 0x0B };
+
+static CMT2300ARadio s_radio;
+
+void setUp() {
+    g_shimCmt.reset();
+    s_radio.begin();
+}
+
+void tearDown() {}
+
+void test_transmit_waits_for_tx_done() {
+    g_shimCmt.airtime = 10;
+    g_shimOnTick = []() { g_shimCmt.service(); };
+
+    unsigned long start = millis();
+    TEST_ASSERT_TRUE(s_radio.transmit(0, FRAME, sizeof(FRAME)));
+    g_shimOnTick = nullptr;
+
+    TEST_ASSERT_EQUAL_UINT32(1, g_shimCmt.transmits);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(10, millis() - start);
+    TEST_ASSERT_LESS_THAN_UINT32(CMT2300A_TX_TIMEOUT, millis() - start);
+
+    // Back in RX, and the TX-done pulse is not taken for a packet
+    TEST_ASSERT_TRUE(g_shimCmt.canReceive());
+    TEST_ASSERT_FALSE(s_radio.available());
+}
+
+void test_transmit_times_out_without_tx_done() {
+    // GPIO1 never pulses
+    unsigned long start = millis();
+    TEST_ASSERT_FALSE(s_radio.transmit(0, FRAME, sizeof(FRAME)));
+
+    TEST_ASSERT_EQUAL_UINT32(CMT2300A_TX_TIMEOUT, millis() - start);
+    TEST_ASSERT_TRUE(g_shimCmt.canReceive());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_transmit_waits_for_tx_done);
+    RUN_TEST(test_transmit_times_out_without_tx_done);
+    return UNITY_END();
+}
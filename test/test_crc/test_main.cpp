@@ -0,0 +1,132 @@
+/**
+ * CRC kernels - known answers and table vs bitwise benchmark
+ *
+ * HoymilesProtocol::crc8/crc16 use the lookup tables from hoymiles_crc.cpp;
+ * the bit-at-a-time loops below are the former implementation and serve as
+ * reference. Reports ns per byte for both at the frame sizes seen on air.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include "hoymiles_protocol.h"
+
+#define BENCH_BYTES     (4UL * 1024UL * 1024UL)     // Bytes hashed per measurement
+
+static uint8_t crc8Bitwise(const uint8_t* data, uint8_t len) {
+    uint8_t crc = 0;
+    for (uint8_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            crc = (crc & 0x01) ? (crc >> 1) ^ 0x8C : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+static uint16_t crc16Bitwise(const uint8_t* data, uint16_t len) {
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < len; i++) {
+        crc ^= data[i];
+        for (uint8_t j = 0; j < 8; j++) {
+            crc = (crc & 0x0001) ? (crc >> 1) ^ 0xA001 : crc >> 1;
+        }
+    }
+    return crc;
+}
+
+static uint8_t s_data[512];
+static volatile uint32_t s_sink;
+
+template <typename Kernel>
+static double nsPerByte(Kernel kernel, uint16_t len) {
+    uint32_t rounds = BENCH_BYTES / len;
+    uint32_t acc = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t r = 0; r < rounds; r++) {
+        s_data[0] = (uint8_t)r;     // Keep the compiler from hoisting the call
+        acc += kernel(s_data, len);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    s_sink = acc;
+    return std::chrono::duration<double, std::nano>(elapsed).count() / ((double)rounds * len);
+}
+
+void setUp() {
+    uint32_t x = 0x12345678;
+    for (uint16_t i = 0; i < sizeof(s_data); i++) {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        s_data[i] = (uint8_t)x;
+    }
+}
+
+void tearDown() {}
+
+void test_known_answers() {
+    const uint8_t check[] = { '1', '2', '3', '4', '5', '6', '7', '8', '9' };
+    TEST_ASSERT_EQUAL_HEX8(0xA1, HoymilesProtocol::crc8(check, sizeof(check)));
+    TEST_ASSERT_EQUAL_HEX16(0x4B37, HoymilesProtocol::crc16(check, sizeof(check)));
+
+    // Empty input returns the initial value
+    TEST_ASSERT_EQUAL_HEX8(0x00, HoymilesProtocol::crc8(check, 0));
+    TEST_ASSERT_EQUAL_HEX16(0xFFFF, HoymilesProtocol::crc16(check, 0));
+
+    // A payload followed by its CRC16 (low byte first) hashes to zero
+    uint8_t framed[34];
+    memcpy(framed, s_data, 32);
+    uint16_t crc = HoymilesProtocol::crc16(framed, 32);
+    framed[32] = crc & 0xFF;
+    framed[33] = crc >> 8;
+    TEST_ASSERT_EQUAL_HEX16(0x0000, HoymilesProtocol::crc16(framed, sizeof(framed)));
+}
+
+void test_table_matches_bitwise() {
+    for (uint16_t len = 0; len <= 255; len++) {
+        TEST_ASSERT_EQUAL_HEX8(crc8Bitwise(s_data, len), HoymilesProtocol::crc8(s_data, len));
+    }
+    for (uint16_t len = 0; len <= sizeof(s_data); len++) {
+        TEST_ASSERT_EQUAL_HEX16(crc16Bitwise(s_data, len), HoymilesProtocol::crc16(s_data, len));
+    }
+
+    // Every single-byte input, i.e. every table entry
+    for (uint16_t b = 0; b < 256; b++) {
+        uint8_t byte = (uint8_t)b;
+        TEST_ASSERT_EQUAL_HEX8(crc8Bitwise(&byte, 1), HoymilesProtocol::crc8(&byte, 1));
+        TEST_ASSERT_EQUAL_HEX16(crc16Bitwise(&byte, 1), HoymilesProtocol::crc16(&byte, 1));
+    }
+}
+
+void test_benchmark() {
+    // Request frame, full NRF24 frame (without its CRC8), reassembled payloads
+    const uint16_t crc8Sizes[] = { 11, 31 };
+    const uint16_t crc16Sizes[] = { 42, 62, 200 };
+    char line[120];
+
+    for (uint16_t len : crc8Sizes) {
+        double bitwise = nsPerByte([](const uint8_t* d, uint16_t n) { return (uint32_t)crc8Bitwise(d, n); }, len);
+        double table = nsPerByte([](const uint8_t* d, uint16_t n) { return (uint32_t)HoymilesProtocol::crc8(d, n); }, len);
+        snprintf(line, sizeof(line), "crc8  %3u bytes: bitwise %.2f ns/B, table %.2f ns/B (x%.1f)",
+                 len, bitwise, table, bitwise / table);
+        TEST_MESSAGE(line);
+        TEST_ASSERT_TRUE(table < bitwise);
+    }
+
+    for (uint16_t len : crc16Sizes) {
+        double bitwise = nsPerByte([](const uint8_t* d, uint16_t n) { return (uint32_t)crc16Bitwise(d, n); }, len);
+        double table = nsPerByte([](const uint8_t* d, uint16_t n) { return (uint32_t)HoymilesProtocol::crc16(d, n); }, len);
+        snprintf(line, sizeof(line), "crc16 %3u bytes: bitwise %.2f ns/B, table %.2f ns/B (x%.1f)",
+                 len, bitwise, table, bitwise / table);
+        TEST_MESSAGE(line);
+        TEST_ASSERT_TRUE(table < bitwise);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_known_answers);
+    RUN_TEST(test_table_matches_bitwise);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,186 @@
+/**
+ * Fixed-point formatting - known answers and fixed vs float benchmark
+ *
+ * Realtime values are kept as scaled integers and printed with
+ * formatFixedPoint(). The float path below is the former implementation
+ * (raw / 10.0f, then String(float)) and serves as reference. Reports ns
+ * per sample for both, where a sample is one decoded HM-600 payload with
+ * every field formatted as text.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include "fixed_point.h"
+#include "hoymiles_models.h"
+
+#define BENCH_SAMPLES   200000UL    // Payloads decoded and formatted per measurement
+
+typedef HoymilesLayout2Ch BenchLayout;
+
+static uint8_t s_payload[HoymilesDecoder::minPayloadLength<BenchLayout>()];
+static volatile uint32_t s_sink;
+
+static void putField(const HoymilesFieldDescriptor& f, int32_t raw) {
+    for (uint8_t i = 0; i < f.width; i++) {
+        s_payload[f.offset + i] = (uint8_t)((uint32_t)raw >> (8 * (f.width - 1 - i)));
+    }
+}
+
+static int32_t rawField(const HoymilesFieldDescriptor& f) {
+    const uint8_t* p = s_payload + f.offset;
+    if (f.width == 4) {
+        return (int32_t)(((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3]);
+    }
+    return f.isSigned ? (int16_t)((p[0] << 8) | p[1]) : (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static float floatField(const HoymilesFieldDescriptor& f) {
+    switch (f.decimals) {
+        case 1:  return rawField(f) / 10.0f;
+        case 2:  return rawField(f) / 100.0f;
+        case 3:  return rawField(f) / 1000.0f;
+        default: return (float)rawField(f);
+    }
+}
+
+static String formatFloatSample() {
+    String text;
+    for (const HoymilesFieldDescriptor& f : BenchLayout::fields) {
+        text += String(floatField(f), f.decimals);
+        text += ',';
+    }
+    return text;
+}
+
+static size_t formatFixedSample(char* buffer, size_t size) {
+    HoymilesRealtimeData data = {};
+    if (!HoymilesDecoder::decode<BenchLayout>(s_payload, sizeof(s_payload), data)) {
+        return 0;
+    }
+    size_t length = 0;
+    for (const HoymilesFieldDescriptor& f : BenchLayout::fields) {
+        length += data.format(buffer + length, size - length - 1, f.channel, f.field);
+        buffer[length++] = ',';
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+static void expectFormat(const char* expected, int32_t value, uint8_t decimals) {
+    char text[16];
+    TEST_ASSERT_EQUAL_UINT32(strlen(expected), formatFixedPoint(text, sizeof(text), value, decimals));
+    TEST_ASSERT_EQUAL_STRING(expected, text);
+}
+
+void setUp() {
+    // A mid-day HM-600 sample; values are raw, in the field's own scale
+    for (const HoymilesFieldDescriptor& f : BenchLayout::fields) {
+        int32_t raw;
+        switch (f.field) {
+            case FIELD_VOLTAGE:         raw = f.channel ? 3412 + f.channel : 2307; break;
+            case FIELD_CURRENT:         raw = f.channel ? 905 - f.channel : 118; break;
+            case FIELD_POWER:           raw = f.channel ? 3087 + f.channel : 5462; break;
+            case FIELD_YIELD_TOTAL:     raw = 1234567; break;
+            case FIELD_YIELD_DAY:       raw = 2150; break;
+            case FIELD_FREQUENCY:       raw = 4998; break;
+            case FIELD_REACTIVE_POWER:  raw = -12; break;
+            case FIELD_POWER_FACTOR:    raw = 998; break;
+            case FIELD_TEMPERATURE:     raw = -35; break;
+            default:                    raw = 0; break;
+        }
+        putField(f, raw);
+    }
+}
+
+void tearDown() {}
+
+void test_zero() {
+    expectFormat("0", 0, 0);
+    expectFormat("0.0", 0, 1);
+    expectFormat("0.00", 0, 2);
+    expectFormat("0.000", 0, 3);
+    expectFormat("0.0000", 0, 4);
+}
+
+void test_each_decimals_count() {
+    expectFormat("12345", 12345, 0);
+    expectFormat("1234.5", 12345, 1);
+    expectFormat("123.45", 12345, 2);
+    expectFormat("12.345", 12345, 3);
+    expectFormat("1.2345", 12345, 4);
+
+    // Leading zeros of the fraction
+    expectFormat("0.5", 5, 1);
+    expectFormat("0.05", 5, 2);
+    expectFormat("0.005", 5, 3);
+    expectFormat("0.0005", 5, 4);
+    expectFormat("2147483647", INT32_MAX, 0);
+}
+
+void test_negative() {
+    expectFormat("-7", -7, 0);
+    expectFormat("-1234.5", -12345, 1);
+    expectFormat("-0.5", -5, 1);
+    expectFormat("-0.05", -5, 2);
+    expectFormat("-0.012", -12, 3);
+    expectFormat("-1.0000", -10000, 4);
+    expectFormat("-2147483648", INT32_MIN, 0);
+    expectFormat("-214748.3648", INT32_MIN, 4);
+}
+
+void test_buffer_too_small() {
+    char text[8];
+    memset(text, 'x', sizeof(text));
+
+    // "1234.5" needs 7 bytes including the terminator
+    TEST_ASSERT_EQUAL_UINT32(6, formatFixedPoint(text, 7, 12345, 1));
+    TEST_ASSERT_EQUAL_UINT32(0, formatFixedPoint(text, 6, 12345, 1));
+    TEST_ASSERT_EQUAL_STRING("", text);
+    TEST_ASSERT_EQUAL_UINT32(0, formatFixedPoint(text, 3, -5, 2));
+}
+
+void test_fixed_matches_float() {
+    char fixed[256];
+    TEST_ASSERT_GREATER_THAN_UINT32(0, formatFixedSample(fixed, sizeof(fixed)));
+    TEST_ASSERT_EQUAL_STRING(formatFloatSample().c_str(), fixed);
+}
+
+void test_benchmark() {
+    char fixed[256];
+    char line[120];
+    uint32_t acc = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+        s_payload[7] = (uint8_t)i;      // DC1 power, keeps the compiler from hoisting the work
+        acc += formatFixedSample(fixed, sizeof(fixed));
+    }
+    double fixedNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+    start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < BENCH_SAMPLES; i++) {
+        s_payload[7] = (uint8_t)i;
+        acc += formatFloatSample().length();
+    }
+    double floatNs = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    s_sink = acc;
+
+    fixedNs /= BENCH_SAMPLES;
+    floatNs /= BENCH_SAMPLES;
+    snprintf(line, sizeof(line), "%u fields/sample: float %.1f ns/sample, fixed %.1f ns/sample (x%.1f)",
+             (unsigned)HoymilesDecoder::fieldCount<BenchLayout>(), floatNs, fixedNs, floatNs / fixedNs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(fixedNs < floatNs);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_zero);
+    RUN_TEST(test_each_decimals_count);
+    RUN_TEST(test_negative);
+    RUN_TEST(test_buffer_too_small);
+    RUN_TEST(test_fixed_matches_float);
+    RUN_TEST(test_benchmark);
+    return UNITY_END();
+}
@@ -0,0 +1,129 @@
+/**
+ * HMS heap use - 100k polls through the CMT2300A backend allocate nothing
+ *
+ * HoymilesHMS creates its CMT2300ARadio in begin(), as on the device; the
+ * RadioLib shim stands in for the chip and SimulatedRadio for the
+ * inverters on the other end of the 868 MHz link. Global operator new is
+ * counted: after begin() every request, GPIO1 interrupt, FIFO read,
+ * fragment request and decode must run without a heap allocation, and
+ * only one CMT2300A driver instance may ever exist.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <RadioLib.h>
+#include <new>
+#include "hoymiles_hms.h"
+#include "hoymiles_radio_sim.h"
+
+#define HEAP_POLLS      100000UL    // Realtime requests sent
+#define HEAP_STEP       10          // ms between two loop() calls
+
+static uint32_t s_allocations;
+static int32_t s_live;
+
+void* operator new(size_t size) {
+    s_allocations++;
+    s_live++;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    if (p) {
+        s_live--;
+        free(p);
+    }
+}
+
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+static const uint64_t SERIALS[] = { 0x114482000001ULL, 0x138282000002ULL };
+
+// Inverter side of the link
+static SimulatedRadio s_air(true, 3);
+static uint32_t s_samples;
+
+/**
+ * Radio -> inverters: HMS requests carry the full serial (bytes 11..18)
+ */
+static void onTransmit(void*, const uint8_t* data, size_t len) {
+    uint64_t serial = 0;
+    for (uint8_t i = 11; i < 19 && i < len; i++) {
+        serial = (serial << 8) | data[i];
+    }
+    s_air.transmit(serial, data, len);
+}
+
+/**
+ * Inverters -> radio: due fragments reach the chip while it listens
+ */
+static void onTick() {
+    g_shimCmt.service();
+    uint8_t frame[SHIM_CMT_MAX_PACKET];
+    while (g_shimCmt.canReceive() && s_air.available()) {
+        uint8_t len = s_air.read(frame, sizeof(frame));
+        if (len > 0) {
+            g_shimCmt.deliver(frame, len);
+        }
+    }
+}
+
+static void onSample(void*, const InverterSample&) {
+    s_samples++;
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_polls_do_not_allocate() {
+    for (uint64_t serial : SERIALS) {
+        SimulatedInverter inverter = { serial, 40, 10, 5, 10, HOYMILES_SIM_ANY_CHANNEL, -70, true };
+        s_air.addInverter(inverter);
+    }
+    g_shimCmt.reset();
+    g_shimCmt.onTransmit = onTransmit;
+    g_shimOnTick = onTick;
+
+    HoymilesHMS hms;
+    hms.begin();
+    for (uint64_t serial : SERIALS) {
+        hms.addInverter(serial);
+    }
+    hms.subscribe(onSample);
+    hms.setPollInterval(HOYMILES_SCHEDULER_MIN_INTERVAL);
+
+    uint32_t allocations = s_allocations;
+    int32_t live = s_live;
+
+    const SimulatedRadio::Stats& stats = s_air.getStats();
+    while (stats.requests + stats.requestsLost < HEAP_POLLS) {
+        hms.loop();
+        shimAdvance(HEAP_STEP);
+    }
+    g_shimOnTick = nullptr;
+
+    char line[160];
+    snprintf(line, sizeof(line),
+             "%lu requests, %lu fragment requests, %lu samples, %lu allocations, %ld live blocks",
+             (unsigned long)(stats.requests + stats.requestsLost), (unsigned long)stats.fragmentRequests,
+             (unsigned long)s_samples, (unsigned long)(s_allocations - allocations), (long)(s_live - live));
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(1, g_shimCmt.instances);
+    TEST_ASSERT_EQUAL_UINT32(0, s_allocations - allocations);
+    TEST_ASSERT_EQUAL_INT32(live, s_live);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.fragmentRequests);
+    TEST_ASSERT_GREATER_THAN_UINT32(HEAP_POLLS * 8 / 10, s_samples);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_polls_do_not_allocate);
+    return UNITY_END();
+}
@@ -0,0 +1,306 @@
+/**
+ * MQTT outbox - ring accounting and concurrent hand-over
+ *
+ * Messages carry a sequence number and a payload derived from it, so every
+ * copy can be checked for order and tearing. Covers records wrapping at
+ * the end of the ring, drop-oldest accounting (wrap markers are not
+ * messages), rejects of oversized messages, QoS 1 refusals, a consumer
+ * reading ahead of the tail while the producer drops, and a producer and
+ * consumer thread running against each other.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "mqtt_outbox.h"
+
+#define OUTBOX_THREAD_MESSAGES  200000
+
+static MqttOutbox* s_outbox;
+static MqttOutboxMessage s_message;
+
+/**
+ * Topic "t/<seq % 7 digits>"; payload: seq (4 bytes), then bytes derived from it
+ */
+static bool pushSeq(MqttOutbox& outbox, uint32_t seq, size_t length, uint8_t qos = 0) {
+    char topic[16];
+    snprintf(topic, sizeof(topic), "t/%.*s", (int)(seq % 7) + 1, "1234567");
+
+    uint8_t payload[MQTT_OUTBOX_MAX_PAYLOAD];
+    if (length < 4) {
+        length = 4;
+    }
+    memcpy(payload, &seq, 4);
+    for (size_t i = 4; i < length; i++) {
+        payload[i] = (uint8_t)(seq * 31 + i);
+    }
+    return outbox.push(topic, payload, length, false, qos);
+}
+
+/**
+ * Check a copied message against its sequence number
+ * @return Sequence number
+ */
+static uint32_t checkSeq(const MqttOutboxMessage& message) {
+    TEST_ASSERT_TRUE(message.length >= 4);
+    uint32_t seq;
+    memcpy(&seq, message.payload, 4);
+
+    char topic[16];
+    snprintf(topic, sizeof(topic), "t/%.*s", (int)(seq % 7) + 1, "1234567");
+    TEST_ASSERT_EQUAL_STRING(topic, message.topic);
+    for (size_t i = 4; i < message.length; i++) {
+        TEST_ASSERT_EQUAL_UINT8((uint8_t)(seq * 31 + i), message.payload[i]);
+    }
+    return seq;
+}
+
+/**
+ * Take the oldest message
+ * @return Its sequence number, -1 if the outbox is empty
+ */
+static long popSeq(MqttOutbox& outbox) {
+    if (!outbox.peek(outbox.front(), s_message)) {
+        return -1;
+    }
+    uint32_t seq = checkSeq(s_message);
+    TEST_ASSERT_TRUE(outbox.release(s_message.position, s_message.next));
+    return seq;
+}
+
+void setUp() {
+    s_outbox = new MqttOutbox();
+}
+
+void tearDown() {
+    delete s_outbox;
+}
+
+void test_wrap_around() {
+    MqttOutbox& outbox = *s_outbox;
+    srand(7);
+
+    // Random sizes keep the wrap point moving; a few messages stay queued
+    uint32_t pushed = 0, popped = 0;
+    for (int round = 0; round < 20000; round++) {
+        size_t length = 4 + rand() % 600;
+        TEST_ASSERT_TRUE(pushSeq(outbox, pushed++, length));
+        if (pushed - popped > 3) {
+            TEST_ASSERT_EQUAL_INT((long)popped, popSeq(outbox));
+            popped++;
+        }
+    }
+    while (popped < pushed) {
+        TEST_ASSERT_EQUAL_INT((long)popped, popSeq(outbox));
+        popped++;
+    }
+
+    TEST_ASSERT_TRUE(outbox.isEmpty());
+    TEST_ASSERT_EQUAL_INT(-1, popSeq(outbox));
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.getDroppedCount());
+    // Positions keep counting, far past the ring size
+    TEST_ASSERT_GREATER_THAN_UINT32(100 * MQTT_OUTBOX_SIZE, outbox.front());
+}
+
+void test_drop_oldest_accounting() {
+    MqttOutbox& outbox = *s_outbox;
+    srand(3);
+
+    // Nobody consumes: every push beyond the capacity drops the oldest messages
+    uint32_t pushed = 0;
+    for (; pushed < 5000; pushed++) {
+        TEST_ASSERT_TRUE(pushSeq(outbox, pushed, 4 + rand() % 300));
+    }
+
+    // The rest are the newest, consecutive, and every other message was counted
+    long first = popSeq(outbox);
+    TEST_ASSERT_TRUE(first > 0);
+    uint32_t kept = 1;
+    long seq, previous = first;
+    while ((seq = popSeq(outbox)) >= 0) {
+        TEST_ASSERT_EQUAL_INT(previous + 1, seq);
+        previous = seq;
+        kept++;
+    }
+    TEST_ASSERT_EQUAL_INT((long)pushed - 1, previous);
+    TEST_ASSERT_EQUAL_UINT32(pushed - kept, outbox.getDroppedCount());
+    TEST_ASSERT_EQUAL_UINT32((uint32_t)first, outbox.getDroppedCount());
+
+    char line[96];
+    snprintf(line, sizeof(line), "%lu pushed, %lu kept, %lu dropped",
+             (unsigned long)pushed, (unsigned long)kept, (unsigned long)outbox.getDroppedCount());
+    TEST_MESSAGE(line);
+}
+
+void test_oversized_rejects() {
+    MqttOutbox& outbox = *s_outbox;
+    uint8_t payload[MQTT_OUTBOX_MAX_PAYLOAD + 1] = { 0 };
+    char topic[MQTT_OUTBOX_MAX_TOPIC + 2];
+
+    TEST_ASSERT_TRUE(pushSeq(outbox, 0, 8));
+
+    TEST_ASSERT_FALSE(outbox.push("t/1", payload, MQTT_OUTBOX_MAX_PAYLOAD + 1, false));
+    TEST_ASSERT_FALSE(outbox.push("", payload, 4, false));
+    memset(topic, 'x', sizeof(topic) - 1);
+    topic[sizeof(topic) - 1] = '\0';
+    TEST_ASSERT_FALSE(outbox.push(topic, payload, 4, false));
+    TEST_ASSERT_EQUAL_UINT32(3, outbox.getRejectedCount());
+
+    // The largest message fits, and rejects left the queue untouched
+    topic[MQTT_OUTBOX_MAX_TOPIC] = '\0';
+    TEST_ASSERT_TRUE(outbox.push(topic, payload, MQTT_OUTBOX_MAX_PAYLOAD, true, 1));
+    TEST_ASSERT_EQUAL_INT(0, popSeq(outbox));
+    TEST_ASSERT_TRUE(outbox.peek(outbox.front(), s_message));
+    TEST_ASSERT_EQUAL_UINT32(MQTT_OUTBOX_MAX_TOPIC, strlen(s_message.topic));
+    TEST_ASSERT_EQUAL_UINT32(MQTT_OUTBOX_MAX_PAYLOAD, s_message.length);
+    TEST_ASSERT_TRUE(s_message.retained);
+    TEST_ASSERT_EQUAL_UINT8(1, s_message.qos);
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.getDroppedCount());
+    TEST_ASSERT_EQUAL_UINT32(3, outbox.getRejectedCount());
+}
+
+void test_qos1_is_refused_not_dropped() {
+    MqttOutbox& outbox = *s_outbox;
+
+    uint32_t pushed = 0;
+    while (pushSeq(outbox, pushed, 200, 1)) {
+        pushed++;
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, outbox.getRefusedCount());
+    TEST_ASSERT_EQUAL_UINT32(0, outbox.getDroppedCount());
+
+    // QoS 0 cannot push a QoS 1 message out either
+    TEST_ASSERT_FALSE(pushSeq(outbox, pushed, 200, 0));
+    TEST_ASSERT_EQUAL_UINT32(2, outbox.getRefusedCount());
+
+    // Acknowledging the oldest makes room again (two if the record has to wrap)
+    uint32_t acked = 0;
+    while (!pushSeq(outbox, pushed, 200, 1)) {
+        TEST_ASSERT_EQUAL_INT((long)acked, popSeq(outbox));
+        acked++;
+    }
+    TEST_ASSERT_TRUE(acked >= 1 && acked <= 2);
+    for (uint32_t seq = acked; seq <= pushed; seq++) {
+        TEST_ASSERT_EQUAL_INT((long)seq, popSeq(outbox));
+    }
+    TEST_ASSERT_TRUE(outbox.isEmpty());
+}
+
+/**
+ * The consumer sends ahead of the tail (in-flight window) while the
+ * producer drops the oldest QoS 0 messages under it
+ */
+void test_read_ahead_with_drops() {
+    MqttOutbox& outbox = *s_outbox;
+    srand(11);
+
+    uint32_t pushed = 0, received = 0;
+    uint32_t cursor = outbox.front();
+    long last = -1;
+
+    for (int step = 0; step < 50000; step++) {
+        if (rand() % 100 < 60) {
+            TEST_ASSERT_TRUE(pushSeq(outbox, pushed++, 4 + rand() % 400));
+            continue;
+        }
+
+        // Send the next message at the cursor, or the oldest if it was dropped
+        if (outbox.peek(cursor, s_message)) {
+            long seq = checkSeq(s_message);
+            TEST_ASSERT_TRUE(seq > last);
+            last = seq;
+            cursor = s_message.next;
+            received++;
+        }
+
+        // Release everything sent so far now and then, like a batch of PUBACKs
+        if (rand() % 4 == 0) {
+            MqttOutboxMessage oldest;
+            while (outbox.peek(outbox.front(), oldest) && (int32_t)(oldest.next - cursor) <= 0) {
+                TEST_ASSERT_TRUE(outbox.release(oldest.position, oldest.next));
+            }
+        }
+    }
+
+    while (outbox.peek(cursor, s_message)) {
+        long seq = checkSeq(s_message);
+        TEST_ASSERT_TRUE(seq > last);
+        last = seq;
+        cursor = s_message.next;
+        received++;
+    }
+    TEST_ASSERT_EQUAL_INT((long)pushed - 1, last);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, outbox.getDroppedCount());
+    TEST_ASSERT_TRUE(received + outbox.getDroppedCount() >= pushed);
+}
+
+void test_producer_consumer_threads() {
+    MqttOutbox& outbox = *s_outbox;
+    std::atomic<bool> done(false);
+    uint32_t received = 0;
+    uint32_t torn = 0;
+    long last = -1;
+
+    std::thread consumer([&]() {
+        MqttOutboxMessage message;
+        for (;;) {
+            bool finished = done.load();
+            if (!outbox.peek(outbox.front(), message)) {
+                if (finished) {
+                    break;
+                }
+                continue;
+            }
+
+            uint32_t seq;
+            memcpy(&seq, message.payload, 4);
+            for (size_t i = 4; i < message.length; i++) {
+                if (message.payload[i] != (uint8_t)(seq * 31 + i)) {
+                    torn++;
+                    break;
+                }
+            }
+            if ((long)seq <= last) {
+                torn++;
+            }
+            last = seq;
+            received++;
+            outbox.release(message.position, message.next);
+        }
+    });
+
+    uint32_t seed = 5;
+    for (uint32_t seq = 0; seq < OUTBOX_THREAD_MESSAGES; seq++) {
+        seed = seed * 1103515245 + 12345;
+        TEST_ASSERT_TRUE(pushSeq(outbox, seq, 4 + (seed >> 16) % 700));
+        // Give the consumer a chance, so the two sides really interleave
+        if (seq % 8 == 0) {
+            std::this_thread::yield();
+        }
+    }
+    done.store(true);
+    consumer.join();
+
+    char line[112];
+    snprintf(line, sizeof(line), "%lu pushed, %lu received, %lu dropped",
+             (unsigned long)OUTBOX_THREAD_MESSAGES, (unsigned long)received,
+             (unsigned long)outbox.getDroppedCount());
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+    TEST_ASSERT_EQUAL_INT(OUTBOX_THREAD_MESSAGES - 1, last);
+    TEST_ASSERT_EQUAL_UINT32(OUTBOX_THREAD_MESSAGES, received + outbox.getDroppedCount());
+    TEST_ASSERT_TRUE(outbox.isEmpty());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_wrap_around);
+    RUN_TEST(test_drop_oldest_accounting);
+    RUN_TEST(test_oversized_rejects);
+    RUN_TEST(test_qos1_is_refused_not_dropped);
+    RUN_TEST(test_read_ahead_with_drops);
+    RUN_TEST(test_producer_consumer_threads);
+    return UNITY_END();
+}
@@ -0,0 +1,279 @@
+/**
+ * MQTT in-flight window - QoS 1 delivery through the MQTT task
+ *
+ * The task runs on the FreeRTOS shim, one turn at a time, against the shim
+ * broker with automatic PUBACKs switched off: the test decides which
+ * messages are acknowledged and when. Covers out-of-order PUBACKs (a
+ * message leaves the outbox only with everything before it), the resend
+ * of unacknowledged messages with their packet identifiers after a
+ * reconnect, the reconnect forced by a missing PUBACK, and the publisher
+ * spooling once window and outbox are full.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <set>
+#include "mqtt_client.h"
+#include "inverter_publisher.h"
+#include "telemetry_spool.h"
+
+static MqttClient* s_client;
+
+/**
+ * Connect and hand the client to the MQTT task
+ */
+static MqttClient& startClient(uint8_t window) {
+    MqttConfig config;
+    config.host = "broker.local";
+    config.port = 1883;
+    config.ssl = false;
+
+    s_client = new MqttClient();
+    s_client->begin(config);
+    TEST_ASSERT_TRUE(s_client->connect());
+    s_client->setInflightWindow(window);
+    TEST_ASSERT_TRUE(s_client->startTask());
+    return *s_client;
+}
+
+static bool publishSeq(MqttClient& client, uint32_t seq) {
+    char topic[16], payload[24];
+    snprintf(topic, sizeof(topic), "t/%lu", (unsigned long)seq);
+    int length = snprintf(payload, sizeof(payload), "payload-%lu", (unsigned long)seq);
+    return client.publish(topic, (const uint8_t*)payload, length, false, 1);
+}
+
+/**
+ * Sequence number of a received message, checked against its payload
+ */
+static long seqOf(const ShimMessage& message) {
+    unsigned long seq;
+    TEST_ASSERT_EQUAL_INT(1, sscanf(message.topic, "t/%lu", &seq));
+    char payload[24];
+    snprintf(payload, sizeof(payload), "payload-%lu", seq);
+    TEST_ASSERT_EQUAL_UINT32(strlen(payload), message.length);
+    TEST_ASSERT_TRUE(memcmp(payload, message.payload, message.length) == 0);
+    TEST_ASSERT_EQUAL_UINT8(1, message.qos);
+    return (long)seq;
+}
+
+static void expectReceived(size_t index, long seq, uint16_t packetId) {
+    TEST_ASSERT_TRUE(index < g_shimBroker.messages.size());
+    TEST_ASSERT_EQUAL_INT(seq, seqOf(g_shimBroker.messages[index]));
+    TEST_ASSERT_EQUAL_HEX16(packetId, g_shimBroker.messages[index].packetId);
+}
+
+void setUp() {
+    g_shimFs.clear();
+    g_shimBroker.online = true;
+    g_shimBroker.autoAck = false;
+    g_shimBroker.kick();
+    g_shimBroker.clear();
+    g_shimBroker.connects = 0;
+    s_client = nullptr;
+}
+
+void tearDown() {
+    // The task of this test stays parked and never touches the client again
+    shimResetTasks();
+    delete s_client;
+}
+
+void test_out_of_order_acks() {
+    MqttClient& client = startClient(4);
+
+    for (uint32_t seq = 0; seq < 6; seq++) {
+        TEST_ASSERT_TRUE(publishSeq(client, seq));
+    }
+    shimRunTasks();
+
+    // The window: four messages, packet identifiers in turn
+    TEST_ASSERT_EQUAL_UINT32(4, g_shimBroker.messages.size());
+    for (uint32_t seq = 0; seq < 4; seq++) {
+        expectReceived(seq, seq, seq + 1);
+    }
+
+    // Acknowledged, but behind the unacknowledged first message: nothing is released
+    g_shimBroker.ack(3);
+    g_shimBroker.ack(2);
+    shimRunTasks(3);
+    TEST_ASSERT_EQUAL_UINT32(4, g_shimBroker.messages.size());
+
+    // The first PUBACK releases the first three, two slots go to the rest
+    g_shimBroker.ack(1);
+    shimRunTasks();
+    TEST_ASSERT_EQUAL_UINT32(6, g_shimBroker.messages.size());
+    expectReceived(4, 4, 5);
+    expectReceived(5, 5, 6);
+
+    // Last first: the window empties only with the oldest
+    g_shimBroker.ack(6);
+    g_shimBroker.ack(5);
+    shimRunTasks();
+    for (uint32_t seq = 6; seq < 10; seq++) {
+        TEST_ASSERT_TRUE(publishSeq(client, seq));
+    }
+    shimRunTasks();
+    TEST_ASSERT_EQUAL_UINT32(7, g_shimBroker.messages.size());
+    expectReceived(6, 6, 7);
+
+    g_shimBroker.ack(4);
+    shimRunTasks();
+    TEST_ASSERT_EQUAL_UINT32(10, g_shimBroker.messages.size());
+    expectReceived(9, 9, 10);
+    TEST_ASSERT_EQUAL_UINT32(1, g_shimBroker.connects);
+    TEST_ASSERT_EQUAL_UINT32(0, client.getRetransmitCount());
+}
+
+void test_resend_after_reconnect() {
+    MqttClient& client = startClient(4);
+
+    for (uint32_t seq = 0; seq < 5; seq++) {
+        TEST_ASSERT_TRUE(publishSeq(client, seq));
+    }
+    shimRunTasks();
+    TEST_ASSERT_EQUAL_UINT32(4, g_shimBroker.messages.size());
+    g_shimBroker.ack(2);
+    shimRunTasks();
+
+    // The broker goes away with three messages unacknowledged
+    g_shimBroker.kick();
+    g_shimBroker.online = false;
+    shimRunTasks();
+    TEST_ASSERT_FALSE(client.isConnected());
+    TEST_ASSERT_FALSE(publishSeq(client, 5));     // The caller spools it
+
+    // Back after the reconnect interval: the unacknowledged messages again,
+    // oldest first and with their packet identifiers, then the queued one
+    g_shimBroker.online = true;
+    shimAdvance(MQTT_RECONNECT_INTERVAL + 1);
+    shimRunTasks();
+    TEST_ASSERT_TRUE(client.isConnected());
+    TEST_ASSERT_EQUAL_UINT32(2, g_shimBroker.connects);
+    TEST_ASSERT_EQUAL_UINT32(3, client.getRetransmitCount());
+    TEST_ASSERT_EQUAL_UINT32(7, g_shimBroker.messages.size());
+    expectReceived(4, 0, 1);
+    expectReceived(5, 2, 3);
+    expectReceived(6, 3, 4);
+
+    // Message 4 waited outside the window; it gets the next identifier
+    g_shimBroker.ack(1);
+    shimRunTasks();
+    TEST_ASSERT_EQUAL_UINT32(8, g_shimBroker.messages.size());
+    expectReceived(7, 4, 5);
+
+    g_shimBroker.ack(4);
+    g_shimBroker.ack(3);
+    g_shimBroker.ack(5);
+    shimRunTasks();
+    TEST_ASSERT_TRUE(publishSeq(client, 6));
+    shimRunTasks();
+    TEST_ASSERT_EQUAL_UINT32(9, g_shimBroker.messages.size());
+    expectReceived(8, 6, 6);
+    TEST_ASSERT_EQUAL_UINT32(3, client.getRetransmitCount());
+}
+
+void test_puback_timeout() {
+    MqttClient& client = startClient(4);
+
+    TEST_ASSERT_TRUE(publishSeq(client, 0));
+    TEST_ASSERT_TRUE(publishSeq(client, 1));
+    shimRunTasks();
+    TEST_ASSERT_EQUAL_UINT32(2, g_shimBroker.messages.size());
+
+    // Only the second is acknowledged; just before the timeout nothing happens
+    g_shimBroker.ack(2);
+    shimAdvance(MQTT_INFLIGHT_TIMEOUT - 1);
+    shimRunTasks();
+    TEST_ASSERT_TRUE(client.isConnected());
+    TEST_ASSERT_EQUAL_UINT32(1, g_shimBroker.connects);
+
+    // The missing PUBACK drops the connection ...
+    shimAdvance(1);
+    shimRunTasks();
+    TEST_ASSERT_FALSE(client.isConnected());
+
+    // ... and the reconnect sends only the unacknowledged message again
+    shimRunTasks();
+    TEST_ASSERT_TRUE(client.isConnected());
+    TEST_ASSERT_EQUAL_UINT32(2, g_shimBroker.connects);
+    TEST_ASSERT_EQUAL_UINT32(1, client.getRetransmitCount());
+    TEST_ASSERT_EQUAL_UINT32(3, g_shimBroker.messages.size());
+    expectReceived(2, 0, 1);
+
+    // Acknowledged this time: the window is empty and stays connected
+    g_shimBroker.ack(1);
+    shimRunTasks();
+    shimAdvance(2 * MQTT_INFLIGHT_TIMEOUT);
+    shimRunTasks();
+    TEST_ASSERT_TRUE(client.isConnected());
+    TEST_ASSERT_EQUAL_UINT32(2, g_shimBroker.connects);
+    TEST_ASSERT_EQUAL_UINT32(3, g_shimBroker.messages.size());
+}
+
+void test_spill_into_spool() {
+    MqttClient& client = startClient(2);
+
+    TelemetrySpool spool;
+    TEST_ASSERT_TRUE(spool.begin());
+    InverterPublisher publisher(client);
+    publisher.begin("opendtu/240AC4000001");
+    publisher.setSpool(&spool);
+    publisher.setQos(1);
+
+    InverterSample sample;
+    sample.reset(0x114172000001ULL, findHoymilesModel(0x114172000001ULL, nullptr));
+    auto capture = [&](int32_t number) {
+        sample.data.values[0][FIELD_POWER] = number * 10;
+        sample.timestamp = millis();
+        TEST_ASSERT_TRUE(publisher.publish(sample));
+    };
+
+    // No PUBACKs: two messages in flight, the outbox fills up (some 75 of
+    // these), the rest is spooled
+    const int32_t samples = 150;
+    for (int32_t number = 1; number <= samples; number++) {
+        capture(number);
+        shimAdvance(100);           // Well within the PUBACK timeout
+        shimRunTasks();
+        publisher.loop();
+    }
+    TEST_ASSERT_EQUAL_UINT32(2, g_shimBroker.messages.size());
+    TEST_ASSERT_FALSE(spool.isEmpty());
+    TEST_ASSERT_GREATER_THAN_UINT32(0, client.getRefusedCount());
+    TEST_ASSERT_EQUAL_UINT32(0, client.getDroppedCount());
+
+    // The broker catches up: every sample arrives exactly once
+    g_shimBroker.autoAck = true;
+    g_shimBroker.ack(1);
+    g_shimBroker.ack(2);
+    for (int step = 0; step < 1000 && (!spool.isEmpty() || g_shimBroker.messages.size() < (size_t)samples); step++) {
+        shimAdvance(TELEMETRY_SPOOL_REPLAY_INTERVAL);
+        shimRunTasks();
+        publisher.loop();
+    }
+    shimRunTasks(2);
+
+    TEST_ASSERT_TRUE(spool.isEmpty());
+    TEST_ASSERT_EQUAL_UINT32(samples, g_shimBroker.messages.size());
+    std::set<long> seen;
+    for (const ShimMessage& message : g_shimBroker.messages) {
+        TEST_ASSERT_EQUAL_UINT8(1, message.qos);
+        std::string text((const char*)message.payload, message.length);
+        size_t at = text.find("\"power\":");
+        TEST_ASSERT_TRUE(at != std::string::npos);
+        long number = atol(text.c_str() + at + 8);
+        TEST_ASSERT_TRUE(number >= 1 && number <= samples);
+        TEST_ASSERT_TRUE(seen.insert(number).second);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, client.getRetransmitCount());
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_out_of_order_acks);
+    RUN_TEST(test_resend_after_reconnect);
+    RUN_TEST(test_puback_timeout);
+    RUN_TEST(test_spill_into_spool);
+    return UNITY_END();
+}
@@ -0,0 +1,199 @@
+/**
+ * Poll loop timing - HoymilesHM::loop() must never block
+ *
+ * Eight simulated inverters with loss, so every poll state (retransmit,
+ * fragment request, timeout, inter-poll gap) is visited. Two bounds per
+ * loop() call:
+ *   virtual time  loop() must not advance millis() at all, i.e. it never
+ *                 calls delay() or waits for the radio
+ *   host time     worst case of one call, measured with steady_clock
+ *
+ * Also checks that the end of a poll cycle is reported once every due
+ * inverter was polled, so a BATCH message holds exactly one cycle.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include "hoymiles_hm.h"
+#include "hoymiles_radio_sim.h"
+#include "inverter_publisher.h"
+#include "config_manager.h"
+
+#define LOOP_DURATION       (5UL * 60UL * 1000UL)   // Simulated time (ms)
+#define LOOP_MAX_HOST_US    2000                    // Worst case of one loop() call on the host
+
+static const uint64_t SERIALS[] = {
+    0x114172000001ULL, 0x114172000002ULL, 0x116172000003ULL, 0x116172000004ULL,
+    0x112172000005ULL, 0x112172000006ULL, 0x114172000007ULL, 0x116172000008ULL
+};
+
+static uint32_t s_samples;
+
+static void onSample(void*, const InverterSample&) {
+    s_samples++;
+}
+
+void setUp() {
+    s_samples = 0;
+}
+
+void tearDown() {}
+
+void test_loop_does_not_block() {
+    SimulatedRadio radio(false, 11);
+    for (uint64_t serial : SERIALS) {
+        SimulatedInverter inverter = { serial, 30, 5, 10, 15, HOYMILES_SIM_ANY_CHANNEL, -70, true };
+        radio.addInverter(inverter);
+    }
+    // One silent inverter for the timeout and offline backoff paths
+    radio.getInverter(SERIALS[7])->online = false;
+
+    HoymilesHM hm;
+    hm.setRadio(&radio);
+    hm.begin();
+    for (uint64_t serial : SERIALS) {
+        hm.addInverter(serial);
+    }
+    hm.subscribe(onSample);
+
+    uint32_t blockingCalls = 0;
+    double worstUs = 0;
+    double totalUs = 0;
+    uint32_t calls = 0;
+
+    for (unsigned long t = 0; t < LOOP_DURATION; t++) {
+        unsigned long before = millis();
+        auto start = std::chrono::steady_clock::now();
+        hm.loop();
+        double us = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+        if (millis() != before) {
+            blockingCalls++;
+        }
+        if (us > worstUs) {
+            worstUs = us;
+        }
+        totalUs += us;
+        calls++;
+
+        shimAdvance(1);
+    }
+
+    char line[160];
+    snprintf(line, sizeof(line), "%lu loop() calls, %lu samples, mean %.2f us, worst %.1f us",
+             (unsigned long)calls, (unsigned long)s_samples, totalUs / calls, worstUs);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(0, blockingCalls);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, radio.getStats().fragmentRequests);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, s_samples);
+    TEST_ASSERT_TRUE(worstUs < LOOP_MAX_HOST_US);
+}
+
+/**
+ * The inverters answer only while loop() keeps running: a slow response
+ * spans many loop() calls instead of one long one
+ */
+void test_response_spans_loop_calls() {
+    SimulatedRadio radio(false, 5);
+    SimulatedInverter inverter = { SERIALS[0], 200, 40, 0, 0, HOYMILES_SIM_ANY_CHANNEL, -60, true };
+    radio.addInverter(inverter);
+
+    HoymilesHM hm;
+    hm.setRadio(&radio);
+    hm.begin();
+    hm.addInverter(SERIALS[0]);
+    hm.subscribe(onSample);
+
+    uint32_t calls = 0;
+    while (s_samples == 0 && calls < 10000) {
+        unsigned long before = millis();
+        hm.loop();
+        TEST_ASSERT_EQUAL_UINT32(before, millis());
+        shimAdvance(1);
+        calls++;
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(1, s_samples);
+    // 200 ms latency plus the fragment gaps, one call per virtual ms
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(200, calls);
+}
+
+struct CycleCheck {
+    InverterPublisher* publisher;
+    uint32_t cycles;
+    uint32_t samplesInCycle;
+};
+
+static void onCycleSample(void* context, const InverterSample& sample) {
+    CycleCheck& check = *(CycleCheck*)context;
+    check.samplesInCycle++;
+    check.publisher->publish(sample);
+}
+
+static void onCycleEnd(void* context) {
+    CycleCheck& check = *(CycleCheck*)context;
+    // Every inverter once; a second sample of one would have split the batch
+    TEST_ASSERT_EQUAL_UINT32(4, check.samplesInCycle);
+    check.samplesInCycle = 0;
+    check.cycles++;
+    TEST_ASSERT_TRUE(check.publisher->flush());
+}
+
+void test_cycle_end_flushes_batch() {
+    static MqttClient client;
+    MqttConfig config;
+    config.host = "broker.local";
+    config.port = 1883;
+    config.ssl = false;
+    client.begin(config);
+    client.connect();
+    g_shimBroker.online = true;
+    g_shimBroker.clear();
+
+    InverterPublisher publisher(client);
+    publisher.begin("opendtu/240AC4000001", InverterTopicLayout::BATCH);
+    // Far beyond the test, so only the cycle end sends batches
+    publisher.setBatchHold(LOOP_DURATION);
+
+    SimulatedRadio radio(false, 3);
+    HoymilesHM hm;
+    hm.setRadio(&radio);
+    hm.begin();
+    for (uint8_t i = 0; i < 4; i++) {
+        SimulatedInverter inverter = { SERIALS[i], 30, 5, 0, 0, HOYMILES_SIM_ANY_CHANNEL, -70, true };
+        radio.addInverter(inverter);
+        hm.addInverter(SERIALS[i]);
+    }
+
+    CycleCheck check = { &publisher, 0, 0 };
+    hm.subscribe(onCycleSample, &check);
+    hm.onCycleEnd(onCycleEnd, &check);
+
+    for (unsigned long t = 0; t < 60000; t++) {
+        hm.loop();
+        publisher.loop();
+        shimAdvance(1);
+    }
+
+    // One cycle per poll interval, each batch with all four inverters
+    TEST_ASSERT_EQUAL_UINT32(60000 / HOYMILES_POLL_INTERVAL, check.cycles);
+    TEST_ASSERT_EQUAL_UINT32(check.cycles, g_shimBroker.messages.size());
+    for (const ShimMessage& message : g_shimBroker.messages) {
+        std::string text((const char*)message.payload, message.length);
+        size_t elements = 0;
+        for (size_t at = text.find("\"serial\""); at != std::string::npos; at = text.find("\"serial\"", at + 1)) {
+            elements++;
+        }
+        TEST_ASSERT_EQUAL_UINT32(4, elements);
+    }
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_loop_does_not_block);
+    RUN_TEST(test_response_spans_loop_calls);
+    RUN_TEST(test_cycle_end_flushes_batch);
+    return UNITY_END();
+}
@@ -0,0 +1,144 @@
+/**
+ * Publish bench - bytes on the wire and CPU per poll cycle by topic layout
+ *
+ * 8 inverters report once per cycle; the JSON and FIELDS layouts send one
+ * or more messages per inverter, BATCH one message per cycle. Each message
+ * is costed as it leaves the device:
+ *   MQTT PUBLISH   fixed header, remaining length, topic length, topic,
+ *                  payload (QoS 0)
+ *   TLS record     5 header + 8 explicit nonce + 16 tag (TLS 1.2 AES-GCM)
+ *   TCP/IPv4       20 + 20 header bytes per segment (one per message)
+ * CPU is the host time of formatting and publishing a cycle into the
+ * PubSubClient shim. Run with: pio test -e native -f test_publish_bench
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include "inverter_publisher.h"
+#include "config_manager.h"
+
+#define BENCH_INVERTERS     8
+#define BENCH_CYCLES        20000
+
+#define WIRE_TLS_OVERHEAD   29
+#define WIRE_TCP_OVERHEAD   40
+
+struct BenchResult {
+    uint32_t messageCount;  // All cycles
+    double messages;        // Per cycle
+    double mqttBytes;
+    double wireBytes;
+    double hostUs;
+};
+
+static MqttClient s_client;
+static InverterSample s_samples[BENCH_INVERTERS];
+
+/**
+ * Bytes of one QoS 0 PUBLISH including TLS and TCP/IP overhead
+ */
+static size_t wireBytes(const ShimMessage& message, size_t* mqttBytes) {
+    size_t remaining = 2 + strlen(message.topic) + message.length;
+    size_t lengthBytes = remaining < 128 ? 1 : remaining < 16384 ? 2 : 3;
+    *mqttBytes = 1 + lengthBytes + remaining;
+    return *mqttBytes + WIRE_TLS_OVERHEAD + WIRE_TCP_OVERHEAD;
+}
+
+static BenchResult runCycles(InverterTopicLayout layout) {
+    InverterPublisher publisher(s_client);
+    publisher.begin("opendtu/240AC4000001", layout);
+
+    // Render the topics and prime the FIELDS cache
+    for (InverterSample& sample : s_samples) {
+        publisher.publish(sample);
+    }
+    publisher.flush();
+    g_shimBroker.clear();
+
+    uint64_t messages = 0, mqtt = 0, wire = 0;
+    double hostNs = 0;
+    for (uint32_t c = 0; c < BENCH_CYCLES; c++) {
+        auto start = std::chrono::steady_clock::now();
+        for (InverterSample& sample : s_samples) {
+            // AC power moves by 30 W every cycle: FIELDS sends only that topic
+            sample.data.values[0][FIELD_POWER] += (c & 1) ? 300 : -300;
+            publisher.publish(sample);
+        }
+        publisher.flush();
+        hostNs += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+
+        for (const ShimMessage& message : g_shimBroker.messages) {
+            size_t mqttBytes;
+            wire += wireBytes(message, &mqttBytes);
+            mqtt += mqttBytes;
+        }
+        messages += g_shimBroker.messages.size();
+        g_shimBroker.clear();
+    }
+
+    BenchResult result;
+    result.messageCount = (uint32_t)messages;
+    result.messages = (double)messages / BENCH_CYCLES;
+    result.mqttBytes = (double)mqtt / BENCH_CYCLES;
+    result.wireBytes = (double)wire / BENCH_CYCLES;
+    result.hostUs = hostNs / 1000.0 / BENCH_CYCLES;
+    return result;
+}
+
+static void report(const char* name, const BenchResult& result) {
+    char line[160];
+    snprintf(line, sizeof(line), "%-6s %5.1f msgs/cycle, %6.0f MQTT bytes, %6.0f wire bytes (TLS+TCP), %6.2f us CPU per cycle",
+             name, result.messages, result.mqttBytes, result.wireBytes, result.hostUs);
+    TEST_MESSAGE(line);
+}
+
+void setUp() {
+    g_shimBroker.online = true;
+    g_shimBroker.clear();
+}
+
+void tearDown() {}
+
+void test_batch_vs_per_inverter() {
+    BenchResult json = runCycles(InverterTopicLayout::JSON);
+    BenchResult fields = runCycles(InverterTopicLayout::FIELDS);
+    BenchResult batch = runCycles(InverterTopicLayout::BATCH);
+
+    report("JSON", json);
+    report("FIELDS", fields);
+    report("BATCH", batch);
+
+    char line[96];
+    snprintf(line, sizeof(line), "BATCH saves %.0f%% of the wire bytes of JSON", 100.0 * (1.0 - batch.wireBytes / json.wireBytes));
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT32(BENCH_INVERTERS * BENCH_CYCLES, json.messageCount);
+    TEST_ASSERT_EQUAL_UINT32(BENCH_CYCLES, batch.messageCount);
+    TEST_ASSERT_TRUE(batch.wireBytes < json.wireBytes);
+}
+
+int main() {
+    g_shimBroker.messages.reserve(4 * BENCH_INVERTERS * INVERTER_PUBLISHER_MAX_FIELDS);
+
+    MqttConfig config;
+    config.host = "broker.local";
+    config.port = 8883;
+    config.ssl = false;
+    s_client.begin(config);
+    s_client.connect();
+
+    for (uint8_t i = 0; i < BENCH_INVERTERS; i++) {
+        uint64_t serial = 0x116172000001ULL + i;
+        s_samples[i].reset(serial, findHoymilesModel(serial, nullptr));
+        for (uint8_t ch = 0; ch <= s_samples[i].data.dcChannels; ch++) {
+            for (uint8_t f = 0; f < FIELD_COUNT; f++) {
+                s_samples[i].data.values[ch][f] = 2300 + ch * 10 + f * 7 + i;
+            }
+        }
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_batch_vs_per_inverter);
+    return UNITY_END();
+}
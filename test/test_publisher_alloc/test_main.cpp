@@ -0,0 +1,153 @@
+/**
+ * Inverter publisher - publishing does not allocate
+ *
+ * Samples go through InverterPublisher and MqttClient into the
+ * PubSubClient shim in every layout and encoding. Global operator new is
+ * counted: once the topics are rendered (first publish per inverter), a
+ * publish must run without a heap allocation.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <new>
+#include "inverter_publisher.h"
+#include "config_manager.h"
+
+#define ALLOC_PUBLISHES     10000
+
+static uint32_t s_allocations;
+
+void* operator new(size_t size) {
+    s_allocations++;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+static const uint64_t SERIALS[] = { 0x114172000001ULL, 0x116172000002ULL };
+
+static MqttClient s_client;
+static InverterSample s_samples[2];
+static uint32_t s_messages;
+
+/**
+ * Publish ALLOC_PUBLISHES samples with moving values
+ * @return Operator new calls during the publishes
+ */
+static uint32_t publishSamples(InverterPublisher& publisher) {
+    // Topics are rendered on the first publish of each inverter
+    for (InverterSample& sample : s_samples) {
+        publisher.publish(sample);
+    }
+    publisher.flush();
+    g_shimBroker.clear();
+
+    uint32_t allocations = s_allocations;
+    s_messages = 0;
+    for (uint32_t i = 0; i < ALLOC_PUBLISHES; i++) {
+        InverterSample& sample = s_samples[i & 1];
+        sample.data.values[0][FIELD_POWER] = 5000 + (int32_t)(i % 100) * 100;
+        sample.data.values[1][FIELD_YIELD_DAY] = (int32_t)i;
+        publisher.publish(sample);
+
+        // clear() keeps the capacity, so recording never allocates
+        s_messages += g_shimBroker.messages.size();
+        g_shimBroker.clear();
+    }
+    publisher.flush();
+    s_messages += g_shimBroker.messages.size();
+    g_shimBroker.clear();
+
+    return s_allocations - allocations;
+}
+
+static void report(const char* name, uint32_t allocations) {
+    char line[96];
+    snprintf(line, sizeof(line), "%s: %u publishes, %lu messages, %lu allocations", name, ALLOC_PUBLISHES,
+             (unsigned long)s_messages, (unsigned long)allocations);
+    TEST_MESSAGE(line);
+}
+
+void setUp() {
+    g_shimBroker.online = true;
+    g_shimBroker.clear();
+}
+
+void tearDown() {}
+
+void test_json_does_not_allocate() {
+    InverterPublisher publisher(s_client);
+    publisher.begin("solar/240AC4000001");
+
+    uint32_t allocations = publishSamples(publisher);
+    report("JSON", allocations);
+    TEST_ASSERT_EQUAL_UINT32(ALLOC_PUBLISHES, s_messages);
+    TEST_ASSERT_EQUAL_UINT32(0, allocations);
+}
+
+void test_cbor_does_not_allocate() {
+    InverterPublisher publisher(s_client);
+    publisher.begin("solar/240AC4000001");
+    publisher.setEncoding(InverterPayloadEncoding::CBOR);
+
+    uint32_t allocations = publishSamples(publisher);
+    report("CBOR", allocations);
+    TEST_ASSERT_EQUAL_UINT32(ALLOC_PUBLISHES, s_messages);
+    TEST_ASSERT_EQUAL_UINT32(0, allocations);
+}
+
+void test_fields_do_not_allocate() {
+    InverterPublisher publisher(s_client);
+    publisher.begin("solar", InverterTopicLayout::FIELDS);
+
+    uint32_t allocations = publishSamples(publisher);
+    report("FIELDS", allocations);
+    // Power and the yields leave their deadbands with every sample
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2 * ALLOC_PUBLISHES, s_messages);
+    TEST_ASSERT_EQUAL_UINT32(0, allocations);
+}
+
+void test_batch_does_not_allocate() {
+    InverterPublisher publisher(s_client);
+    publisher.begin("solar/240AC4000001", InverterTopicLayout::BATCH);
+
+    uint32_t allocations = publishSamples(publisher);
+    report("BATCH", allocations);
+    // One message per cycle of both inverters
+    TEST_ASSERT_EQUAL_UINT32(ALLOC_PUBLISHES / 2, s_messages);
+    TEST_ASSERT_EQUAL_UINT32(0, allocations);
+}
+
+int main() {
+    g_shimBroker.messages.reserve(64);
+
+    MqttConfig config;
+    config.host = "broker.local";
+    config.port = 1883;
+    config.ssl = false;
+    s_client.begin(config);
+    s_client.connect();
+
+    for (uint8_t i = 0; i < 2; i++) {
+        s_samples[i].reset(SERIALS[i], findHoymilesModel(SERIALS[i], nullptr));
+        s_samples[i].data.values[0][FIELD_VOLTAGE] = 2301;
+        s_samples[i].data.values[1][FIELD_CURRENT] = 412;
+    }
+
+    UNITY_BEGIN();
+    RUN_TEST(test_json_does_not_allocate);
+    RUN_TEST(test_cbor_does_not_allocate);
+    RUN_TEST(test_fields_do_not_allocate);
+    RUN_TEST(test_batch_does_not_allocate);
+    return UNITY_END();
+}
@@ -0,0 +1,280 @@
+/**
+ * Radio simulator bench - HoymilesHM / HoymilesHMS against SimulatedRadio
+ *
+ * Drives the real poll state machines against N virtual inverters with
+ * latency, loss and fragmentation, in virtual time, and reports:
+ *   throughput    samples decoded per simulated minute, and host time per
+ *                 simulated hour (cost of the poll logic)
+ *   success rate  samples / realtime requests sent (every retransmit and
+ *                 offline probe counts as a request)
+ *   frames missed answer packets sent on a channel the DTU did not listen on
+ * Run with: pio test -e native -f test_radio_sim
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <chrono>
+#include "hoymiles_hm.h"
+#include "hoymiles_hms.h"
+#include "hoymiles_radio_sim.h"
+
+#define BENCH_DURATION      (10UL * 60UL * 1000UL)     // Simulated time per run (ms)
+#define BENCH_STEP          1                           // ms of virtual time per loop() call
+
+struct BenchResult {
+    uint32_t samples[HOYMILES_SIM_MAX_INVERTERS];
+    uint32_t total;
+    uint32_t badValues;
+    double hostMs;
+};
+
+static const uint64_t* s_serials;
+static uint8_t s_serialCount;
+static BenchResult s_result;
+
+static void onSample(void*, const InverterSample& sample) {
+    for (uint8_t i = 0; i < s_serialCount; i++) {
+        if (s_serials[i] == sample.serial) {
+            s_result.samples[i]++;
+        }
+    }
+    s_result.total++;
+    // SimulatedRadio answers with fixed AC values (540.2 W, 230.1 V)
+    if (sample.getPower() != 5402 || sample.getVoltage() != 2301) {
+        s_result.badValues++;
+    }
+}
+
+static void fillFleet(SimulatedRadio& radio, const uint64_t* serials, uint8_t count,
+                      uint16_t latency, uint8_t loss) {
+    for (uint8_t i = 0; i < count; i++) {
+        SimulatedInverter inverter = { serials[i], latency, 5, loss, loss,
+                                       HOYMILES_SIM_ANY_CHANNEL, -65, true };
+        TEST_ASSERT_TRUE(radio.addInverter(inverter));
+    }
+    s_serials = serials;
+    s_serialCount = count;
+    memset(&s_result, 0, sizeof(s_result));
+}
+
+template <typename Driver>
+static void run(Driver& driver) {
+    auto start = std::chrono::steady_clock::now();
+    for (unsigned long t = 0; t < BENCH_DURATION; t += BENCH_STEP) {
+        driver.loop();
+        shimAdvance(BENCH_STEP);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    s_result.hostMs = std::chrono::duration<double, std::milli>(elapsed).count();
+}
+
+static double report(const char* name, const SimulatedRadio& radio, uint8_t count) {
+    const SimulatedRadio::Stats& stats = radio.getStats();
+    uint32_t requests = stats.requests + stats.requestsLost;
+    double successRate = requests ? (double)s_result.total / requests : 0.0;
+
+    char line[200];
+    snprintf(line, sizeof(line),
+             "%s: %u inverters, %lu samples/min, success %.1f %%, %u requests (%u lost), "
+             "%u fragment requests, %u frames missed, %.0f ms host time per simulated hour",
+             name, count, (unsigned long)(s_result.total * 60000UL / BENCH_DURATION),
+             successRate * 100.0, requests, stats.requestsLost, stats.fragmentRequests,
+             stats.framesMissed, s_result.hostMs * 3600000.0 / BENCH_DURATION);
+    TEST_MESSAGE(line);
+    return successRate;
+}
+
+static const uint64_t HM_SERIALS[] = {
+    0x114172000001ULL, 0x114172000002ULL, 0x116172000003ULL, 0x116172000004ULL,
+    0x112172000005ULL, 0x112172000006ULL, 0x114172000007ULL, 0x116172000008ULL
+};
+
+static const uint64_t HMS_SERIALS[] = {
+    0x114482000001ULL, 0x114482000002ULL, 0x138282000003ULL, 0x138282000004ULL
+};
+
+void setUp() {}
+void tearDown() {}
+
+/**
+ * Clean air: every poll due must deliver a sample
+ */
+void test_hm_fleet_lossless() {
+    SimulatedRadio radio(false, 1);
+    fillFleet(radio, HM_SERIALS, 8, 20, 0);
+
+    HoymilesHM hm;
+    hm.setRadio(&radio);
+    hm.begin();
+    for (uint64_t serial : HM_SERIALS) {
+        hm.addInverter(serial);
+    }
+    hm.subscribe(onSample);
+    run(hm);
+
+    double successRate = report("HM lossless", radio, 8);
+    TEST_ASSERT_EQUAL_UINT32(0, s_result.badValues);
+    TEST_ASSERT_EQUAL_UINT32(0, radio.getStats().fragmentRequests);
+    TEST_ASSERT_TRUE(successRate > 0.95);
+}
+
+/**
+ * 10 % request and fragment loss: retransmits and fragment requests keep
+ * every inverter reporting
+ */
+void test_hm_fleet_lossy() {
+    SimulatedRadio radio(false, 42);
+    fillFleet(radio, HM_SERIALS, 8, 20, 10);
+
+    HoymilesHM hm;
+    hm.setRadio(&radio);
+    hm.begin();
+    for (uint64_t serial : HM_SERIALS) {
+        hm.addInverter(serial);
+    }
+    hm.subscribe(onSample);
+    run(hm);
+
+    double successRate = report("HM 10% loss", radio, 8);
+    TEST_ASSERT_EQUAL_UINT32(0, s_result.badValues);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, radio.getStats().fragmentRequests);
+    for (uint8_t i = 0; i < 8; i++) {
+        TEST_ASSERT_GREATER_THAN_UINT32(0, s_result.samples[i]);
+    }
+    TEST_ASSERT_TRUE(successRate > 0.75);
+}
+
+/**
+ * One inverter silent (night, out of range): the others keep their rate
+ */
+void test_hm_offline_inverter() {
+    SimulatedRadio radio(false, 7);
+    fillFleet(radio, HM_SERIALS, 4, 20, 0);
+    radio.getInverter(HM_SERIALS[3])->online = false;
+
+    HoymilesHM hm;
+    hm.setRadio(&radio);
+    hm.begin();
+    for (uint8_t i = 0; i < 4; i++) {
+        hm.addInverter(HM_SERIALS[i]);
+    }
+    hm.subscribe(onSample);
+    run(hm);
+
+    report("HM 1 of 4 offline", radio, 4);
+    TEST_ASSERT_EQUAL_UINT32(0, s_result.samples[3]);
+    TEST_ASSERT_EQUAL(InverterLinkState::OFFLINE, hm.getScheduler().getState(3));
+    uint32_t due = BENCH_DURATION / HOYMILES_POLL_INTERVAL;
+    for (uint8_t i = 0; i < 3; i++) {
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(due * 95 / 100, s_result.samples[i]);
+    }
+}
+
+/**
+ * A channel that drops most frames: hopping moves polls to better channels
+ */
+void test_hm_bad_channel() {
+    SimulatedRadio radio(false, 9);
+    fillFleet(radio, HM_SERIALS, 4, 20, 0);
+    radio.setChannelLoss(HOYMILES_SIM_DEFAULT_CHANNEL_HM, 80);
+
+    HoymilesHM hm;
+    hm.setRadio(&radio);
+    hm.begin();
+    for (uint8_t i = 0; i < 4; i++) {
+        hm.addInverter(HM_SERIALS[i]);
+    }
+    hm.subscribe(onSample);
+    run(hm);
+
+    double successRate = report("HM 80% loss on 2440 MHz", radio, 4);
+    TEST_ASSERT_TRUE(successRate > 0.8);
+}
+
+/**
+ * HM answers hop one channel per packet: the DTU follows them, also past
+ * packets lost on the air
+ */
+void test_hm_rx_hopping() {
+    SimulatedRadio radio(false, 5);
+    fillFleet(radio, HM_SERIALS, 4, 20, 0);
+
+    HoymilesHM hm;
+    hm.setRadio(&radio);
+    hm.begin();
+    for (uint8_t i = 0; i < 4; i++) {
+        hm.addInverter(HM_SERIALS[i]);
+    }
+    hm.subscribe(onSample);
+    run(hm);
+
+    // Clean air: every packet heard, on the channels after the request's
+    report("HM hopping answers", radio, 4);
+    TEST_ASSERT_EQUAL_UINT32(0, radio.getStats().framesMissed);
+    TEST_ASSERT_EQUAL_UINT32(0, radio.getStats().fragmentRequests);
+    for (uint8_t i = 0; i < 4; i++) {
+        const HoymilesChannelStats& channels = hm.getChannelStats(i);
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(BENCH_DURATION / HOYMILES_POLL_INTERVAL * 95 / 100, s_result.samples[i]);
+        // Polls go out on channel 40: the answers come on 61 and 75
+        TEST_ASSERT_EQUAL_INT(40, channels.getChannel());
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(s_result.samples[i] * 9 / 10, channels.getRxSuccesses(3));
+        TEST_ASSERT_GREATER_OR_EQUAL_UINT32(s_result.samples[i] * 9 / 10, channels.getRxSuccesses(4));
+        TEST_ASSERT_EQUAL_UINT32(channels.getRxAttempts(3), channels.getRxSuccesses(3));
+        TEST_ASSERT_TRUE(channels.getFirstRxDelay() >= 20 && channels.getFirstRxDelay() <= 22);
+    }
+
+    // 20 % of the packets lost: an overdue packet is skipped, the next one still heard
+    SimulatedRadio lossy(false, 6);
+    fillFleet(lossy, HM_SERIALS, 4, 20, 0);
+    for (uint8_t i = 0; i < 4; i++) {
+        lossy.getInverter(HM_SERIALS[i])->fragmentLoss = 20;
+    }
+
+    HoymilesHM follower;
+    follower.setRadio(&lossy);
+    follower.begin();
+    for (uint8_t i = 0; i < 4; i++) {
+        follower.addInverter(HM_SERIALS[i]);
+    }
+    follower.subscribe(onSample);
+    run(follower);
+
+    double successRate = report("HM hopping answers, 20% packet loss", lossy, 4);
+    const SimulatedRadio::Stats& stats = lossy.getStats();
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.framesLost);
+    TEST_ASSERT_LESS_THAN_UINT32(stats.framesLost / 10, stats.framesMissed);
+    TEST_ASSERT_GREATER_THAN_UINT32(0, stats.fragmentRequests);
+    TEST_ASSERT_TRUE(successRate > 0.85);
+}
+
+void test_hms_fleet_lossy() {
+    SimulatedRadio radio(true, 3);
+    fillFleet(radio, HMS_SERIALS, 4, 40, 5);
+
+    HoymilesHMS hms;
+    hms.setRadio(&radio);
+    hms.begin();
+    for (uint64_t serial : HMS_SERIALS) {
+        hms.addInverter(serial);
+    }
+    hms.subscribe(onSample);
+    run(hms);
+
+    double successRate = report("HMS 5% loss", radio, 4);
+    TEST_ASSERT_EQUAL_UINT32(0, s_result.badValues);
+    for (uint8_t i = 0; i < 4; i++) {
+        TEST_ASSERT_GREATER_THAN_UINT32(0, s_result.samples[i]);
+    }
+    TEST_ASSERT_TRUE(successRate > 0.75);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_hm_fleet_lossless);
+    RUN_TEST(test_hm_fleet_lossy);
+    RUN_TEST(test_hm_offline_inverter);
+    RUN_TEST(test_hm_bad_channel);
+    RUN_TEST(test_hm_rx_hopping);
+    RUN_TEST(test_hms_fleet_lossy);
+    return UNITY_END();
+}
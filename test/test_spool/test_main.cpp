@@ -0,0 +1,331 @@
+/**
+ * Telemetry spool - crash consistency and replay order
+ *
+ * Runs on the in-memory LittleFS of the host shim, whose write budget cuts
+ * a write short like a power loss. Checks that a torn frame is dropped and
+ * overwritten after the restart, that eviction discards the oldest data
+ * first, that random resets never reorder or invent messages (replay is
+ * at-least-once), and that the publisher sends live messages right away
+ * while the backlog replays, every message carrying its capture time.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+#include <set>
+#include "telemetry_spool.h"
+#include "inverter_publisher.h"
+#include "config_manager.h"
+
+#define SPOOL_TOPIC         "opendtu/240AC4000001/1912602625/data"
+#define SPOOL_FUZZ_ROUNDS   200
+#define SPOOL_FUZZ_STEPS    3000
+
+static bool appendSeq(TelemetrySpool& spool, int seq, int pad = 40) {
+    char payload[400];
+    int n = snprintf(payload, sizeof(payload), "{\"seq\":%d,\"pad\":\"%*s\"}", seq, pad, "");
+    return spool.append(SPOOL_TOPIC, (const uint8_t*)payload, n);
+}
+
+/**
+ * Sequence number of the oldest frame, -1 if the spool is empty
+ */
+static int peekSeq(TelemetrySpool& spool) {
+    const char* topic;
+    const uint8_t* payload;
+    size_t length;
+    if (!spool.peek(topic, payload, length)) {
+        return -1;
+    }
+    TEST_ASSERT_EQUAL_STRING(SPOOL_TOPIC, topic);
+
+    char text[512];
+    memcpy(text, payload, length < sizeof(text) - 1 ? length : sizeof(text) - 1);
+    text[length < sizeof(text) - 1 ? length : sizeof(text) - 1] = '\0';
+    int seq = -1;
+    TEST_ASSERT_EQUAL_INT(1, sscanf(text, "{\"seq\":%d", &seq));
+    return seq;
+}
+
+/**
+ * Integer after "<key>": in a message, -1 if the key is missing
+ */
+static long jsonInt(const ShimMessage& message, const char* key) {
+    std::string text((const char*)message.payload, message.length);
+    std::string pattern = std::string("\"") + key + "\":";
+    size_t at = text.find(pattern);
+    return at == std::string::npos ? -1 : atol(text.c_str() + at + pattern.size());
+}
+
+static void connectClient(MqttClient& client) {
+    MqttConfig config;
+    config.host = "broker.local";
+    config.port = 1883;
+    config.ssl = false;
+    client.begin(config);
+    client.connect();
+}
+
+void setUp() {
+    g_shimFs.clear();
+    g_shimBroker.online = true;
+    g_shimBroker.clear();
+}
+
+void tearDown() {}
+
+void test_torn_frame_is_overwritten() {
+    TelemetrySpool spool;
+    TEST_ASSERT_TRUE(spool.begin());
+    for (int i = 0; i < 10; i++) {
+        TEST_ASSERT_TRUE(appendSeq(spool, i));
+    }
+
+    // Power lost 20 bytes into the next frame
+    g_shimFs.writeBudget = 20;
+    TEST_ASSERT_FALSE(appendSeq(spool, 10));
+    g_shimFs.writeBudget = -1;
+
+    TelemetrySpool restarted;
+    TEST_ASSERT_TRUE(restarted.begin());
+    TEST_ASSERT_TRUE(appendSeq(restarted, 11));
+
+    for (int seq : { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 11 }) {
+        TEST_ASSERT_EQUAL_INT(seq, peekSeq(restarted));
+        restarted.pop();
+    }
+    TEST_ASSERT_TRUE(restarted.isEmpty());
+
+    // A drained spool is not replayed again
+    TelemetrySpool again;
+    TEST_ASSERT_TRUE(again.begin());
+    TEST_ASSERT_TRUE(again.isEmpty());
+}
+
+void test_eviction_keeps_order() {
+    TelemetrySpool spool;
+    TEST_ASSERT_TRUE(spool.begin());
+
+    int appended = 0;
+    while (spool.getEvictedCount() < 3) {
+        TEST_ASSERT_TRUE(appendSeq(spool, appended++));
+    }
+
+    size_t bytes = 0;
+    for (const auto& file : g_shimFs.files) {
+        bytes += file.second.size();
+    }
+    TEST_ASSERT_TRUE(bytes <= 2 * TELEMETRY_SPOOL_SEGMENT_SIZE);
+
+    // The newest messages survive, consecutive and oldest first
+    int previous = -1, first = -1, kept = 0, seq;
+    while ((seq = peekSeq(spool)) >= 0) {
+        if (previous >= 0) {
+            TEST_ASSERT_EQUAL_INT(previous + 1, seq);
+        } else {
+            first = seq;
+        }
+        previous = seq;
+        spool.pop();
+        kept++;
+    }
+    TEST_ASSERT_EQUAL_INT(appended - 1, previous);
+
+    char line[96];
+    snprintf(line, sizeof(line), "appended %d, kept %d (%d..%d), files %u bytes",
+             appended, kept, first, previous, (unsigned)bytes);
+    TEST_MESSAGE(line);
+}
+
+void test_resets_never_reorder() {
+    srand(1);
+    uint32_t acknowledged = 0, lost = 0, duplicates = 0;
+
+    for (int round = 0; round < SPOOL_FUZZ_ROUNDS; round++) {
+        g_shimFs.clear();
+        TelemetrySpool* spool = new TelemetrySpool();
+        TEST_ASSERT_TRUE(spool->begin());
+
+        std::set<int> appended, replayed;
+        int seq = 0, last = -1;
+        uint32_t evicted = 0;
+
+        auto restart = [&]() {
+            evicted += spool->getEvictedCount();
+            delete spool;
+            spool = new TelemetrySpool();
+            TEST_ASSERT_TRUE(spool->begin());
+            last = -1;      // Replay restarts at the oldest segment
+        };
+
+        for (int step = 0; step < SPOOL_FUZZ_STEPS; step++) {
+            int action = rand() % 100;
+            if (action < 55) {
+                bool cut = rand() % 50 == 0;
+                if (cut) {
+                    g_shimFs.writeBudget = rand() % 60;
+                }
+                if (appendSeq(*spool, seq, rand() % 300)) {
+                    appended.insert(seq);
+                }
+                seq++;
+                g_shimFs.writeBudget = -1;
+                if (cut) {
+                    restart();
+                }
+            } else if (action < 95) {
+                int value = peekSeq(*spool);
+                if (value >= 0) {
+                    TEST_ASSERT_TRUE(value > last);
+                    last = value;
+                    if (replayed.count(value)) {
+                        duplicates++;
+                    }
+                    replayed.insert(value);
+                    spool->pop();
+                }
+            } else {
+                restart();
+            }
+        }
+
+        int value;
+        while ((value = peekSeq(*spool)) >= 0) {
+            TEST_ASSERT_TRUE(value > last);
+            last = value;
+            replayed.insert(value);
+            spool->pop();
+        }
+        evicted += spool->getEvictedCount();
+        delete spool;
+
+        // Nothing that failed to append is replayed; without eviction nothing is lost
+        for (int x : replayed) {
+            TEST_ASSERT_TRUE(appended.count(x) > 0);
+        }
+        for (int a : appended) {
+            if (!replayed.count(a)) {
+                TEST_ASSERT_TRUE(evicted > 0);
+                lost++;
+            }
+        }
+        acknowledged += appended.size();
+    }
+
+    char line[128];
+    snprintf(line, sizeof(line), "%lu appended, %lu lost to eviction, %lu replayed twice after resets",
+             (unsigned long)acknowledged, (unsigned long)lost, (unsigned long)duplicates);
+    TEST_MESSAGE(line);
+}
+
+void test_live_messages_bypass_backlog() {
+    static MqttClient client;
+    connectClient(client);
+
+    TelemetrySpool spool;
+    TEST_ASSERT_TRUE(spool.begin());
+    InverterPublisher publisher(client);
+    publisher.begin("opendtu/240AC4000001");
+    publisher.setSpool(&spool);
+
+    InverterSample sample;
+    sample.reset(0x114172000001ULL, findHoymilesModel(0x114172000001ULL, nullptr));
+
+    // Power carries the sample number, one sample per second; the first 20 are spooled offline
+    auto capture = [&](int32_t number) {
+        sample.data.values[0][FIELD_POWER] = number * 10;
+        sample.timestamp = millis();
+        TEST_ASSERT_TRUE(publisher.publish(sample));
+    };
+
+    g_shimBroker.online = false;
+    int32_t next = 1;
+    uint32_t firstTime = (uint32_t)time(nullptr);
+    for (; next <= 20; next++) {
+        capture(next);
+        shimAdvance(1000);
+        publisher.loop();
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, g_shimBroker.messages.size());
+
+    // Back online: each live sample reaches the broker at once, the backlog drains alongside
+    g_shimBroker.online = true;
+    for (int step = 0; step < 400; step++) {
+        if (step % 10 == 0 && next <= 40) {
+            size_t before = g_shimBroker.messages.size();
+            capture(next);
+            TEST_ASSERT_EQUAL_UINT32(before + 1, g_shimBroker.messages.size());
+            TEST_ASSERT_EQUAL_INT(next, jsonInt(g_shimBroker.messages.back(), "power"));
+            next++;
+        }
+        shimAdvance(TELEMETRY_SPOOL_REPLAY_INTERVAL);
+        publisher.loop();
+
+        // Replay outpaces the live rate: one backlog second per replay interval
+        if (step == 20) {
+            TEST_ASSERT_TRUE(spool.isEmpty());
+        }
+    }
+    TEST_ASSERT_TRUE(spool.isEmpty());
+
+    // Every sample once; "ts" restores the sample order
+    TEST_ASSERT_EQUAL_UINT32(40, g_shimBroker.messages.size());
+    std::set<int> seen;
+    for (const ShimMessage& message : g_shimBroker.messages) {
+        long number = jsonInt(message, "power");
+        TEST_ASSERT_TRUE(number >= 1 && number <= 40);
+        TEST_ASSERT_TRUE(seen.insert((int)number).second);
+        TEST_ASSERT_EQUAL_UINT32(firstTime + (uint32_t)(number - 1), (uint32_t)jsonInt(message, "ts"));
+    }
+    TEST_ASSERT_EQUAL_INT(21, jsonInt(g_shimBroker.messages.front(), "power"));
+}
+
+void test_batch_elements_carry_capture_time() {
+    static MqttClient client;
+    connectClient(client);
+
+    TelemetrySpool spool;
+    TEST_ASSERT_TRUE(spool.begin());
+    InverterPublisher publisher(client);
+    publisher.begin("opendtu/240AC4000001", InverterTopicLayout::BATCH);
+    publisher.setSpool(&spool);
+
+    InverterSample first, second;
+    first.reset(0x114172000001ULL, findHoymilesModel(0x114172000001ULL, nullptr));
+    second.reset(0x114172000002ULL, findHoymilesModel(0x114172000002ULL, nullptr));
+
+    // Two inverters polled 3 s apart while offline, spooled as one batch
+    g_shimBroker.online = false;
+    uint32_t firstTime = (uint32_t)time(nullptr);
+    first.timestamp = millis();
+    TEST_ASSERT_TRUE(publisher.publish(first));
+    shimAdvance(3000);
+    second.timestamp = millis();
+    TEST_ASSERT_TRUE(publisher.publish(second));
+    TEST_ASSERT_TRUE(publisher.flush());
+    TEST_ASSERT_FALSE(spool.isEmpty());
+
+    // Replayed a minute later, each element keeps the time of its own response
+    shimAdvance(60000);
+    g_shimBroker.online = true;
+    publisher.loop();
+    TEST_ASSERT_TRUE(spool.isEmpty());
+    TEST_ASSERT_EQUAL_UINT32(1, g_shimBroker.messages.size());
+
+    const ShimMessage& batch = g_shimBroker.messages[0];
+    std::string text((const char*)batch.payload, batch.length);
+    char expected[96];
+    snprintf(expected, sizeof(expected), "[{\"serial\":1912602625,\"ts\":%lu,", (unsigned long)firstTime);
+    TEST_ASSERT_EQUAL_INT(0, text.find(expected));
+    snprintf(expected, sizeof(expected), "{\"serial\":1912602626,\"ts\":%lu,", (unsigned long)firstTime + 3);
+    TEST_ASSERT_TRUE(text.find(expected) != std::string::npos);
+}
+
+int main() {
+    UNITY_BEGIN();
+    RUN_TEST(test_torn_frame_is_overwritten);
+    RUN_TEST(test_eviction_keeps_order);
+    RUN_TEST(test_resets_never_reorder);
+    RUN_TEST(test_live_messages_bypass_backlog);
+    RUN_TEST(test_batch_elements_carry_capture_time);
+    return UNITY_END();
+}